@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "animation.h"
+
+float animation_linear(float t) {
+    return t;
+}
+
+float animation_ease_in(float t) {
+    return t * t * t;
+}
+
+float animation_ease_out(float t) {
+    t = 1.0f - t;
+    return 1.0f - t * t * t;
+}
+
+float animation_ease_in_out(float t) {
+    if (t < 0.5f) {
+        return 4.0f * t * t * t;
+    }
+    t = 2.0f - 2.0f * t;
+    return 1.0f - 0.5f * t * t * t;
+}
+
+double animation_time() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+void animator_init(animator_t* animator) {
+    animator->count = 0;
+    animator->now = animation_time();
+    animator->paused = 0;
+}
+
+//Returns the slot animating a value, reusing the one already running on it
+static animation_t* animator_slot(animator_t* animator, const float* value) {
+    int i;
+
+    for (i = 0; i < animator->count; i++) {
+        if (animator->animations[i].value == value) {
+            return &animator->animations[i];
+        }
+    }
+
+    if (animator->count == ANIMATION_MAX) {
+        return NULL;
+    }
+
+    return &animator->animations[animator->count++];
+}
+
+static int animator_start(animator_t* animator, float* value, float to, float duration, animation_ease_t ease) {
+    animation_t* animation = animator_slot(animator, value);
+
+    if (!animation) {
+        return EXIT_FAILURE;
+    }
+
+    //Start from the time of the last update, the frame being built is drawn for that time
+    animation->value = value;
+    animation->from = *value;
+    animation->to = to;
+    animation->start = animator->now;
+    animation->duration = duration;
+    animation->ease = ease;
+
+    return EXIT_SUCCESS;
+}
+
+int animator_tween(animator_t* animator, float* value, float to, float duration, animation_ease_t ease) {
+    return animator_start(animator, value, to, duration, ease ? ease : animation_linear);
+}
+
+int animator_spin(animator_t* animator, float* value, float rate, float period) {
+    return animator_start(animator, value, rate, period, NULL);
+}
+
+void animator_stop(animator_t* animator, const float* value) {
+    int i;
+
+    for (i = 0; i < animator->count; i++) {
+        if (animator->animations[i].value == value) {
+            animator->animations[i] = animator->animations[--animator->count];
+            return;
+        }
+    }
+}
+
+int animator_is_running(const animator_t* animator, const float* value) {
+    int i;
+
+    for (i = 0; i < animator->count; i++) {
+        if (animator->animations[i].value == value) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+void animator_update(animator_t* animator) {
+    int i = 0;
+
+    if (animator->paused) {
+        return;
+    }
+
+    const double now = animation_time();
+    animator->now = now;
+
+    while (i < animator->count) {
+        animation_t* animation = &animator->animations[i];
+        const double elapsed = now - animation->start;
+
+        if (!animation->ease) {
+            //Spins are worked out in double, a float clock loses precision after a few hours
+            double value = animation->from + animation->to * elapsed;
+            if (animation->duration > 0.0f) {
+                value = fmod(value, animation->duration);
+            }
+            *animation->value = (float)value;
+        } else if (elapsed < animation->duration) {
+            *animation->value = animation->from
+                    + (animation->to - animation->from) * animation->ease((float)(elapsed / animation->duration));
+        } else {
+            //Finished, the last slot moves into this one
+            *animation->value = animation->to;
+            *animation = animator->animations[--animator->count];
+            continue;
+        }
+
+        i++;
+    }
+}
+
+void animator_pause(animator_t* animator) {
+    if (!animator->paused) {
+        animator->now = animation_time();
+        animator->paused = 1;
+    }
+}
+
+void animator_resume(animator_t* animator) {
+    int i;
+
+    if (!animator->paused) {
+        return;
+    }
+
+    //Shift every start forward by the time spent paused
+    const double now = animation_time();
+    const double paused_for = now - animator->now;
+
+    for (i = 0; i < animator->count; i++) {
+        animator->animations[i].start += paused_for;
+    }
+    animator->now = now;
+    animator->paused = 0;
+}
@@ -14,48 +14,198 @@
  * limitations under the License.
  */
 
+#include "animation.h"
+#include "mesh.h"
+#include "vecmath.h"
+
 #include <glview/glview.h>
 
-#include <GLES/gl.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
 
-static const GLfloat vertices[] =
+// Colors of the front, right, back, left, top and bottom face
+static const GLubyte face_colors[6][4] =
 {
-      // front
-      -0.5f, 0.5f, 0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f,
-       0.5f, 0.5f, 0.5f, -0.5f, -0.5f, 0.5f, 0.5f, -0.5f, 0.5f,
+      { 16, 146, 236, 255 },
+      { 75, 170, 236, 255 },
+      { 134, 194, 236, 255 },
+      { 16, 146, 236, 255 },
+      { 75, 170, 236, 255 },
+      { 134, 194, 236, 255 }
+};
 
-      // right
-      0.5f, 0.5f, 0.5f, 0.5f, -0.5f, 0.5f, 0.5f, 0.5f, -0.5f,
-      0.5f, 0.5f, -0.5f, 0.5f, -0.5f, 0.5f, 0.5f, -0.5f, -0.5f,
+// Set CUBEROTATE_STRESS to a number of cubes to draw that many in a block and log the throughput
+#define STRESS_REPORT_SECONDS 5.0
 
-      // back
-      0.5f, 0.5f, -0.5f, 0.5f, -0.5f, -0.5f, -0.5f, 0.5f, -0.5f,
-      -0.5f, 0.5f, -0.5f, 0.5f, -0.5f, -0.5f, -0.5f, -0.5f, -0.5f,
+static mesh_t *meshes = NULL;
+static int mesh_count = 0;
+static int cube_count = 1;
+static bool reporting = false;
+static double report_time = 0.0;
+static int report_frames = 0;
+static double submit_time = 0.0;
 
-      // left
-      -0.5f, 0.5f, -0.5f, -0.5f, -0.5f, -0.5f, -0.5f, 0.5f, 0.5f,
-      -0.5f, 0.5f, 0.5f, -0.5f, -0.5f, -0.5f, -0.5f, -0.5f, 0.5f,
+// Built with make GLES=1 the cubes are drawn with the OpenGL ES 1.1 fixed function pipeline instead of shaders
+#ifdef USING_GL11
+#define GLES_VERSION "1.1"
+#else
+#define GLES_VERSION "2.0"
+#endif
 
-      // top
-      -0.5f, 0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f, -0.5f,
-       0.5f, 0.5f, -0.5f, -0.5f, 0.5f, 0.5f, 0.5f, 0.5f, 0.5f,
+// The cube turns at one degree per frame at 60 frames per second, whatever the actual frame rate
+#define DEGREES_PER_SECOND 60.0f
 
-      // bottom
-      -0.5f, -0.5f, 0.5f, -0.5f, -0.5f, -0.5f, 0.5f, -0.5f, 0.5f,
-       0.5f, -0.5f, 0.5f, -0.5f, -0.5f, -0.5f, 0.5f, -0.5f, -0.5f
-};
+static float angle = 0.0f;
+static animator_t animator;
+
+// The rotation is rebuilt from the angle every frame, so no error builds up in the matrix
+static mat4_t projection;
+
+#ifdef USING_GL20
+static GLuint program = 0;
+static GLint position_loc;
+static GLint color_loc;
+static GLint mvp_loc;
 
-static const GLfloat colors[] =
+static const char *vertex_source =
+        "uniform mat4 u_mvp;"
+        "attribute vec4 a_position;"
+        "attribute vec4 a_color;"
+        "varying lowp vec4 v_color;"
+        "void main()"
+        "{"
+        "    gl_Position = u_mvp * a_position;"
+        "    v_color = a_color;"
+        "}";
+
+static const char *fragment_source =
+        "varying lowp vec4 v_color;"
+        "void main()"
+        "{"
+        "    gl_FragColor = v_color;"
+        "}";
+
+static GLuint
+compile_shader(GLenum type, const char *source)
 {
-       /* front  */  0.0625f,0.57421875f,0.92578125f,1.0f, 0.0625f,0.57421875f,0.92578125f,1.0f, 0.0625f,0.57421875f,0.92578125f,1.0f, 0.0625f,0.57421875f,0.92578125f,1.0f, 0.0625f,0.57421875f,0.92578125f,1.0f, 0.0625f,0.57421875f,0.92578125f,1.0f,
-       /* right  */  0.29296875f,0.66796875f,0.92578125f,1.0f,0.29296875f,0.66796875f,0.92578125f,1.0f, 0.29296875f,0.66796875f,0.92578125f,1.0f, 0.29296875f,0.66796875f,0.92578125f,1.0f, 0.29296875f,0.66796875f,0.92578125f,1.0f, 0.29296875f,0.66796875f,0.92578125f,1.0f,
-       /* back   */  0.52734375f,0.76171875f,0.92578125f,1.0f, 0.52734375f,0.76171875f,0.92578125f,1.0f,0.52734375f,0.76171875f,0.92578125f,1.0f, 0.52734375f,0.76171875f,0.92578125f,1.0f, 0.52734375f,0.76171875f,0.92578125f,1.0f, 0.52734375f,0.76171875f,0.92578125f,1.0f,
-       /* left   */  0.0625f,0.57421875f,0.92578125f,1.0f, 0.0625f,0.57421875f,0.92578125f,1.0f, 0.0625f,0.57421875f,0.92578125f,1.0f, 0.0625f,0.57421875f,0.92578125f,1.0f,0.0625f,0.57421875f,0.92578125f,1.0f, 0.0625f,0.57421875f,0.92578125f,1.0f,
-       /* top    */  0.29296875f,0.66796875f,0.92578125f,1.0f, 0.29296875f,0.66796875f,0.92578125f,1.0f,0.29296875f,0.66796875f,0.92578125f,1.0f,0.29296875f,0.66796875f,0.92578125f,1.0f,0.29296875f,0.66796875f,0.92578125f,1.0f,0.29296875f,0.66796875f,0.92578125f,1.0f,
-       /* bottom */  0.52734375f,0.76171875f,0.92578125f,1.0f,0.52734375f,0.76171875f,0.92578125f,1.0f,0.52734375f,0.76171875f,0.92578125f,1.0f,0.52734375f,0.76171875f,0.92578125f,1.0f,0.52734375f,0.76171875f,0.92578125f,1.0f,0.52734375f,0.76171875f,0.92578125f,1.0f
-};
+    GLint status;
+    GLuint shader = glCreateShader(type);
+
+    if (!shader) {
+        fprintf(stderr, "Failed to create shader: %d\n", glGetError());
+        return 0;
+    }
+
+    glShaderSource(shader, 1, &source, 0);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (GL_FALSE == status) {
+        GLchar log[256];
+        glGetShaderInfoLog(shader, 256, NULL, log);
+        fprintf(stderr, "Failed to compile shader: %s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+static int
+create_program(void)
+{
+    GLint status;
+    GLuint vs = compile_shader(GL_VERTEX_SHADER, vertex_source);
+    GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+
+    if (vs && fs) {
+        program = glCreateProgram();
+    }
+    if (program) {
+        glAttachShader(program, vs);
+        glAttachShader(program, fs);
+        glLinkProgram(program);
+
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (GL_FALSE == status) {
+            GLchar log[256];
+            glGetProgramInfoLog(program, 256, NULL, log);
+            fprintf(stderr, "Failed to link shader program: %s\n", log);
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    // The program keeps what it needs of the shaders
+    if (vs) {
+        glDeleteShader(vs);
+    }
+    if (fs) {
+        glDeleteShader(fs);
+    }
+
+    if (!program) {
+        return EXIT_FAILURE;
+    }
+
+    position_loc = glGetAttribLocation(program, "a_position");
+    color_loc = glGetAttribLocation(program, "a_color");
+    mvp_loc = glGetUniformLocation(program, "u_mvp");
+
+    return EXIT_SUCCESS;
+}
+#endif
+
+// Builds the cubes into as few static meshes as the 16 bit indices allow
+static int
+create_meshes(int count)
+{
+    const int per_mesh = MESH_MAX_VERTICES / MESH_CUBE_VERTICES;
+    int side = 1;
+    int i = 0;
+
+    // Stress mode fills the space of the single cube with a block of smaller ones
+    while (side * side * side < count) {
+        side++;
+    }
+    const float spacing = 1.0f / side;
+
+    mesh_count = (count + per_mesh - 1) / per_mesh;
+    meshes = (mesh_t*)calloc(mesh_count, sizeof(mesh_t));
+    if (!meshes) {
+        return EXIT_FAILURE;
+    }
+
+    int m;
+    for (m = 0; m < mesh_count; m++) {
+        mesh_builder_t builder;
+
+        if (EXIT_SUCCESS != mesh_builder_init(&builder, 0.5f, MESH_COLORS)) {
+            return EXIT_FAILURE;
+        }
+
+        for (; i < count && i < (m + 1) * per_mesh; i++) {
+            float center[3];
+            center[0] = (i % side + 0.5f) * spacing - 0.5f;
+            center[1] = (i / side % side + 0.5f) * spacing - 0.5f;
+            center[2] = (i / (side * side) + 0.5f) * spacing - 0.5f;
+
+            if (EXIT_SUCCESS != mesh_builder_add_cube(&builder, center, count > 1 ? 0.35f * spacing : 0.5f, face_colors)) {
+                mesh_builder_free(&builder);
+                return EXIT_FAILURE;
+            }
+        }
+
+        int rc = mesh_create(&meshes[m], &builder);
+        mesh_builder_free(&builder);
+        if (EXIT_SUCCESS != rc) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
 
 static void
 init(void *p)
@@ -67,56 +217,145 @@ init(void *p)
     glClearDepthf(1.0f);
     glClearColor(0.0f,0.0f,0.0f,1.0f);
     glEnable(GL_CULL_FACE);
-    glShadeModel(GL_SMOOTH);
 
     glViewport(0, 0, surface_width, surface_height);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-
-    float nearClip = -2.0f;
-    float farClip  = 2.0f;
-    float yFOV  = 75.0f;
-    float yMax = nearClip * tan(yFOV*M_PI/360.0f);
-    float aspect = surface_width/surface_height;
-    float xMin = -yMax * aspect;
-    float xMax = yMax *aspect;
-
-    glFrustumf(xMin, xMax, -yMax, yMax, nearClip, farClip);
 
+    // Keep the cube square whatever the orientation, with its depth inside the clip volume
     if (surface_width > surface_height) {
-        glScalef((float)surface_height/(float)surface_width, 1.0f, 1.0f);
+        const float aspect = (float)surface_width / (float)surface_height;
+        mat4_ortho(&projection, -aspect, aspect, -1.0f, 1.0f, -1.0f, 1.0f);
     } else {
-        glScalef(1.0f, (float)surface_width/(float)surface_height, 1.0f);
+        const float aspect = (float)surface_height / (float)surface_width;
+        mat4_ortho(&projection, -1.0f, 1.0f, -aspect, aspect, -1.0f, 1.0f);
     }
 
+#ifdef USING_GL11
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(projection.m);
     glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+#else
+    if (EXIT_SUCCESS != create_program()) {
+        exit(EXIT_FAILURE);
+    }
+#endif
+
+    animator_init(&animator);
+    animator_spin(&animator, &angle, DEGREES_PER_SECOND, 360.0f);
+
+    const char *stress = getenv("CUBEROTATE_STRESS");
+    if (stress && atoi(stress) > 0) {
+        cube_count = atoi(stress);
+        reporting = true;
+    }
+    if (cube_count > 1) {
+        // Cubes of the block hide each other
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    if (EXIT_SUCCESS != create_meshes(cube_count)) {
+        fprintf(stderr, "Unable to create meshes for %d cubes\n", cube_count);
+        exit(EXIT_FAILURE);
+    }
+
+    report_time = animation_time();
+}
+
+static void
+finalize(void *p)
+{
+    int i;
+    for (i = 0; i < mesh_count; i++) {
+        mesh_destroy(&meshes[i]);
+    }
+    free(meshes);
+    meshes = NULL;
+    mesh_count = 0;
+
+#ifdef USING_GL20
+    if (program) {
+        glDeleteProgram(program);
+        program = 0;
+    }
+#endif
+}
+
+static void
+report(void)
+{
+    const double now = animation_time();
+
+    report_frames++;
+    if (now - report_time < STRESS_REPORT_SECONDS) {
+        return;
+    }
+
+    const double fps = report_frames / (now - report_time);
+    fprintf(stderr, "%d cubes: %.1f fps, %.2f million vertices and %.2f million triangles per second, "
+            "%.3f ms to submit a frame with OpenGL ES %s\n",
+            cube_count, fps, fps * cube_count * MESH_CUBE_VERTICES / 1e6, fps * cube_count * MESH_CUBE_INDICES / 3 / 1e6,
+            submit_time * 1000.0 / report_frames, GLES_VERSION);
+
+    report_time = now;
+    report_frames = 0;
+    submit_time = 0.0;
 }
 
 static void
 display(void *p)
 {
+    const double start = animation_time();
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glVertexPointer(3, GL_FLOAT, 0, vertices);
+    // Rotate by the angle reached at this time rather than a fixed step per frame
+    animator_update(&animator);
+
+    quat_t rotation;
+    quat_from_axis_angle(&rotation, angle, 1.0f, 1.0f, 0.0f);
 
-    glEnableClientState(GL_COLOR_ARRAY);
-    glColorPointer(4, GL_FLOAT, 0, colors);
+    // All meshes share the scale, they are built with the same extent
+    const float scale = 1.0f / meshes[0].scale;
+    mat4_t model;
+    mat4_rotation(&model, &rotation);
+    mat4_scale(&model, scale, scale, scale);
 
-    glRotatef(1.0f, 1.0f, 1.0f, 0.0f);
+    // The geometry already sits in GPU memory, each mesh is a single draw call
+    int i;
+#ifdef USING_GL11
+    glLoadMatrixf(model.m);
+
+    for (i = 0; i < mesh_count; i++) {
+        mesh_draw(&meshes[i], 0, -1, 0);
+    }
+#else
+    mat4_t mvp;
+    mat4_multiply(&mvp, &projection, &model);
 
-    glDrawArrays(GL_TRIANGLES, 0 , 36);
+    glUseProgram(program);
+    glUniformMatrix4fv(mvp_loc, 1, GL_FALSE, mvp.m);
 
-    glDisableClientState(GL_VERTEX_ARRAY);
-    glDisableClientState(GL_COLOR_ARRAY);
+    for (i = 0; i < mesh_count; i++) {
+        mesh_draw(&meshes[i], position_loc, -1, color_loc);
+    }
+#endif
+
+    submit_time += animation_time() - start;
+
+    if (reporting) {
+        report();
+    }
 }
 
 int
 main(int argc, char **argv)
 {
+#ifdef USING_GL11
     glview_initialize(GLVIEW_API_OPENGLES_11, &display);
+#else
+    glview_initialize(GLVIEW_API_OPENGLES_20, &display);
+#endif
     glview_register_initialize_callback(&init);
+    glview_register_finalize_callback(&finalize);
     glview_loop();
     return 0;
 }
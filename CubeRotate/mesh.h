@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _MESH_H_INCLUDED
+#define _MESH_H_INCLUDED
+
+#ifdef USING_GL11
+#include <GLES/gl.h>
+#elif defined(USING_GL20)
+#include <GLES2/gl2.h>
+#else
+#error mesh must be compiled with either USING_GL11 or USING_GL20 flags
+#endif
+
+/**
+ * Indexed triangle meshes kept in static vertex buffer objects.
+ *
+ * Geometry is assembled once with a mesh builder, uploaded with
+ * mesh_create() and from then on drawn with a single glDrawElements() call
+ * straight from GPU memory. Vertices are packed into 16 bytes: positions as
+ * shorts, normals as signed bytes and colors as unsigned bytes, fed to the
+ * vertex shader as attributes, or as client state arrays with OpenGL ES 1.1.
+ *
+ * Positions reach the shader in units of 1 / scale of the mesh, so the model
+ * matrix must include mat4_scale(1 / mesh->scale). Normals and colors arrive
+ * normalized to -1..1 and 0..1.
+ */
+
+//Indices are unsigned shorts, so a mesh holds at most this many vertices
+#define MESH_MAX_VERTICES 65536
+
+#define MESH_CUBE_VERTICES 24
+#define MESH_CUBE_INDICES 36
+
+//Attributes a mesh has besides positions
+#define MESH_NORMALS 1
+#define MESH_COLORS 2
+
+typedef struct {
+    //x, y, z in units of 1 / scale of the mesh, the fourth short keeps the normal aligned
+    GLshort position[4];
+    //x, y, z scaled to -127..127, the fourth byte is padding
+    GLbyte normal[4];
+    GLubyte color[4];
+} mesh_vertex_t;
+
+typedef struct {
+    mesh_vertex_t* vertices;
+    GLushort* indices;
+    int vertex_count;
+    int index_count;
+    int vertex_capacity;
+    int index_capacity;
+    float scale;
+    int attributes;
+} mesh_builder_t;
+
+typedef struct {
+    GLuint vertex_buffer;
+    GLuint index_buffer;
+    GLsizei index_count;
+    float scale;
+    int attributes;
+} mesh_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Prepares an empty builder.
+ *
+ * @param builder to prepare
+ * @param extent largest distance from the origin along any axis, sets the precision of positions
+ * @param attributes MESH_NORMALS and/or MESH_COLORS, or 0
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int mesh_builder_init(mesh_builder_t* builder, float extent, int attributes);
+
+/**
+ * Adds an axis aligned cube, wound counter-clockwise seen from outside.
+ *
+ * @param builder to add to
+ * @param center of the cube, or NULL for the origin
+ * @param half_size distance from the center to each face
+ * @param face_colors front, right, back, left, top and bottom color, or NULL for white
+ * @return EXIT_SUCCESS on success, EXIT_FAILURE if the mesh would exceed MESH_MAX_VERTICES
+ */
+int mesh_builder_add_cube(mesh_builder_t* builder, const float* center, float half_size, const GLubyte face_colors[6][4]);
+
+/**
+ * Releases the memory of a builder. The meshes created from it are not affected.
+ */
+void mesh_builder_free(mesh_builder_t* builder);
+
+/**
+ * Uploads the geometry of a builder into static buffers.
+ * NOTE: must be called with a current GL context
+ *
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int mesh_create(mesh_t* mesh, const mesh_builder_t* builder);
+
+/**
+ * Draws a mesh in one call with the program in use. With USING_GL11 the
+ * vertex, normal and color arrays are used instead of attributes, and only
+ * whether normal and color are -1 matters.
+ *
+ * @param mesh to draw
+ * @param position location of the vec4 position attribute
+ * @param normal location of the vec3 normal attribute, or -1 if the shader has none
+ * @param color location of the vec4 color attribute, or -1 if the shader has none
+ */
+void mesh_draw(const mesh_t* mesh, GLint position, GLint normal, GLint color);
+
+/**
+ * Deletes the buffers of a mesh.
+ */
+void mesh_destroy(mesh_t* mesh);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MESH_H_INCLUDED */
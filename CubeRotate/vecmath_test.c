@@ -0,0 +1,308 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Test program for vecmath.c, built on Linux with:
+ *
+ *   cc -O2 -std=gnu99 -ffp-contract=off -DVECMATH_TEST_MAIN vecmath_test.c vecmath.c -lm
+ *
+ * The other samples carry copies of vecmath.c; compiling this file against
+ * one of those instead tests that copy. Without VECMATH_TEST_MAIN the file is
+ * empty, so the app build can include it.
+ */
+
+#ifdef VECMATH_TEST_MAIN
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "simd.h"
+#include "vecmath.h"
+
+//How far inverse times matrix may be from identity, relative to the largest entry of the matrix
+//times the largest entry of the inverse
+#define INVERSE_TOLERANCE (64.0f * FLT_EPSILON)
+
+//How far a rotation matrix built from a quaternion may be from the one glRotatef() builds
+#define ROTATION_TOLERANCE (32.0f * FLT_EPSILON)
+
+static unsigned test_random = 1;
+
+static float test_uniform(float low, float high) {
+    test_random = test_random * 1664525u + 1013904223u;
+    return low + (high - low) * (float)(test_random >> 8) / (float)(1 << 24);
+}
+
+static float test_largest(const mat4_t* m) {
+    float largest = 0.0f;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        if (fabsf(m->m[i]) > largest) {
+            largest = fabsf(m->m[i]);
+        }
+    }
+
+    return largest;
+}
+
+//Alternates between the kinds of matrices the samples invert and multiply: general ones that need
+//row swaps, model view matrices, and projections times model view matrices
+static void test_matrix(mat4_t* out, int kind) {
+    quat_t q;
+    int i;
+
+    if (kind % 3 == 0) {
+        int order[4] = { 0, 1, 2, 3 };
+
+        //A dominant entry in each column, on a shuffled row so elimination has to pivot
+        for (i = 3; i > 0; i--) {
+            const int j = (int)test_uniform(0.0f, i + 0.999f);
+            const int t = order[i];
+            order[i] = order[j];
+            order[j] = t;
+        }
+        for (i = 0; i < 16; i++) {
+            out->m[i] = test_uniform(-1.0f, 1.0f);
+        }
+        for (i = 0; i < 4; i++) {
+            out->m[4 * i + order[i]] += out->m[4 * i + order[i]] < 0.0f ? -4.0f : 4.0f;
+        }
+        return;
+    }
+
+    if (kind % 3 == 1) {
+        mat4_identity(out);
+    } else {
+        mat4_perspective(out, test_uniform(30.0f, 90.0f), test_uniform(0.5f, 2.0f), test_uniform(0.1f, 1.0f),
+                test_uniform(10.0f, 100.0f));
+    }
+
+    mat4_translate(out, test_uniform(-10.0f, 10.0f), test_uniform(-10.0f, 10.0f), test_uniform(-20.0f, -2.0f));
+    quat_from_axis_angle(&q, test_uniform(-360.0f, 360.0f), test_uniform(-1.0f, 1.0f), test_uniform(-1.0f, 1.0f),
+            test_uniform(-1.0f, 1.0f));
+    mat4_rotate(out, &q);
+    mat4_scale(out, test_uniform(0.25f, 4.0f), test_uniform(0.25f, 4.0f), test_uniform(0.25f, 4.0f));
+}
+
+//The matrix glRotatef() multiplies by, from the OpenGL ES 1.1 specification
+static void test_gl_rotation(mat4_t* out, float degrees, float x, float y, float z) {
+    const double length = sqrt((double)x * x + (double)y * y + (double)z * z);
+    const double angle = degrees * M_PI / 180.0;
+    const double c = cos(angle), s = sin(angle);
+    const double nx = x / length, ny = y / length, nz = z / length;
+
+    mat4_identity(out);
+    out->m[0] = (float)(nx * nx * (1.0 - c) + c);
+    out->m[1] = (float)(ny * nx * (1.0 - c) + nz * s);
+    out->m[2] = (float)(nx * nz * (1.0 - c) - ny * s);
+    out->m[4] = (float)(nx * ny * (1.0 - c) - nz * s);
+    out->m[5] = (float)(ny * ny * (1.0 - c) + c);
+    out->m[6] = (float)(ny * nz * (1.0 - c) + nx * s);
+    out->m[8] = (float)(nx * nz * (1.0 - c) + ny * s);
+    out->m[9] = (float)(ny * nz * (1.0 - c) - nx * s);
+    out->m[10] = (float)(nz * nz * (1.0 - c) + c);
+}
+
+//Counts results where the vector and scalar versions disagree in any bit or an inverse failed, and
+//finds the worst distance of inverse times matrix from identity
+static int test_simd(int count, float* inverse_error) {
+    int errors = 0;
+    int n, i;
+
+    *inverse_error = 0.0f;
+
+    for (n = 0; n < count; n++) {
+        mat4_t a, b, simd, scalar, product;
+        vec4_t v, simd_v, scalar_v;
+
+        test_matrix(&a, n);
+        test_matrix(&b, n + 1);
+        vec4_set(&v, test_uniform(-100.0f, 100.0f), test_uniform(-100.0f, 100.0f), test_uniform(-100.0f, 100.0f),
+                test_uniform(0.0f, 1.0f));
+
+        mat4_multiply(&simd, &a, &b);
+        mat4_multiply_scalar(&scalar, &a, &b);
+        if (memcmp(&simd, &scalar, sizeof(mat4_t))) {
+            errors++;
+        }
+
+        //In place, as mat4_translate() and friends use it
+        product = a;
+        mat4_multiply(&product, &product, &b);
+        if (memcmp(&product, &scalar, sizeof(mat4_t))) {
+            errors++;
+        }
+
+        mat4_transform(&simd_v, &a, &v);
+        mat4_transform_scalar(&scalar_v, &a, &v);
+        if (memcmp(&simd_v, &scalar_v, sizeof(vec4_t))) {
+            errors++;
+        }
+
+        const int simd_result = mat4_inverse(&simd, &a);
+        const int scalar_result = mat4_inverse_scalar(&scalar, &a);
+        if (simd_result != EXIT_SUCCESS || scalar_result != EXIT_SUCCESS) {
+            errors++;
+            continue;
+        }
+        if (memcmp(&simd, &scalar, sizeof(mat4_t))) {
+            errors++;
+        }
+
+        const float scale = test_largest(&a) * test_largest(&simd);
+        mat4_multiply(&product, &simd, &a);
+        for (i = 0; i < 16; i++) {
+            const float error = fabsf(product.m[i] - (i % 5 == 0 ? 1.0f : 0.0f)) / scale;
+            if (error > *inverse_error) {
+                *inverse_error = error;
+            }
+        }
+    }
+
+    return errors;
+}
+
+//Returns how many singular matrices either inverse accepted or wrote to out for
+static int test_singular(int* count) {
+    mat4_t singular[5];
+    quat_t q;
+    int errors = 0;
+    int n;
+
+    memset(&singular[0], 0, sizeof(mat4_t));
+
+    //A model view matrix that flattens z
+    mat4_translation(&singular[1], 1.0f, 2.0f, -5.0f);
+    quat_from_axis_angle(&q, 30.0f, 1.0f, 1.0f, 0.0f);
+    mat4_rotate(&singular[1], &q);
+    mat4_scale(&singular[1], 2.0f, 2.0f, 0.0f);
+
+    //Two equal columns, and a column twice another
+    test_matrix(&singular[2], 0);
+    memcpy(singular[2].m + 4, singular[2].m, 4 * sizeof(float));
+    test_matrix(&singular[3], 1);
+    for (n = 0; n < 4; n++) {
+        singular[3].m[8 + n] = 2.0f * singular[3].m[n];
+    }
+
+    //Two equal rows
+    mat4_transpose(&singular[4], &singular[2]);
+
+    *count = sizeof(singular) / sizeof(singular[0]);
+    for (n = 0; n < *count; n++) {
+        mat4_t simd, scalar, untouched;
+
+        memset(&untouched, 0x5a, sizeof(mat4_t));
+        simd = scalar = untouched;
+        if (mat4_inverse(&simd, &singular[n]) != EXIT_FAILURE || memcmp(&simd, &untouched, sizeof(mat4_t))) {
+            errors++;
+        }
+        if (mat4_inverse_scalar(&scalar, &singular[n]) != EXIT_FAILURE
+                || memcmp(&scalar, &untouched, sizeof(mat4_t))) {
+            errors++;
+        }
+    }
+
+    return errors;
+}
+
+//Finds the worst difference from glRotatef() for rotations by random angles around random,
+//unnormalized axes. Returns 1 if a zero axis does not give the identity.
+static int test_rotation(int count, float* rotation_error) {
+    mat4_t from_quat, expected;
+    quat_t q;
+    int errors = 0;
+    int n, i;
+
+    *rotation_error = 0.0f;
+
+    for (n = 0; n < count; n++) {
+        const float degrees = test_uniform(-720.0f, 720.0f);
+        const float length = test_uniform(0.1f, 10.0f);
+        const float x = length * test_uniform(-1.0f, 1.0f);
+        const float y = length * test_uniform(-1.0f, 1.0f);
+        const float z = length * test_uniform(-1.0f, 1.0f);
+
+        quat_from_axis_angle(&q, degrees, x, y, z);
+        mat4_rotation(&from_quat, &q);
+        test_gl_rotation(&expected, degrees, x, y, z);
+
+        for (i = 0; i < 16; i++) {
+            const float error = fabsf(from_quat.m[i] - expected.m[i]);
+            if (error > *rotation_error) {
+                *rotation_error = error;
+            }
+        }
+    }
+
+    //A zero axis gives no rotation rather than NaNs
+    quat_from_axis_angle(&q, 45.0f, 0.0f, 0.0f, 0.0f);
+    mat4_rotation(&from_quat, &q);
+    mat4_identity(&expected);
+    if (memcmp(&from_quat, &expected, sizeof(mat4_t))) {
+        errors++;
+    }
+
+    return errors;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "usage: %s [-n matrices] [-s seed]\n", name);
+}
+
+int main(int argc, char** argv) {
+    int count = 100000;
+    float inverse_error, rotation_error;
+    int singular;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            count = atoi(optarg);
+            break;
+        case 's':
+            test_random = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    const int mismatches = test_simd(count, &inverse_error);
+    const int accepted = test_singular(&singular);
+    const int zero_axis = test_rotation(count, &rotation_error);
+
+    printf("%s against scalar over %d matrices: %d results differ, inverse times matrix off identity by %.2g"
+            " (limit %.2g)\n", SIMD_NAME, count, mismatches, inverse_error, INVERSE_TOLERANCE);
+    printf("singular matrices: %d of %d inverses not rejected\n", accepted, 2 * singular);
+    printf("rotations from quaternions: off glRotatef() by %.2g (limit %.2g)%s\n", rotation_error,
+            ROTATION_TOLERANCE, zero_axis ? ", zero axis not the identity" : "");
+
+    const int errors = mismatches + accepted + zero_axis
+            + (inverse_error > INVERSE_TOLERANCE) + (rotation_error > ROTATION_TOLERANCE);
+    printf("%s\n", errors == 0 ? "PASS" : "FAIL");
+
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#endif
@@ -0,0 +1,860 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "bench.h"
+#include "boxes.h"
+#include "collide.h"
+#include "gravity.h"
+#include "pool.h"
+#include "simd.h"
+#include "world.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define COLLIDE_STEPS 100
+#define PARALLEL_STEPS 200
+#define PARALLEL_CHUNK 4096
+#define POOL_BOXES 1000000
+#define CHURN_STEPS 600
+#define CHURN_BURST 500
+#define SETTLE_STEPS 600
+
+//Most a settled pile may still move per step and overlap, in pixels
+#define SETTLE_MAX_MOVE 1.0f
+#define SETTLE_MAX_OVERLAP 1.0f
+
+//Screen area per box, keeps the density roughly constant between runs
+//so the numbers show how the step scales rather than how crowded it is
+#define AREA_PER_BOX (MAX_SIZE * MAX_SIZE)
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static unsigned next_random(unsigned *state) {
+    unsigned x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return *state = x;
+}
+
+static float uniform(unsigned *state) {
+    return (float)(next_random(state) >> 8) / (float)(1 << 24);
+}
+
+void bench_collide(FILE *out) {
+    static const int counts[] = { 1000, 10000, 50000 };
+    int c, i;
+
+    for (c = 0; c < (int)(sizeof(counts) / sizeof(counts[0])); c++) {
+        boxes_t boxes;
+        grid_t grid;
+        int n = counts[c];
+        float side = sqrtf(n * AREA_PER_BOX);
+        long long pairs = 0;
+        long long contacts = 0;
+        double start, elapsed;
+
+        if (EXIT_SUCCESS != boxes_init(&boxes, n)) {
+            return;
+        }
+        collide_init(&grid);
+
+        srand(1);
+        for (i = 0; i < n; i++) {
+            boxes.x[i] = side * rand() / RAND_MAX;
+            boxes.y[i] = side * rand() / RAND_MAX;
+            boxes.size[i] = 40.0f + 20.0f * rand() / RAND_MAX;
+        }
+        boxes.count = n;
+
+        start = now();
+        for (i = 0; i < COLLIDE_STEPS; i++) {
+            collide_step(&grid, &boxes, side, side, 0.0f, 0.0f, false);
+            pairs += grid.stats.pairs_tested;
+            contacts += grid.stats.contacts;
+        }
+        elapsed = now() - start;
+
+        fprintf(out, "collide %6d boxes: %9lld pairs/step %8lld contacts/step"
+                " %8.3f ms/step\n", n, pairs / COLLIDE_STEPS,
+                contacts / COLLIDE_STEPS, 1000.0 * elapsed / COLLIDE_STEPS);
+
+        collide_free(&grid);
+        boxes_free(&boxes);
+    }
+}
+
+typedef struct {
+    boxes_t *boxes;
+    float gravity_x;
+    float gravity_y;
+} parallel_t;
+
+static void parallel_chunk(void *data, int begin, int end) {
+    parallel_t *p = (parallel_t *)data;
+    boxes_update_range(p->boxes, p->gravity_x, p->gravity_y, 1.0f / 60.0f,
+            BENCH_WIDTH, BENCH_HEIGHT, true, begin, end);
+}
+
+void bench_parallel(FILE *out) {
+    static const int counts[] = { 100000, 1000000 };
+    int cpus = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int c, t, i;
+
+    if (cpus < 1) {
+        cpus = 1;
+    }
+
+    for (c = 0; c < (int)(sizeof(counts) / sizeof(counts[0])); c++) {
+        int n = counts[c];
+        double single = 0.0;
+        unsigned reference = 0;
+
+        for (t = 1; t <= cpus; t++) {
+            boxes_t boxes;
+            parallel_t p;
+            pool_t *pool;
+            double start, elapsed;
+            unsigned sum;
+
+            if (EXIT_SUCCESS != boxes_init(&boxes, n)) {
+                return;
+            }
+
+            pool = pool_create(t);
+            if (!pool) {
+                boxes_free(&boxes);
+                return;
+            }
+
+            srand(1);
+            for (i = 0; i < n; i++) {
+                boxes.x[i] = BENCH_WIDTH * rand() / RAND_MAX;
+                boxes.y[i] = BENCH_HEIGHT * rand() / RAND_MAX;
+            }
+            boxes.count = n;
+
+            p.boxes = &boxes;
+            start = now();
+            for (i = 0; i < PARALLEL_STEPS; i++) {
+                //Turn the gravity vector a little every step
+                p.gravity_x = 9.8f * sinf(i * 0.05f);
+                p.gravity_y = -9.8f * cosf(i * 0.05f);
+                pool_run(pool, parallel_chunk, &p, n, PARALLEL_CHUNK);
+            }
+            elapsed = (now() - start) / PARALLEL_STEPS;
+
+            sum = boxes_checksum(&boxes);
+            if (t == 1) {
+                single = elapsed;
+                reference = sum;
+            }
+
+            fprintf(out, "update %7d boxes %2d threads: %8.3f ms/step"
+                    " %5.2fx %s\n", n, pool_threads(pool), 1000.0 * elapsed,
+                    single / elapsed, (sum == reference) ? "match" : "MISMATCH");
+
+            pool_destroy(pool);
+            boxes_free(&boxes);
+        }
+    }
+}
+
+void bench_churn(FILE *out) {
+    world_t world;
+    double start, add_time, remove_time, churn_time;
+    long long added = 0;
+    long long live = 0;
+    int i;
+
+    if (EXIT_SUCCESS != world_init(&world, POOL_BOXES, 1)) {
+        return;
+    }
+
+    world.width = BENCH_WIDTH;
+    world.height = BENCH_HEIGHT;
+
+    //Grow from empty, including every reallocation on the way
+    start = now();
+    for (i = 0; i < POOL_BOXES; i++) {
+        world_add_box(&world, BENCH_WIDTH * 0.5f, BENCH_HEIGHT * 0.5f);
+    }
+    add_time = now() - start;
+
+    start = now();
+    while (world.boxes.count > 0) {
+        int index = (int)(world.boxes.count * world_random(&world));
+        world_remove_box(&world, index);
+    }
+    remove_time = now() - start;
+
+    fprintf(out, "pool %d boxes: %.1f ns/add %.1f ns/remove\n", POOL_BOXES,
+            1e9 * add_time / POOL_BOXES, 1e9 * remove_time / POOL_BOXES);
+
+    //Boxes fall off the bottom and are removed while new bursts arrive
+    world.wrap = false;
+    world.collide = false;
+    world.gravity_x = 0.0f;
+    world.gravity_y = -9.8f;
+    world.despawned = 0;
+
+    start = now();
+    for (i = 0; i < CHURN_STEPS; i++) {
+        int k;
+
+        for (k = 0; k < CHURN_BURST; k++) {
+            float x = BENCH_WIDTH * world_random(&world);
+            float y = BENCH_HEIGHT * world_random(&world);
+            added += world_add_box(&world, x, y);
+        }
+
+        world_step(&world);
+        live += world.boxes.count;
+    }
+    churn_time = now() - start;
+
+    fprintf(out, "churn %d boxes/step: %lld live on average, %.0f adds/s"
+            " %.0f removes/s, %.3f ms/step\n", CHURN_BURST,
+            live / CHURN_STEPS, added / churn_time,
+            world.despawned / churn_time, 1000.0 * churn_time / CHURN_STEPS);
+
+    world_free(&world);
+}
+
+//Gravity the benchmark device is tilted through, one vector every
+//GRAVITY_PERIOD steps with linear blending in between
+#define GRAVITY_PERIOD 240
+
+static const float gravity_script[][2] = {
+    {  0.0f, -9.8f },
+    {  6.9f, -6.9f },
+    {  9.8f,  0.0f },
+    {  0.0f,  9.8f },
+    { -6.9f,  6.9f },
+    { -9.8f,  0.0f },
+    { -0.5f, -9.7f },
+};
+
+static void scripted_gravity(int step, float *x, float *y) {
+    int count = sizeof(gravity_script) / sizeof(gravity_script[0]);
+    int key = (step / GRAVITY_PERIOD) % count;
+    int next = (key + 1) % count;
+    float t = (float)(step % GRAVITY_PERIOD) / GRAVITY_PERIOD;
+
+    *x = gravity_script[key][0]
+            + (gravity_script[next][0] - gravity_script[key][0]) * t;
+    *y = gravity_script[key][1]
+            + (gravity_script[next][1] - gravity_script[key][1]) * t;
+}
+
+//Deepest overlap between any two boxes, along the axis it would be
+//resolved on
+static float deepest_overlap(const boxes_t *boxes) {
+    float deepest = 0.0f;
+    int a, b;
+
+    for (a = 0; a < boxes->count; a++) {
+        for (b = a + 1; b < boxes->count; b++) {
+            float half_a = 0.5f * boxes->size[a];
+            float half_b = 0.5f * boxes->size[b];
+            float px = half_a + half_b - fabsf((boxes->x[b] + half_b)
+                    - (boxes->x[a] + half_a));
+            float py = half_a + half_b - fabsf((boxes->y[b] + half_b)
+                    - (boxes->y[a] + half_a));
+            float depth = (px < py) ? px : py;
+
+            if (depth > deepest) {
+                deepest = depth;
+            }
+        }
+    }
+
+    return deepest;
+}
+
+//Holds gravity straight down until a pile should have settled, then
+//reports how far boxes still move per step and how deep they overlap.
+//Fails if either is above its limit.
+static int bench_settle(FILE *out, world_t *world) {
+    float moved = 0.0f;
+    float deepest;
+    int i;
+
+    world->gravity_x = 0.0f;
+    world->gravity_y = -9.8f;
+    for (i = 0; i < SETTLE_STEPS; i++) {
+        if (EXIT_SUCCESS != world_step(world)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (i = 0; i < world->boxes.count; i++) {
+        float dx = fabsf(world->boxes.x[i] - world->boxes.prev_x[i]);
+        float dy = fabsf(world->boxes.y[i] - world->boxes.prev_y[i]);
+
+        if (dx > moved) {
+            moved = dx;
+        }
+        if (dy > moved) {
+            moved = dy;
+        }
+    }
+
+    deepest = deepest_overlap(&world->boxes);
+
+    fprintf(out, "settled on %.0fx%.0f after %d steps: largest move %.3f"
+            " px/step, deepest overlap %.3f px\n", world->width,
+            world->height, SETTLE_STEPS, moved, deepest);
+
+    if (moved > SETTLE_MAX_MOVE || deepest > SETTLE_MAX_OVERLAP) {
+        fprintf(out, "pile did not settle: limits are %.1f px/step and"
+                " %.1f px\n", SETTLE_MAX_MOVE, SETTLE_MAX_OVERLAP);
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+int bench_world(FILE *out, const bench_options_t *options) {
+    world_t world;
+    double start, elapsed;
+    int i;
+
+    if (EXIT_SUCCESS != world_init(&world, options->boxes, options->threads)) {
+        return EXIT_FAILURE;
+    }
+
+    world.width = options->width;
+    world.height = options->height;
+    world.collide = options->collide;
+    world.stack = options->stack;
+    world_seed(&world, options->seed);
+
+    for (i = 0; i < options->boxes; i++) {
+        float x = options->width * world_random(&world);
+        float y = options->height * world_random(&world);
+        world_add_box(&world, x, y);
+    }
+
+    start = now();
+    for (i = 0; i < options->steps; i++) {
+        scripted_gravity(i, &world.gravity_x, &world.gravity_y);
+        if (EXIT_SUCCESS != world_step(&world)) {
+            fprintf(out, "world %d boxes: collision step out of memory\n",
+                    options->boxes);
+            world_free(&world);
+            return EXIT_FAILURE;
+        }
+    }
+    elapsed = now() - start;
+
+    fprintf(out, "world %d boxes %d steps %d threads collide %s%s seed %u:"
+            " %.2f ns/box/step checksum %08x\n", options->boxes,
+            options->steps, world.pool ? pool_threads(world.pool) : 1,
+            options->collide ? "on" : "off", options->stack ? " stack" : "",
+            options->seed,
+            1e9 * elapsed / ((double)options->boxes * options->steps),
+            world_checksum(&world));
+
+    if (options->stack && EXIT_SUCCESS != bench_settle(out, &world)) {
+        world_free(&world);
+        return EXIT_FAILURE;
+    }
+
+    world_free(&world);
+
+    return EXIT_SUCCESS;
+}
+
+//Lays out the same seeded boxes in both sets. A few start exactly on an
+//edge or far outside the screen so every branch of the wrap is taken.
+static void kernel_boxes(boxes_t *a, boxes_t *b, int n, unsigned seed) {
+    unsigned random = seed ? seed : 1;
+    int i;
+
+    for (i = 0; i < n; i++) {
+        float x, y;
+
+        x = BENCH_WIDTH * (2.0f * uniform(&random) - 0.5f);
+        y = BENCH_HEIGHT * (2.0f * uniform(&random) - 0.5f);
+        switch (i % 16) {
+        case 0:
+            x = 0.0f;
+            break;
+        case 1:
+            y = BENCH_HEIGHT;
+            break;
+        case 2:
+            x = -MAX_SIZE;
+            y = -MAX_SIZE;
+            break;
+        }
+
+        a->x[i] = b->x[i] = x;
+        a->y[i] = b->y[i] = y;
+        a->size[i] = b->size[i] = 40.0f + 20.0f * uniform(&random);
+    }
+    a->count = b->count = n;
+}
+
+int bench_kernel(FILE *out, const bench_options_t *options) {
+    boxes_t vector, scalar;
+    size_t size = options->boxes * sizeof(float);
+    double vector_time = 0.0;
+    double scalar_time = 0.0;
+    long long wraps = 0;
+    int mismatch = -1;
+    int i, j;
+
+    if (EXIT_SUCCESS != boxes_init(&vector, options->boxes)) {
+        return EXIT_FAILURE;
+    }
+    if (EXIT_SUCCESS != boxes_init(&scalar, options->boxes)) {
+        boxes_free(&vector);
+        return EXIT_FAILURE;
+    }
+
+    kernel_boxes(&vector, &scalar, options->boxes, options->seed);
+
+    for (i = 0; i < options->steps && mismatch < 0; i++) {
+        float gx, gy;
+        //Every seventh step skips the wrap so the next one finds boxes far
+        //out, every eleventh is a 10 Hz tick that moves boxes several sizes
+        bool wrap = (i % 7) != 0;
+        float dt = (i % 11) ? 1.0f / 60.0f : 1.0f / 10.0f;
+        double start;
+
+        scripted_gravity(i, &gx, &gy);
+
+        start = now();
+        boxes_update(&vector, gx, gy, dt, BENCH_WIDTH, BENCH_HEIGHT, wrap);
+        vector_time += now() - start;
+
+        start = now();
+        boxes_update_scalar(&scalar, gx, gy, dt, BENCH_WIDTH, BENCH_HEIGHT,
+                wrap);
+        scalar_time += now() - start;
+
+        for (j = 0; j < options->boxes; j++) {
+            wraps += (scalar.wrapped[j] != 0.0f);
+        }
+
+        if (memcmp(vector.x, scalar.x, size) || memcmp(vector.y, scalar.y, size)
+                || memcmp(vector.wrapped, scalar.wrapped, size)) {
+            mismatch = i;
+        }
+    }
+
+    if (mismatch >= 0) {
+        fprintf(out, "kernel %s %d boxes: MISMATCH with the scalar kernel at"
+                " step %d\n", SIMD_NAME, options->boxes, mismatch);
+    } else {
+        fprintf(out, "kernel %s %d boxes %d steps: match, %lld wraps, %.2f"
+                " ns/box/step against %.2f for the scalar kernel\n", SIMD_NAME,
+                options->boxes, options->steps, wraps,
+                1e9 * vector_time / ((double)options->boxes * options->steps),
+                1e9 * scalar_time / ((double)options->boxes * options->steps));
+    }
+
+    boxes_free(&scalar);
+    boxes_free(&vector);
+
+    return (mismatch >= 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+//Synthetic sensor trace: readings every SENSOR_PERIOD seconds with some
+//timing jitter and noise on top of a known tilt sequence
+#define SENSOR_PERIOD 0.025
+#define SENSOR_JITTER 0.002
+#define SENSOR_NOISE 0.15f
+#define SYNTHETIC_SECONDS 60.0
+#define STANDARD_GRAVITY 9.80665f
+
+//Traces are replayed at this frame rate, each frame is shown one frame
+//after it is simulated
+#define TRACE_FRAME_RATE 60.0
+#define TRACE_LATENCY (1.0 / TRACE_FRAME_RATE)
+
+//Half width of the centred average used as ground truth for recorded traces
+#define TRUTH_WINDOW 0.05
+
+typedef struct {
+    gravity_sample_t *raw;
+    //Ground truth at the time of each raw reading
+    gravity_sample_t *truth;
+    int count;
+} trace_t;
+
+//Sum of 12 uniforms is a good enough normal distribution for sensor noise
+static float normal(unsigned *state) {
+    float sum = 0.0f;
+    int i;
+
+    for (i = 0; i < 12; i++) {
+        sum += uniform(state);
+    }
+    return sum - 6.0f;
+}
+
+//Tilt angle of the synthetic device: slow turns with a quick flick every
+//few seconds, which is where filters either lag or overshoot
+static double synthetic_angle(double t) {
+    double angle = 1.2 * sin(0.4 * t) + 0.6 * sin(1.3 * t);
+    double phase = fmod(t, 5.0);
+
+    if (phase > 4.0) {
+        angle += 0.8 * sin(M_PI * (phase - 4.0));
+    }
+    return angle;
+}
+
+static int trace_synthetic(trace_t *trace, unsigned seed) {
+    int capacity = (int)(SYNTHETIC_SECONDS / SENSOR_PERIOD) + 1;
+    unsigned state = seed ? seed : 1;
+    double t = 0.0;
+    int i;
+
+    trace->raw = (gravity_sample_t *)malloc(capacity * sizeof(gravity_sample_t));
+    trace->truth = (gravity_sample_t *)malloc(
+            capacity * sizeof(gravity_sample_t));
+    if (!trace->raw || !trace->truth) {
+        free(trace->raw);
+        free(trace->truth);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < capacity; i++) {
+        double angle = synthetic_angle(t);
+
+        trace->truth[i].time = t;
+        trace->truth[i].x = STANDARD_GRAVITY * (float)sin(angle);
+        trace->truth[i].y = -STANDARD_GRAVITY * (float)cos(angle);
+
+        trace->raw[i].time = t;
+        trace->raw[i].x = trace->truth[i].x + SENSOR_NOISE * normal(&state);
+        trace->raw[i].y = trace->truth[i].y + SENSOR_NOISE * normal(&state);
+
+        t += SENSOR_PERIOD + SENSOR_JITTER * (2.0f * uniform(&state) - 1.0f);
+    }
+    trace->count = capacity;
+
+    return EXIT_SUCCESS;
+}
+
+static int trace_load(trace_t *trace, const char *path) {
+    FILE *file = fopen(path, "r");
+    char line[256];
+    int capacity = 1024;
+    int i, j;
+
+    if (!file) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    trace->count = 0;
+    trace->raw = (gravity_sample_t *)malloc(capacity * sizeof(gravity_sample_t));
+
+    //One reading per line: seconds, x and y, as written by the app
+    while (trace->raw && fgets(line, sizeof(line), file)) {
+        gravity_sample_t sample;
+
+        if (line[0] == '#' || sscanf(line, "%lf %f %f", &sample.time,
+                &sample.x, &sample.y) != 3) {
+            continue;
+        }
+
+        if (trace->count == capacity) {
+            gravity_sample_t *raw = (gravity_sample_t *)realloc(trace->raw,
+                    2 * capacity * sizeof(gravity_sample_t));
+            if (!raw) {
+                free(trace->raw);
+                trace->raw = NULL;
+                break;
+            }
+            trace->raw = raw;
+            capacity *= 2;
+        }
+        trace->raw[trace->count++] = sample;
+    }
+    fclose(file);
+
+    if (!trace->raw || trace->count < 2) {
+        fprintf(stderr, "%s does not hold a sensor trace\n", path);
+        free(trace->raw);
+        return EXIT_FAILURE;
+    }
+
+    trace->truth = (gravity_sample_t *)malloc(
+            trace->count * sizeof(gravity_sample_t));
+    if (!trace->truth) {
+        free(trace->raw);
+        return EXIT_FAILURE;
+    }
+
+    //There is no ground truth for a recording, a centred average is as
+    //close as a filter that can see the future gets
+    for (i = 0; i < trace->count; i++) {
+        double t = trace->raw[i].time;
+        double x = 0.0, y = 0.0;
+        int n = 0;
+
+        for (j = i; j >= 0 && t - trace->raw[j].time <= TRUTH_WINDOW; j--) {
+            x += trace->raw[j].x;
+            y += trace->raw[j].y;
+            n++;
+        }
+        for (j = i + 1; j < trace->count
+                && trace->raw[j].time - t <= TRUTH_WINDOW; j++) {
+            x += trace->raw[j].x;
+            y += trace->raw[j].y;
+            n++;
+        }
+
+        trace->truth[i].time = t;
+        trace->truth[i].x = (float)(x / n);
+        trace->truth[i].y = (float)(y / n);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+//Ground truth at time t, interpolated between readings. *cursor only moves
+//forward so that a replay stays linear in the trace length
+static void trace_truth(const trace_t *trace, double t, int *cursor, float *x,
+        float *y) {
+    const gravity_sample_t *a, *b;
+    float f;
+
+    while (*cursor + 2 < trace->count && trace->truth[*cursor + 1].time <= t) {
+        (*cursor)++;
+    }
+
+    a = &trace->truth[*cursor];
+    b = &trace->truth[*cursor + 1];
+    f = (float)((t - a->time) / (b->time - a->time));
+    if (f < 0.0f) {
+        f = 0.0f;
+    } else if (f > 1.0f) {
+        f = 1.0f;
+    }
+
+    *x = a->x + (b->x - a->x) * f;
+    *y = a->y + (b->y - a->y) * f;
+}
+
+//Replays a trace through one filter at TRACE_FRAME_RATE and prints the
+//error against ground truth at presentation time, the frame to frame jitter
+//of the output, and the cost of filtering and predicting
+static void replay(FILE *out, const trace_t *trace, gravity_filter_t filter,
+        bool predict) {
+    gravity_t gravity;
+    double start = trace->raw[0].time;
+    double end = trace->raw[trace->count - 1].time;
+    double frame_time = 1.0 / TRACE_FRAME_RATE;
+    double error = 0.0, jitter = 0.0;
+    double elapsed = 0.0;
+    float gx = 0.0f, gy = -STANDARD_GRAVITY;
+    float prev_x = 0.0f, prev_y = 0.0f, prev_dx = 0.0f, prev_dy = 0.0f;
+    int next = 0, cursor = 0, frames = 0;
+    double t;
+
+    gravity_init(&gravity, filter);
+    if (!predict) {
+        gravity.horizon = 0.0f;
+    }
+
+    for (t = start; t < end; t += frame_time) {
+        double present = t + TRACE_LATENCY;
+        double begin = now();
+        float tx, ty;
+
+        //Readings that arrived since the last frame
+        while (next < trace->count && trace->raw[next].time <= t) {
+            gravity_push(&gravity, trace->raw[next].time, trace->raw[next].x,
+                    trace->raw[next].y);
+            next++;
+        }
+        gravity_predict(&gravity, present, &gx, &gy);
+        elapsed += now() - begin;
+
+        trace_truth(trace, present, &cursor, &tx, &ty);
+        error += (gx - tx) * (gx - tx) + (gy - ty) * (gy - ty);
+
+        //Second difference, how much the motion changes from frame to frame
+        if (frames >= 2) {
+            float ax = (gx - prev_x) - prev_dx;
+            float ay = (gy - prev_y) - prev_dy;
+            jitter += ax * ax + ay * ay;
+        }
+        if (frames >= 1) {
+            prev_dx = gx - prev_x;
+            prev_dy = gy - prev_y;
+        }
+        prev_x = gx;
+        prev_y = gy;
+        frames++;
+    }
+
+    fprintf(out, "gravity %-8s %-9s: rms error %.3f m/s2 jitter %.4f m/s2"
+            " %.0f ns/frame\n", gravity_filter_name(filter),
+            predict ? "predicted" : "held", sqrt(error / frames),
+            (frames > 2) ? sqrt(jitter / (frames - 2)) : 0.0,
+            1e9 * elapsed / frames);
+}
+
+int bench_gravity(FILE *out, const char *path) {
+    trace_t trace;
+    int filter;
+
+    if (path) {
+        if (EXIT_SUCCESS != trace_load(&trace, path)) {
+            return EXIT_FAILURE;
+        }
+    } else if (EXIT_SUCCESS != trace_synthetic(&trace, 1)) {
+        return EXIT_FAILURE;
+    }
+
+    fprintf(out, "gravity trace %s: %d readings over %.1f s\n",
+            path ? path : "synthetic", trace.count,
+            trace.raw[trace.count - 1].time - trace.raw[0].time);
+
+    for (filter = 0; filter < GRAVITY_FILTER_COUNT; filter++) {
+        replay(out, &trace, (gravity_filter_t)filter, false);
+        if (filter != GRAVITY_FILTER_NONE) {
+            replay(out, &trace, (gravity_filter_t)filter, true);
+        }
+    }
+
+    free(trace.raw);
+    free(trace.truth);
+
+    return EXIT_SUCCESS;
+}
+
+#ifdef FALLINGBLOCKS_BENCH_MAIN
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-n boxes] [-m steps] [-t threads] [-s seed]"
+            " [-W width] [-H height] [-x] [-p] [-c] [-a] [-g trace]\n"
+            "  -W  screen width in pixels, default 1280\n"
+            "  -H  screen height in pixels, default 768\n"
+            "  -x  disable collisions\n"
+            "  -p  pile boxes up against the screen edges, then check that"
+            " they settle\n"
+            "  -c  also compare the vector update kernel against the scalar"
+            " one\n"
+            "  -a  also run the kernel comparison, collision, thread scaling,"
+            " box pool and gravity filter benchmarks\n"
+            "  -g  only replay a recorded gravity sensor trace through each"
+            " filter\n",
+            name);
+}
+
+int main(int argc, char **argv) {
+    bench_options_t options;
+    const char *trace = NULL;
+    bool all = false;
+    bool kernel = false;
+    int opt;
+
+    options.boxes = 10000;
+    options.steps = 1000;
+    options.threads = 1;
+    options.seed = 1;
+    options.collide = true;
+    options.stack = false;
+    options.width = BENCH_WIDTH;
+    options.height = BENCH_HEIGHT;
+
+    while ((opt = getopt(argc, argv, "n:m:t:s:W:H:xpcag:h")) != -1) {
+        switch (opt) {
+        case 'n':
+            options.boxes = atoi(optarg);
+            break;
+        case 'm':
+            options.steps = atoi(optarg);
+            break;
+        case 't':
+            options.threads = atoi(optarg);
+            break;
+        case 's':
+            options.seed = (unsigned)strtoul(optarg, NULL, 0);
+            break;
+        case 'W':
+            options.width = (float)atof(optarg);
+            break;
+        case 'H':
+            options.height = (float)atof(optarg);
+            break;
+        case 'x':
+            options.collide = false;
+            break;
+        case 'p':
+            options.stack = true;
+            break;
+        case 'c':
+            kernel = true;
+            break;
+        case 'a':
+            all = true;
+            break;
+        case 'g':
+            trace = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (options.boxes <= 0 || options.steps <= 0 || options.width <= 0.0f
+            || options.height <= 0.0f) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (trace) {
+        return bench_gravity(stdout, trace);
+    }
+
+    if (EXIT_SUCCESS != bench_world(stdout, &options)) {
+        return EXIT_FAILURE;
+    }
+
+    if ((kernel || all) && EXIT_SUCCESS != bench_kernel(stdout, &options)) {
+        return EXIT_FAILURE;
+    }
+
+    if (all) {
+        bench_collide(stdout);
+        bench_parallel(stdout);
+        bench_churn(stdout);
+        bench_gravity(stdout, NULL);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#endif
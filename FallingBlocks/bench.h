@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdbool.h>
+#include <stdio.h>
+
+//Screen size used by the update benchmarks
+#define BENCH_WIDTH 1280.0f
+#define BENCH_HEIGHT 768.0f
+
+typedef struct {
+    int boxes;
+    int steps;
+    int threads;
+    unsigned seed;
+    bool collide;
+    bool stack;
+    //Screen the world benchmark runs on, in pixels
+    float width;
+    float height;
+} bench_options_t;
+
+/**
+ * Measures the box pool: the cost of growing it one box at a time and
+ * removing boxes in random order, then a spawn/despawn run in which bursts
+ * of boxes are added every step and removed once they fall off screen.
+ *
+ * @param out stream the results are written to
+ */
+void bench_churn(FILE *out);
+
+/**
+ * Runs the platform independent simulation with a fixed seed and a
+ * scripted gravity sequence, then prints the time per box per step and a
+ * checksum of the final state. The checksum only depends on the options,
+ * not on the thread count or CPU, so it can be used to check that an
+ * optimisation did not change the results.
+ *
+ * With stack set the boxes pile up against the screen edges instead of
+ * wrapping. Gravity is then held straight down until the pile settles,
+ * and the distance the boxes still moved in the last step and the deepest
+ * overlap left between two boxes are printed as well. The screen has to be
+ * big enough to hold the pile for it to settle.
+ *
+ * @param out stream the results are written to
+ * @param options what to simulate
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE, also when a
+ * pile moved or overlapped by more than a pixel after settling
+ */
+int bench_world(FILE *out, const bench_options_t *options);
+
+/**
+ * Runs the vector and the scalar update kernel side by side over the same
+ * seeded boxes, some of them on an edge or far off screen, with the
+ * scripted gravity sequence and prints the time per box per step of each.
+ * Some steps are 10 Hz ticks. Compares the positions and wrap flags bit
+ * for bit after every step and stops at the first difference.
+ *
+ * @param out stream the results are written to
+ * @param options boxes, steps and seed to use
+ * @return EXIT_SUCCESS if the kernels matched otherwise EXIT_FAILURE
+ */
+int bench_kernel(FILE *out, const bench_options_t *options);
+
+/**
+ * Runs the collision step over 1k, 10k and 50k randomly placed boxes and
+ * prints the number of pairs tested, contacts and time per step.
+ *
+ * @param out stream the results are written to
+ */
+void bench_collide(FILE *out);
+
+/**
+ * Runs the box update over 100k and 1M boxes with 1 to N threads, where N
+ * is the number of CPUs, and prints time per step, speedup over one thread
+ * and whether the result matched the single threaded run bit for bit.
+ *
+ * @param out stream the results are written to
+ */
+void bench_parallel(FILE *out);
+
+/**
+ * Replays a gravity sensor trace through every filter, with and without
+ * prediction, as a 60 fps app would see it and prints the RMS error against
+ * ground truth at presentation time, the frame to frame jitter of the
+ * result and the time spent per frame. Recorded traces have no ground
+ * truth, a centred average of the readings stands in for it.
+ *
+ * @param out stream the results are written to
+ * @param path trace recorded with FALLINGBLOCKS_SENSOR_TRACE, or NULL for
+ *        a synthetic trace with known ground truth
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int bench_gravity(FILE *out, const char *path);
+
+#endif /* BENCH_H_ */
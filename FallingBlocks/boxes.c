@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "boxes.h"
+#include "simd.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Below this magnitude a gravity component does not take part in wrapping,
+//boxes are considered to be falling along the other axis only
+#define AXIS_EPSILON 0.05f
+
+//Per step constants shared by the scalar and vector kernels.
+//
+//Wrapping is done by walking backwards from the box position (along -gravity)
+//until the ray leaves the screen rectangle, which is the classic slab test:
+//the ray is inside the x slab for t in [t_near_x, t_far_x] and inside the
+//y slab for t in [t_near_y, t_far_y]. The box re-enters at t_far, the
+//smaller of the two far values. If the ray misses the rectangle altogether
+//the box restarts from the origin.
+//
+//All divisions are hoisted out here so the per box work is only adds,
+//multiplies, min/max and compares.
+typedef struct {
+    //Displacement per step
+    float vx;
+    float vy;
+
+    //A box is off screen once x * sx > lim_x or y * sy > lim_y
+    float sx;
+    float sy;
+    float lim_x;
+    float lim_y;
+
+    //Slab planes crossed by the backwards ray first and last
+    float near_x;
+    float near_y;
+    float far_x;
+    float far_y;
+
+    //1 / backwards direction, and bias that pushes disabled axes to infinity
+    float inv_dx;
+    float inv_dy;
+    float near_bias_x;
+    float near_bias_y;
+    float far_bias_x;
+    float far_bias_y;
+
+    //Backwards direction used to place a wrapped box
+    float dx;
+    float dy;
+} wrap_t;
+
+static void setup_axis(float g, float other, float step, float extent,
+        float *v, float *s, float *lim, float *near, float *far,
+        float *inv_d, float *near_bias, float *far_bias, float *d) {
+    //An axis takes part if it is clearly moving, or if it is the dominant
+    //one so that at least one axis always wraps
+    bool active = (g != 0.0f)
+            && ((fabsf(g) > AXIS_EPSILON) || (fabsf(g) >= fabsf(other)));
+
+    *v = g * step;
+
+    if (!active) {
+        *s = 1.0f;
+        *lim = INFINITY;
+        *near = 0.0f;
+        *far = 0.0f;
+        *inv_d = 0.0f;
+        *near_bias = -INFINITY;
+        *far_bias = INFINITY;
+        *d = 0.0f;
+        return;
+    }
+
+    if (g > 0.0f) {
+        //Leaves through the high edge, comes back at 0
+        *s = 1.0f;
+        *lim = extent;
+        *near = extent;
+        *far = 0.0f;
+    } else {
+        //Leaves once fully past 0, comes back at the high edge
+        *s = -1.0f;
+        *lim = MAX_SIZE;
+        *near = 0.0f;
+        *far = extent;
+    }
+
+    *d = -g;
+    *inv_d = 1.0f / *d;
+    *near_bias = 0.0f;
+    *far_bias = 0.0f;
+}
+
+static void setup_wrap(wrap_t *w, float gravity_x, float gravity_y, float dt,
+        float width, float height, bool wrap) {
+    float step = BOX_SPEED * dt;
+
+    setup_axis(gravity_x, gravity_y, step, width, &w->vx, &w->sx, &w->lim_x,
+            &w->near_x, &w->far_x, &w->inv_dx, &w->near_bias_x,
+            &w->far_bias_x, &w->dx);
+    setup_axis(gravity_y, gravity_x, step, height, &w->vy, &w->sy, &w->lim_y,
+            &w->near_y, &w->far_y, &w->inv_dy, &w->near_bias_y,
+            &w->far_bias_y, &w->dy);
+
+    //Boxes that are not wrapped simply never count as off screen
+    if (!wrap) {
+        w->lim_x = INFINITY;
+        w->lim_y = INFINITY;
+    }
+}
+
+int boxes_init(boxes_t *boxes, int max_boxes) {
+    memset(boxes, 0, sizeof(*boxes));
+    return boxes_reserve(boxes, max_boxes);
+}
+
+int boxes_reserve(boxes_t *boxes, int max_boxes) {
+    void *mem;
+    float *old = boxes->x;
+    int old_capacity = boxes->capacity;
+    int capacity = (max_boxes + BOXES_PER_LINE - 1) & ~(BOXES_PER_LINE - 1);
+    int i;
+
+    if (capacity <= old_capacity) {
+        return EXIT_SUCCESS;
+    }
+
+    //One block for all attributes, each one starting on a cache line
+    if (posix_memalign(&mem, BOXES_PER_LINE * sizeof(float),
+            BOX_ATTRIBUTES * capacity * sizeof(float)) != 0) {
+        return EXIT_FAILURE;
+    }
+    memset(mem, 0, BOX_ATTRIBUTES * capacity * sizeof(float));
+
+    //Attributes are laid out back to back in the order of boxes_t
+    for (i = 0; i < BOX_ATTRIBUTES && old; i++) {
+        memcpy((float *)mem + i * capacity, old + i * old_capacity,
+                boxes->count * sizeof(float));
+    }
+    free(old);
+
+    boxes->x = (float *)mem;
+    boxes->y = boxes->x + capacity;
+    boxes->size = boxes->y + capacity;
+    boxes->color = boxes->size + capacity;
+    boxes->prev_x = boxes->color + capacity;
+    boxes->prev_y = boxes->prev_x + capacity;
+    boxes->wrapped = boxes->prev_y + capacity;
+    boxes->capacity = capacity;
+
+    return EXIT_SUCCESS;
+}
+
+void boxes_free(boxes_t *boxes) {
+    free(boxes->x);
+    memset(boxes, 0, sizeof(*boxes));
+}
+
+void boxes_remove(boxes_t *boxes, int i) {
+    int last = --boxes->count;
+
+    //Move the last box into the hole so the arrays stay dense
+    boxes->x[i] = boxes->x[last];
+    boxes->y[i] = boxes->y[last];
+    boxes->size[i] = boxes->size[last];
+    boxes->color[i] = boxes->color[last];
+    boxes->prev_x[i] = boxes->prev_x[last];
+    boxes->prev_y[i] = boxes->prev_y[last];
+    boxes->wrapped[i] = boxes->wrapped[last];
+}
+
+void boxes_save(boxes_t *boxes) {
+    memcpy(boxes->prev_x, boxes->x, boxes->count * sizeof(float));
+    memcpy(boxes->prev_y, boxes->y, boxes->count * sizeof(float));
+}
+
+unsigned boxes_checksum(const boxes_t *boxes) {
+    unsigned hash = 2166136261u;
+    int i;
+
+    for (i = 0; i < boxes->count; i++) {
+        unsigned bits[2];
+        int k;
+
+        memcpy(&bits[0], &boxes->x[i], sizeof(unsigned));
+        memcpy(&bits[1], &boxes->y[i], sizeof(unsigned));
+        for (k = 0; k < 2; k++) {
+            hash = (hash ^ bits[k]) * 16777619u;
+        }
+    }
+
+    return hash;
+}
+
+void boxes_update_scalar(boxes_t *boxes, float gravity_x, float gravity_y,
+        float dt, float width, float height, bool wrap) {
+    boxes_update_scalar_range(boxes, gravity_x, gravity_y, dt, width, height,
+            wrap, 0, boxes->count);
+}
+
+void boxes_update(boxes_t *boxes, float gravity_x, float gravity_y, float dt,
+        float width, float height, bool wrap) {
+    boxes_update_range(boxes, gravity_x, gravity_y, dt, width, height, wrap,
+            0, boxes->count);
+}
+
+void boxes_update_scalar_range(boxes_t *boxes, float gravity_x,
+        float gravity_y, float dt, float width, float height, bool wrap,
+        int begin, int end) {
+    int i;
+    wrap_t w;
+    float *bx = boxes->x;
+    float *by = boxes->y;
+    float *bw = boxes->wrapped;
+
+    setup_wrap(&w, gravity_x, gravity_y, dt, width, height, wrap);
+
+    for (i = begin; i < end; i++) {
+        float x = bx[i] + w.vx;
+        float y = by[i] + w.vy;
+        bool out = (x * w.sx > w.lim_x) || (y * w.sy > w.lim_y);
+
+        if (out) {
+            float t_near_x = (w.near_x - x) * w.inv_dx + w.near_bias_x;
+            float t_near_y = (w.near_y - y) * w.inv_dy + w.near_bias_y;
+            float t_far_x = (w.far_x - x) * w.inv_dx + w.far_bias_x;
+            float t_far_y = (w.far_y - y) * w.inv_dy + w.far_bias_y;
+
+            float t_near = (t_near_x > t_near_y) ? t_near_x : t_near_y;
+            float t_far = (t_far_x < t_far_y) ? t_far_x : t_far_y;
+
+            if (t_near > t_far) {
+                //Corner case, the line does not cross the screen
+                x = 0.0f;
+                y = 0.0f;
+            } else {
+                x = x + t_far * w.dx;
+                y = y + t_far * w.dy;
+            }
+        }
+
+        bx[i] = x;
+        by[i] = y;
+        bw[i] = out ? 1.0f : 0.0f;
+    }
+}
+
+void boxes_update_range(boxes_t *boxes, float gravity_x, float gravity_y,
+        float dt, float width, float height, bool wrap, int begin, int end) {
+#ifdef SIMD_SCALAR
+    boxes_update_scalar_range(boxes, gravity_x, gravity_y, dt, width, height,
+            wrap, begin, end);
+#else
+    int i;
+    wrap_t w;
+    float *bx = boxes->x;
+    float *by = boxes->y;
+    float *bw = boxes->wrapped;
+
+    setup_wrap(&w, gravity_x, gravity_y, dt, width, height, wrap);
+
+    const simd4f zero = simd4f_splat(0.0f);
+    const simd4f one = simd4f_splat(1.0f);
+    const simd4f vx = simd4f_splat(w.vx);
+    const simd4f vy = simd4f_splat(w.vy);
+    const simd4f sx = simd4f_splat(w.sx);
+    const simd4f sy = simd4f_splat(w.sy);
+    const simd4f lim_x = simd4f_splat(w.lim_x);
+    const simd4f lim_y = simd4f_splat(w.lim_y);
+    const simd4f near_x = simd4f_splat(w.near_x);
+    const simd4f near_y = simd4f_splat(w.near_y);
+    const simd4f far_x = simd4f_splat(w.far_x);
+    const simd4f far_y = simd4f_splat(w.far_y);
+    const simd4f inv_dx = simd4f_splat(w.inv_dx);
+    const simd4f inv_dy = simd4f_splat(w.inv_dy);
+    const simd4f near_bias_x = simd4f_splat(w.near_bias_x);
+    const simd4f near_bias_y = simd4f_splat(w.near_bias_y);
+    const simd4f far_bias_x = simd4f_splat(w.far_bias_x);
+    const simd4f far_bias_y = simd4f_splat(w.far_bias_y);
+    const simd4f dx = simd4f_splat(w.dx);
+    const simd4f dy = simd4f_splat(w.dy);
+
+    //Storage is padded to SIMD_WIDTH, the tail lanes are scratch
+    for (i = begin; i < end; i += SIMD_WIDTH) {
+        simd4f x = simd4f_add(simd4f_load(bx + i), vx);
+        simd4f y = simd4f_add(simd4f_load(by + i), vy);
+
+        simd4m out = simd4m_or(simd4f_cmpgt(simd4f_mul(x, sx), lim_x),
+                simd4f_cmpgt(simd4f_mul(y, sy), lim_y));
+
+        simd4f t_near_x = simd4f_add(
+                simd4f_mul(simd4f_sub(near_x, x), inv_dx), near_bias_x);
+        simd4f t_near_y = simd4f_add(
+                simd4f_mul(simd4f_sub(near_y, y), inv_dy), near_bias_y);
+        simd4f t_far_x = simd4f_add(
+                simd4f_mul(simd4f_sub(far_x, x), inv_dx), far_bias_x);
+        simd4f t_far_y = simd4f_add(
+                simd4f_mul(simd4f_sub(far_y, y), inv_dy), far_bias_y);
+
+        simd4f t_near = simd4f_max(t_near_x, t_near_y);
+        simd4f t_far = simd4f_min(t_far_x, t_far_y);
+        simd4m miss = simd4f_cmpgt(t_near, t_far);
+
+        simd4f wx = simd4f_select(miss, zero,
+                simd4f_add(x, simd4f_mul(t_far, dx)));
+        simd4f wy = simd4f_select(miss, zero,
+                simd4f_add(y, simd4f_mul(t_far, dy)));
+
+        simd4f_store(bx + i, simd4f_select(out, wx, x));
+        simd4f_store(by + i, simd4f_select(out, wy, y));
+        simd4f_store(bw + i, simd4f_select(out, one, zero));
+    }
+#endif
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BOXES_H_
+#define BOXES_H_
+
+#include <stdbool.h>
+
+//Largest edge length of a box, in pixels
+#define MAX_SIZE 60.0f
+
+//Distance travelled per second for each unit of gravity, in pixels
+#define BOX_SPEED 300.0f
+
+//Boxes per 64 byte cache line in each attribute array
+#define BOXES_PER_LINE 16
+
+//Number of float arrays in boxes_t
+#define BOX_ATTRIBUTES 7
+
+/**
+ * Box storage laid out as a structure of arrays so that the update kernel
+ * can load four boxes worth of one attribute with a single vector load.
+ * Every array starts on a cache line and holds capacity entries, where
+ * capacity is a multiple of BOXES_PER_LINE. Ranges of boxes that start on a
+ * multiple of BOXES_PER_LINE can therefore be updated from different
+ * threads without sharing cache lines.
+ *
+ * prev_x and prev_y hold the positions before the last step so that the
+ * renderer can interpolate between simulation ticks. wrapped is 1 for
+ * boxes that the last step wrapped around to the opposite edge, which the
+ * renderer must not interpolate, and 0 otherwise.
+ *
+ * Boxes [0, count) are always live. Removing a box moves the last one into
+ * its slot, so adding and removing are O(1) and the update kernel never
+ * has to skip holes.
+ */
+typedef struct {
+    float *x;
+    float *y;
+    float *size;
+    float *color;
+    float *prev_x;
+    float *prev_y;
+    float *wrapped;
+
+    int count;
+    int capacity;
+} boxes_t;
+
+/**
+ * Allocates storage for at least max_boxes boxes.
+ *
+ * @param boxes structure to initialize
+ * @param max_boxes number of boxes that need to fit
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int boxes_init(boxes_t *boxes, int max_boxes);
+
+/**
+ * Grows the storage so that at least max_boxes boxes fit, keeping the
+ * current boxes. Pointers into the old arrays become invalid.
+ *
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int boxes_reserve(boxes_t *boxes, int max_boxes);
+
+/**
+ * Removes box i by moving the last box into its place.
+ */
+void boxes_remove(boxes_t *boxes, int i);
+
+/**
+ * Releases storage allocated by boxes_init().
+ */
+void boxes_free(boxes_t *boxes);
+
+/**
+ * Copies the current positions into prev_x and prev_y.
+ */
+void boxes_save(boxes_t *boxes);
+
+/**
+ * Returns an FNV-1a style hash over the bits of every box position.
+ */
+unsigned boxes_checksum(const boxes_t *boxes);
+
+/**
+ * Moves every box along the gravity vector for dt seconds. If wrap is set,
+ * boxes that left the width x height area come back in at the opposite
+ * edge, along the line they were travelling on, and are flagged in
+ * wrapped. Uses the vector kernel.
+ */
+void boxes_update(boxes_t *boxes, float gravity_x, float gravity_y, float dt,
+        float width, float height, bool wrap);
+
+/**
+ * Scalar reference version of boxes_update(). Performs the same floating
+ * point operations in the same order, so both produce identical bits for
+ * any position that is not denormal (see simd.h).
+ */
+void boxes_update_scalar(boxes_t *boxes, float gravity_x, float gravity_y,
+        float dt, float width, float height, bool wrap);
+
+/**
+ * Same as boxes_update() for boxes [begin, end) only. begin must be a
+ * multiple of SIMD_WIDTH. Boxes are updated independently of each other,
+ * so splitting a step into ranges gives the same result as one call.
+ */
+void boxes_update_range(boxes_t *boxes, float gravity_x, float gravity_y,
+        float dt, float width, float height, bool wrap, int begin, int end);
+
+/**
+ * Same as boxes_update_scalar() for boxes [begin, end) only.
+ */
+void boxes_update_scalar_range(boxes_t *boxes, float gravity_x,
+        float gravity_y, float dt, float width, float height, bool wrap,
+        int begin, int end);
+
+#endif /* BOXES_H_ */
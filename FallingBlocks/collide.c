@@ -0,0 +1,556 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "collide.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define CELL_SIZE MAX_SIZE
+
+//Boxes may sit up to MAX_SIZE past the left and bottom edges before they
+//wrap and a step past the right and top edges, keep a margin on each side.
+//Anything further out is clamped into the border cells.
+#define MARGIN (2.0f * MAX_SIZE)
+
+//An edge or a box only holds others up along an axis that gravity pulls
+//along with at least this fraction of its strength, about 75 degrees
+#define SUPPORT_FRACTION 0.25f
+
+//Most collision passes per step when boxes pile up. Passes stop as soon
+//as one finds no overlapping pair.
+#define STACK_PASSES 16
+
+//Overlap, in pixels, that boxes placed against each other may be left
+//with by rounding. Boxes overlapping by less still block each other.
+#define CONTACT_SLOP 0.01f
+
+void collide_init(grid_t *grid) {
+    memset(grid, 0, sizeof(*grid));
+}
+
+void collide_free(grid_t *grid) {
+    free(grid->cell_start);
+    free(grid->cell_of);
+    free(grid->sorted);
+    free(grid->resting);
+    free(grid->target_x);
+    free(grid->target_y);
+    free(grid->order);
+    memset(grid, 0, sizeof(*grid));
+}
+
+static int resize(grid_t *grid, int num_boxes, float width, float height) {
+    int cols = (int)((width + 2.0f * MARGIN) / CELL_SIZE) + 1;
+    int rows = (int)((height + 2.0f * MARGIN) / CELL_SIZE) + 1;
+
+    grid->origin_x = -MARGIN;
+    grid->origin_y = -MARGIN;
+    grid->cols = cols;
+    grid->rows = rows;
+
+    if (cols * rows > grid->num_cells) {
+        int *cell_start = (int *)realloc(grid->cell_start,
+                sizeof(int) * (cols * rows + 1));
+        if (!cell_start) {
+            return EXIT_FAILURE;
+        }
+        grid->cell_start = cell_start;
+        grid->num_cells = cols * rows;
+    }
+
+    if (num_boxes > grid->max_boxes) {
+        int *cell_of = (int *)realloc(grid->cell_of, sizeof(int) * num_boxes);
+        int *sorted;
+        unsigned char *resting;
+        float *target_x;
+        float *target_y;
+        collide_order_t *order;
+        if (!cell_of) {
+            return EXIT_FAILURE;
+        }
+        grid->cell_of = cell_of;
+
+        sorted = (int *)realloc(grid->sorted, sizeof(int) * num_boxes);
+        if (!sorted) {
+            return EXIT_FAILURE;
+        }
+        grid->sorted = sorted;
+
+        resting = (unsigned char *)realloc(grid->resting, num_boxes);
+        if (!resting) {
+            return EXIT_FAILURE;
+        }
+        grid->resting = resting;
+
+        target_x = (float *)realloc(grid->target_x, sizeof(float) * num_boxes);
+        if (!target_x) {
+            return EXIT_FAILURE;
+        }
+        grid->target_x = target_x;
+
+        target_y = (float *)realloc(grid->target_y, sizeof(float) * num_boxes);
+        if (!target_y) {
+            return EXIT_FAILURE;
+        }
+        grid->target_y = target_y;
+
+        order = (collide_order_t *)realloc(grid->order,
+                sizeof(collide_order_t) * num_boxes);
+        if (!order) {
+            return EXIT_FAILURE;
+        }
+        grid->order = order;
+        grid->max_boxes = num_boxes;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+static void build(grid_t *grid, const boxes_t *boxes) {
+    int i;
+    int num_cells = grid->cols * grid->rows;
+    int *cell_start = grid->cell_start;
+    int *cell_of = grid->cell_of;
+    const float inv_cell = 1.0f / CELL_SIZE;
+
+    memset(cell_start, 0, sizeof(int) * (num_cells + 1));
+
+    //Count boxes per cell, shifted by one so the prefix sum below leaves
+    //the first index of every cell in cell_start[cell]
+    for (i = 0; i < boxes->count; i++) {
+        int cx = (int)((boxes->x[i] - grid->origin_x) * inv_cell);
+        int cy = (int)((boxes->y[i] - grid->origin_y) * inv_cell);
+
+        if (cx < 0) {
+            cx = 0;
+        } else if (cx >= grid->cols) {
+            cx = grid->cols - 1;
+        }
+
+        if (cy < 0) {
+            cy = 0;
+        } else if (cy >= grid->rows) {
+            cy = grid->rows - 1;
+        }
+
+        cell_of[i] = cy * grid->cols + cx;
+        cell_start[cell_of[i] + 1]++;
+    }
+
+    for (i = 0; i < num_cells; i++) {
+        cell_start[i + 1] += cell_start[i];
+    }
+
+    //Scatter, using cell_start as the running insert position. This shifts
+    //every entry to the start of the next cell, which is undone afterwards.
+    for (i = 0; i < boxes->count; i++) {
+        grid->sorted[cell_start[cell_of[i]]++] = i;
+    }
+
+    for (i = num_cells; i > 0; i--) {
+        cell_start[i] = cell_start[i - 1];
+    }
+    cell_start[0] = 0;
+}
+
+//Direction gravity pulls along one axis if it is strong enough there
+static int down(float along, float across) {
+    if (along * along < SUPPORT_FRACTION * SUPPORT_FRACTION
+            * (along * along + across * across)) {
+        return 0;
+    }
+    return (along < 0.0f) ? -1 : 1;
+}
+
+//Marks the boxes touching an edge that gravity pulls them towards
+static void rest_on_edges(grid_t *grid, const boxes_t *boxes, float width,
+        float height) {
+    int i;
+
+    for (i = 0; i < boxes->count; i++) {
+        float x = boxes->x[i];
+        float y = boxes->y[i];
+        float size = boxes->size[i];
+
+        grid->resting[i] = (grid->down_x < 0 && x <= 0.0f)
+                || (grid->down_x > 0 && x + size >= width)
+                || (grid->down_y < 0 && y <= 0.0f)
+                || (grid->down_y > 0 && y + size >= height);
+    }
+}
+
+//Moves a and b apart by push along one axis, b in the direction of push.
+//A box that would be pushed along gravity stays put if it is resting and
+//the other one takes the whole push and comes to rest on it. Across
+//gravity a resting box stays put if the other one is free to move.
+//Otherwise each moves half.
+static void separate(grid_t *grid, float *position, int a, int b,
+        float push, int down) {
+    unsigned char *resting = grid->resting;
+
+    if (down != 0 && push * down > 0.0f && resting[b]) {
+        position[a] -= push;
+        resting[a] = 1;
+    } else if (down != 0 && push * down < 0.0f && resting[a]) {
+        position[b] += push;
+        resting[b] = 1;
+    } else if (resting[a] && !resting[b]) {
+        position[b] += push;
+    } else if (resting[b] && !resting[a]) {
+        position[a] -= push;
+    } else {
+        position[a] -= 0.5f * push;
+        position[b] += 0.5f * push;
+    }
+}
+
+//Narrowphase for one pair, pushes the boxes apart along the axis of least
+//penetration
+static void resolve(grid_t *grid, boxes_t *boxes, int a, int b) {
+    collide_stats_t *stats = &grid->stats;
+    float half_a = 0.5f * boxes->size[a];
+    float half_b = 0.5f * boxes->size[b];
+    float dx = (boxes->x[b] + half_b) - (boxes->x[a] + half_a);
+    float dy = (boxes->y[b] + half_b) - (boxes->y[a] + half_a);
+    float px = half_a + half_b - (dx < 0.0f ? -dx : dx);
+    float py = half_a + half_b - (dy < 0.0f ? -dy : dy);
+
+    stats->pairs_tested++;
+
+    if (px <= 0.0f || py <= 0.0f) {
+        return;
+    }
+
+    stats->contacts++;
+
+    //A step can carry a box most of the way through another, so a pile
+    //pushes boxes out on the side they were on before the step, along the
+    //axis on which they only started to overlap during it
+    if (grid->stack) {
+        float side_x = (boxes->prev_x[b] + half_b)
+                - (boxes->prev_x[a] + half_a);
+        float side_y = (boxes->prev_y[b] + half_b)
+                - (boxes->prev_y[a] + half_a);
+        bool was_x = (half_a + half_b > (side_x < 0.0f ? -side_x : side_x));
+        bool was_y = (half_a + half_b > (side_y < 0.0f ? -side_y : side_y));
+
+        if (side_x != 0.0f) {
+            px = half_a + half_b - (side_x < 0.0f ? -dx : dx);
+            dx = side_x;
+        }
+        if (side_y != 0.0f) {
+            py = half_a + half_b - (side_y < 0.0f ? -dy : dy);
+            dy = side_y;
+        }
+
+        if (was_x && !was_y) {
+            px = py + 1.0f;
+        } else if (was_y && !was_x) {
+            py = px + 1.0f;
+        }
+    }
+
+    if (px < py) {
+        separate(grid, boxes->x, a, b, (dx < 0.0f) ? -px : px, grid->down_x);
+    } else {
+        separate(grid, boxes->y, a, b, (dy < 0.0f) ? -py : py, grid->down_y);
+    }
+}
+
+static void collide_cells(grid_t *grid, boxes_t *boxes, int cell, int other) {
+    int i, j;
+    int *sorted = grid->sorted;
+    int end = grid->cell_start[cell + 1];
+    int other_end = grid->cell_start[other + 1];
+
+    for (i = grid->cell_start[cell]; i < end; i++) {
+        for (j = grid->cell_start[other]; j < other_end; j++) {
+            resolve(grid, boxes, sorted[i], sorted[j]);
+        }
+    }
+}
+
+//Resolves every pair of boxes in neighbouring cells once
+static void sweep(grid_t *grid, boxes_t *boxes) {
+    int row, col, i, j;
+    int step_x, step_y;
+
+    //Walk rows and columns away from the edges gravity pulls towards, so
+    //the pairs below a box are resolved before the pairs above it
+    step_x = (grid->down_x > 0) ? -1 : 1;
+    step_y = (grid->down_y > 0) ? -1 : 1;
+
+    //Each pair of cells is visited once: a cell against itself, then
+    //against the next one in its row and the three in the next row
+    for (row = 0; row < grid->rows; row++) {
+        int cy = (step_y > 0) ? row : grid->rows - 1 - row;
+
+        for (col = 0; col < grid->cols; col++) {
+            int cx = (step_x > 0) ? col : grid->cols - 1 - col;
+            int cell = cy * grid->cols + cx;
+            int start = grid->cell_start[cell];
+            int end = grid->cell_start[cell + 1];
+
+            if (start == end) {
+                continue;
+            }
+
+            for (i = start; i < end; i++) {
+                for (j = i + 1; j < end; j++) {
+                    resolve(grid, boxes, grid->sorted[i], grid->sorted[j]);
+                }
+            }
+
+            if (cx + step_x >= 0 && cx + step_x < grid->cols) {
+                collide_cells(grid, boxes, cell, cell + step_x);
+            }
+
+            if (cy + step_y >= 0 && cy + step_y < grid->rows) {
+                int next = cell + step_y * grid->cols;
+
+                if (cx > 0) {
+                    collide_cells(grid, boxes, cell, next - 1);
+                }
+                collide_cells(grid, boxes, cell, next);
+                if (cx + 1 < grid->cols) {
+                    collide_cells(grid, boxes, cell, next + 1);
+                }
+            }
+        }
+    }
+}
+
+//Orders boxes furthest along gravity first, ties by index so the result
+//does not depend on how qsort() orders equal keys
+static int compare_order(const void *a, const void *b) {
+    const collide_order_t *order_a = (const collide_order_t *)a;
+    const collide_order_t *order_b = (const collide_order_t *)b;
+
+    if (order_a->key != order_b->key) {
+        return (order_a->key > order_b->key) ? -1 : 1;
+    }
+    return order_a->box - order_b->box;
+}
+
+//Length of the overlap of [a, a + size_a) and [b, b + size_b), negative
+//if there is a gap between them
+static inline float overlap(float a, float size_a, float b, float size_b) {
+    float lo = (a > b) ? a : b;
+    float hi = (a + size_a < b + size_b) ? a + size_a : b + size_b;
+
+    return hi - lo;
+}
+
+//Distance between a and b
+static inline float fabs_diff(float a, float b) {
+    return (a < b) ? b - a : a - b;
+}
+
+//Cell column or row that offset from the grid origin falls into, clamped
+//to the grid like build() does
+static int cell_index(float offset, int count) {
+    int c = (int)(offset * (1.0f / CELL_SIZE));
+
+    if (c < 0) {
+        return 0;
+    } else if (c >= count) {
+        return count - 1;
+    }
+    return c;
+}
+
+//Moves box i along one axis towards target and stops it against the first
+//box in the way. Boxes it already overlaps do not stop it. The grid was
+//built before the boxes moved, so every box may be up to reach away from
+//the cell it is sorted into. Returns whether a box stopped it.
+static bool advance_axis(grid_t *grid, boxes_t *boxes, int i, float target,
+        float reach, bool along_x) {
+    float *position = along_x ? boxes->x : boxes->y;
+    const float *across = along_x ? boxes->y : boxes->x;
+    const float *size = boxes->size;
+    float start = position[i];
+    float end = target;
+    float lo = (start < end) ? start : end;
+    float hi = ((start < end) ? end : start) + size[i];
+    float x0, x1, y0, y1;
+    int cx0, cx1, cy0, cy1, cx, cy, k;
+
+    if (end == start) {
+        return false;
+    }
+
+    //Area the box sweeps through
+    if (along_x) {
+        x0 = lo;
+        x1 = hi;
+        y0 = boxes->y[i];
+        y1 = y0 + size[i];
+    } else {
+        x0 = boxes->x[i];
+        x1 = x0 + size[i];
+        y0 = lo;
+        y1 = hi;
+    }
+
+    cx0 = cell_index(x0 - MAX_SIZE - reach - grid->origin_x, grid->cols);
+    cx1 = cell_index(x1 + reach - grid->origin_x, grid->cols);
+    cy0 = cell_index(y0 - MAX_SIZE - reach - grid->origin_y, grid->rows);
+    cy1 = cell_index(y1 + reach - grid->origin_y, grid->rows);
+
+    for (cy = cy0; cy <= cy1; cy++) {
+        for (cx = cx0; cx <= cx1; cx++) {
+            int cell = cy * grid->cols + cx;
+
+            for (k = grid->cell_start[cell]; k < grid->cell_start[cell + 1];
+                    k++) {
+                int j = grid->sorted[k];
+
+                if (j == i) {
+                    continue;
+                }
+
+                grid->stats.pairs_tested++;
+
+                if (overlap(across[i], size[i], across[j], size[j])
+                        <= CONTACT_SLOP
+                        || overlap(start, size[i], position[j], size[j])
+                        > CONTACT_SLOP) {
+                    continue;
+                }
+
+                if (end > start && position[j] >= start + size[i]
+                        - CONTACT_SLOP && position[j] - size[i] < end) {
+                    end = position[j] - size[i];
+                } else if (end < start && position[j] + size[j] <= start
+                        + CONTACT_SLOP && position[j] + size[j] > end) {
+                    end = position[j] + size[j];
+                }
+            }
+        }
+    }
+
+    //A box left touching by rounding may stop it before it moved at all
+    if ((target > start && end > start) || (target < start && end < start)) {
+        position[i] = end;
+    }
+
+    return end != target;
+}
+
+//Moves every box again from where it was before the update to where the
+//update put it, without passing through any box it did not overlap yet
+static void advance(grid_t *grid, boxes_t *boxes, float gravity_x,
+        float gravity_y) {
+    collide_order_t *order = grid->order;
+    float reach = 0.0f;
+    int i, k;
+
+    for (i = 0; i < boxes->count; i++) {
+        float dx = boxes->x[i] - boxes->prev_x[i];
+        float dy = boxes->y[i] - boxes->prev_y[i];
+
+        dx = (dx < 0.0f) ? -dx : dx;
+        dy = (dy < 0.0f) ? -dy : dy;
+        if (dx > reach) {
+            reach = dx;
+        }
+        if (dy > reach) {
+            reach = dy;
+        }
+
+        grid->target_x[i] = boxes->x[i];
+        grid->target_y[i] = boxes->y[i];
+        boxes->x[i] = boxes->prev_x[i];
+        boxes->y[i] = boxes->prev_y[i];
+
+        order[i].key = boxes->x[i] * gravity_x + boxes->y[i] * gravity_y;
+        order[i].box = i;
+    }
+
+    qsort(order, boxes->count, sizeof(collide_order_t), compare_order);
+    build(grid, boxes);
+
+    for (k = 0; k < boxes->count; k++) {
+        bool stopped_x, stopped_y;
+
+        i = order[k].box;
+
+        //The longer part of the move first, so a falling box that grazes
+        //a corner lands on top of it rather than stopping beside it
+        if (fabs_diff(grid->target_x[i], boxes->x[i])
+                >= fabs_diff(grid->target_y[i], boxes->y[i])) {
+            stopped_x = advance_axis(grid, boxes, i, grid->target_x[i], reach,
+                    true);
+            stopped_y = advance_axis(grid, boxes, i, grid->target_y[i], reach,
+                    false);
+        } else {
+            stopped_y = advance_axis(grid, boxes, i, grid->target_y[i], reach,
+                    false);
+            stopped_x = advance_axis(grid, boxes, i, grid->target_x[i], reach,
+                    true);
+        }
+
+        //A box held up by another one rests on it, so pushing apart the
+        //boxes that overlap does not drive it down into the one below
+        if ((stopped_x && grid->down_x != 0)
+                || (stopped_y && grid->down_y != 0)) {
+            grid->resting[i] = 1;
+        }
+    }
+}
+
+int collide_step(grid_t *grid, boxes_t *boxes, float width, float height,
+        float gravity_x, float gravity_y, bool stack) {
+    int pass;
+
+    grid->stats.pairs_tested = 0;
+    grid->stats.contacts = 0;
+
+    if (boxes->count < 2) {
+        return EXIT_SUCCESS;
+    }
+
+    if (EXIT_SUCCESS != resize(grid, boxes->capacity, width, height)) {
+        return EXIT_FAILURE;
+    }
+
+    grid->stack = stack;
+    grid->down_x = stack ? down(gravity_x, gravity_y) : 0;
+    grid->down_y = stack ? down(gravity_y, gravity_x) : 0;
+
+    rest_on_edges(grid, boxes, width, height);
+
+    if (stack) {
+        advance(grid, boxes, gravity_x, gravity_y);
+    }
+
+    //Push apart the boxes that already overlapped. Cells are coarser than
+    //the boxes, so a pair on top of a pile can come up before the pair
+    //under it. A pile takes a few passes to settle.
+    for (pass = 0; pass < (stack ? STACK_PASSES : 1); pass++) {
+        int contacts = grid->stats.contacts;
+
+        build(grid, boxes);
+        sweep(grid, boxes);
+
+        if (grid->stats.contacts == contacts) {
+            break;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COLLIDE_H_
+#define COLLIDE_H_
+
+#include <stdbool.h>
+
+#include "boxes.h"
+
+typedef struct {
+    //Box pairs that reached the AABB test in the last step
+    int pairs_tested;
+    //Pairs that overlapped and were pushed apart
+    int contacts;
+} collide_stats_t;
+
+typedef struct {
+    //Distance along gravity, boxes further along are moved first
+    float key;
+    int box;
+} collide_order_t;
+
+/**
+ * Uniform grid broadphase. Cells are MAX_SIZE wide so a box can only touch
+ * boxes anchored in its own or a neighbouring cell. The grid is rebuilt
+ * every step with a counting sort: count boxes per cell, prefix sum the
+ * counts into cell_start, then scatter box indices into sorted.
+ */
+typedef struct {
+    float origin_x;
+    float origin_y;
+    int cols;
+    int rows;
+
+    int *cell_start;
+    int num_cells;
+
+    int *cell_of;
+    int *sorted;
+    //Boxes that cannot move any further along gravity this step
+    unsigned char *resting;
+    int max_boxes;
+
+    //Stack only: where the update moved each box, and the boxes in the
+    //order they are moved there, furthest along gravity first
+    float *target_x;
+    float *target_y;
+    collide_order_t *order;
+
+    //Boxes pile up, and the direction gravity pulls along each axis, -1, 0
+    //or 1
+    bool stack;
+    int down_x;
+    int down_y;
+
+    collide_stats_t stats;
+} grid_t;
+
+/**
+ * Prepares an empty grid. Storage is allocated on the first step.
+ */
+void collide_init(grid_t *grid);
+
+/**
+ * Releases storage held by the grid.
+ */
+void collide_free(grid_t *grid);
+
+/**
+ * Rebuilds the grid and pushes every overlapping pair of boxes apart along
+ * the axis of least penetration. Pairs are visited in a fixed order so the
+ * result is deterministic.
+ *
+ * With stack set the boxes are expected to be kept inside the width x
+ * height area. Each box is first moved again from its position before the
+ * update (prev_x, prev_y) to where the update put it, one axis at a time,
+ * and stops against the first box in its way. Boxes are moved furthest
+ * along gravity first, so a box follows the one under it down within the
+ * step, and boxes that did not overlap before the step never overlap
+ * after it. A pile that has settled therefore stays exactly where it is.
+ *
+ * Boxes that already overlapped, such as a box added on top of another,
+ * pass through each other and are then pushed apart. A box touching the
+ * edge gravity pulls towards or stopped by another box along gravity is
+ * resting, and a box pushed off a resting box against gravity comes to
+ * rest on it. Resting boxes are not moved by boxes that are still falling,
+ * which take the whole push instead. Boxes are pushed out on the side they
+ * were on before the step. Pairs are resolved starting from the edge
+ * gravity pulls towards, in passes until one finds no overlap left,
+ * so rest spreads upwards through a pile within the step.
+ *
+ * @param gravity_x gravity, only used with stack
+ * @param gravity_y gravity, only used with stack
+ * @param stack whether boxes pile up against the edges
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE if out of memory
+ */
+int collide_step(grid_t *grid, boxes_t *boxes, float width, float height,
+        float gravity_x, float gravity_y, bool stack);
+
+#endif /* COLLIDE_H_ */
@@ -18,11 +18,30 @@ CCFLAGS+=-fstack-protector-strong -D_FORTIFY_SOURCE=2 \
 	$(if $(filter g so shared,$(VARIANTS)),,-fPIE) \
 	$(if $(filter g,$(VARIANTS)),,-frecord-gcc-switches)
 
+# Vector units for the box update kernel and vecmath.c. Contraction into
+# fused multiply-add is disabled so the vector and scalar kernels round
+# identically.
+CCFLAGS+=-ffp-contract=off \
+	$(if $(filter arm,$(CPU)),-mfpu=neon) \
+	$(if $(filter x86,$(CPU)),-msse2 -mfpmath=sse)
+
+# OpenGL ES version to draw with: 2 for shaders (the default) or 1 for the
+# fixed function pipeline, e.g. make GLES=1. Only the library of that
+# version is linked, so the entry points both share always reach it.
+GLES?=2
+ifeq ($(GLES),1)
+CCFLAGS+=-DUSING_GL11
+GLES_LIB=GLESv1_CM
+else
+CCFLAGS+=-DUSING_GL20
+GLES_LIB=GLESv2
+endif
+
 # Linker options for enhanced security
 LDFLAGS+=-Wl,-z,relro -Wl,-z,now $(if $(filter g so shared,$(VARIANTS)),,-pie)
 
 # Add your required library names, here
-LIBS+=bps glview screen GLESv1_CM
+LIBS+=bps glview screen $(GLES_LIB) m
 
 include $(MKFILES_ROOT)/qmacros.mk
 
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gravity.h"
+
+#include <math.h>
+#include <string.h>
+
+#define HISTORY_MASK (GRAVITY_HISTORY - 1)
+
+//Readings used to estimate the slope for extrapolation
+#define SLOPE_SPAN 3
+
+static const char *filter_names[GRAVITY_FILTER_COUNT] = {
+    "none",
+    "lowpass",
+    "oneeuro",
+};
+
+void gravity_init(gravity_t *gravity, gravity_filter_t filter) {
+    memset(gravity, 0, sizeof(*gravity));
+
+    gravity->filter = filter;
+    gravity->cutoff = 4.0f;
+    gravity->min_cutoff = 1.0f;
+    gravity->beta = 0.3f;
+    gravity->d_cutoff = 1.0f;
+    gravity->horizon = 0.05f;
+}
+
+const char *gravity_filter_name(gravity_filter_t filter) {
+    return (filter < GRAVITY_FILTER_COUNT) ? filter_names[filter] : "unknown";
+}
+
+gravity_filter_t gravity_filter_from_name(const char *name) {
+    int i;
+
+    for (i = 0; i < GRAVITY_FILTER_COUNT; i++) {
+        if (!strcmp(name, filter_names[i])) {
+            return (gravity_filter_t)i;
+        }
+    }
+
+    return GRAVITY_FILTER_COUNT;
+}
+
+//Smoothing factor of an exponential filter with the given cutoff
+static float smoothing(float cutoff, float dt) {
+    float tau = 1.0f / (2.0f * (float)M_PI * cutoff);
+    return 1.0f / (1.0f + tau / dt);
+}
+
+void gravity_push(gravity_t *gravity, double time, float x, float y) {
+    gravity_sample_t *sample;
+
+    if (gravity->count == 0) {
+        gravity->x = x;
+        gravity->y = y;
+        gravity->dx = 0.0f;
+        gravity->dy = 0.0f;
+    } else {
+        const gravity_sample_t *last =
+                &gravity->history[(gravity->head - 1) & HISTORY_MASK];
+        float dt = (float)(time - last->time);
+        float a;
+
+        if (dt <= 0.0f) {
+            dt = 1e-3f;
+        }
+
+        switch (gravity->filter) {
+        case GRAVITY_FILTER_LOWPASS:
+            a = smoothing(gravity->cutoff, dt);
+            gravity->x += a * (x - gravity->x);
+            gravity->y += a * (y - gravity->y);
+            break;
+        case GRAVITY_FILTER_ONE_EURO: {
+            //Smoothed speed decides how much smoothing the value gets
+            float ad = smoothing(gravity->d_cutoff, dt);
+            float speed;
+
+            gravity->dx += ad * ((x - gravity->x) / dt - gravity->dx);
+            gravity->dy += ad * ((y - gravity->y) / dt - gravity->dy);
+            speed = sqrtf(gravity->dx * gravity->dx + gravity->dy * gravity->dy);
+
+            a = smoothing(gravity->min_cutoff + gravity->beta * speed, dt);
+            gravity->x += a * (x - gravity->x);
+            gravity->y += a * (y - gravity->y);
+            break;
+        }
+        default:
+            gravity->x = x;
+            gravity->y = y;
+            break;
+        }
+    }
+
+    sample = &gravity->history[gravity->head];
+    sample->time = time;
+    sample->x = gravity->x;
+    sample->y = gravity->y;
+
+    gravity->head = (gravity->head + 1) & HISTORY_MASK;
+    if (gravity->count < GRAVITY_HISTORY) {
+        gravity->count++;
+    }
+}
+
+void gravity_predict(const gravity_t *gravity, double time, float *x,
+        float *y) {
+    const gravity_sample_t *newest;
+    const gravity_sample_t *oldest;
+    double ahead, span;
+    int back;
+
+    if (gravity->count == 0) {
+        return;
+    }
+
+    newest = &gravity->history[(gravity->head - 1) & HISTORY_MASK];
+    *x = newest->x;
+    *y = newest->y;
+
+    //Raw readings are held, extrapolating them would amplify the noise
+    if (gravity->filter == GRAVITY_FILTER_NONE || gravity->count < 2) {
+        return;
+    }
+
+    back = (gravity->count < SLOPE_SPAN) ? gravity->count : SLOPE_SPAN;
+    oldest = &gravity->history[(gravity->head - back) & HISTORY_MASK];
+    span = newest->time - oldest->time;
+    if (span <= 0.0) {
+        return;
+    }
+
+    ahead = time - newest->time;
+    if (ahead <= 0.0) {
+        return;
+    }
+    if (ahead > gravity->horizon) {
+        ahead = gravity->horizon;
+    }
+
+    *x += (float)((newest->x - oldest->x) * ahead / span);
+    *y += (float)((newest->y - oldest->y) * ahead / span);
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GRAVITY_H_
+#define GRAVITY_H_
+
+//Filtered readings kept for extrapolation, must be a power of two
+#define GRAVITY_HISTORY 8
+
+typedef enum {
+    //Raw readings, held until the next one arrives
+    GRAVITY_FILTER_NONE,
+    //Fixed cutoff exponential smoothing
+    GRAVITY_FILTER_LOWPASS,
+    //One euro filter: smooth while still, cutoff rises with speed
+    GRAVITY_FILTER_ONE_EURO,
+    GRAVITY_FILTER_COUNT
+} gravity_filter_t;
+
+typedef struct {
+    double time;
+    float x;
+    float y;
+} gravity_sample_t;
+
+/**
+ * Gravity sensor processing: every reading is timestamped, filtered and
+ * stored in a small ring buffer. gravity_predict() then extrapolates the
+ * filtered signal to the time a frame will actually be shown, so the
+ * simulation follows the device at display rate instead of stepping at
+ * sensor rate.
+ */
+typedef struct {
+    gravity_filter_t filter;
+
+    //Filtered readings, newest at history[(head - 1) & (GRAVITY_HISTORY - 1)]
+    gravity_sample_t history[GRAVITY_HISTORY];
+    int head;
+    int count;
+
+    //Filter state
+    float x;
+    float y;
+    float dx;
+    float dy;
+
+    //Low pass cutoff in Hz
+    float cutoff;
+    //One euro parameters: cutoff at rest in Hz, speed coefficient and the
+    //cutoff used to smooth the speed estimate
+    float min_cutoff;
+    float beta;
+    float d_cutoff;
+
+    //Longest time, in seconds, gravity_predict() extrapolates past the
+    //newest reading
+    float horizon;
+} gravity_t;
+
+/**
+ * Resets the pipeline and selects a filter, using default parameters.
+ */
+void gravity_init(gravity_t *gravity, gravity_filter_t filter);
+
+/**
+ * Filters a new reading and adds it to the history.
+ *
+ * @param time when the reading was taken, in seconds on a monotonic clock
+ */
+void gravity_push(gravity_t *gravity, double time, float x, float y);
+
+/**
+ * Estimates gravity at the given time by extrapolating the filtered
+ * readings along their recent slope, at most horizon seconds past the
+ * newest one. Leaves x and y untouched if there are no readings yet.
+ */
+void gravity_predict(const gravity_t *gravity, double time, float *x,
+        float *y);
+
+/**
+ * Returns a printable name for a filter.
+ */
+const char *gravity_filter_name(gravity_filter_t filter);
+
+/**
+ * Parses a filter name as returned by gravity_filter_name().
+ *
+ * @return the filter, or GRAVITY_FILTER_COUNT if the name is unknown
+ */
+gravity_filter_t gravity_filter_from_name(const char *name);
+
+#endif /* GRAVITY_H_ */
@@ -21,56 +21,121 @@
 #include <bps/sensor.h>
 
 #include <glview/glview.h>
+#ifdef USING_GL11
 #include <GLES/gl.h>
+#elif defined(USING_GL20)
+#include <GLES2/gl2.h>
+#else
+#error FallingBlocks must be compiled with either USING_GL11 or USING_GL20 flags
+#endif
 #include <screen/screen.h>
 
 #include <math.h>
+#include <pthread.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
+#include <time.h>
 
-typedef struct {
-    float x;
-    float y;
-    float size;
-    GLfloat color;
-} box_t;
+#include "bench.h"
+#include "gravity.h"
+#include "render.h"
+#include "world.h"
 
 typedef struct {
-    float gravity_x;
-    float gravity_y;
     float width;
     float height;
 
-    int num_boxes;
-    box_t *boxes;
+    world_t world;
+    render_t render;
+
+    //Sensor readings are filtered and extrapolated to the time each tick
+    //will be on screen, predict is how far ahead of the tick that is
+    gravity_t gravity;
+    double predict;
+
+    //Raw readings are appended here when FALLINGBLOCKS_SENSOR_TRACE is set
+    FILE *trace;
+
+    //Boxes added per tap
+    int burst;
+
+    //The simulation advances in fixed ticks, real time is banked in the
+    //accumulator and at most max_steps ticks are run per frame
+    double tick;
+    int max_steps;
+    double accumulator;
+    double last_time;
+
+    //Stress mode keeps adding boxes until the frame rate drops below 60 fps
+    bool stress;
+    int stress_frames;
+    double stress_start;
 } app_t;
 
-static const GLfloat vertices[] =
-{
-    0.0f, 0.0f,
-    1.0f, 0.0f,
-    0.0f, 1.0f,
-    1.0f, 1.0f,
-};
+#define MAX_BOXES 100000
+
+//Render buffers start out this big and grow with the number of boxes
+#define INITIAL_BOXES 1024
+
+//Extra boxes of a burst land within this distance of the tap
+#define BURST_RADIUS (2.0f * MAX_SIZE)
 
-#define MAX_SIZE 60.0f
-#define MAX_BOXES 200
+//Simulation rate and how many ticks a slow frame may catch up on
+#define DEFAULT_TICK_RATE 60
+#define DEFAULT_MAX_STEPS 4
+
+//A frame shows up on screen one refresh after it is drawn
+#define DEFAULT_PREDICT_MS 16
+
+//Stress mode measures frame rate over this many frames before growing
+#define STRESS_WINDOW 30
+#define STRESS_STEP 250
+#define STRESS_TARGET_FPS 59.0
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
 
 static void add_cube(app_t *app, int x, int y) {
-    //See if we reached a limit
-    int num_boxes = app->num_boxes;
-    if (num_boxes == MAX_BOXES - 1) {
+    //Screen coordinates start at the top, world coordinates at the bottom
+    float wx = (float)x;
+    float wy = app->height - (float)y;
+    int i;
+
+    if (!world_add_box(&app->world, wx, wy)) {
         return;
     }
 
-    //Add a cube with a random shade of green and some size variation
-    app->boxes[num_boxes].color = ((float) rand()) / RAND_MAX;
+    //Scatter the rest of a burst around the tap
+    for (i = 1; i < app->burst; i++) {
+        float dx = BURST_RADIUS * (2.0f * world_random(&app->world) - 1.0f);
+        float dy = BURST_RADIUS * (2.0f * world_random(&app->world) - 1.0f);
 
-    app->boxes[num_boxes].x = (float)x;
-    app->boxes[num_boxes].y = app->height - (float)y;
-    app->boxes[num_boxes].size = 40.0 + 20.0 * ((float) rand()) / RAND_MAX;
+        if (!world_add_box(&app->world, wx + dx, wy + dy)) {
+            return;
+        }
+    }
+}
 
-    app->num_boxes++;
+//The in-app benchmarks, on a thread of their own so the first frame is not
+//held up. The sizes are cut down to what a device gets through in seconds,
+//the full runs are left to the Linux build of bench.c.
+static void *run_bench(void *arg) {
+    bench_options_t options = { 1000, 1000, 0, 1, false, false,
+            BENCH_WIDTH, BENCH_HEIGHT };
+
+    (void)arg;
+    bench_world(stderr, &options);
+    bench_kernel(stderr, &options);
+    bench_collide(stderr);
+    bench_parallel(stderr);
+    bench_churn(stderr);
+    bench_gravity(stderr, NULL);
+    return NULL;
 }
 
 static void initialize(void *data) {
@@ -81,28 +146,17 @@ static void initialize(void *data) {
 
     glview_get_size(&width, &height);
 
-    glViewport(0, 0, width, height);
-
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-
-    glOrthof(0.0f, (float)width / (float)height, 0.0f, 1.0f, -1.0f, 1.0f);
-
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-
-    //Set world coordinates to coincide with screen pixels
-    glScalef(1.0f / (float)height, 1.0f / (float)height, 1.0f);
-
     app->width = (float)width;
     app->height = (float)height;
+    app->world.width = app->width;
+    app->world.height = app->height;
 
     //Set clear color to a shade of green for good looks
     glClearColor(0.0f, 0.25f, 0.0f, 1.0f);
 
     //Setup Sensors
-    app->gravity_x = 0.0f;
-    app->gravity_y = -1.0f;
+    app->world.gravity_x = 0.0f;
+    app->world.gravity_y = -1.0f;
 
     // Gravity data doesn't change for the simulator
     deviceinfo_details_t *details;
@@ -126,152 +180,169 @@ static void initialize(void *data) {
         sensor_request_events(SENSOR_TYPE_GRAVITY);
     }
 
-    //Start with one cube on the screen
-    add_cube(app, 200, 100);
-}
+    //FALLINGBLOCKS_FILTER selects none, lowpass or oneeuro smoothing and
+    //FALLINGBLOCKS_PREDICT how many milliseconds ahead gravity is predicted
+    const char *filter = getenv("FALLINGBLOCKS_FILTER");
+    gravity_filter_t type = filter ? gravity_filter_from_name(filter)
+            : GRAVITY_FILTER_ONE_EURO;
+    if (type == GRAVITY_FILTER_COUNT) {
+        fprintf(stderr, "Unknown gravity filter %s\n", filter);
+        type = GRAVITY_FILTER_ONE_EURO;
+    }
+    gravity_init(&app->gravity, type);
+
+    const char *predict = getenv("FALLINGBLOCKS_PREDICT");
+    int predict_ms = predict ? atoi(predict) : DEFAULT_PREDICT_MS;
+    app->predict = ((predict_ms > 0) ? predict_ms : 0) / 1000.0;
+
+    //FALLINGBLOCKS_SENSOR_TRACE records readings for the bench -g option
+    const char *trace = getenv("FALLINGBLOCKS_SENSOR_TRACE");
+    if (trace) {
+        app->trace = fopen(trace, "w");
+        if (!app->trace) {
+            fprintf(stderr, "Failed to open %s\n", trace);
+        }
+    }
 
-static void update(app_t *app) {
-    //Update position of every cube
-    int i;
-    float m, b;
-
-    box_t *boxes = app->boxes;
-    float gravity_x = app->gravity_x;
-    float gravity_y = app->gravity_y;
-    float width = app->width;
-    float height = app->height;
-
-    for (i = 0; i < app->num_boxes; i++) {
-        boxes[i].x += gravity_x * 5;
-        boxes[i].y += gravity_y * 5;
-
-        //y = mx + b
-        if ((gravity_x > 0.05) || (gravity_x < -0.05)) {
-            //General case, boxes are not falling vertically
-            m = gravity_y / gravity_x;
-            b = boxes[i].y - m * boxes[i].x;
-
-            if ((boxes[i].x > width) && (gravity_x > 0.0)) {
-                //Right edge
-                if ((b >= 0) && (b <= height)) {
-                    //Intersection with x = 0
-                    boxes[i].x = 0;
-                    boxes[i].y = b;
-                } else if ((-b / m >= 0) && (-b / m <= width)) {
-                    //Intersection with y = 0
-                    boxes[i].x = -b / m;
-                    boxes[i].y = 0;
-                } else if (((height - b) / m >= 0)
-                        && ((height - b) / m <= width)) {
-                    //Intersection with y = APP_HEIGHT
-                    boxes[i].x = (height - b) / m;
-                    boxes[i].y = height;
-                } else {
-                    //Corner case
-                    boxes[i].x = 0;
-                    boxes[i].y = 0;
-                }
-            } else if ((boxes[i].x + MAX_SIZE < 0.0) && (gravity_x < 0.0)) {
-                //Left edge
-                if ((m * width + b >= 0) && (m * width + b <= height)) {
-                    //Intersection with x = APP_WIDTH
-                    boxes[i].x = width;
-                    boxes[i].y = m * width + b;
-                } else if ((-b / m >= 0) && (-b / m <= width)) {
-                    //Intersection with y = 0
-                    boxes[i].x = -b / m;
-                    boxes[i].y = 0;
-                } else if (((height - b) / m >= 0)
-                        && ((height - b) / m <= width)) {
-                    //Intersection with y = APP_HEIGHT
-                    boxes[i].x = (height - b) / m;
-                    boxes[i].y = height;
-                } else {
-                    //Corner case
-                    boxes[i].x = 0;
-                    boxes[i].y = 0;
-                }
-            } else if ((boxes[i].y > height) && (gravity_y > 0.0)) {
-                //Top edge
-                if ((b >= 0) && (b <= height)) {
-                    //Intersection with x = 0
-                    boxes[i].x = 0;
-                    boxes[i].y = b;
-                } else if ((-b / m >= 0) && (-b / m <= width)) {
-                    //Intersection with y = 0
-                    boxes[i].x = -b / m;
-                    boxes[i].y = 0;
-                } else if ((m * width + b >= 0) && (m * width + b <= height)) {
-                    //Intersection with x = APP_WIDTH
-                    boxes[i].x = width;
-                    boxes[i].y = m * width + b;
-                } else {
-                    //Corner case
-                    boxes[i].x = 0;
-                    boxes[i].y = 0;
-                }
-            } else if ((boxes[i].y + MAX_SIZE <= 0.0) && (gravity_y < 0.0)) {
-                //Bottom edge
-                if ((m * width + b >= 0) && (m * width + b <= height)) {
-                    //Intersection with x = APP_WIDTH
-                    boxes[i].x = width;
-                    boxes[i].y = m * width + b;
-                } else if ((b >= 0) && (b <= height)) {
-                    //Intersection with x = 0
-                    boxes[i].x = 0;
-                    boxes[i].y = b;
-                } else if (((height - b) / m >= 0)
-                        && ((height - b) / m <= width)) {
-                    //Intersection with y = APP_HEIGHT
-                    boxes[i].x = (height - b) / m;
-                    boxes[i].y = height;
-                } else {
-                    //Corner case
-                    boxes[i].x = 0;
-                    boxes[i].y = 0;
-                }
-            }
-        } else {
-            //Special case, boxes are falling (almost) vertically so we can't describe m = -+ infinity effectively
-            if ((boxes[i].y > height) && (gravity_y > 0.0)) {
-                //Top edge
-                boxes[i].y = 0;
-            } else if ((boxes[i].y + MAX_SIZE <= 0.0) && (gravity_y < 0.0)) {
-                //Bottom edge
-                boxes[i].y = height;
-            }
+#ifdef USING_GL20
+    if (EXIT_SUCCESS != render_init(&app->render, RENDER_SHADER,
+            INITIAL_BOXES)) {
+        fprintf(stderr, "Unable to create the shader renderer\n");
+        exit(EXIT_FAILURE);
+    }
+#else
+    //FALLINGBLOCKS_RENDER=immediate selects the original one draw per box
+    //path of the OpenGL ES 1.1 renderer
+    const char *mode = getenv("FALLINGBLOCKS_RENDER");
+    if (mode && !strcmp(mode, "immediate")) {
+        render_init(&app->render, RENDER_IMMEDIATE, INITIAL_BOXES);
+    } else if (EXIT_SUCCESS != render_init(&app->render, RENDER_BATCHED,
+            INITIAL_BOXES)) {
+        render_init(&app->render, RENDER_IMMEDIATE, INITIAL_BOXES);
+    }
+#endif
+
+    //Set world coordinates to coincide with screen pixels
+    render_resize(&app->render, app->width, app->height);
+
+    //FALLINGBLOCKS_COLLIDE=0 lets boxes pass through each other
+    const char *collide = getenv("FALLINGBLOCKS_COLLIDE");
+    app->world.collide = !(collide && !strcmp(collide, "0"));
+
+    //FALLINGBLOCKS_DESPAWN=1 removes boxes that leave the screen instead
+    //of wrapping them around, FALLINGBLOCKS_BURST adds several per tap
+    app->world.wrap = (getenv("FALLINGBLOCKS_DESPAWN") == NULL);
+    const char *burst = getenv("FALLINGBLOCKS_BURST");
+    app->burst = burst ? atoi(burst) : 1;
+    if (app->burst < 1) {
+        app->burst = 1;
+    }
+
+    //FALLINGBLOCKS_STACK=1 keeps boxes on screen so they pile up
+    app->world.stack = (getenv("FALLINGBLOCKS_STACK") != NULL);
+
+    if (getenv("FALLINGBLOCKS_BENCH")) {
+        pthread_t bench;
+        pthread_attr_t attr;
+
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (pthread_create(&bench, &attr, run_bench, NULL) != 0) {
+            fprintf(stderr, "Unable to start the benchmark thread\n");
         }
+        pthread_attr_destroy(&attr);
     }
-}
 
-static void render(const box_t *boxes, int num_boxes) {
-    int i;
+    //FALLINGBLOCKS_TICK_RATE and FALLINGBLOCKS_MAX_STEPS tune the simulation
+    const char *tick_rate = getenv("FALLINGBLOCKS_TICK_RATE");
+    const char *max_steps = getenv("FALLINGBLOCKS_MAX_STEPS");
+    int rate = tick_rate ? atoi(tick_rate) : DEFAULT_TICK_RATE;
+    app->tick = 1.0 / ((rate > 0) ? rate : DEFAULT_TICK_RATE);
+    app->world.tick = (float)app->tick;
+    app->max_steps = max_steps ? atoi(max_steps) : DEFAULT_MAX_STEPS;
+    if (app->max_steps < 1) {
+        app->max_steps = DEFAULT_MAX_STEPS;
+    }
+    app->accumulator = 0.0;
+    app->last_time = now();
 
-    //Typical rendering pass
-    glClear(GL_COLOR_BUFFER_BIT);
+    app->stress = (getenv("FALLINGBLOCKS_STRESS") != NULL);
+    app->stress_frames = 0;
+    app->stress_start = now();
 
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glVertexPointer(2, GL_FLOAT, 0, vertices);
+    //Start with one cube on the screen
+    add_cube(app, 200, 100);
+}
 
-    for (i = 0; i < num_boxes; i++) {
-        glPushMatrix();
+static void stress(app_t *app) {
+    int i;
+    double fps, submit;
 
-        glColor4f(boxes[i].color, 0.78f, 0, 1.0f);
-        glTranslatef(boxes[i].x, boxes[i].y, 0.0f);
-        glScalef(boxes[i].size, boxes[i].size, 1.0f);
+    if (++app->stress_frames < STRESS_WINDOW) {
+        return;
+    }
 
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    fps = app->stress_frames / (now() - app->stress_start);
+    submit = render_submit_time(&app->render);
+
+    if (fps < STRESS_TARGET_FPS || app->world.boxes.count >= MAX_BOXES) {
+        //The previous step was the last one that held the target rate
+        fprintf(stderr, "%s rendering: %d boxes at 60 fps, %.1f fps and "
+                "%.3f ms to submit a frame at %d\n",
+                render_mode_name(app->render.mode),
+                app->world.boxes.count - STRESS_STEP, fps, submit * 1000.0,
+                app->world.boxes.count);
+        app->stress = false;
+        return;
+    }
 
-        glPopMatrix();
+    for (i = 0; i < STRESS_STEP; i++) {
+        float x = app->width * world_random(&app->world);
+        float y = app->height * world_random(&app->world);
+        world_add_box(&app->world, x, y);
     }
 
-    glDisableClientState(GL_VERTEX_ARRAY);
+    app->stress_frames = 0;
+    app->stress_start = now();
 }
 
 static void frame(void *data) {
     app_t *app = (app_t *)data;
-    update(app);
-    render(app->boxes, app->num_boxes);
+    int steps = 0;
+    double current = now();
+    double tick_time;
+
+    //Run as many fixed ticks as the elapsed time covers
+    app->accumulator += current - app->last_time;
+    app->last_time = current;
+
+    //Time the simulation has reached so far
+    tick_time = current - app->accumulator;
+
+    while (app->accumulator >= app->tick && steps < app->max_steps) {
+        tick_time += app->tick;
+        gravity_predict(&app->gravity, tick_time + app->predict,
+                &app->world.gravity_x, &app->world.gravity_y);
+        if (EXIT_SUCCESS != world_step(&app->world)) {
+            fprintf(stderr, "Out of memory for collisions, turning them off\n");
+            app->world.collide = false;
+        }
+        app->accumulator -= app->tick;
+        steps++;
+    }
+
+    //Too far behind to catch up, drop the backlog rather than spiral
+    if (app->accumulator >= app->tick) {
+        app->accumulator = fmod(app->accumulator, app->tick);
+    }
+
+    //Draw the boxes part way between the last two ticks
+    render_boxes(&app->render, &app->world.boxes,
+            (float)(app->accumulator / app->tick));
+
+    if (app->stress) {
+        stress(app);
+    }
 }
 
 static void screen_event_handler(app_t *app, bps_event_t *event) {
@@ -315,26 +386,41 @@ static void event_handler(bps_event_t *event, int domain, int code, void *data)
         screen_event_handler(app, event);
     } else if (domain == navigator_get_domain()) {
         if (NAVIGATOR_SWIPE_DOWN == code) {
-            app->num_boxes = 0;
+            world_clear(&app->world);
         }
     } else if (domain == sensor_get_domain()) {
         if (SENSOR_GRAVITY_READING == code) {
             float z, x, y;
+            double stamp = now();
+
+            //Stamped on arrival so readings and frames share one clock
             sensor_event_get_xyz(event, &x, &y, &z);
-            app->gravity_x = -x;
-            app->gravity_y = -y;
+            gravity_push(&app->gravity, stamp, -x, -y);
+
+            if (app->trace) {
+                fprintf(app->trace, "%.6f %f %f\n", stamp, -x, -y);
+            }
         }
     }
 }
 
 static void finalize(void *data) {
     app_t *app = (app_t*)data;
-    free(app->boxes);
+    if (app->trace) {
+        fclose(app->trace);
+    }
+    render_free(&app->render);
+    world_free(&app->world);
     free(app);
 }
 
 int main(int argc, char **argv) {
+    //The OpenGL ES version is chosen at build time, see common.mk
+#ifdef USING_GL11
     glview_initialize(GLVIEW_API_OPENGLES_11, &frame);
+#else
+    glview_initialize(GLVIEW_API_OPENGLES_20, &frame);
+#endif
     glview_register_initialize_callback(&initialize);
     glview_register_finalize_callback(&finalize);
     glview_register_event_callback(&event_handler);
@@ -344,8 +430,10 @@ int main(int argc, char **argv) {
         return EXIT_FAILURE;
     }
 
-    app->boxes = (box_t *)calloc(sizeof(box_t), MAX_BOXES);
-    if (!app->boxes) {
+    //FALLINGBLOCKS_THREADS limits the update threads, default is one per CPU
+    const char *threads = getenv("FALLINGBLOCKS_THREADS");
+    if (EXIT_SUCCESS != world_init(&app->world, MAX_BOXES,
+            threads ? atoi(threads) : 0)) {
         return EXIT_FAILURE;
     }
 
@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pool.h"
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_THREADS 16
+#define CACHE_LINE 64
+
+//Range of chunks owned by one thread. next is advanced with an atomic add
+//by the owner and by thieves alike, padded so that threads claiming work
+//do not bounce each other's cache lines.
+typedef struct {
+    volatile int next;
+    int end;
+    char pad[CACHE_LINE - 2 * sizeof(int)];
+} queue_t;
+
+typedef struct {
+    pool_t *pool;
+    int index;
+    pthread_t thread;
+} worker_t;
+
+struct pool_t {
+    queue_t queues[MAX_THREADS];
+    worker_t workers[MAX_THREADS];
+    int threads;
+
+    //Current job
+    pool_func_t func;
+    void *arg;
+    int count;
+    int chunk;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned generation;
+    int finished;
+    int quit;
+};
+
+//Claims the next chunk of a queue, returns -1 once it is empty. next may
+//run past end, it is reset before the next job.
+static int claim(queue_t *queue) {
+    int index = __sync_fetch_and_add(&queue->next, 1);
+    return (index < queue->end) ? index : -1;
+}
+
+static void work(pool_t *pool, int self) {
+    int i, index;
+
+    //Own chunks first, then walk the other queues and steal from them
+    for (i = 0; i < pool->threads; i++) {
+        queue_t *queue = &pool->queues[(self + i) % pool->threads];
+
+        while ((index = claim(queue)) >= 0) {
+            int begin = index * pool->chunk;
+            int end = begin + pool->chunk;
+            pool->func(pool->arg, begin, end < pool->count ? end : pool->count);
+        }
+    }
+}
+
+static void *worker_main(void *data) {
+    worker_t *worker = (worker_t *)data;
+    pool_t *pool = worker->pool;
+    unsigned generation = 0;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->mutex);
+        while (!pool->quit && pool->generation == generation) {
+            pthread_cond_wait(&pool->start, &pool->mutex);
+        }
+        if (pool->quit) {
+            pthread_mutex_unlock(&pool->mutex);
+            return NULL;
+        }
+        generation = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+
+        work(pool, worker->index);
+
+        pthread_mutex_lock(&pool->mutex);
+        if (++pool->finished == pool->threads - 1) {
+            pthread_cond_signal(&pool->done);
+        }
+        pthread_mutex_unlock(&pool->mutex);
+    }
+}
+
+pool_t *pool_create(int threads) {
+    int i;
+    pool_t *pool;
+
+    if (threads <= 0) {
+        threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threads <= 0) {
+        threads = 1;
+    } else if (threads > MAX_THREADS) {
+        threads = MAX_THREADS;
+    }
+
+    if (posix_memalign((void **)&pool, CACHE_LINE, sizeof(*pool)) != 0) {
+        return NULL;
+    }
+    memset(pool, 0, sizeof(*pool));
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->start, NULL);
+    pthread_cond_init(&pool->done, NULL);
+
+    //Thread 0 is the caller of pool_run()
+    pool->threads = 1;
+    for (i = 1; i < threads; i++) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        if (pthread_create(&pool->workers[i].thread, NULL, worker_main,
+                &pool->workers[i]) != 0) {
+            break;
+        }
+        pool->threads++;
+    }
+
+    return pool;
+}
+
+void pool_destroy(pool_t *pool) {
+    int i;
+
+    if (!pool) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = 1;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 1; i < pool->threads; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+    }
+
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool);
+}
+
+int pool_threads(const pool_t *pool) {
+    return pool->threads;
+}
+
+void pool_run(pool_t *pool, pool_func_t func, void *arg, int count, int chunk) {
+    int i;
+    int num_chunks = (count + chunk - 1) / chunk;
+
+    //Not worth waking anybody up
+    if (pool->threads == 1 || num_chunks <= 1) {
+        if (count > 0) {
+            func(arg, 0, count);
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+
+    pool->func = func;
+    pool->arg = arg;
+    pool->count = count;
+    pool->chunk = chunk;
+
+    //Give every thread an equal contiguous share to start from
+    for (i = 0; i < pool->threads; i++) {
+        pool->queues[i].next = num_chunks * i / pool->threads;
+        pool->queues[i].end = num_chunks * (i + 1) / pool->threads;
+    }
+
+    pool->finished = 0;
+    pool->generation++;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->mutex);
+
+    work(pool, 0);
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->finished < pool->threads - 1) {
+        pthread_cond_wait(&pool->done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef POOL_H_
+#define POOL_H_
+
+typedef struct pool_t pool_t;
+
+/**
+ * Work function, processes items [begin, end).
+ */
+typedef void (*pool_func_t)(void *arg, int begin, int end);
+
+/**
+ * Creates a pool that runs work on the calling thread plus threads - 1
+ * worker threads.
+ *
+ * @param threads total number of threads to use, 0 for one per CPU
+ * @return the pool, or NULL on failure
+ */
+pool_t *pool_create(int threads);
+
+/**
+ * Stops the worker threads and frees the pool.
+ */
+void pool_destroy(pool_t *pool);
+
+/**
+ * Returns the number of threads work is spread over, including the caller.
+ */
+int pool_threads(const pool_t *pool);
+
+/**
+ * Splits [0, count) into chunks of chunk items and runs func over all of
+ * them, returning once every chunk is done. Each thread starts on its own
+ * contiguous run of chunks and steals chunks from the other threads once
+ * it runs out.
+ *
+ * func must not depend on which thread runs a chunk or in which order the
+ * chunks run; results are then the same for any number of threads.
+ */
+void pool_run(pool_t *pool, pool_func_t func, void *arg, int count, int chunk);
+
+#endif /* POOL_H_ */
@@ -0,0 +1,409 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "render.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+//Two triangles per box, GLES 1.1 has no 32 bit indices so the batched
+//path draws unindexed to stay within a single call at any box count
+#define VERTICES_PER_BOX 6
+
+//Green channel of every box, matches glColor4f(color, 0.78f, 0, 1.0f)
+#define BOX_GREEN 199
+
+#ifdef USING_GL20
+//The whole shader path: positions are transformed by a uniform and
+//colours passed through, nothing else
+static const char *vertex_source =
+        "uniform mat4 u_projection;"
+        "attribute vec2 a_position;"
+        "attribute vec4 a_color;"
+        "varying lowp vec4 v_color;"
+        "void main()"
+        "{"
+        "    gl_Position = u_projection * vec4(a_position, 0.0, 1.0);"
+        "    v_color = a_color;"
+        "}";
+
+static const char *fragment_source =
+        "varying lowp vec4 v_color;"
+        "void main()"
+        "{"
+        "    gl_FragColor = v_color;"
+        "}";
+
+#endif
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+#ifdef USING_GL20
+static GLuint compile_shader(GLenum type, const char *source) {
+    GLint status;
+    GLuint shader = glCreateShader(type);
+
+    if (!shader) {
+        return 0;
+    }
+
+    glShaderSource(shader, 1, &source, 0);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (GL_FALSE == status) {
+        GLchar log[256];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        fprintf(stderr, "Failed to compile shader: %s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+static int create_program(render_t *render) {
+    GLint status;
+    GLuint vs = compile_shader(GL_VERTEX_SHADER, vertex_source);
+    GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+
+    if (vs && fs) {
+        render->program = glCreateProgram();
+    }
+
+    if (render->program) {
+        glAttachShader(render->program, vs);
+        glAttachShader(render->program, fs);
+        glLinkProgram(render->program);
+
+        glGetProgramiv(render->program, GL_LINK_STATUS, &status);
+        if (GL_FALSE == status) {
+            GLchar log[256];
+            glGetProgramInfoLog(render->program, sizeof(log), NULL, log);
+            fprintf(stderr, "Failed to link shader program: %s\n", log);
+            glDeleteProgram(render->program);
+            render->program = 0;
+        }
+    }
+
+    //The program keeps what it needs of the shaders
+    if (vs) {
+        glDeleteShader(vs);
+    }
+    if (fs) {
+        glDeleteShader(fs);
+    }
+
+    if (!render->program) {
+        return EXIT_FAILURE;
+    }
+
+    render->position_loc = glGetAttribLocation(render->program, "a_position");
+    render->color_loc = glGetAttribLocation(render->program, "a_color");
+    render->projection_loc = glGetUniformLocation(render->program,
+            "u_projection");
+
+    return EXIT_SUCCESS;
+}
+#endif
+
+int render_init(render_t *render, render_mode_t mode, int max_boxes) {
+    render->mode = mode;
+    render->max_boxes = max_boxes;
+    render->vertices = NULL;
+    render->vbo = 0;
+    render->vbo_size = 0;
+    render->program = 0;
+    render->submit_time = 0.0;
+    render->submit_frames = 0;
+    mat4_identity(&render->projection);
+
+#ifdef USING_GL20
+    if (mode != RENDER_SHADER || EXIT_SUCCESS != create_program(render)) {
+        return EXIT_FAILURE;
+    }
+#else
+    if (mode == RENDER_SHADER) {
+        return EXIT_FAILURE;
+    }
+
+    if (mode == RENDER_IMMEDIATE) {
+        return EXIT_SUCCESS;
+    }
+#endif
+
+    render->vertices = (render_vertex_t *)malloc(
+            sizeof(render_vertex_t) * VERTICES_PER_BOX * max_boxes);
+    if (!render->vertices) {
+        return EXIT_FAILURE;
+    }
+
+    render->vbo_size = sizeof(render_vertex_t) * VERTICES_PER_BOX * max_boxes;
+    glGenBuffers(1, &render->vbo);
+
+    return EXIT_SUCCESS;
+}
+
+void render_free(render_t *render) {
+    if (render->vbo) {
+        glDeleteBuffers(1, &render->vbo);
+        render->vbo = 0;
+    }
+
+#ifdef USING_GL20
+    if (render->program) {
+        glDeleteProgram(render->program);
+        render->program = 0;
+    }
+#endif
+
+    free(render->vertices);
+    render->vertices = NULL;
+}
+
+void render_resize(render_t *render, float width, float height) {
+    glViewport(0, 0, (GLsizei)width, (GLsizei)height);
+
+    mat4_ortho(&render->projection, 0.0f, width, 0.0f, height, -1.0f, 1.0f);
+
+#ifdef USING_GL11
+    glMatrixMode(GL_PROJECTION);
+    glLoadMatrixf(render->projection.m);
+
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+#endif
+}
+
+double render_submit_time(render_t *render) {
+    double average = render->submit_frames
+            ? render->submit_time / render->submit_frames : 0.0;
+
+    render->submit_time = 0.0;
+    render->submit_frames = 0;
+
+    return average;
+}
+
+const char *render_mode_name(render_mode_t mode) {
+    switch (mode) {
+    case RENDER_SHADER:
+        return "shader";
+    case RENDER_BATCHED:
+        return "batched";
+    default:
+        return "immediate";
+    }
+}
+
+//Position of box i between the previous and current step. Boxes that
+//just wrapped are drawn where they are now rather than sliding across the
+//screen.
+static inline GLfloat lerp(const boxes_t *boxes, const float *prev,
+        const float *cur, int i, float alpha) {
+    if (boxes->wrapped[i] != 0.0f) {
+        return cur[i];
+    }
+
+    return prev[i] + (cur[i] - prev[i]) * alpha;
+}
+
+#ifdef USING_GL11
+static const GLfloat quad[] =
+{
+    0.0f, 0.0f,
+    1.0f, 0.0f,
+    0.0f, 1.0f,
+    1.0f, 1.0f,
+};
+
+static void render_immediate(const boxes_t *boxes, float alpha) {
+    int i;
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(2, GL_FLOAT, 0, quad);
+
+    for (i = 0; i < boxes->count; i++) {
+        glPushMatrix();
+
+        glColor4f(boxes->color[i], 0.78f, 0, 1.0f);
+        glTranslatef(lerp(boxes, boxes->prev_x, boxes->x, i, alpha),
+                lerp(boxes, boxes->prev_y, boxes->y, i, alpha), 0.0f);
+        glScalef(boxes->size[i], boxes->size[i], 1.0f);
+
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        glPopMatrix();
+    }
+
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+#endif
+
+//Makes room for at least count boxes in the vertex and GL buffers
+static int grow(render_t *render, int count) {
+    int max_boxes = render->max_boxes;
+    render_vertex_t *vertices;
+
+    while (max_boxes < count) {
+        max_boxes = max_boxes ? 2 * max_boxes : count;
+    }
+
+    vertices = (render_vertex_t *)realloc(render->vertices,
+            sizeof(render_vertex_t) * VERTICES_PER_BOX * max_boxes);
+    if (!vertices) {
+        return EXIT_FAILURE;
+    }
+
+    render->vertices = vertices;
+    render->max_boxes = max_boxes;
+    render->vbo_size = sizeof(render_vertex_t) * VERTICES_PER_BOX * max_boxes;
+
+    return EXIT_SUCCESS;
+}
+
+//Expands the boxes into the vertex buffer, which is left bound, and
+//returns the number of vertices to draw
+static GLsizei fill(render_t *render, const boxes_t *boxes, float alpha) {
+    int i;
+    int count = boxes->count;
+    render_vertex_t *v;
+    GLsizeiptr size;
+
+    if (count > render->max_boxes && EXIT_SUCCESS != grow(render, count)) {
+        count = render->max_boxes;
+    }
+
+    if (count == 0) {
+        return 0;
+    }
+
+    v = render->vertices;
+
+    //Expand every box into two triangles in world coordinates
+    for (i = 0; i < count; i++) {
+        GLfloat x0 = lerp(boxes, boxes->prev_x, boxes->x, i, alpha);
+        GLfloat y0 = lerp(boxes, boxes->prev_y, boxes->y, i, alpha);
+        GLfloat x1 = x0 + boxes->size[i];
+        GLfloat y1 = y0 + boxes->size[i];
+        GLubyte red = (GLubyte)(boxes->color[i] * 255.0f + 0.5f);
+        int k;
+
+        v[0].x = x0; v[0].y = y0;
+        v[1].x = x1; v[1].y = y0;
+        v[2].x = x0; v[2].y = y1;
+        v[3].x = x0; v[3].y = y1;
+        v[4].x = x1; v[4].y = y0;
+        v[5].x = x1; v[5].y = y1;
+
+        for (k = 0; k < VERTICES_PER_BOX; k++) {
+            v[k].color[0] = red;
+            v[k].color[1] = BOX_GREEN;
+            v[k].color[2] = 0;
+            v[k].color[3] = 255;
+        }
+
+        v += VERTICES_PER_BOX;
+    }
+
+    size = sizeof(render_vertex_t) * VERTICES_PER_BOX * count;
+
+    glBindBuffer(GL_ARRAY_BUFFER, render->vbo);
+
+    //Orphan the previous frame's storage so the driver does not have to
+    //wait for the GPU to finish reading it before the new upload
+    glBufferData(GL_ARRAY_BUFFER, render->vbo_size, NULL, GL_DYNAMIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, render->vertices);
+
+    return VERTICES_PER_BOX * count;
+}
+
+#ifdef USING_GL11
+static void render_batched(render_t *render, const boxes_t *boxes,
+        float alpha) {
+    GLsizei vertex_count = fill(render, boxes, alpha);
+
+    if (vertex_count == 0) {
+        return;
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(2, GL_FLOAT, sizeof(render_vertex_t),
+            (const GLvoid *)offsetof(render_vertex_t, x));
+    glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(render_vertex_t),
+            (const GLvoid *)offsetof(render_vertex_t, color));
+
+    glDrawArrays(GL_TRIANGLES, 0, vertex_count);
+
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+#else
+static void render_shader(render_t *render, const boxes_t *boxes,
+        float alpha) {
+    GLsizei vertex_count = fill(render, boxes, alpha);
+
+    if (vertex_count == 0) {
+        return;
+    }
+
+    glUseProgram(render->program);
+    glUniformMatrix4fv(render->projection_loc, 1, GL_FALSE,
+            render->projection.m);
+
+    glEnableVertexAttribArray(render->position_loc);
+    glEnableVertexAttribArray(render->color_loc);
+    glVertexAttribPointer(render->position_loc, 2, GL_FLOAT, GL_FALSE,
+            sizeof(render_vertex_t),
+            (const GLvoid *)offsetof(render_vertex_t, x));
+    glVertexAttribPointer(render->color_loc, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+            sizeof(render_vertex_t),
+            (const GLvoid *)offsetof(render_vertex_t, color));
+
+    glDrawArrays(GL_TRIANGLES, 0, vertex_count);
+
+    glDisableVertexAttribArray(render->color_loc);
+    glDisableVertexAttribArray(render->position_loc);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+#endif
+
+void render_boxes(render_t *render, const boxes_t *boxes, float alpha) {
+    double start = now();
+
+    //Typical rendering pass
+    glClear(GL_COLOR_BUFFER_BIT);
+
+#ifdef USING_GL20
+    render_shader(render, boxes, alpha);
+#else
+    if (render->mode == RENDER_BATCHED) {
+        render_batched(render, boxes, alpha);
+    } else {
+        render_immediate(boxes, alpha);
+    }
+#endif
+
+    render->submit_time += now() - start;
+    render->submit_frames++;
+}
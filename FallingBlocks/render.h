@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RENDER_H_
+#define RENDER_H_
+
+#ifdef USING_GL11
+#include <GLES/gl.h>
+#elif defined(USING_GL20)
+#include <GLES2/gl2.h>
+#else
+#error render.h must be compiled with either USING_GL11 or USING_GL20 flags
+#endif
+
+#include "boxes.h"
+#include "vecmath.h"
+
+//RENDER_IMMEDIATE and RENDER_BATCHED are only available in USING_GL11
+//builds, RENDER_SHADER only in USING_GL20 builds
+typedef enum {
+    //One matrix push, colour, translate, scale and draw call per box
+    RENDER_IMMEDIATE,
+    //All boxes expanded into one streamed vertex buffer and a single draw
+    RENDER_BATCHED,
+    //OpenGL ES 2.0: the batched vertex buffer drawn by a minimal shader
+    //with the projection in a uniform, so the driver emulates no fixed
+    //function state
+    RENDER_SHADER
+} render_mode_t;
+
+//Interleaved vertex used by the batched path, 12 bytes
+typedef struct {
+    GLfloat x;
+    GLfloat y;
+    GLubyte color[4];
+} render_vertex_t;
+
+typedef struct {
+    render_mode_t mode;
+
+    int max_boxes;
+    render_vertex_t *vertices;
+    GLuint vbo;
+    GLsizeiptr vbo_size;
+
+    //RENDER_SHADER only
+    GLuint program;
+    GLint position_loc;
+    GLint color_loc;
+    GLint projection_loc;
+    mat4_t projection;
+
+    //CPU time spent issuing GL calls since the last render_submit_time()
+    double submit_time;
+    int submit_frames;
+} render_t;
+
+/**
+ * Prepares the renderer. Must be called with a current GL context of the
+ * OpenGL ES version the renderer was built for.
+ *
+ * @param render renderer to initialize
+ * @param mode which rendering path to use
+ * @param max_boxes number of boxes to size the buffers for, they grow
+ * when render_boxes() is given more
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE, also when the
+ * mode is not available in this build
+ */
+int render_init(render_t *render, render_mode_t mode, int max_boxes);
+
+/**
+ * Releases the buffers allocated by render_init().
+ */
+void render_free(render_t *render);
+
+/**
+ * Sets the viewport and a projection with one unit per pixel and the
+ * origin at the bottom left.
+ */
+void render_resize(render_t *render, float width, float height);
+
+/**
+ * Clears the screen and draws every box.
+ *
+ * @param alpha how far between the previous and the current simulation
+ * step to draw the boxes, from 0 to 1
+ */
+void render_boxes(render_t *render, const boxes_t *boxes, float alpha);
+
+/**
+ * Returns the average CPU time render_boxes() took per frame, in seconds,
+ * since the previous call. This is the time to issue the GL calls, the GPU
+ * may still be drawing when it returns.
+ */
+double render_submit_time(render_t *render);
+
+/**
+ * Returns a printable name for a rendering mode.
+ */
+const char *render_mode_name(render_mode_t mode);
+
+#endif /* RENDER_H_ */
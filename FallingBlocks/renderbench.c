@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * Desktop benchmark for render.c. Draws random boxes into an offscreen EGL
+ * pbuffer with every rendering mode of the OpenGL ES version it is built
+ * for and prints the CPU time per frame. Only compiled with
+ * FALLINGBLOCKS_RENDER_BENCH_MAIN, see readme.txt for the build commands.
+ */
+
+#ifdef FALLINGBLOCKS_RENDER_BENCH_MAIN
+
+#include "boxes.h"
+#include "render.h"
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef USING_GL11
+#define CLIENT_VERSION 1
+#define RENDERABLE_TYPE EGL_OPENGL_ES_BIT
+static const render_mode_t modes[] = { RENDER_IMMEDIATE, RENDER_BATCHED };
+#else
+#define CLIENT_VERSION 2
+#define RENDERABLE_TYPE EGL_OPENGL_ES2_BIT
+static const render_mode_t modes[] = { RENDER_SHADER };
+#endif
+
+//Screen the boxes are scattered over, the pbuffer only sees its corner
+#define WORLD_WIDTH 1280.0f
+#define WORLD_HEIGHT 720.0f
+
+static double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+//Makes a pbuffer context current. Prefers Mesa's surfaceless platform so
+//no X or Wayland server is needed.
+static int init_egl(int width, int height) {
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLConfig config;
+    EGLSurface surface;
+    EGLContext context;
+    EGLint num_configs;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display;
+
+    const EGLint config_attribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, RENDERABLE_TYPE,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_NONE
+    };
+    const EGLint surface_attribs[] = {
+        EGL_WIDTH, width,
+        EGL_HEIGHT, height,
+        EGL_NONE
+    };
+    const EGLint context_attribs[] = {
+        EGL_CONTEXT_CLIENT_VERSION, CLIENT_VERSION,
+        EGL_NONE
+    };
+
+    get_platform_display = (PFNEGLGETPLATFORMDISPLAYEXTPROC)
+            eglGetProcAddress("eglGetPlatformDisplayEXT");
+#ifdef EGL_PLATFORM_SURFACELESS_MESA
+    if (get_platform_display) {
+        display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                EGL_DEFAULT_DISPLAY, NULL);
+    }
+#else
+    (void)get_platform_display;
+#endif
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    if (!eglInitialize(display, NULL, NULL)) {
+        fprintf(stderr, "eglInitialize failed: 0x%x\n", eglGetError());
+        return EXIT_FAILURE;
+    }
+
+    eglBindAPI(EGL_OPENGL_ES_API);
+
+    if (!eglChooseConfig(display, config_attribs, &config, 1, &num_configs)
+            || num_configs < 1) {
+        fprintf(stderr, "No OpenGL ES %d pbuffer config\n", CLIENT_VERSION);
+        return EXIT_FAILURE;
+    }
+
+    surface = eglCreatePbufferSurface(display, config, surface_attribs);
+    if (surface == EGL_NO_SURFACE) {
+        fprintf(stderr, "eglCreatePbufferSurface failed: 0x%x\n",
+                eglGetError());
+        return EXIT_FAILURE;
+    }
+
+    context = eglCreateContext(display, config, EGL_NO_CONTEXT,
+            context_attribs);
+    if (context == EGL_NO_CONTEXT
+            || !eglMakeCurrent(display, surface, surface, context)) {
+        fprintf(stderr, "eglMakeCurrent failed: 0x%x\n", eglGetError());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+//Draws frames frames of boxes in one mode and prints the CPU time
+//render_boxes() took to issue them and the time until glFinish() returned
+static int run_mode(render_mode_t mode, const boxes_t *boxes, int frames,
+        int width, int height) {
+    render_t render;
+    double start, elapsed;
+    int i;
+
+    if (EXIT_SUCCESS != render_init(&render, mode, boxes->count)) {
+        fprintf(stderr, "render_init failed for %s\n",
+                render_mode_name(mode));
+        return EXIT_FAILURE;
+    }
+
+    //Same projection as the app so every box goes through the pipeline,
+    //the small viewport keeps rasterization out of the measurement
+    render_resize(&render, WORLD_WIDTH, WORLD_HEIGHT);
+    glViewport(0, 0, width, height);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    //One untimed frame so buffer creation and shader setup are excluded
+    render_boxes(&render, boxes, 0.0f);
+    glFinish();
+    render_submit_time(&render);
+
+    start = now();
+    for (i = 0; i < frames; i++) {
+        render_boxes(&render, boxes, (float)i / frames);
+    }
+    glFinish();
+    elapsed = now() - start;
+
+    printf("render %6d boxes %-9s: %8.3f ms/frame submit %8.3f ms/frame"
+            " with glFinish\n", boxes->count, render_mode_name(mode),
+            1000.0 * render_submit_time(&render), 1000.0 * elapsed / frames);
+
+    render_free(&render);
+
+    return glGetError() == GL_NO_ERROR ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static void usage(const char *name) {
+    fprintf(stderr, "usage: %s [-n boxes] [-f frames] [-w width]"
+            " [-h height]\n"
+            "  -n  number of boxes, default 1000 and 10000\n"
+            "  -f  frames timed per mode, default 200\n"
+            "  -w  pbuffer width, default 16\n"
+            "  -h  pbuffer height, default 16\n", name);
+}
+
+int main(int argc, char **argv) {
+    int counts[] = { 1000, 10000 };
+    int num_counts = 2;
+    int frames = 200;
+    int width = 16;
+    int height = 16;
+    int opt;
+    int c, i, m;
+
+    while ((opt = getopt(argc, argv, "n:f:w:h:")) != -1) {
+        switch (opt) {
+        case 'n':
+            counts[0] = atoi(optarg);
+            num_counts = 1;
+            break;
+        case 'f':
+            frames = atoi(optarg);
+            break;
+        case 'w':
+            width = atoi(optarg);
+            break;
+        case 'h':
+            height = atoi(optarg);
+            break;
+        default:
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (counts[0] <= 0 || frames <= 0 || width <= 0 || height <= 0) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (EXIT_SUCCESS != init_egl(width, height)) {
+        return EXIT_FAILURE;
+    }
+
+    printf("%s, %s, %dx%d pbuffer\n", glGetString(GL_VERSION),
+            glGetString(GL_RENDERER), width, height);
+
+    for (c = 0; c < num_counts; c++) {
+        boxes_t boxes;
+        int n = counts[c];
+
+        if (EXIT_SUCCESS != boxes_init(&boxes, n)) {
+            return EXIT_FAILURE;
+        }
+
+        srand(1);
+        for (i = 0; i < n; i++) {
+            boxes.x[i] = WORLD_WIDTH * rand() / RAND_MAX;
+            boxes.y[i] = WORLD_HEIGHT * rand() / RAND_MAX;
+            boxes.size[i] = 20.0f + (MAX_SIZE - 20.0f) * rand() / RAND_MAX;
+            boxes.color[i] = (float)rand() / RAND_MAX;
+        }
+        boxes.count = n;
+
+        //Previous step a few pixels away so the interpolation does work
+        boxes_save(&boxes);
+        for (i = 0; i < n; i++) {
+            boxes.y[i] -= 5.0f;
+        }
+
+        for (m = 0; m < (int)(sizeof(modes) / sizeof(modes[0])); m++) {
+            if (EXIT_SUCCESS != run_mode(modes[m], &boxes, frames, width,
+                    height)) {
+                boxes_free(&boxes);
+                return EXIT_FAILURE;
+            }
+        }
+
+        boxes_free(&boxes);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "world.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+//Boxes per work item of the parallel update, a multiple of BOXES_PER_LINE
+#define UPDATE_CHUNK 4096
+
+//Storage starts out this big and doubles whenever it fills up
+#define INITIAL_BOXES 1024
+
+int world_init(world_t *world, int max_boxes, int threads) {
+    memset(world, 0, sizeof(*world));
+
+    if (EXIT_SUCCESS != boxes_init(&world->boxes,
+            max_boxes < INITIAL_BOXES ? max_boxes : INITIAL_BOXES)) {
+        return EXIT_FAILURE;
+    }
+
+    //Without worker threads the update simply runs on the caller
+    world->pool = pool_create(threads);
+
+    collide_init(&world->grid);
+    world->max_boxes = max_boxes;
+    world->gravity_x = 0.0f;
+    world->gravity_y = -1.0f;
+    world->tick = 1.0f / 60.0f;
+    world->collide = true;
+    world->wrap = true;
+    world_seed(world, 1);
+
+    return EXIT_SUCCESS;
+}
+
+void world_free(world_t *world) {
+    pool_destroy(world->pool);
+    collide_free(&world->grid);
+    boxes_free(&world->boxes);
+}
+
+void world_seed(world_t *world, unsigned seed) {
+    world->random = seed ? seed : 1;
+}
+
+float world_random(world_t *world) {
+    //xorshift32, the top 24 bits map exactly onto a float in [0, 1)
+    unsigned r = world->random;
+    r ^= r << 13;
+    r ^= r >> 17;
+    r ^= r << 5;
+    world->random = r;
+
+    return (r >> 8) * (1.0f / 16777216.0f);
+}
+
+bool world_add_box(world_t *world, float x, float y) {
+    boxes_t *boxes = &world->boxes;
+    int i = boxes->count;
+
+    if (i >= world->max_boxes) {
+        return false;
+    }
+
+    if (i == boxes->capacity) {
+        int capacity = 2 * boxes->capacity;
+        if (capacity > world->max_boxes) {
+            capacity = world->max_boxes;
+        }
+        if (EXIT_SUCCESS != boxes_reserve(boxes, capacity)) {
+            return false;
+        }
+    }
+
+    //A random shade of green and some size variation
+    boxes->color[i] = world_random(world);
+    boxes->size[i] = 40.0f + 20.0f * world_random(world);
+
+    boxes->x[i] = x;
+    boxes->y[i] = y;
+    boxes->prev_x[i] = x;
+    boxes->prev_y[i] = y;
+    boxes->wrapped[i] = 0.0f;
+
+    boxes->count++;
+
+    return true;
+}
+
+void world_remove_box(world_t *world, int i) {
+    boxes_remove(&world->boxes, i);
+}
+
+void world_clear(world_t *world) {
+    world->boxes.count = 0;
+}
+
+//Removes every box that is completely outside the screen
+static void despawn(world_t *world) {
+    boxes_t *boxes = &world->boxes;
+    int i;
+
+    //Walk backwards so the box swapped into a hole has been checked already
+    for (i = boxes->count - 1; i >= 0; i--) {
+        float x = boxes->x[i];
+        float y = boxes->y[i];
+        float size = boxes->size[i];
+
+        if ((x > world->width) || (x + size < 0.0f)
+                || (y > world->height) || (y + size < 0.0f)) {
+            boxes_remove(boxes, i);
+            world->despawned++;
+        }
+    }
+}
+
+//Puts every box back inside the screen, the edges act as floor and walls
+static void contain(world_t *world) {
+    boxes_t *boxes = &world->boxes;
+    int i;
+
+    for (i = 0; i < boxes->count; i++) {
+        float right = world->width - boxes->size[i];
+        float top = world->height - boxes->size[i];
+
+        if (boxes->x[i] < 0.0f) {
+            boxes->x[i] = 0.0f;
+        } else if (boxes->x[i] > right) {
+            boxes->x[i] = right;
+        }
+
+        if (boxes->y[i] < 0.0f) {
+            boxes->y[i] = 0.0f;
+        } else if (boxes->y[i] > top) {
+            boxes->y[i] = top;
+        }
+    }
+}
+
+static void update_chunk(void *data, int begin, int end) {
+    world_t *world = (world_t *)data;
+    boxes_update_range(&world->boxes, world->gravity_x, world->gravity_y,
+            world->tick, world->width, world->height,
+            world->wrap && !world->stack, begin, end);
+}
+
+int world_step(world_t *world) {
+    int result = EXIT_SUCCESS;
+
+    boxes_save(&world->boxes);
+
+    //Move every box, spread over the worker threads
+    if (world->pool) {
+        pool_run(world->pool, update_chunk, world, world->boxes.count,
+                UPDATE_CHUNK);
+    } else {
+        update_chunk(world, 0, world->boxes.count);
+    }
+
+    if (world->stack) {
+        contain(world);
+    } else if (!world->wrap) {
+        despawn(world);
+    }
+
+    //Push overlapping boxes apart
+    if (world->collide) {
+        result = collide_step(&world->grid, &world->boxes, world->width,
+                world->height, world->gravity_x, world->gravity_y,
+                world->stack);
+
+        //Boxes pushed through an edge go back against it
+        if (world->stack) {
+            contain(world);
+        }
+    }
+
+    return result;
+}
+
+unsigned world_checksum(const world_t *world) {
+    return boxes_checksum(&world->boxes);
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef WORLD_H_
+#define WORLD_H_
+
+#include <stdbool.h>
+
+#include "boxes.h"
+#include "collide.h"
+#include "pool.h"
+
+/**
+ * The FallingBlocks simulation without any platform dependencies. Input
+ * (gravity, new boxes) is set by the caller and random numbers come from
+ * a seeded generator, so a given sequence of calls always produces the
+ * same state on any platform with IEEE floats.
+ */
+typedef struct {
+    boxes_t boxes;
+    grid_t grid;
+    pool_t *pool;
+    int max_boxes;
+
+    //Inputs, set by the caller between steps
+    float gravity_x;
+    float gravity_y;
+    float width;
+    float height;
+
+    //Seconds simulated by one world_step()
+    float tick;
+
+    //Boxes push each other apart instead of passing through
+    bool collide;
+
+    //Boxes leaving the screen come back in at the opposite edge, otherwise
+    //they are removed once they are completely off screen
+    bool wrap;
+
+    //Boxes stay on screen and pile up against the edges gravity pulls them
+    //towards, coming to rest on each other. Overrides wrap.
+    bool stack;
+
+    //Boxes removed for leaving the screen since world_init()
+    long long despawned;
+
+    unsigned random;
+} world_t;
+
+/**
+ * Creates an empty world. Box storage starts small and grows as boxes are
+ * added.
+ *
+ * @param world world to initialize
+ * @param max_boxes most boxes the world will ever hold
+ * @param threads threads to update boxes on, 0 for one per CPU
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int world_init(world_t *world, int max_boxes, int threads);
+
+/**
+ * Releases everything allocated by world_init().
+ */
+void world_free(world_t *world);
+
+/**
+ * Restarts the random number generator used for new boxes.
+ */
+void world_seed(world_t *world, unsigned seed);
+
+/**
+ * Returns the next random number in [0, 1).
+ */
+float world_random(world_t *world);
+
+/**
+ * Adds a box with a random colour and size at x, y.
+ *
+ * @return false if the world is full
+ */
+bool world_add_box(world_t *world, float x, float y);
+
+/**
+ * Removes box i. The last box takes its index.
+ */
+void world_remove_box(world_t *world, int i);
+
+/**
+ * Removes every box.
+ */
+void world_clear(world_t *world);
+
+/**
+ * Advances the simulation by one tick. If the collision step runs out of
+ * memory the boxes have still moved, but overlapping boxes were not pushed
+ * apart.
+ *
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int world_step(world_t *world);
+
+/**
+ * Returns a hash of every box position, for comparing runs bit for bit.
+ */
+unsigned world_checksum(const world_t *world);
+
+#endif /* WORLD_H_ */
@@ -75,6 +75,14 @@ struct font_t {
     int initialized;
 };
 
+struct text_batch_t {
+    GLfloat* vertices;
+    GLfloat* texture_coords;
+    GLushort* indices;
+    int glyphs;
+    int capacity;
+};
+
 
 static void
 bbutil_egl_perror(const char *msg) {
@@ -467,34 +475,15 @@ font_t* bbutil_load_font(const char* path, int point_size, int dpi) {
     return font;
 }
 
-void bbutil_render_text(font_t* font, const char* msg, float x, float y, float r, float g, float b, float a) {
+//Writes the quads for the glyphs of msg into the arrays, as glyphs first to first + msg_len - 1
+static void layout_text(font_t* font, const char* msg, int msg_len, float x, float y,
+        GLfloat* vertices, GLfloat* texture_coords, GLushort* indices, int first) {
     int i, c;
-    GLfloat *vertices;
-    GLfloat *texture_coords;
-    GLushort* indices;
-
     float pen_x = 0.0f;
 
-    if (!font) {
-        fprintf(stderr, "Font must not be null\n");
-        return;
-    }
-
-    if (!font->initialized) {
-        fprintf(stderr, "Font has not been loaded\n");
-        return;
-    }
-
-    if (!msg) {
-        return;
-    }
-
-    const int msg_len = strlen(msg);
-
-    vertices = (GLfloat*) malloc(sizeof(GLfloat) * 8 * msg_len);
-    texture_coords = (GLfloat*) malloc(sizeof(GLfloat) * 8 * msg_len);
-
-    indices = (GLushort*) malloc(sizeof(GLushort) * 6 * msg_len);
+    vertices += 8 * first;
+    texture_coords += 8 * first;
+    indices += 6 * first;
 
     for(i = 0; i < msg_len; ++i) {
         c = msg[i];
@@ -517,164 +506,179 @@ void bbutil_render_text(font_t* font, const char* msg, float x, float y, float r
         texture_coords[8 * i + 6] = font->tex_x2[c];
         texture_coords[8 * i + 7] = font->tex_y1[c];
 
-        indices[i * 6 + 0] = 4 * i + 0;
-        indices[i * 6 + 1] = 4 * i + 1;
-        indices[i * 6 + 2] = 4 * i + 2;
-        indices[i * 6 + 3] = 4 * i + 2;
-        indices[i * 6 + 4] = 4 * i + 1;
-        indices[i * 6 + 5] = 4 * i + 3;
+        indices[i * 6 + 0] = 4 * (first + i) + 0;
+        indices[i * 6 + 1] = 4 * (first + i) + 1;
+        indices[i * 6 + 2] = 4 * (first + i) + 2;
+        indices[i * 6 + 3] = 4 * (first + i) + 2;
+        indices[i * 6 + 4] = 4 * (first + i) + 1;
+        indices[i * 6 + 5] = 4 * (first + i) + 3;
 
         //Assume we are only working with typewriter fonts
         pen_x += font->advance[c];
     }
-#ifdef USING_GL11
-    glEnable(GL_TEXTURE_2D);
-    glEnable(GL_BLEND);
 
-    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+#ifdef USING_GL20
+    //Map text coordinates from (0...surface width, 0...surface height) to (-1...1, -1...1)
+    //this make our vertex shader very simple and also works irrespective of orientation changes
+    EGLint surface_width, surface_height;
 
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    eglQuerySurface(egl_disp, egl_surf, EGL_WIDTH, &surface_width);
+    eglQuerySurface(egl_disp, egl_surf, EGL_HEIGHT, &surface_height);
 
-    glColor4f(r, g, b, a);
+    for(i = 0; i < 4 * msg_len; ++i) {
+        vertices[2 * i + 0] = 2 * vertices[2 * i + 0] / surface_width - 1.0f;
+        vertices[2 * i + 1] = 2 * vertices[2 * i + 1] / surface_height - 1.0f;
+    }
+#endif
+}
 
-    glVertexPointer(2, GL_FLOAT, 0, vertices);
-    glTexCoordPointer(2, GL_FLOAT, 0, texture_coords);
-    glBindTexture(GL_TEXTURE_2D, font->font_texture);
+#ifdef USING_GL20
+static int init_text_program() {
+    GLint status;
+
+    // Create shaders if this hasn't been done already
+    const char* v_source =
+            "precision mediump float;"
+            "attribute vec2 a_position;"
+            "attribute vec2 a_texcoord;"
+            "varying vec2 v_texcoord;"
+            "void main()"
+            "{"
+            "   gl_Position = vec4(a_position, 0.0, 1.0);"
+            "    v_texcoord = a_texcoord;"
+            "}";
+
+    const char* f_source =
+            "precision lowp float;"
+            "varying vec2 v_texcoord;"
+            "uniform sampler2D u_font_texture;"
+            "uniform vec4 u_col;"
+            "void main()"
+            "{"
+            "    vec4 temp = texture2D(u_font_texture, v_texcoord);"
+            "    gl_FragColor = u_col * temp;"
+            "}";
+
+    // Compile the vertex shader
+    GLuint vs = glCreateShader(GL_VERTEX_SHADER);
+
+    if (!vs) {
+        fprintf(stderr, "Failed to create vertex shader: %d\n", glGetError());
+        return 0;
+    } else {
+        glShaderSource(vs, 1, &v_source, 0);
+        glCompileShader(vs);
+        glGetShaderiv(vs, GL_COMPILE_STATUS, &status);
+        if (GL_FALSE == status) {
+            GLchar log[256];
+            glGetShaderInfoLog(vs, 256, NULL, log);
 
-    glDrawElements(GL_TRIANGLES, 6 * msg_len, GL_UNSIGNED_SHORT, indices);
+            fprintf(stderr, "Failed to compile vertex shader: %s\n", log);
 
-    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-    glDisableClientState(GL_VERTEX_ARRAY);
-    glDisable(GL_TEXTURE_2D);
-    glDisable(GL_BLEND);
-#elif defined USING_GL20
-    if (!text_program_initialized) {
-        GLint status;
-
-        // Create shaders if this hasn't been done already
-        const char* v_source =
-                "precision mediump float;"
-                "attribute vec2 a_position;"
-                "attribute vec2 a_texcoord;"
-                "varying vec2 v_texcoord;"
-                "void main()"
-                "{"
-                "   gl_Position = vec4(a_position, 0.0, 1.0);"
-                "    v_texcoord = a_texcoord;"
-                "}";
-
-        const char* f_source =
-                "precision lowp float;"
-                "varying vec2 v_texcoord;"
-                "uniform sampler2D u_font_texture;"
-                "uniform vec4 u_col;"
-                "void main()"
-                "{"
-                "    vec4 temp = texture2D(u_font_texture, v_texcoord);"
-                "    gl_FragColor = u_col * temp;"
-                "}";
-
-        // Compile the vertex shader
-        GLuint vs = glCreateShader(GL_VERTEX_SHADER);
-
-        if (!vs) {
-            fprintf(stderr, "Failed to create vertex shader: %d\n", glGetError());
-            return;
-        } else {
-            glShaderSource(vs, 1, &v_source, 0);
-            glCompileShader(vs);
-            glGetShaderiv(vs, GL_COMPILE_STATUS, &status);
-            if (GL_FALSE == status) {
-                GLchar log[256];
-                glGetShaderInfoLog(vs, 256, NULL, log);
-
-                fprintf(stderr, "Failed to compile vertex shader: %s\n", log);
-
-                glDeleteShader(vs);
-            }
+            glDeleteShader(vs);
         }
+    }
 
-        // Compile the fragment shader
-        GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
+    // Compile the fragment shader
+    GLuint fs = glCreateShader(GL_FRAGMENT_SHADER);
 
-        if (!fs) {
-            fprintf(stderr, "Failed to create fragment shader: %d\n", glGetError());
-            return;
-        } else {
-            glShaderSource(fs, 1, &f_source, 0);
-            glCompileShader(fs);
-            glGetShaderiv(fs, GL_COMPILE_STATUS, &status);
-            if (GL_FALSE == status) {
-                GLchar log[256];
-                glGetShaderInfoLog(fs, 256, NULL, log);
+    if (!fs) {
+        fprintf(stderr, "Failed to create fragment shader: %d\n", glGetError());
+        return 0;
+    } else {
+        glShaderSource(fs, 1, &f_source, 0);
+        glCompileShader(fs);
+        glGetShaderiv(fs, GL_COMPILE_STATUS, &status);
+        if (GL_FALSE == status) {
+            GLchar log[256];
+            glGetShaderInfoLog(fs, 256, NULL, log);
 
-                fprintf(stderr, "Failed to compile fragment shader: %s\n", log);
+            fprintf(stderr, "Failed to compile fragment shader: %s\n", log);
 
-                glDeleteShader(vs);
-                glDeleteShader(fs);
+            glDeleteShader(vs);
+            glDeleteShader(fs);
 
-                return;
-            }
+            return 0;
         }
+    }
 
-        // Create and link the program
-        text_rendering_program = glCreateProgram();
-        if (text_rendering_program)
-        {
-            glAttachShader(text_rendering_program, vs);
-            glAttachShader(text_rendering_program, fs);
-            glLinkProgram(text_rendering_program);
-
-            glGetProgramiv(text_rendering_program, GL_LINK_STATUS, &status);
-            if (status == GL_FALSE)    {
-                GLchar log[256];
-                glGetProgramInfoLog(fs, 256, NULL, log);
+    // Create and link the program
+    text_rendering_program = glCreateProgram();
+    if (text_rendering_program)
+    {
+        glAttachShader(text_rendering_program, vs);
+        glAttachShader(text_rendering_program, fs);
+        glLinkProgram(text_rendering_program);
 
-                fprintf(stderr, "Failed to link text rendering shader program: %s\n", log);
+        glGetProgramiv(text_rendering_program, GL_LINK_STATUS, &status);
+        if (status == GL_FALSE)    {
+            GLchar log[256];
+            glGetProgramInfoLog(fs, 256, NULL, log);
 
-                glDeleteProgram(text_rendering_program);
-                text_rendering_program = 0;
+            fprintf(stderr, "Failed to link text rendering shader program: %s\n", log);
 
-                return;
-            }
-        } else {
-            fprintf(stderr, "Failed to create a shader program\n");
+            glDeleteProgram(text_rendering_program);
+            text_rendering_program = 0;
 
-            glDeleteShader(vs);
-            glDeleteShader(fs);
-            return;
+            return 0;
         }
+    } else {
+        fprintf(stderr, "Failed to create a shader program\n");
 
-        // We don't need the shaders anymore - the program is enough
-        glDeleteShader(fs);
         glDeleteShader(vs);
+        glDeleteShader(fs);
+        return 0;
+    }
 
-        glUseProgram(text_rendering_program);
+    // We don't need the shaders anymore - the program is enough
+    glDeleteShader(fs);
+    glDeleteShader(vs);
 
-        // Store the locations of the shader variables we need later
-        positionLoc = glGetAttribLocation(text_rendering_program, "a_position");
-        texcoordLoc = glGetAttribLocation(text_rendering_program, "a_texcoord");
-        textureLoc = glGetUniformLocation(text_rendering_program, "u_font_texture");
-        colorLoc = glGetUniformLocation(text_rendering_program, "u_col");
+    glUseProgram(text_rendering_program);
 
-        text_program_initialized = 1;
-    }
+    // Store the locations of the shader variables we need later
+    positionLoc = glGetAttribLocation(text_rendering_program, "a_position");
+    texcoordLoc = glGetAttribLocation(text_rendering_program, "a_texcoord");
+    textureLoc = glGetUniformLocation(text_rendering_program, "u_font_texture");
+    colorLoc = glGetUniformLocation(text_rendering_program, "u_col");
+
+    text_program_initialized = 1;
 
+    return 1;
+}
+#endif
+
+//Draws glyphs laid out by layout_text()
+static void draw_text(font_t* font, const GLfloat* vertices, const GLfloat* texture_coords,
+        const GLushort* indices, int glyphs, float r, float g, float b, float a) {
+#ifdef USING_GL11
+    glEnable(GL_TEXTURE_2D);
     glEnable(GL_BLEND);
 
-    //Map text coordinates from (0...surface width, 0...surface height) to (-1...1, -1...1)
-    //this make our vertex shader very simple and also works irrespective of orientation changes
-    EGLint surface_width, surface_height;
+    glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
-    eglQuerySurface(egl_disp, egl_surf, EGL_WIDTH, &surface_width);
-    eglQuerySurface(egl_disp, egl_surf, EGL_HEIGHT, &surface_height);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
-    for(i = 0; i < 4 * msg_len; ++i) {
-        vertices[2 * i + 0] = 2 * vertices[2 * i + 0] / surface_width - 1.0f;
-        vertices[2 * i + 1] = 2 * vertices[2 * i + 1] / surface_height - 1.0f;
+    glColor4f(r, g, b, a);
+
+    glVertexPointer(2, GL_FLOAT, 0, vertices);
+    glTexCoordPointer(2, GL_FLOAT, 0, texture_coords);
+    glBindTexture(GL_TEXTURE_2D, font->font_texture);
+
+    glDrawElements(GL_TRIANGLES, 6 * glyphs, GL_UNSIGNED_SHORT, indices);
+
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_BLEND);
+#elif defined USING_GL20
+    if (!text_program_initialized && !init_text_program()) {
+        return;
     }
 
+    glEnable(GL_BLEND);
+
     //Render text
     glUseProgram(text_rendering_program);
 
@@ -695,19 +699,124 @@ void bbutil_render_text(font_t* font, const char* msg, float x, float y, float r
     glVertexAttribPointer(texcoordLoc, 2, GL_FLOAT, GL_FALSE, 0, texture_coords);
 
        //Draw the string
-    glDrawElements(GL_TRIANGLES, 6 * msg_len, GL_UNSIGNED_SHORT, indices);
+    glDrawElements(GL_TRIANGLES, 6 * glyphs, GL_UNSIGNED_SHORT, indices);
 
     glDisableVertexAttribArray(positionLoc);
     glDisableVertexAttribArray(texcoordLoc);
 #else
     fprintf(stderr, "bbutil should be compiled with either USING_GL11 or USING_GL20 -D flags\n");
 #endif
+}
+
+void bbutil_render_text(font_t* font, const char* msg, float x, float y, float r, float g, float b, float a) {
+    GLfloat *vertices;
+    GLfloat *texture_coords;
+    GLushort* indices;
+
+    if (!font) {
+        fprintf(stderr, "Font must not be null\n");
+        return;
+    }
+
+    if (!font->initialized) {
+        fprintf(stderr, "Font has not been loaded\n");
+        return;
+    }
+
+    if (!msg) {
+        return;
+    }
+
+    const int msg_len = strlen(msg);
+
+    vertices = (GLfloat*) malloc(sizeof(GLfloat) * 8 * msg_len);
+    texture_coords = (GLfloat*) malloc(sizeof(GLfloat) * 8 * msg_len);
+
+    indices = (GLushort*) malloc(sizeof(GLushort) * 6 * msg_len);
+
+    layout_text(font, msg, msg_len, x, y, vertices, texture_coords, indices, 0);
+    draw_text(font, vertices, texture_coords, indices, msg_len, r, g, b, a);
 
     free(vertices);
     free(texture_coords);
     free(indices);
 }
 
+text_batch_t* bbutil_create_text_batch() {
+    return (text_batch_t*) calloc(1, sizeof(text_batch_t));
+}
+
+void bbutil_clear_text_batch(text_batch_t* batch) {
+    if (batch) {
+        batch->glyphs = 0;
+    }
+}
+
+int bbutil_add_text(text_batch_t* batch, font_t* font, const char* msg, float x, float y) {
+    if (!batch || !font || !font->initialized || !msg) {
+        return EXIT_FAILURE;
+    }
+
+    const int msg_len = strlen(msg);
+    const int glyphs = batch->glyphs + msg_len;
+
+    //Indices are unsigned shorts, 4 vertices per glyph
+    if (glyphs > 65536 / 4) {
+        return EXIT_FAILURE;
+    }
+
+    if (glyphs > batch->capacity) {
+        int capacity = batch->capacity ? batch->capacity : 64;
+        while (capacity < glyphs) {
+            capacity *= 2;
+        }
+
+        GLfloat* vertices = (GLfloat*) realloc(batch->vertices, sizeof(GLfloat) * 8 * capacity);
+        if (!vertices) {
+            return EXIT_FAILURE;
+        }
+        batch->vertices = vertices;
+
+        GLfloat* texture_coords = (GLfloat*) realloc(batch->texture_coords, sizeof(GLfloat) * 8 * capacity);
+        if (!texture_coords) {
+            return EXIT_FAILURE;
+        }
+        batch->texture_coords = texture_coords;
+
+        GLushort* indices = (GLushort*) realloc(batch->indices, sizeof(GLushort) * 6 * capacity);
+        if (!indices) {
+            return EXIT_FAILURE;
+        }
+        batch->indices = indices;
+
+        batch->capacity = capacity;
+    }
+
+    layout_text(font, msg, msg_len, x, y, batch->vertices, batch->texture_coords, batch->indices, batch->glyphs);
+    batch->glyphs = glyphs;
+
+    return EXIT_SUCCESS;
+}
+
+void bbutil_render_text_batch(text_batch_t* batch, font_t* font, float r, float g, float b, float a) {
+    if (!batch || !batch->glyphs || !font || !font->initialized) {
+        return;
+    }
+
+    draw_text(font, batch->vertices, batch->texture_coords, batch->indices, batch->glyphs, r, g, b, a);
+}
+
+void bbutil_destroy_text_batch(text_batch_t* batch) {
+    if (!batch) {
+        return;
+    }
+
+    free(batch->vertices);
+    free(batch->texture_coords);
+    free(batch->indices);
+    free(batch);
+}
+
 void bbutil_destroy_font(font_t* font) {
     if (!font) {
         return;
@@ -25,6 +25,7 @@ extern EGLDisplay egl_disp;
 extern EGLSurface egl_surf;
 
 typedef struct font_t font_t;
+typedef struct text_batch_t text_batch_t;
 
 #define BBUTIL_DEFAULT_FONT "/usr/fonts/font_repository/monotype/arial.ttf"
 
@@ -79,6 +80,47 @@ void bbutil_destroy_font(font_t* font);
  */
 void bbutil_render_text(font_t* font, const char* msg, float x, float y, float r, float g, float b, float a);
 
+/**
+ * Creates an empty text batch. A batch holds the glyph geometry of any number of
+ * strings, laid out once and drawn with a single call for as long as the text
+ * stays the same.
+ *
+ * @return pointer to text_batch_t structure on success or NULL on failure
+ */
+text_batch_t* bbutil_create_text_batch();
+
+/**
+ * Removes all strings from a batch, keeping its memory for the next ones
+ */
+void bbutil_clear_text_batch(text_batch_t* batch);
+
+/**
+ * Lays out a string and adds it to a batch
+ * NOTE: must be called after a successful return from bbutil_init() or bbutil_init_egl() call
+ *
+ * @param batch to add the string to
+ * @param font to use for rendering
+ * @param msg the message to add
+ * @param x, y position of the bottom-left corner of text string in world coordinate space
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int bbutil_add_text(text_batch_t* batch, font_t* font, const char* msg, float x, float y);
+
+/**
+ * Renders every string in a batch. The font must be the one the strings were added with.
+ *
+ * @param batch to render
+ * @param font the strings were laid out with
+ * @param rgba color for the text to render with
+ */
+void bbutil_render_text_batch(text_batch_t* batch, font_t* font, float r, float g, float b, float a);
+
+/**
+ * Destroys a text batch
+ * @param batch to be destroyed
+ */
+void bbutil_destroy_text_batch(text_batch_t* batch);
+
 /**
  * Returns the non-scaled width and height of a string
  * NOTE: must be called after a successful return from bbutil_init() or bbutil_init_egl() call
@@ -0,0 +1,1364 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "gamepad.h"
+#include "inputring.h"
+#include "latency.h"
+#include "profile.h"
+#include "record.h"
+#include "simd.h"
+#include "stick.h"
+
+// The consumer drains the ring at this rate, like update() does.
+static const int FRAME_RATE = 60;
+
+// The producer wakes up this often and pushes all events that are due.
+static const uint64_t PRODUCER_TICK = 1000000ULL;
+
+// Surface size used when replaying without a display.
+static const float BENCH_WIDTH = 1280.0f;
+static const float BENCH_HEIGHT = 768.0f;
+
+// Events per second in a synthetic session.
+static const int SESSION_RATE = 1000;
+
+// Most slots a device lookup may look at on average.  Linear probing in a
+// table at most half full needs 1.5 with a hash that spreads the handles.
+static const double MAX_AVERAGE_PROBES = 2.0;
+
+// Timed runs of the idle frames, the middle one is reported so a run that was
+// preempted or started on a cold cache does not count.
+static const int IDLE_RUNS = 7;
+
+typedef struct StressTest_t {
+    InputRing ring;
+    int rate;
+    uint64_t end;
+    volatile int done;
+
+    // Producer side totals.
+    unsigned sent;
+    unsigned edges;
+    int finalButtons;
+} StressTest;
+
+static void sleepNanos(uint64_t nanos)
+{
+    struct timespec delay;
+    delay.tv_sec = nanos / 1000000000ULL;
+    delay.tv_nsec = nanos % 1000000000ULL;
+    nanosleep(&delay, NULL);
+}
+
+static void* producer(void* arg)
+{
+    StressTest* test = (StressTest*)arg;
+    const uint64_t start = input_ring_now();
+    unsigned random = 1;
+    int buttons = 0;
+    int analog[3] = { 0, 0, 0 };
+
+    for (;;) {
+        uint64_t now = input_ring_now();
+        unsigned due;
+
+        if (now >= test->end) {
+            break;
+        }
+
+        // Push every event that should have happened by now.
+        due = (unsigned)((now - start) * test->rate / 1000000000ULL);
+        while (test->sent < due) {
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+
+            // Each event toggles one of 16 buttons and moves a stick.
+            buttons ^= 1 << (random & 15);
+            analog[0] = (int)(random >> 8 & 0xff) - 128;
+            analog[1] = (int)(random >> 16 & 0xff) - 128;
+
+            input_ring_push(&test->ring, input_ring_now(), buttons, analog, analog);
+            test->sent++;
+            test->edges++;
+        }
+        input_ring_flush(&test->ring);
+
+        sleepNanos(PRODUCER_TICK);
+    }
+
+    // The consumer is still running, so the last merged entry will get through.
+    while (test->ring.hasPending) {
+        input_ring_flush(&test->ring);
+        sleepNanos(PRODUCER_TICK);
+    }
+
+    test->finalButtons = buttons;
+    __sync_lock_test_and_set(&test->done, 1);
+
+    return NULL;
+}
+
+int bench_input_ring(FILE* out, int rate, int seconds)
+{
+    StressTest* test = (StressTest*)calloc(1, sizeof(StressTest));
+    pthread_t thread;
+    InputEvent event;
+    unsigned received = 0;
+    unsigned edges = 0;
+    unsigned frames = 0;
+    unsigned outOfOrder = 0;
+    unsigned maxBatch = 0;
+    uint64_t lastTime = 0;
+    uint64_t drainTime = 0;
+    int buttons = 0;
+    int result;
+
+    if (!test) {
+        return EXIT_FAILURE;
+    }
+
+    input_ring_init(&test->ring);
+    test->rate = rate;
+    test->end = input_ring_now() + (uint64_t)seconds * 1000000000ULL;
+
+    if (pthread_create(&thread, NULL, producer, test) != 0) {
+        free(test);
+        return EXIT_FAILURE;
+    }
+
+    for (;;) {
+        bool done = __sync_fetch_and_add(&test->done, 0) != 0;
+        uint64_t start = input_ring_now();
+        unsigned batch = 0;
+
+        while (input_ring_pop(&test->ring, &event)) {
+            // A press or release must follow the state the consumer already has.
+            if ((event.pressed & buttons) || (event.released & ~buttons)) {
+                if ((event.pressed & event.released) == 0) {
+                    outOfOrder++;
+                }
+            }
+            if (event.time < lastTime) {
+                outOfOrder++;
+            }
+
+            // Edges of a button alternate, so an odd count must change its state.
+            int changed = 0;
+            int i;
+            for (i = 0; i < INPUT_RING_BUTTONS; ++i) {
+                edges += event.edges[i];
+                changed |= (event.edges[i] & 1) << i;
+            }
+            if (changed != (buttons ^ event.buttons)) {
+                outOfOrder++;
+            }
+
+            buttons = event.buttons;
+            lastTime = event.time;
+            received++;
+            batch++;
+        }
+
+        drainTime += input_ring_now() - start;
+        if (batch > maxBatch) {
+            maxBatch = batch;
+        }
+        frames++;
+
+        // Stop once the producer has finished and everything was drained.
+        if (done) {
+            break;
+        }
+
+        sleepNanos(1000000000ULL / FRAME_RATE);
+    }
+
+    pthread_join(thread, NULL);
+
+    // Merged entries count repeated edges of a button, so every edge must arrive.
+    result = (edges == test->edges
+            && buttons == test->finalButtons && outOfOrder == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    fprintf(out, "input ring %d events/s for %d s: sent %u edges %u, received %u entries"
+            " edges %u, merged %u folded %u, out of order %u, max %u per frame,"
+            " %.0f ns drain per frame: %s\n",
+            rate, seconds, test->sent, test->edges, received, edges,
+            test->ring.merged, test->ring.folded, outOfOrder, maxBatch,
+            frames ? (double)drainTime / frames : 0.0,
+            result == EXIT_SUCCESS ? "PASS" : "FAIL");
+
+    free(test);
+
+    return result;
+}
+
+static void writeAttach(RecordFile* record, uint64_t time, int device, bool gamepad, int analogCount, int buttonCount)
+{
+    Record event;
+
+    memset(&event, 0, sizeof(event));
+    event.type = RECORD_ATTACH;
+    event.time = time;
+    event.device = device;
+    event.info.gamepad = gamepad;
+    event.info.analogCount = analogCount;
+    event.info.buttonCount = buttonCount;
+    snprintf(event.info.id, sizeof(event.info.id), "synthetic-%d", device);
+    record_write(record, &event);
+}
+
+int bench_write_session(const char* path, int seconds)
+{
+    RecordFile record;
+    Record event;
+    Gamepad* layout = (Gamepad*)malloc(sizeof(Gamepad));
+    unsigned random = 1;
+    int buttons[2] = { 0, 0 };
+    int count = seconds * SESSION_RATE;
+    int i;
+
+    if (!layout) {
+        return EXIT_FAILURE;
+    }
+
+    if (EXIT_SUCCESS != record_create(&record, path)) {
+        free(layout);
+        return EXIT_FAILURE;
+    }
+
+    // Only used to find where the buttons are.
+    if (EXIT_SUCCESS != gamepad_init(layout, BENCH_WIDTH, BENCH_HEIGHT)) {
+        record_close(&record);
+        free(layout);
+        return EXIT_FAILURE;
+    }
+
+    writeAttach(&record, record.start, 0, true, 2, 16);
+    writeAttach(&record, record.start, 1, false, 1, 12);
+
+    for (i = 0; i < count; ++i) {
+        uint64_t time = record.start + (uint64_t)i * 1000000000ULL / SESSION_RATE;
+        int device = i & 1;
+
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+
+        // Tap button A of player one, so the next press remaps it.
+        if (i == count / 4) {
+            const Quad* quad = layout->players[0]->virtualButtons[8].quad;
+            memset(&event, 0, sizeof(event));
+            event.type = RECORD_TOUCH;
+            event.time = time;
+            event.x = (int)(quad->x + quad->width * 0.5f);
+            event.y = (int)(BENCH_HEIGHT - quad->y - quad->height * 0.5f);
+            record_write(&record, &event);
+        }
+
+        // Pull the second controller out for a while.
+        if (i == count / 2) {
+            memset(&event, 0, sizeof(event));
+            event.type = RECORD_DETACH;
+            event.time = time;
+            event.device = 1;
+            record_write(&record, &event);
+        } else if (i == 3 * count / 4) {
+            writeAttach(&record, time, 1, false, 1, 12);
+        }
+
+        // Sticks move on every event, a button changes on one in sixteen.
+        if ((random & 0xf0) == 0) {
+            buttons[device] ^= 1 << (random & 15);
+        }
+
+        memset(&event, 0, sizeof(event));
+        event.type = RECORD_STATE;
+        event.time = time;
+        event.device = device;
+        event.buttons = buttons[device];
+        event.analog0[0] = (int)(random >> 8 & 0xff) - 128;
+        event.analog0[1] = (int)(random >> 16 & 0xff) - 128;
+        event.analog0[2] = random >> 24;
+        event.analog1[0] = -event.analog0[1];
+        event.analog1[1] = event.analog0[0];
+        event.analog1[2] = 255 - event.analog0[2];
+        record_write(&record, &event);
+    }
+
+    record_close(&record);
+    gamepad_free(layout);
+    free(layout);
+
+    return EXIT_SUCCESS;
+}
+
+int bench_replay(FILE* out, const char* path)
+{
+    static const char* names[] = { "", "state", "attach", "detach", "touch" };
+    Gamepad* gamepad = (Gamepad*)malloc(sizeof(Gamepad));
+    RecordFile record;
+    Record event;
+    unsigned counts[5] = { 0 };
+    uint64_t updateTime[5] = { 0 };
+    uint64_t buildTime = 0;
+    uint64_t worstUpdate = 0;
+    uint64_t worstBuild = 0;
+    uint64_t uploadBytes = 0;
+    unsigned total = 0;
+    int i;
+
+    if (!gamepad) {
+        return EXIT_FAILURE;
+    }
+
+    if (EXIT_SUCCESS != record_open(&record, path)) {
+        free(gamepad);
+        return EXIT_FAILURE;
+    }
+
+    if (EXIT_SUCCESS != gamepad_init(gamepad, BENCH_WIDTH, BENCH_HEIGHT)) {
+        record_close(&record);
+        free(gamepad);
+        return EXIT_FAILURE;
+    }
+
+    // Every event is followed by a frame, as with GAMEPAD_REPLAY_SPEED=max.
+    while (record_read(&record, &event)) {
+        uint64_t start = input_ring_now();
+        record_apply(gamepad, &event);
+        gamepad_update(gamepad);
+        uint64_t updated = input_ring_now();
+        gamepad_build(gamepad);
+        uint64_t built = input_ring_now();
+
+        if (event.type >= RECORD_STATE && event.type <= RECORD_TOUCH) {
+            counts[event.type]++;
+            updateTime[event.type] += updated - start;
+        }
+        buildTime += built - updated;
+
+        // What render() would send to the vertex buffer for this frame.
+        uploadBytes += gamepad->dirtyQuads * (QUAD_VERTEX_COORDS + QUAD_TEXCOORDS) * sizeof(float);
+
+        if (updated - start > worstUpdate) {
+            worstUpdate = updated - start;
+        }
+        if (built - updated > worstBuild) {
+            worstBuild = built - updated;
+        }
+        total++;
+    }
+
+    record_close(&record);
+
+    if (total == 0) {
+        fprintf(out, "replay %s: no events\n", path);
+        gamepad_free(gamepad);
+        free(gamepad);
+        return EXIT_FAILURE;
+    }
+
+    uint64_t updateTotal = 0;
+    for (i = RECORD_STATE; i <= RECORD_TOUCH; ++i) {
+        updateTotal += updateTime[i];
+    }
+
+    fprintf(out, "replay %s: %u events, update %.0f ns (worst %llu), render %.0f ns (worst %llu),"
+            " %.0f ns per event\n", path, total,
+            (double)updateTotal / total, (unsigned long long)worstUpdate,
+            (double)buildTime / total, (unsigned long long)worstBuild,
+            (double)(updateTotal + buildTime) / total);
+    fprintf(out, "  upload %.0f bytes per frame, %d bytes for all %d quads\n",
+            (double)uploadBytes / total,
+            (int)(gamepad->quadCount * (QUAD_VERTEX_COORDS + QUAD_TEXCOORDS) * sizeof(float)), gamepad->quadCount);
+
+    for (i = RECORD_STATE; i <= RECORD_TOUCH; ++i) {
+        if (counts[i]) {
+            fprintf(out, "  %-6s %8u events, update %.0f ns\n", names[i], counts[i], (double)updateTime[i] / counts[i]);
+        }
+    }
+
+    gamepad_free(gamepad);
+    free(gamepad);
+
+    return EXIT_SUCCESS;
+}
+
+static void* benchHandle(int device)
+{
+    // Spaced like heap pointers, which is what libscreen hands out.
+    return (void*)(intptr_t)(0x10000 + device * 64);
+}
+
+static GameController* linearFind(Gamepad* gamepad, void* handle)
+{
+    int i;
+    for (i = 0; i < gamepad->playerCount; ++i) {
+        if (gamepad->players[i]->handle == handle) {
+            return gamepad->players[i];
+        }
+    }
+
+    return NULL;
+}
+
+int bench_players(FILE* out, int players)
+{
+    Gamepad* gamepad = (Gamepad*)malloc(sizeof(Gamepad));
+    GameController** expected = (GameController**)calloc(players, sizeof(GameController*));
+    DeviceInfo info;
+    unsigned random = 1;
+    unsigned errors = 0;
+    uint64_t hashTime = 0;
+    uint64_t scanTime = 0;
+    uint64_t frameTime = 0;
+    const int lookups = 100000;
+    const int frames = 100;
+    int i, j;
+
+    if (!gamepad || !expected || EXIT_SUCCESS != gamepad_init(gamepad, BENCH_WIDTH, BENCH_HEIGHT)) {
+        free(expected);
+        free(gamepad);
+        return EXIT_FAILURE;
+    }
+
+    memset(&info, 0, sizeof(info));
+    info.gamepad = true;
+    info.analogCount = 2;
+    info.buttonCount = 16;
+
+    // Give every player a state and a mapping of its own.
+    for (i = 0; i < players; ++i) {
+        int analog[3] = { i & 127, -(i & 127), i & 255 };
+
+        snprintf(info.id, sizeof(info.id), "bench-%d", i);
+        expected[i] = gamepad_attach(gamepad, benchHandle(i), &info);
+        if (!expected[i]) {
+            fprintf(out, "players %d: attach %d failed\n", players, i);
+            gamepad_free(gamepad);
+            free(expected);
+            free(gamepad);
+            return EXIT_FAILURE;
+        }
+
+        expected[i]->virtualButtons[8].mapping = 1 << (i & 15);
+        input_ring_push(&expected[i]->eventRing, input_ring_now(), i & 0xffff, analog, analog);
+        input_ring_flush(&expected[i]->eventRing);
+    }
+    gamepad_update(gamepad);
+
+    // Device lookup, once through the map and once by scanning every player.
+    uint64_t start = input_ring_now();
+    for (i = 0; i < lookups; ++i) {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        if (gamepad_find(gamepad, benchHandle(random % players)) != expected[random % players]) {
+            errors++;
+        }
+    }
+    hashTime = input_ring_now() - start;
+
+    start = input_ring_now();
+    for (i = 0; i < lookups; ++i) {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        if (linearFind(gamepad, benchHandle(random % players)) != expected[random % players]) {
+            errors++;
+        }
+    }
+    scanTime = input_ring_now() - start;
+
+    // Pull out and plug back in every odd device.  The others must not notice.
+    for (j = 0; j < 4; ++j) {
+        for (i = 1; i < players; i += 2) {
+            gamepad_detach(gamepad, benchHandle(i));
+        }
+        gamepad_update(gamepad);
+
+        for (i = 0; i < players; i += 2) {
+            GameController* controller = expected[i];
+            if (gamepad_find(gamepad, benchHandle(i)) != controller
+                    || controller->player != i
+                    || controller->buttons != (i & 0xffff)
+                    || controller->analog0[0] != (i & 127)
+                    || controller->virtualButtons[8].mapping != 1 << (i & 15)) {
+                errors++;
+            }
+        }
+
+        for (i = 1; i < players; i += 2) {
+            snprintf(info.id, sizeof(info.id), "bench-%d", i);
+            expected[i] = gamepad_attach(gamepad, benchHandle(i), &info);
+            if (!expected[i] || gamepad_find(gamepad, benchHandle(i)) != expected[i]) {
+                errors++;
+            }
+        }
+    }
+
+    if (gamepad->playerCount != (players > MIN_PLAYERS ? players : MIN_PLAYERS)) {
+        errors++;
+    }
+
+    // Handles spaced like heap pointers must still spread over the table.
+    int longestProbe;
+    const double averageProbe = (double)devicemap_probes(&gamepad->devices, &longestProbe) / gamepad->devices.count;
+    if (averageProbe > MAX_AVERAGE_PROBES) {
+        fprintf(out, "players %d: %.2f probes per lookup on average\n", players, averageProbe);
+        errors++;
+    }
+
+    // Cost of a frame with every player on screen.
+    start = input_ring_now();
+    for (i = 0; i < frames; ++i) {
+        gamepad_update(gamepad);
+        gamepad_build(gamepad);
+    }
+    frameTime = input_ring_now() - start;
+
+    fprintf(out, "players %d: find %.1f ns (scan %.1f ns), probes %.2f average %d longest,"
+            " update and build %.1f us per frame, %d quads: %s\n", players,
+            (double)hashTime / lookups, (double)scanTime / lookups, averageProbe, longestProbe,
+            (double)frameTime / frames / 1000.0, gamepad->quadCount,
+            errors == 0 ? "PASS" : "FAIL");
+
+    gamepad_free(gamepad);
+    free(expected);
+    free(gamepad);
+
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static uint64_t cpuNow()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static int compareTimes(const void* a, const void* b)
+{
+    const uint64_t x = *(const uint64_t*)a;
+    const uint64_t y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+// Returns the CPU time of the middle one of IDLE_RUNS runs, after one run to warm up.
+static uint64_t idleFrames(Gamepad* gamepad, int frames, bool reformat, unsigned* textChanges, int* dirtyFrames)
+{
+    uint64_t times[IDLE_RUNS];
+    unsigned serial = gamepad->textSerial;
+    int run, i, j;
+
+    *dirtyFrames = 0;
+
+    for (run = -1; run < IDLE_RUNS; ++run) {
+        uint64_t start = cpuNow();
+
+        for (i = 0; i < frames; ++i) {
+            // Forgetting what the text shows makes update() format it and set the quads again, as it did
+            // every frame before.
+            for (j = 0; reformat && j < gamepad->playerCount; ++j) {
+                gamepad->players[j]->textValid = false;
+            }
+
+            gamepad_update(gamepad);
+            gamepad_build(gamepad);
+
+            if (gamepad->dirtyQuads > 0) {
+                ++*dirtyFrames;
+            }
+        }
+
+        if (run >= 0) {
+            times[run] = cpuNow() - start;
+        }
+    }
+
+    *textChanges = gamepad->textSerial - serial;
+
+    qsort(times, IDLE_RUNS, sizeof(times[0]), compareTimes);
+    return times[IDLE_RUNS / 2];
+}
+
+int bench_idle(FILE* out, int players)
+{
+    Gamepad* gamepad = (Gamepad*)malloc(sizeof(Gamepad));
+    DeviceInfo info;
+    unsigned changes, reformatChanges;
+    int dirtyFrames, reformatDirtyFrames;
+    const int frames = 10000;
+    int i;
+
+    if (!gamepad || EXIT_SUCCESS != gamepad_init(gamepad, BENCH_WIDTH, BENCH_HEIGHT)) {
+        free(gamepad);
+        return EXIT_FAILURE;
+    }
+
+    memset(&info, 0, sizeof(info));
+    info.gamepad = true;
+    info.analogCount = 2;
+    info.buttonCount = 16;
+
+    // Controllers that are attached with their sticks slightly off centre and then left alone.
+    for (i = 0; i < players; ++i) {
+        int analog[3] = { -3, 5, 0 };
+        GameController* controller;
+
+        snprintf(info.id, sizeof(info.id), "bench-%d", i);
+        controller = gamepad_attach(gamepad, benchHandle(i), &info);
+        if (!controller) {
+            gamepad_free(gamepad);
+            free(gamepad);
+            return EXIT_FAILURE;
+        }
+        input_ring_push(&controller->eventRing, input_ring_now(), 0, analog, analog);
+        input_ring_flush(&controller->eventRing);
+    }
+    gamepad_update(gamepad);
+    gamepad_build(gamepad);
+
+    uint64_t idle = idleFrames(gamepad, frames, false, &changes, &dirtyFrames);
+    uint64_t reformat = idleFrames(gamepad, frames, true, &reformatChanges, &reformatDirtyFrames);
+
+    fprintf(out, "idle %d players: %.0f ns CPU per frame, %u text changes and %d frames with changed quads"
+            " in %d frames; formatting and setting quads every frame %.0f ns CPU per frame (median of %d runs)\n",
+            players, (double)idle / frames, changes, dirtyFrames, (IDLE_RUNS + 1) * frames,
+            (double)reformat / frames, IDLE_RUNS);
+
+    gamepad_free(gamepad);
+    free(gamepad);
+
+    return changes == 0 && dirtyFrames == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+typedef struct LatencyTest_t {
+    Gamepad* gamepad;
+    GameController* controller;
+    InputSource source;
+
+    // Samples per second of the poll thread, 0 to sample at the start of every frame instead.
+    int pollRate;
+
+    // Stamp samples with the time the simulated button changed instead of the time of the sample,
+    // to include the wait for the next sample.
+    bool stampPress;
+
+    uint64_t end;
+    volatile int done;
+
+    // The simulated device.
+    pthread_mutex_t deviceMutex;
+    int deviceButtons;
+    uint64_t deviceChanged;
+} LatencyTest;
+
+static void sampleDevice(LatencyTest* test)
+{
+    static const int centre[3] = { 0, 0, 0 };
+    uint64_t now = input_ring_now();
+    int buttons;
+    uint64_t changed;
+
+    pthread_mutex_lock(&test->deviceMutex);
+    buttons = test->deviceButtons;
+    changed = test->deviceChanged;
+    pthread_mutex_unlock(&test->deviceMutex);
+
+    input_ring_push(&test->controller->pollRing, test->stampPress ? changed : now, buttons, centre, centre);
+    input_ring_flush(&test->controller->pollRing);
+}
+
+static void* presser(void* arg)
+{
+    static const int centre[3] = { 0, 0, 0 };
+    LatencyTest* test = (LatencyTest*)arg;
+    unsigned random = 7;
+    int buttons = 0;
+
+    while (input_ring_now() < test->end) {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+
+        // Press or release a button every 2 to 10 ms, at no particular point in the frame.
+        sleepNanos(2000000ULL + random % 8000000ULL);
+        buttons ^= 1;
+
+        if (test->source == INPUT_EVENTS) {
+            // An event is stamped when it is received, as handleScreenEvent() does.
+            input_ring_push(&test->controller->eventRing, input_ring_now(), buttons, centre, centre);
+            input_ring_flush(&test->controller->eventRing);
+        } else {
+            pthread_mutex_lock(&test->deviceMutex);
+            test->deviceButtons = buttons;
+            test->deviceChanged = input_ring_now();
+            pthread_mutex_unlock(&test->deviceMutex);
+        }
+    }
+
+    __sync_lock_test_and_set(&test->done, 1);
+
+    return NULL;
+}
+
+static void* latencyPoller(void* arg)
+{
+    LatencyTest* test = (LatencyTest*)arg;
+    const uint64_t period = 1000000000ULL / test->pollRate;
+    uint64_t next = input_ring_now();
+
+    while (!__sync_fetch_and_add(&test->done, 0)) {
+        sampleDevice(test);
+
+        uint64_t now = input_ring_now();
+        next += period;
+        if (next > now) {
+            sleepNanos(next - now);
+        } else {
+            next = now;
+        }
+    }
+
+    return NULL;
+}
+
+static int runLatency(Gamepad* gamepad, GameController* controller, InputSource source, int pollRate,
+        bool stampPress, int seconds, LatencyHistogram* histogram)
+{
+    LatencyTest test;
+    pthread_t pressThread, pollThread;
+    bool polling = (source == INPUT_POLLING && pollRate > 0);
+    const uint64_t frame = 1000000000ULL / FRAME_RATE;
+
+    memset(&test, 0, sizeof(test));
+    test.gamepad = gamepad;
+    test.controller = controller;
+    test.source = source;
+    test.pollRate = pollRate;
+    test.stampPress = stampPress;
+    test.end = input_ring_now() + (uint64_t)seconds * 1000000000ULL;
+    test.deviceChanged = input_ring_now();
+    pthread_mutex_init(&test.deviceMutex, NULL);
+    latency_init(histogram);
+
+    if (pthread_create(&pressThread, NULL, presser, &test) != 0) {
+        return EXIT_FAILURE;
+    }
+    if (polling && pthread_create(&pollThread, NULL, latencyPoller, &test) != 0) {
+        __sync_lock_test_and_set(&test.done, 1);
+        pthread_join(pressThread, NULL);
+        return EXIT_FAILURE;
+    }
+
+    // Frames at a steady 60 fps, like update() and render() between two swaps.
+    uint64_t next = input_ring_now();
+    while (!__sync_fetch_and_add(&test.done, 0)) {
+        if (source == INPUT_POLLING && pollRate == 0) {
+            sampleDevice(&test);
+        }
+
+        gamepad_update(gamepad);
+        gamepad_build(gamepad);
+
+        uint64_t now = input_ring_now();
+        int i;
+        for (i = 0; i < gamepad->edgeCount[source]; ++i) {
+            latency_add(histogram, now - gamepad->edgeTimes[source][i]);
+        }
+
+        next += frame;
+        if (next > now) {
+            sleepNanos(next - now);
+        }
+    }
+
+    pthread_join(pressThread, NULL);
+    if (polling) {
+        pthread_join(pollThread, NULL);
+    }
+    pthread_mutex_destroy(&test.deviceMutex);
+
+    return EXIT_SUCCESS;
+}
+
+int bench_latency(FILE* out, int pollRate, int seconds)
+{
+    static const char* const names[] = { "events", "polling", "press" };
+    Gamepad* gamepad = (Gamepad*)malloc(sizeof(Gamepad));
+    LatencyHistogram histograms[3];
+    DeviceInfo info;
+    int result = EXIT_SUCCESS;
+
+    if (!gamepad || EXIT_SUCCESS != gamepad_init(gamepad, BENCH_WIDTH, BENCH_HEIGHT)) {
+        free(gamepad);
+        return EXIT_FAILURE;
+    }
+
+    memset(&info, 0, sizeof(info));
+    info.gamepad = true;
+    info.buttonCount = 16;
+    strcpy(info.id, "bench-latency");
+
+    GameController* controller = gamepad_attach(gamepad, benchHandle(0), &info);
+    if (!controller
+            || EXIT_SUCCESS != runLatency(gamepad, controller, INPUT_EVENTS, pollRate, false, seconds, &histograms[0])
+            || EXIT_SUCCESS != runLatency(gamepad, controller, INPUT_POLLING, pollRate, false, seconds, &histograms[1])
+            || EXIT_SUCCESS != runLatency(gamepad, controller, INPUT_POLLING, pollRate, true, seconds, &histograms[2])) {
+        result = EXIT_FAILURE;
+    }
+
+    if (result == EXIT_SUCCESS) {
+        if (pollRate > 0) {
+            fprintf(out, "latency to end of frame at %d fps, polling at %d Hz (press includes the wait for the sample):\n", FRAME_RATE, pollRate);
+        } else {
+            fprintf(out, "latency to end of frame at %d fps, polling once per frame (press includes the wait for the sample):\n", FRAME_RATE);
+        }
+        latency_report(out, names, histograms, 3);
+    }
+
+    gamepad_free(gamepad);
+    free(gamepad);
+
+    return result;
+}
+
+// Bit i set if on-screen button i shows one of the device buttons, worked out without the tables.
+static int directButtons(const Profile* profile, int buttons)
+{
+    int mapped = 0;
+    int i;
+    for (i = 0; i < PROFILE_BUTTONS; ++i) {
+        if (profile->buttons[i] >= 0 && (buttons & (1 << profile->buttons[i]))) {
+            mapped |= 1 << i;
+        }
+    }
+
+    return mapped;
+}
+
+static void randomProfile(Profile* profile, unsigned* random, const char* id)
+{
+    memset(profile, 0, sizeof(*profile));
+    snprintf(profile->id, sizeof(profile->id), "%s", id);
+
+    int i;
+    for (i = 0; i < PROFILE_BUTTONS; ++i) {
+        *random ^= *random << 13;
+        *random ^= *random >> 17;
+        *random ^= *random << 5;
+        profile->buttons[i] = (*random % 5 == 0) ? -1 : (int)(*random >> 8) % 32;
+    }
+
+    for (i = 0; i < PROFILE_AXES; ++i) {
+        *random ^= *random << 13;
+        *random ^= *random >> 17;
+        *random ^= *random << 5;
+        profile->axes[i].invert = (*random & 1) != 0;
+        profile->axes[i].scale = (*random >> 1) % (4 * PROFILE_SCALE_ONE);
+        profile->axes[i].deadZone = (*random >> 12) % 64;
+    }
+}
+
+int bench_profiles(FILE* out, const char* path)
+{
+    Gamepad* gamepad = (Gamepad*)malloc(sizeof(Gamepad));
+    ProfileStore loaded;
+    Profile profiles[8];
+    DeviceInfo info;
+    unsigned random = 11;
+    int errors = 0;
+    const int events = 200000;
+    int i, j;
+
+    if (!gamepad || EXIT_SUCCESS != gamepad_init(gamepad, BENCH_WIDTH, BENCH_HEIGHT)) {
+        free(gamepad);
+        return EXIT_FAILURE;
+    }
+
+    memset(&info, 0, sizeof(info));
+    info.gamepad = true;
+    info.analogCount = 2;
+    info.buttonCount = 32;
+
+    // Without a profile every value in range comes through as it is.
+    strcpy(info.id, "bench-default");
+    GameController* controller = gamepad_attach(gamepad, benchHandle(0), &info);
+    if (!controller) {
+        gamepad_free(gamepad);
+        free(gamepad);
+        return EXIT_FAILURE;
+    }
+
+    for (i = -128; i < 256; ++i) {
+        int stick = i < 128 ? i : 127;
+        int analog[3] = { stick, -stick - 1, i < 0 ? -i : i };
+        input_ring_push(&controller->eventRing, input_ring_now(), 0, analog, analog);
+        input_ring_flush(&controller->eventRing);
+        gamepad_update(gamepad);
+        if (controller->analog0[0] != analog[0] || controller->analog0[1] != analog[1] || controller->analog1[2] != analog[2]) {
+            errors++;
+        }
+    }
+    gamepad_detach(gamepad, benchHandle(0));
+
+    // Random profiles, mapped through the tables and worked out directly for the same states.
+    for (j = 0; j < 8; ++j) {
+        char id[64];
+        snprintf(id, sizeof(id), "bench-profile-%d", j);
+        randomProfile(&profiles[j], &random, id);
+        profile_put(&gamepad->profiles, &profiles[j]);
+    }
+
+    for (j = 0; j < 8; ++j) {
+        strcpy(info.id, profiles[j].id);
+        controller = gamepad_attach(gamepad, benchHandle(j), &info);
+
+        for (i = 0; controller && i < 2000; ++i) {
+            random ^= random << 13;
+            random ^= random >> 17;
+            random ^= random << 5;
+
+            int buttons = (int)random;
+            int analog0[3] = { (int)(random >> 4 & 0x1ff) - 300, (int)(random >> 8 & 0xff) - 128, (int)(random >> 16 & 0x1ff) - 20 };
+            int analog1[3] = { -analog0[1], analog0[0], 255 - (int)(random >> 24) };
+
+            input_ring_push(&controller->eventRing, input_ring_now(), buttons, analog0, analog1);
+            input_ring_flush(&controller->eventRing);
+            gamepad_update(gamepad);
+
+            int k;
+            for (k = 0; k < 3; ++k) {
+                if (controller->analog0[k] != profile_map_axis(&profiles[j].axes[k], k == 2, analog0[k])
+                        || controller->analog1[k] != profile_map_axis(&profiles[j].axes[k + 3], k == 2, analog1[k])) {
+                    errors++;
+                }
+            }
+            if (controller->mappedButtons != directButtons(&profiles[j], buttons)) {
+                errors++;
+            }
+        }
+
+        if (!controller) {
+            errors++;
+        }
+    }
+
+    // Remap A on the first player to device button 5: the profile of that device changes and
+    // every other profile stays the same.
+    controller = gamepad->players[0];
+    const Quad* quad = controller->virtualButtons[8].quad;
+    gamepad_touch(gamepad, (int)(quad->x + quad->width / 2), (int)(gamepad->height - quad->y - quad->height / 2));
+    {
+        int centre[3] = { 0, 0, 0 };
+        input_ring_push(&controller->eventRing, input_ring_now(), 1 << 5, centre, centre);
+        input_ring_flush(&controller->eventRing);
+    }
+    gamepad_update(gamepad);
+
+    const Profile* remapped = profile_find(&gamepad->profiles, controller->id);
+    if (!gamepad->profilesChanged || !remapped || remapped->buttons[8] != 5 || !(controller->mappedButtons & (1 << 8))) {
+        errors++;
+    }
+    for (i = 0; i < PROFILE_BUTTONS; ++i) {
+        if (i != 8 && remapped && remapped->buttons[i] == 5) {
+            errors++;
+        }
+    }
+    profiles[0] = *remapped;
+
+    // Everything survives a trip through the file.
+    profile_store_init(&loaded);
+    if (EXIT_SUCCESS != profile_save(&gamepad->profiles, path) || EXIT_SUCCESS != profile_load(&loaded, path)
+            || loaded.count != gamepad->profiles.count) {
+        errors++;
+    } else {
+        for (j = 0; j < 8; ++j) {
+            const Profile* profile = profile_find(&loaded, profiles[j].id);
+            if (!profile || memcmp(profile->buttons, profiles[j].buttons, sizeof(profile->buttons))) {
+                errors++;
+                continue;
+            }
+            for (i = 0; i < PROFILE_AXES; ++i) {
+                if (profile->axes[i].invert != profiles[j].axes[i].invert
+                        || profile->axes[i].scale != profiles[j].axes[i].scale
+                        || profile->axes[i].deadZone != profiles[j].axes[i].deadZone) {
+                    errors++;
+                }
+            }
+        }
+    }
+
+    // Cost of mapping one state: four button lookups and six axis lookups against working it out.
+    uint16_t buttonTable[4][256];
+    int16_t axisTables[PROFILE_AXES][PROFILE_AXIS_VALUES];
+    profile_build_button_table(profiles[1].buttons, buttonTable);
+    for (i = 0; i < PROFILE_AXES; ++i) {
+        profile_build_axis_table(&profiles[1].axes[i], i % 3 == 2, axisTables[i]);
+    }
+
+    volatile unsigned sink = 0;
+    uint64_t start = input_ring_now();
+    for (i = 0; i < events; ++i) {
+        const unsigned bits = (unsigned)i * 2654435761u;
+        int mapped = buttonTable[0][bits & 0xff] | buttonTable[1][bits >> 8 & 0xff]
+                | buttonTable[2][bits >> 16 & 0xff] | buttonTable[3][bits >> 24];
+        for (j = 0; j < PROFILE_AXES; ++j) {
+            mapped += axisTables[j][(bits >> (j * 4)) & 0x1ff];
+        }
+        sink += mapped;
+    }
+    uint64_t tableTime = input_ring_now() - start;
+
+    start = input_ring_now();
+    for (i = 0; i < events; ++i) {
+        const unsigned bits = (unsigned)i * 2654435761u;
+        int mapped = directButtons(&profiles[1], (int)bits);
+        for (j = 0; j < PROFILE_AXES; ++j) {
+            mapped += profile_map_axis(&profiles[1].axes[j], j % 3 == 2, (int)((bits >> (j * 4)) & 0x1ff) + PROFILE_AXIS_MIN);
+        }
+        sink += mapped;
+    }
+    uint64_t directTime = input_ring_now() - start;
+
+    long fileSize = -1;
+    FILE* file = fopen(path, "rb");
+    if (file) {
+        fseek(file, 0, SEEK_END);
+        fileSize = ftell(file);
+        fclose(file);
+    }
+
+    fprintf(out, "profiles: %ld bytes for %d profiles, map %.1f ns per state (computed %.1f ns): %s\n",
+            fileSize, loaded.count,
+            (double)tableTime / events, (double)directTime / events, errors == 0 ? "PASS" : "FAIL");
+
+    remove(path);
+    profile_store_free(&loaded);
+    gamepad_free(gamepad);
+    free(gamepad);
+
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Two rounds through a fixed set of stick settings: a stick position and the expected result.  The second round
+// moves every stick by a few units, so that the changes of at most the jitter threshold are dropped.
+static const StickSettings GOLDEN_STICK_SETTINGS = { 20, { 200, 150 }, 2 };
+static const int GOLDEN_STICKS = 12;
+static const int GOLDEN_STICK_VALUES[2][12][4] = {
+    {
+        { 0, 0, 0, 0 }, { 15, -10, 0, 0 }, { 21, 0, 0, 0 }, { 64, 0, 21, 0 },
+        { 127, 0, 124, 0 }, { -128, 0, -128, 0 }, { 90, 90, 62, 74 }, { -128, -128, -128, -128 },
+        { 0, 64, 0, 33 }, { -40, 30, -7, 9 }, { 300, -300, 126, -128 }, { 5, 120, 0, 113 }
+    },
+    {
+        { 3, -1, 0, 0 }, { 17, -11, 0, 0 }, { 24, -1, 0, 0 }, { 66, -1, 21, 0 },
+        { 130, -1, 124, 0 }, { -126, -1, -128, 0 }, { 93, 89, 68, 75 }, { -126, -129, -128, -128 },
+        { 3, 63, 0, 33 }, { -38, 29, -7, 9 }, { 303, -301, 126, -128 }, { 7, 119, 0, 113 }
+    }
+};
+
+// Settings the vector kernels are compared with the scalar version under.
+static const StickSettings BENCH_STICK_SETTINGS[] = {
+    { 0, { 100, 100 }, 0 },
+    { 24, { 100, 100 }, 0 },
+    { 0, { 200, 150 }, 0 },
+    { 0, { 100, 100 }, 4 },
+    { 16, { 175, 175 }, 3 },
+    { 100, { 10, 1000 }, 255 }
+};
+
+// Fills in random positions, some far out of range, and sometimes just a small step from the last filtered one.
+static void randomSticks(StickBatch* batch, unsigned* random)
+{
+    int i;
+    for (i = 0; i < batch->count; ++i) {
+        *random ^= *random << 13;
+        *random ^= *random >> 17;
+        *random ^= *random << 5;
+
+        if (*random & 0x10000) {
+            batch->x[i] = (int16_t)(batch->lastX[i] + (int)(*random & 7) - 3);
+            batch->y[i] = (int16_t)(batch->lastY[i] + (int)(*random >> 3 & 7) - 3);
+        } else {
+            batch->x[i] = (int16_t)((int)(*random >> 6 & 0x1ff) - 256);
+            batch->y[i] = (int16_t)((int)(*random >> 20 & 0x1ff) - 256);
+        }
+    }
+}
+
+static bool sameSticks(const StickBatch* a, const StickBatch* b)
+{
+    size_t size = a->count * sizeof(int16_t);
+
+    return !memcmp(a->x, b->x, size) && !memcmp(a->y, b->y, size)
+            && !memcmp(a->lastX, b->lastX, size) && !memcmp(a->lastY, b->lastY, size);
+}
+
+int bench_sticks(FILE* out, int sticks)
+{
+    StickProcessor processor;
+    StickBatch vector, scalar;
+    unsigned random = 17;
+    int errors = 0;
+    const int rounds = 200;
+    int i, j, k;
+
+    if (sticks < 1) {
+        sticks = 1;
+    }
+
+    // The fixed checks use up to a row of positions.
+    const int capacity = sticks > 2 * STICK_RANGE ? sticks : 2 * STICK_RANGE;
+    if (EXIT_SUCCESS != stick_batch_init(&vector, capacity) || EXIT_SUCCESS != stick_batch_init(&scalar, capacity)) {
+        stick_batch_free(&vector);
+        return EXIT_FAILURE;
+    }
+
+    // Known results for both kernels.
+    stick_setup(&processor, &GOLDEN_STICK_SETTINGS);
+    for (j = 0; j < 2; ++j) {
+        StickBatch* batch = j ? &scalar : &vector;
+        memset(batch->lastX, 0, GOLDEN_STICKS * sizeof(int16_t));
+        memset(batch->lastY, 0, GOLDEN_STICKS * sizeof(int16_t));
+        batch->count = GOLDEN_STICKS;
+
+        for (k = 0; k < 2; ++k) {
+            for (i = 0; i < GOLDEN_STICKS; ++i) {
+                batch->x[i] = (int16_t)GOLDEN_STICK_VALUES[k][i][0];
+                batch->y[i] = (int16_t)GOLDEN_STICK_VALUES[k][i][1];
+            }
+
+            if (j) {
+                stick_process_scalar(&processor, batch);
+            } else {
+                stick_process(&processor, batch);
+            }
+
+            for (i = 0; i < GOLDEN_STICKS; ++i) {
+                if (batch->x[i] != GOLDEN_STICK_VALUES[k][i][2] || batch->y[i] != GOLDEN_STICK_VALUES[k][i][3]) {
+                    fprintf(out, "sticks: golden %d of round %d gave %d, %d\n", i, k, batch->x[i], batch->y[i]);
+                    errors++;
+                }
+            }
+        }
+    }
+
+    // Without a dead zone, curve or filter every position in range comes through as it is.
+    stick_setup(&processor, &BENCH_STICK_SETTINGS[0]);
+    if (processor.enabled) {
+        errors++;
+    }
+    vector.count = 0;
+    for (i = -STICK_RANGE; i < STICK_RANGE; ++i) {
+        vector.x[vector.count] = (int16_t)i;
+        vector.y[vector.count] = (int16_t)(-1 - i);
+        vector.lastX[vector.count] = vector.lastY[vector.count] = 0;
+        if (++vector.count == vector.capacity || i == STICK_RANGE - 1) {
+            stick_process(&processor, &vector);
+            for (k = 0; k < vector.count; ++k) {
+                if (vector.x[k] != i - vector.count + 1 + k || vector.y[k] != -1 - vector.x[k]) {
+                    errors++;
+                }
+            }
+            vector.count = 0;
+        }
+    }
+
+    // The radial dead zone against the exact formula, anywhere inside the stick's circle.
+    stick_setup(&processor, &BENCH_STICK_SETTINGS[1]);
+    int worst = 0;
+    for (i = -STICK_RANGE; i < STICK_RANGE; ++i) {
+        vector.count = 0;
+        for (j = -STICK_RANGE; j < STICK_RANGE && vector.count < vector.capacity; j += 4) {
+            vector.x[vector.count] = (int16_t)i;
+            vector.y[vector.count] = (int16_t)j;
+            vector.lastX[vector.count] = vector.lastY[vector.count] = 0;
+            vector.count++;
+        }
+        stick_process(&processor, &vector);
+
+        for (k = 0; k < vector.count; ++k) {
+            const double x = i, y = -STICK_RANGE + 4 * k;
+            const double r = sqrt(x * x + y * y);
+            const double deadZone = BENCH_STICK_SETTINGS[1].deadZone;
+            if (r >= STICK_RANGE) {
+                continue;
+            }
+
+            const double gain = r <= deadZone ? 0.0 : (r - deadZone) / (STICK_RANGE - deadZone) * STICK_RANGE / r;
+            const int error = (int)fabs(vector.x[k] - x * gain) + (int)fabs(vector.y[k] - y * gain);
+            if (error > worst) {
+                worst = error;
+            }
+        }
+    }
+    if (worst > 4) {
+        fprintf(out, "sticks: radial dead zone off by up to %d\n", worst);
+        errors++;
+    }
+
+    // The vector kernels against the scalar version, for a full batch and one with a partly used last vector.
+    uint64_t vectorTime = 0, scalarTime = 0;
+    for (j = 0; j < (int)(sizeof(BENCH_STICK_SETTINGS) / sizeof(BENCH_STICK_SETTINGS[0])); ++j) {
+        stick_setup(&processor, &BENCH_STICK_SETTINGS[j]);
+
+        vector.count = scalar.count = (j & 1) && sticks > 3 ? sticks - 3 : sticks;
+        memset(vector.lastX, 0, vector.capacity * sizeof(int16_t));
+        memset(vector.lastY, 0, vector.capacity * sizeof(int16_t));
+        memset(scalar.lastX, 0, scalar.capacity * sizeof(int16_t));
+        memset(scalar.lastY, 0, scalar.capacity * sizeof(int16_t));
+
+        for (k = 0; k < rounds; ++k) {
+            randomSticks(&vector, &random);
+            memcpy(scalar.x, vector.x, vector.count * sizeof(int16_t));
+            memcpy(scalar.y, vector.y, vector.count * sizeof(int16_t));
+
+            uint64_t start = input_ring_now();
+            stick_process(&processor, &vector);
+            vectorTime += input_ring_now() - start;
+
+            start = input_ring_now();
+            stick_process_scalar(&processor, &scalar);
+            scalarTime += input_ring_now() - start;
+
+            if (!sameSticks(&vector, &scalar)) {
+                errors++;
+            }
+        }
+    }
+
+    const double processed = (double)rounds * (sizeof(BENCH_STICK_SETTINGS) / sizeof(BENCH_STICK_SETTINGS[0])) * sticks;
+    fprintf(out, "sticks %d: %s %.2f ns per stick, scalar %.2f ns per stick, radial error at most %d: %s\n",
+            sticks, SIMD_NAME, vectorTime / processed, scalarTime / processed, worst, errors == 0 ? "PASS" : "FAIL");
+
+    stick_batch_free(&vector);
+    stick_batch_free(&scalar);
+
+    return errors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+#ifdef GAMEPAD_BENCH_MAIN
+
+int main(int argc, char** argv)
+{
+    const char* replay = NULL;
+    const char* session = NULL;
+    int players = 0;
+    bool idle = false;
+    int pollRate = -1;
+    const char* profilePath = NULL;
+    int sticks = 0;
+    int rate = BENCH_EVENT_RATE;
+    int seconds = BENCH_SECONDS;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "r:s:p:w:n:il:m:x:h")) != -1) {
+        switch (opt) {
+        case 'r':
+            rate = atoi(optarg);
+            break;
+        case 's':
+            seconds = atoi(optarg);
+            break;
+        case 'p':
+            replay = optarg;
+            break;
+        case 'w':
+            session = optarg;
+            break;
+        case 'n':
+            players = atoi(optarg);
+            break;
+        case 'i':
+            idle = true;
+            break;
+        case 'l':
+            pollRate = atoi(optarg);
+            break;
+        case 'm':
+            profilePath = optarg;
+            break;
+        case 'x':
+            sticks = atoi(optarg);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-r events per second] [-s seconds] [-w recording] [-p recording] [-n players] [-i] [-l poll rate] [-m file] [-x sticks]\n"
+                    "  -w  write a synthetic recording of the given length\n"
+                    "  -p  replay a recording and report the cost per event\n"
+                    "  -n  attach this many controllers and measure lookup, hot-plug and frame cost\n"
+                    "  -i  measure the frame cost with idle controllers, two unless -n is given\n"
+                    "  -l  compare the latency of events and polling at this rate, 0 for once per frame\n"
+                    "  -m  check mapping profiles against direct computation, saving them to file and back\n"
+                    "  -x  check stick processing against the scalar version and time it for this many sticks\n"
+                    "  without -w, -p, -n, -i, -l, -m or -x the input ring stress test is run\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (rate <= 0 || seconds <= 0) {
+        fprintf(stderr, "rate and seconds must be positive\n");
+        return EXIT_FAILURE;
+    }
+
+    if (sticks > 0) {
+        return bench_sticks(stdout, sticks);
+    }
+
+    if (profilePath) {
+        return bench_profiles(stdout, profilePath);
+    }
+
+    if (pollRate >= 0) {
+        return bench_latency(stdout, pollRate, seconds);
+    }
+
+    if (idle) {
+        return bench_idle(stdout, players > 0 ? players : 2);
+    }
+
+    if (players > 0) {
+        return bench_players(stdout, players);
+    }
+
+    if (session && EXIT_SUCCESS != bench_write_session(session, seconds)) {
+        return EXIT_FAILURE;
+    }
+
+    if (replay) {
+        return bench_replay(stdout, replay);
+    }
+
+    if (session) {
+        return EXIT_SUCCESS;
+    }
+
+    return bench_input_ring(stdout, rate, seconds);
+}
+
+#endif
@@ -0,0 +1,131 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdio.h>
+
+// Default load for the input ring stress test.
+#define BENCH_EVENT_RATE 10000
+#define BENCH_SECONDS 2
+
+/**
+ * Stress tests the input ring.  A producer thread pushes controller states
+ * at the given rate, every one of them pressing or releasing a button, while
+ * the calling thread drains the ring once per 60 fps frame the way update()
+ * does.  Prints how many edges were sent and received, how many snapshots
+ * had to be merged and the drain time per frame.
+ *
+ * @param out stream the results are written to
+ * @param rate events per second
+ * @param seconds how long to run
+ * @return EXIT_SUCCESS if every edge arrived in order otherwise EXIT_FAILURE
+ */
+int bench_input_ring(FILE* out, int rate, int seconds);
+
+/**
+ * Writes a synthetic recording: two controllers attached, a stream of stick
+ * moves and button presses at 1000 events per second, a tap that remaps a
+ * button and one controller being removed and attached again.
+ *
+ * @param path where to write the recording
+ * @param seconds length of the recorded session
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int bench_write_session(const char* path, int seconds);
+
+/**
+ * Replays a recording as fast as possible, running gamepad_update() and
+ * gamepad_build() after every event, and prints the average and worst
+ * cost of each per event, and how many bytes of changed geometry render()
+ * would upload per frame.  Text and GL calls are not included.
+ *
+ * @param out stream the results are written to
+ * @param path recording made with GAMEPAD_RECORD or bench_write_session()
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int bench_replay(FILE* out, const char* path);
+
+/**
+ * Attaches the given number of controllers, each with its own state and
+ * button mapping, and measures device lookup through the registry against
+ * a scan of all players.  Checks that handles spaced like heap pointers
+ * need few probes per lookup.  Then removes and re-attaches every other
+ * device a few times, checking that the remaining players keep their
+ * place, state and mapping, and measures update and build per frame with
+ * everyone on screen.
+ *
+ * @param out stream the results are written to
+ * @param players number of controllers to attach
+ * @return EXIT_SUCCESS if no player was disturbed otherwise EXIT_FAILURE
+ */
+int bench_players(FILE* out, int players);
+
+/**
+ * Measures the CPU time of gamepad_update() and gamepad_build() per frame
+ * with attached controllers that send no input, and again with the status
+ * text formatted and the quads set every frame for comparison.  Each is the
+ * median of several runs.
+ *
+ * @param out stream the results are written to
+ * @param players number of idle controllers
+ * @return EXIT_SUCCESS if idle controllers changed no text and no quads otherwise EXIT_FAILURE
+ */
+int bench_idle(FILE* out, int players);
+
+/**
+ * Compares input latency of the event and polling paths.  A thread presses
+ * and releases a simulated button every few milliseconds while frames are
+ * built at 60 fps, and the time from each change to the end of the first
+ * frame showing it is collected, as GAMEPAD_LATENCY does up to the swap.
+ * Polling is measured twice: from the sample, as the app sees it, and from
+ * the simulated press, which includes the wait for the next sample.
+ *
+ * @param out stream the histograms are written to
+ * @param pollRate samples per second of the poll thread, 0 to poll once per frame
+ * @param seconds how long to run each path
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int bench_latency(FILE* out, int pollRate, int seconds);
+
+/**
+ * Checks mapping profiles: values in range pass unchanged without a
+ * profile, states mapped through a controller's tables match the profile
+ * worked out directly, a remap updates only the profile of that device, and
+ * profiles are the same after being saved and loaded again.  Also reports
+ * the cost of mapping a state through the tables and without them.
+ *
+ * @param out stream the results are written to
+ * @param path file the profiles are saved to and loaded from, removed afterwards
+ * @return EXIT_SUCCESS if all checks pass otherwise EXIT_FAILURE
+ */
+int bench_profiles(FILE* out, const char* path);
+
+/**
+ * Checks stick processing: a fixed set of positions gives known results,
+ * positions pass unchanged without settings, the radial dead zone stays
+ * close to the exact formula, and the vector kernels match the scalar
+ * version for random positions under several settings.  Also reports the
+ * cost per stick of both.
+ *
+ * @param out stream the results are written to
+ * @param sticks sticks processed in each batch
+ * @return EXIT_SUCCESS if all checks pass otherwise EXIT_FAILURE
+ */
+int bench_sticks(FILE* out, int sticks);
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,175 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "devicemap.h"
+
+// Size of the first table, must be a power of two.
+static const int INITIAL_CAPACITY = 16;
+
+static unsigned slotOf(const DeviceMap* map, void* handle)
+{
+    // Handles are pointers, so the low bits carry little information.
+    // Fibonacci hashing: multiplying by 2^32 / golden ratio mixes every key
+    // bit into the high bits of the product, which select the slot.  The
+    // low bits of the product only depend on the low bits of the key.
+    uintptr_t key = (uintptr_t)handle;
+    unsigned hash = (unsigned)(key ^ (key >> 16)) * 2654435769u;
+    return hash >> map->shift;
+}
+
+void devicemap_init(DeviceMap* map)
+{
+    memset(map, 0, sizeof(*map));
+}
+
+void devicemap_free(DeviceMap* map)
+{
+    free(map->keys);
+    free(map->values);
+    memset(map, 0, sizeof(*map));
+}
+
+void* devicemap_get(const DeviceMap* map, void* handle)
+{
+    if (!map->count || !handle) {
+        return NULL;
+    }
+
+    unsigned slot = slotOf(map, handle);
+    while (map->keys[slot]) {
+        if (map->keys[slot] == handle) {
+            return map->values[slot];
+        }
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+
+    return NULL;
+}
+
+static int grow(DeviceMap* map)
+{
+    DeviceMap bigger;
+    int i;
+
+    bigger.capacity = map->capacity ? map->capacity * 2 : INITIAL_CAPACITY;
+    bigger.count = 0;
+    bigger.shift = 32;
+    for (i = bigger.capacity; i > 1; i >>= 1) {
+        bigger.shift--;
+    }
+    bigger.keys = (void**)calloc(bigger.capacity, sizeof(void*));
+    bigger.values = (void**)calloc(bigger.capacity, sizeof(void*));
+    if (!bigger.keys || !bigger.values) {
+        free(bigger.keys);
+        free(bigger.values);
+        return EXIT_FAILURE;
+    }
+
+    for (i = 0; i < map->capacity; ++i) {
+        if (map->keys[i]) {
+            devicemap_put(&bigger, map->keys[i], map->values[i]);
+        }
+    }
+
+    devicemap_free(map);
+    *map = bigger;
+
+    return EXIT_SUCCESS;
+}
+
+int devicemap_put(DeviceMap* map, void* handle, void* value)
+{
+    if (!handle) {
+        return EXIT_FAILURE;
+    }
+
+    // Keep the table at most half full so that probe sequences stay short.
+    if ((map->count + 1) * 2 > map->capacity && EXIT_SUCCESS != grow(map)) {
+        return EXIT_FAILURE;
+    }
+
+    unsigned slot = slotOf(map, handle);
+    while (map->keys[slot] && map->keys[slot] != handle) {
+        slot = (slot + 1) & (map->capacity - 1);
+    }
+
+    if (!map->keys[slot]) {
+        map->keys[slot] = handle;
+        map->count++;
+    }
+    map->values[slot] = value;
+
+    return EXIT_SUCCESS;
+}
+
+void devicemap_remove(DeviceMap* map, void* handle)
+{
+    const unsigned mask = map->capacity - 1;
+
+    if (!map->count || !handle) {
+        return;
+    }
+
+    unsigned slot = slotOf(map, handle);
+    while (map->keys[slot] != handle) {
+        if (!map->keys[slot]) {
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+
+    // Move later members of the cluster back into the hole if their probe
+    // sequence passes over it, so every key stays reachable from its home slot.
+    unsigned hole = slot;
+    unsigned next = (slot + 1) & mask;
+    while (map->keys[next]) {
+        unsigned home = slotOf(map, map->keys[next]);
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            map->keys[hole] = map->keys[next];
+            map->values[hole] = map->values[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+
+    map->keys[hole] = NULL;
+    map->values[hole] = NULL;
+    map->count--;
+}
+
+int devicemap_probes(const DeviceMap* map, int* longest)
+{
+    const unsigned mask = map->capacity - 1;
+    int total = 0;
+    int i;
+
+    *longest = 0;
+    for (i = 0; i < map->capacity; ++i) {
+        if (map->keys[i]) {
+            int probes = (int)((i - slotOf(map, map->keys[i])) & mask) + 1;
+            total += probes;
+            if (probes > *longest) {
+                *longest = probes;
+            }
+        }
+    }
+
+    return total;
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEVICEMAP_H_
+#define DEVICEMAP_H_
+
+/**
+ * Hash map from device handles to the objects representing them, so that
+ * an input event can find its controller in constant time however many
+ * controllers are attached.
+ *
+ * Open addressing with linear probing.  The table is kept at most half
+ * full and entries are removed by shifting the rest of their cluster back,
+ * so lookups never have to skip deleted slots.
+ */
+typedef struct DeviceMap_t {
+    void** keys;
+    void** values;
+    int capacity;
+    int count;
+    // 32 minus log2(capacity), the hash bits that are not part of a slot.
+    int shift;
+} DeviceMap;
+
+/**
+ * Initializes an empty map.
+ */
+void devicemap_init(DeviceMap* map);
+
+/**
+ * Releases the memory used by a map.
+ */
+void devicemap_free(DeviceMap* map);
+
+/**
+ * Returns the value stored for a handle, or NULL.
+ */
+void* devicemap_get(const DeviceMap* map, void* handle);
+
+/**
+ * Stores a value for a non-NULL handle, replacing any previous value.
+ *
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int devicemap_put(DeviceMap* map, void* handle, void* value);
+
+/**
+ * Removes a handle from the map, if present.
+ */
+void devicemap_remove(DeviceMap* map, void* handle);
+
+/**
+ * Counts the slots a lookup of each stored handle looks at.
+ *
+ * @param longest set to the most slots looked at for any one handle
+ * @return the number of slots looked at summed over all handles
+ */
+int devicemap_probes(const DeviceMap* map, int* longest);
+
+#endif /* DEVICEMAP_H_ */
@@ -0,0 +1,1016 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __QNX__
+#include <screen/screen.h>
+#else
+// Game button bits as defined by libscreen, so that recorded sessions can be replayed on other systems.
+enum {
+    SCREEN_A_GAME_BUTTON = (1 << 0),
+    SCREEN_B_GAME_BUTTON = (1 << 1),
+    SCREEN_C_GAME_BUTTON = (1 << 2),
+    SCREEN_X_GAME_BUTTON = (1 << 3),
+    SCREEN_Y_GAME_BUTTON = (1 << 4),
+    SCREEN_Z_GAME_BUTTON = (1 << 5),
+    SCREEN_MENU1_GAME_BUTTON = (1 << 6),
+    SCREEN_MENU2_GAME_BUTTON = (1 << 7),
+    SCREEN_MENU3_GAME_BUTTON = (1 << 8),
+    SCREEN_MENU4_GAME_BUTTON = (1 << 9),
+    SCREEN_L1_GAME_BUTTON = (1 << 10),
+    SCREEN_L2_GAME_BUTTON = (1 << 11),
+    SCREEN_L3_GAME_BUTTON = (1 << 12),
+    SCREEN_R1_GAME_BUTTON = (1 << 13),
+    SCREEN_R2_GAME_BUTTON = (1 << 14),
+    SCREEN_R3_GAME_BUTTON = (1 << 15),
+    SCREEN_DPAD_UP_GAME_BUTTON = (1 << 16),
+    SCREEN_DPAD_DOWN_GAME_BUTTON = (1 << 17),
+    SCREEN_DPAD_LEFT_GAME_BUTTON = (1 << 18),
+    SCREEN_DPAD_RIGHT_GAME_BUTTON = (1 << 19)
+};
+#endif
+
+#include "gamepad.h"
+
+// Size and positions of all the controls.
+static const float ANALOG0_X = 75.0f;
+static const float ANALOG1_X  = 460.0f;
+static const float ANALOG_Y = 75.0f;
+static const float ANALOG_SIZE = 100.0f;
+
+static const float DPAD_X = 25.0f;
+static const float DPAD_Y = 275.0f;
+static const float DPAD_LONG = 112.5f;
+static const float DPAD_SHORT = 75.0f;
+
+static const float BUTTONS_X = 400.0f;
+static const float BUTTONS_Y = 275.0f;
+static const float BUTTON_SIZE = 75.0f;
+
+static const float LEFT_TRIGGERS_X = 25.0f;
+static const float RIGHT_TRIGGERS_X = 450.0f;
+static const float TRIGGERS_Y = 525.0f;
+static const float TRIGGER_WIDTH = 175.0f;
+static const float TRIGGER_HEIGHT = 50.0f;
+
+static const float SELECT_X = 237.5f;
+static const float SELECT_Y = 475.0f;
+
+// Size of the area the controls above were designed for.  Players are
+// scaled down when their share of the screen is smaller than this.
+static const float PLAYER_WIDTH = 640.0f;
+static const float PLAYER_HEIGHT = 768.0f;
+
+// Changed quads at most this far apart are uploaded together, one more
+// call to update a buffer costs more than the few bytes in between.
+static const int DIRTY_MERGE_GAP = 4;
+
+// The device button shown by each on-screen button when a device has no profile, in the order of initButtons().
+static const int _defaultMappings[MAX_BUTTONS] = {
+    SCREEN_L2_GAME_BUTTON, SCREEN_R2_GAME_BUTTON, SCREEN_R3_GAME_BUTTON, SCREEN_L3_GAME_BUTTON,
+    SCREEN_DPAD_UP_GAME_BUTTON, SCREEN_DPAD_DOWN_GAME_BUTTON, SCREEN_DPAD_LEFT_GAME_BUTTON, SCREEN_DPAD_RIGHT_GAME_BUTTON,
+    SCREEN_A_GAME_BUTTON, SCREEN_B_GAME_BUTTON, SCREEN_X_GAME_BUTTON, SCREEN_Y_GAME_BUTTON,
+    SCREEN_L1_GAME_BUTTON, SCREEN_R1_GAME_BUTTON, SCREEN_MENU1_GAME_BUTTON, SCREEN_MENU2_GAME_BUTTON
+};
+
+// Texture coordinates for each image in our texture atlas.
+static const float _outerUVs[4] = { 0.0f, 1.0f, 0.25f, 0.75f };
+static const float _innerUVs[4] = { 0.25f, 1.0f, 0.5f, 0.75f };
+static const float _buttonDownUVs[4] = { 0.0f, 0.7109375f, 0.166015625f, 0.544921875f };
+static const float _buttonUpUVs[4] = { 0.166015625f, 0.7109375f, 0.33203125f, 0.544921875f };
+static const float _triggerDownUVs[4] = { 0.0f, 0.51171875f, 0.1474609375f, 0.466796875f };
+static const float _triggerUpUVs[4] = { 0.17578125f, 0.51171875f, 0.3232421875f, 0.466796875f };
+static const float _upDPadDownUVs[4] = { 0.0f, 0.267578125f, 0.1005859375f, 0.1201171875f };
+static const float _upDPadUpUVs[4] = { 0.390625f, 0.267578125f, 0.4912109375f, 0.1201171875f };
+static const float _downDPadDownUVs[4] = { 0.17578125f, 0.267578125f, 0.2763671875f, 0.1201171875f };
+static const float _downDPadUpUVs[4] = { 0.56640625f, 0.267578125f, 0.6669921875f, 0.1201171875f };
+static const float _leftDPadDownUVs[4] = { 0.0f, 0.4140625f, 0.1474609375f, 0.3125f };
+static const float _leftDPadUpUVs[4] = { 0.390625f, 0.4140625f, 0.5380859375f, 0.3125f };
+static const float _rightDPadDownUVs[4] = { 0.17578125f, 0.4140625f, 0.3232421875f, 0.3125f };
+static const float _rightDPadUpUVs[4] = { 0.56640625f, 0.4140625f, 0.7138671875f, 0.3125f } ;
+
+// Index of the single bit set in a button mapping, or -1 for no mapping.
+static int mappingBit(int mapping)
+{
+    int bit;
+    for (bit = 0; bit < 32; ++bit) {
+        if (mapping == (int)(1u << bit)) {
+            return bit;
+        }
+    }
+
+    return -1;
+}
+
+static void defaultProfile(Profile* profile, const char* id)
+{
+    memset(profile, 0, sizeof(*profile));
+    strncpy(profile->id, id, sizeof(profile->id) - 1);
+
+    int i;
+    for (i = 0; i < MAX_BUTTONS; ++i) {
+        profile->buttons[i] = mappingBit(_defaultMappings[i]);
+    }
+
+    for (i = 0; i < PROFILE_AXES; ++i) {
+        profile->axes[i].invert = false;
+        profile->axes[i].scale = PROFILE_SCALE_ONE;
+        profile->axes[i].deadZone = 0;
+    }
+}
+
+// Bit i of the result is set if on-screen button i shows one of the given device buttons.
+static int mapButtons(const GameController* controller, int buttons)
+{
+    const unsigned bits = (unsigned)buttons;
+
+    return controller->buttonTable[0][bits & 0xff] | controller->buttonTable[1][bits >> 8 & 0xff]
+            | controller->buttonTable[2][bits >> 16 & 0xff] | controller->buttonTable[3][bits >> 24];
+}
+
+static int mapAxis(const int16_t* table, int raw)
+{
+    int index = raw - PROFILE_AXIS_MIN;
+    if (index < 0) {
+        index = 0;
+    } else if (index >= PROFILE_AXIS_VALUES) {
+        index = PROFILE_AXIS_VALUES - 1;
+    }
+
+    return table[index];
+}
+
+static void applyProfile(GameController* controller, const Profile* profile)
+{
+    int i;
+    for (i = 0; i < MAX_BUTTONS; ++i) {
+        const int bit = profile->buttons[i];
+        controller->virtualButtons[i].mapping = (bit >= 0 && bit < 32) ? (int)(1u << bit) : 0;
+    }
+
+    // The third axis of each stick is its trigger.
+    for (i = 0; i < PROFILE_AXES; ++i) {
+        controller->axes[i] = profile->axes[i];
+        profile_build_axis_table(&profile->axes[i], i % 3 == 2, controller->axisTables[i]);
+    }
+
+    profile_build_button_table(profile->buttons, controller->buttonTable);
+    controller->mappedButtons = mapButtons(controller, controller->buttons);
+    controller->mappedPressed = mapButtons(controller, controller->pressed);
+}
+
+// Stores the current mappings of a controller as the profile of its device, and applies them.
+static void storeProfile(Gamepad* gamepad, GameController* controller)
+{
+    Profile profile;
+
+    memset(&profile, 0, sizeof(profile));
+    memcpy(profile.id, controller->id, sizeof(profile.id));
+
+    int i;
+    for (i = 0; i < MAX_BUTTONS; ++i) {
+        profile.buttons[i] = mappingBit(controller->virtualButtons[i].mapping);
+    }
+    memcpy(profile.axes, controller->axes, sizeof(profile.axes));
+
+    applyProfile(controller, &profile);
+
+    if (EXIT_SUCCESS == profile_put(&gamepad->profiles, &profile)) {
+        gamepad->profilesChanged = true;
+    }
+}
+
+static void initController(GameController* controller)
+{
+    // Initialize controller values.
+    controller->handle = 0;
+    controller->gamepad = false;
+    controller->analogCount = 0;
+    controller->buttonCount = 0;
+    controller->buttons = 0;
+    controller->analog0[0] = controller->analog0[1] = controller->analog0[2] = 0;
+    controller->analog1[0] = controller->analog1[1] = controller->analog1[2] = 0;
+    controller->pressed = 0;
+    memset(controller->stickLast, 0, sizeof(controller->stickLast));
+    controller->activeButton = NULL;
+    controller->textValid = false;
+    input_ring_init(&controller->eventRing);
+    input_ring_init(&controller->pollRing);
+    sprintf(controller->deviceString, "Player %d: No device detected.", controller->player + 1);
+
+    Profile profile;
+    defaultProfile(&profile, "");
+    applyProfile(controller, &profile);
+}
+
+static void initButtons(GameController* controller)
+{
+    /**
+     * Quads  | Buttons  | Description
+     * =======|==========|=============
+     * 0, 1   | 0, 1     | Analog triggers.
+     * 2-7    | 2, 3     | Analog sticks and their buttons.
+     * 8-11   | 4 - 7    | D-Pad.  Up, Down, Left, Right.
+     * 12-15  | 8 - 11   | A, B, X, Y Buttons.
+     * 16, 17 | 12, 13   | Triggers: L1, R1
+     * 18, 19 | 14, 15   | Select, Start.
+     */
+    Quad* quads = controller->quads;
+    Button* buttons = controller->virtualButtons;
+
+    int j;
+    // Assign quads to all buttons other than L2, R2, L3 and R3.
+    for (j = 4; j < 16; ++j) {
+        buttons[j].quad = &quads[j+4];
+    }
+
+    // D-Pad.
+    for (j = 4; j < 8; ++j) {
+        buttons[j].type = DPAD_UP + j-4;
+    }
+
+    // Buttons.
+    for (j = 8; j < 12; ++j) {
+        buttons[j].type = BUTTON;
+        buttons[j].quad->uvs = _buttonUpUVs;
+    }
+
+    // Triggers.
+    for (j = 12; j < 16; ++j) {
+        buttons[j].type = DIGITAL_TRIGGER;
+        buttons[j].quad->uvs = _triggerUpUVs;
+    }
+
+    // Analog triggers
+    buttons[0].label = "L2";
+    buttons[0].type = ANALOG_TRIGGER;
+    buttons[0].quad = &quads[0];
+    buttons[0].quad->uvs = _triggerDownUVs;
+
+    buttons[1].label = "R2";
+    buttons[1].type = ANALOG_TRIGGER;
+    buttons[1].quad = &quads[1];
+    buttons[1].quad->uvs = _triggerDownUVs;
+
+    // Right stick
+    quads[2].uvs = _outerUVs;
+    controller->analog1Inner = &quads[3];
+    controller->analog1Inner->uvs = _innerUVs;
+
+    // R3
+    buttons[2].label = "R3";
+    buttons[2].type = BUTTON;
+    buttons[2].quad = &quads[4];
+    buttons[2].quad->uvs = _buttonUpUVs;
+
+    // Left stick
+    quads[5].uvs = _outerUVs;
+    controller->analog0Inner = &quads[6];
+    controller->analog0Inner->uvs = _innerUVs;
+
+    // L3
+    buttons[3].label = "L3";
+    buttons[3].type = BUTTON;
+    buttons[3].quad = &quads[7];
+    buttons[3].quad->uvs = _buttonUpUVs;
+
+    // D-Pad
+    buttons[4].label = "U";
+    buttons[4].quad->uvs = _upDPadUpUVs;
+
+    buttons[5].label = "D";
+    buttons[5].quad->uvs = _downDPadUpUVs;
+
+    buttons[6].label = "L";
+    buttons[6].quad->uvs = _leftDPadUpUVs;
+
+    buttons[7].label = "R";
+    buttons[7].quad->uvs = _rightDPadUpUVs;
+
+    // A, B, X, Y
+    buttons[8].label = "A";
+
+    buttons[9].label = "B";
+
+    buttons[10].label = "X";
+
+    buttons[11].label = "Y";
+
+    // L1, R1
+    buttons[12].label = "L1";
+
+    buttons[13].label = "R1";
+
+    // Select, Start
+    buttons[14].label = "Select";
+
+    buttons[15].label = "Start";
+}
+
+static void place(const GameController* controller, Quad* quad, float x, float y, float width, float height)
+{
+    quad->x = controller->left + x * controller->scale;
+    quad->y = controller->bottom + y * controller->scale;
+    quad->width = width * controller->scale;
+    quad->height = height * controller->scale;
+}
+
+static void layoutController(GameController* controller)
+{
+    Quad* quads = controller->quads;
+
+    // Analog triggers
+    place(controller, &quads[0], LEFT_TRIGGERS_X, TRIGGERS_Y + TRIGGER_HEIGHT + 25.0f, TRIGGER_WIDTH, TRIGGER_HEIGHT);
+    place(controller, &quads[1], RIGHT_TRIGGERS_X, TRIGGERS_Y + TRIGGER_HEIGHT + 25.0f, TRIGGER_WIDTH, TRIGGER_HEIGHT);
+
+    // Right stick and R3
+    place(controller, &quads[2], ANALOG1_X, ANALOG_Y, ANALOG_SIZE, ANALOG_SIZE);
+    place(controller, &quads[3], ANALOG1_X, ANALOG_Y, ANALOG_SIZE, ANALOG_SIZE);
+    place(controller, &quads[4], ANALOG1_X - BUTTON_SIZE*2.0f, ANALOG_Y + BUTTON_SIZE, BUTTON_SIZE, BUTTON_SIZE);
+
+    // Left stick and L3
+    place(controller, &quads[5], ANALOG0_X, ANALOG_Y, ANALOG_SIZE, ANALOG_SIZE);
+    place(controller, &quads[6], ANALOG0_X, ANALOG_Y, ANALOG_SIZE, ANALOG_SIZE);
+    place(controller, &quads[7], ANALOG0_X + BUTTON_SIZE*2.0f, ANALOG_Y + BUTTON_SIZE, BUTTON_SIZE, BUTTON_SIZE);
+
+    // Up, Down, Left, Right
+    place(controller, &quads[8], DPAD_X + DPAD_SHORT, DPAD_Y + DPAD_LONG, DPAD_SHORT, DPAD_LONG);
+    place(controller, &quads[9], DPAD_X + DPAD_SHORT, DPAD_Y, DPAD_SHORT, DPAD_LONG);
+    place(controller, &quads[10], DPAD_X, DPAD_Y + DPAD_SHORT, DPAD_LONG, DPAD_SHORT);
+    place(controller, &quads[11], DPAD_X + DPAD_LONG, DPAD_Y + DPAD_SHORT, DPAD_LONG, DPAD_SHORT);
+
+    // A, B, X, Y
+    place(controller, &quads[12], BUTTONS_X + BUTTON_SIZE, BUTTONS_Y, BUTTON_SIZE, BUTTON_SIZE);
+    place(controller, &quads[13], BUTTONS_X + 2*BUTTON_SIZE, BUTTONS_Y + BUTTON_SIZE, BUTTON_SIZE, BUTTON_SIZE);
+    place(controller, &quads[14], BUTTONS_X, BUTTONS_Y + BUTTON_SIZE, BUTTON_SIZE, BUTTON_SIZE);
+    place(controller, &quads[15], BUTTONS_X + BUTTON_SIZE, BUTTONS_Y + 2*BUTTON_SIZE, BUTTON_SIZE, BUTTON_SIZE);
+
+    // L1, R1
+    place(controller, &quads[16], LEFT_TRIGGERS_X, TRIGGERS_Y, TRIGGER_WIDTH, TRIGGER_HEIGHT);
+    place(controller, &quads[17], RIGHT_TRIGGERS_X, TRIGGERS_Y, TRIGGER_WIDTH, TRIGGER_HEIGHT);
+
+    // Select, Start
+    place(controller, &quads[18], SELECT_X, SELECT_Y, TRIGGER_WIDTH, TRIGGER_HEIGHT);
+    place(controller, &quads[19], SELECT_X, SELECT_Y + TRIGGER_HEIGHT + 25.0f, TRIGGER_WIDTH, TRIGGER_HEIGHT);
+}
+
+static int reserveGeometry(Gamepad* gamepad, int quadCount)
+{
+    if (quadCount > gamepad->quadCapacity) {
+        // The last index of every quad refers to the first vertex of the next one,
+        // so one spare vertex keeps the final quad's index in range.
+        float* vertices = (float*)realloc(gamepad->vertices, (quadCount * QUAD_VERTEX_COORDS + 2) * sizeof(float));
+        if (!vertices) {
+            return EXIT_FAILURE;
+        }
+        gamepad->vertices = vertices;
+
+        float* textureCoords = (float*)realloc(gamepad->textureCoords, (quadCount * QUAD_TEXCOORDS + 2) * sizeof(float));
+        if (!textureCoords) {
+            return EXIT_FAILURE;
+        }
+        gamepad->textureCoords = textureCoords;
+
+        unsigned short* indices = (unsigned short*)realloc(gamepad->indices, quadCount * QUAD_INDICES * sizeof(unsigned short));
+        if (!indices) {
+            return EXIT_FAILURE;
+        }
+        gamepad->indices = indices;
+
+        // At worst every quad is a run of its own.
+        int* dirtyRuns = (int*)realloc(gamepad->dirtyRuns, quadCount * 2 * sizeof(int));
+        if (!dirtyRuns) {
+            return EXIT_FAILURE;
+        }
+        gamepad->dirtyRuns = dirtyRuns;
+        gamepad->dirtyRunCount = 0;
+        gamepad->dirtyQuads = 0;
+
+        // Cleared arrays make every quad differ from what gamepad_build() computes, so all are sent again.
+        memset(vertices, 0, (quadCount * QUAD_VERTEX_COORDS + 2) * sizeof(float));
+        memset(textureCoords, 0, (quadCount * QUAD_TEXCOORDS + 2) * sizeof(float));
+
+        // Each quad is a strip of 4 vertices, joined to the next by a degenerate triangle.
+        int i;
+        for (i = 0; i < quadCount; ++i) {
+            int vertexCount = i*4;
+            indices[i*6] = vertexCount;
+            indices[i*6 + 1] = 1 + vertexCount;
+            indices[i*6 + 2] = 2 + vertexCount;
+            indices[i*6 + 3] = 3 + vertexCount;
+            indices[i*6 + 4] = 3 + vertexCount;
+            indices[i*6 + 5] = 4 + vertexCount;
+        }
+
+        gamepad->quadCapacity = quadCount;
+    }
+
+    gamepad->quadCount = quadCount;
+
+    return EXIT_SUCCESS;
+}
+
+static void layout(Gamepad* gamepad)
+{
+    // Two players side by side, as the controls were designed for, or a
+    // roughly square grid once there are more.
+    int columns = MIN_PLAYERS;
+    while (columns * columns < gamepad->playerCount) {
+        ++columns;
+    }
+    int rows = (gamepad->playerCount + columns - 1) / columns;
+
+    float cellWidth = gamepad->width / columns;
+    float cellHeight = gamepad->height / rows;
+    float scale = fminf(1.0f, fminf(cellWidth / PLAYER_WIDTH, cellHeight / PLAYER_HEIGHT));
+
+    int i;
+    for (i = 0; i < gamepad->playerCount; ++i) {
+        GameController* controller = gamepad->players[i];
+
+        controller->cellWidth = cellWidth;
+        controller->cellHeight = cellHeight;
+        controller->scale = scale;
+        controller->left = cellWidth * (i % columns);
+        controller->bottom = gamepad->height - cellHeight * (i / columns + 1);
+        controller->textValid = false;
+        layoutController(controller);
+    }
+
+    // Finally, one last quad is used for the "polling" button.
+    Quad* pollingQuad = &gamepad->pollingQuad;
+    pollingQuad->x = (gamepad->width * 0.5f) - TRIGGER_WIDTH * 0.5f;
+    pollingQuad->y = 5.0f;
+    pollingQuad->width = TRIGGER_WIDTH;
+    pollingQuad->height = TRIGGER_HEIGHT + 20;
+
+    gamepad->quadsChanged = true;
+}
+
+static GameController* addPlayer(Gamepad* gamepad)
+{
+    if (gamepad->playerCount == MAX_PLAYERS) {
+        return NULL;
+    }
+
+    if (gamepad->playerCount == gamepad->playerCapacity) {
+        int capacity = gamepad->playerCapacity ? gamepad->playerCapacity * 2 : MIN_PLAYERS;
+        GameController** players = (GameController**)realloc(gamepad->players, capacity * sizeof(GameController*));
+        if (!players) {
+            return NULL;
+        }
+        gamepad->players = players;
+        gamepad->playerCapacity = capacity;
+    }
+
+    if (EXIT_SUCCESS != reserveGeometry(gamepad, (gamepad->playerCount + 1) * PLAYER_QUADS + 1)) {
+        return NULL;
+    }
+
+    GameController* controller = (GameController*)calloc(1, sizeof(GameController));
+    if (!controller) {
+        return NULL;
+    }
+
+    controller->player = gamepad->playerCount;
+    initController(controller);
+    initButtons(controller);
+
+    gamepad->players[gamepad->playerCount++] = controller;
+    layout(gamepad);
+
+    return controller;
+}
+
+int gamepad_init(Gamepad* gamepad, float width, float height)
+{
+    memset(gamepad, 0, sizeof(*gamepad));
+    gamepad->width = width;
+    gamepad->height = height;
+    gamepad->polling = false;
+    devicemap_init(&gamepad->devices);
+    profile_store_init(&gamepad->profiles);
+
+    // Populate an array of button mappings.
+    int i;
+    for (i = 0; i < 32; ++i) {
+        gamepad->buttonMappings[i] = 1 << i;
+    }
+
+    gamepad->pollingQuad.uvs = _triggerUpUVs;
+    gamepad->pollingButton.quad = &gamepad->pollingQuad;
+    gamepad->pollingButton.type = DIGITAL_TRIGGER;
+    gamepad->pollingButton.label = "Polling";
+
+    // Set the initial positions of all joysticks and buttons.
+    for (i = 0; i < MIN_PLAYERS; ++i) {
+        if (!addPlayer(gamepad)) {
+            gamepad_free(gamepad);
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void gamepad_free(Gamepad* gamepad)
+{
+    int i;
+    for (i = 0; i < gamepad->playerCount; ++i) {
+        free(gamepad->players[i]);
+    }
+
+    free(gamepad->players);
+    free(gamepad->vertices);
+    free(gamepad->textureCoords);
+    free(gamepad->indices);
+    free(gamepad->dirtyRuns);
+    devicemap_free(&gamepad->devices);
+    profile_store_free(&gamepad->profiles);
+
+    gamepad->players = NULL;
+    gamepad->playerCount = gamepad->playerCapacity = 0;
+    gamepad->vertices = gamepad->textureCoords = NULL;
+    gamepad->indices = NULL;
+    gamepad->quadCount = gamepad->quadCapacity = 0;
+    gamepad->dirtyRuns = NULL;
+    gamepad->dirtyRunCount = gamepad->dirtyQuads = 0;
+}
+
+GameController* gamepad_find(Gamepad* gamepad, void* handle)
+{
+    return (GameController*)devicemap_get(&gamepad->devices, handle);
+}
+
+GameController* gamepad_attach(Gamepad* gamepad, void* handle, const DeviceInfo* info)
+{
+    if (!handle) {
+        return NULL;
+    }
+
+    // A device that is already attached keeps its player.
+    GameController* controller = gamepad_find(gamepad, handle);
+    if (controller) {
+        return controller;
+    }
+
+    int i;
+    for (i = 0; i < gamepad->playerCount && !controller; ++i) {
+        if (!gamepad->players[i]->handle) {
+            controller = gamepad->players[i];
+        }
+    }
+
+    if (!controller) {
+        controller = addPlayer(gamepad);
+        if (!controller) {
+            return NULL;
+        }
+    }
+
+    if (EXIT_SUCCESS != devicemap_put(&gamepad->devices, handle, controller)) {
+        return NULL;
+    }
+
+    controller->handle = handle;
+    controller->gamepad = info->gamepad;
+    controller->analogCount = info->analogCount;
+    controller->buttonCount = info->buttonCount;
+    memcpy(controller->id, info->id, sizeof(controller->id));
+    controller->id[sizeof(controller->id) - 1] = '\0';
+    controller->textValid = false;
+
+    // Devices of the same kind share a profile.
+    const Profile* profile = profile_find(&gamepad->profiles, controller->id);
+    if (profile) {
+        applyProfile(controller, profile);
+    } else {
+        Profile defaults;
+        defaultProfile(&defaults, controller->id);
+        applyProfile(controller, &defaults);
+    }
+
+    if (controller->gamepad) {
+        sprintf(controller->deviceString, "Gamepad device ID: %s", info->id);
+    } else {
+        sprintf(controller->deviceString, "Joystick device: %s", info->id);
+    }
+
+    return controller;
+}
+
+void gamepad_detach(Gamepad* gamepad, void* handle)
+{
+    GameController* controller = gamepad_find(gamepad, handle);
+    if (!controller) {
+        return;
+    }
+
+    devicemap_remove(&gamepad->devices, handle);
+    initController(controller);
+
+    // Give back the space of free players at the end, so the others can grow again.
+    int playerCount = gamepad->playerCount;
+    while (gamepad->playerCount > MIN_PLAYERS && !gamepad->players[gamepad->playerCount - 1]->handle) {
+        free(gamepad->players[--gamepad->playerCount]);
+    }
+
+    if (playerCount != gamepad->playerCount) {
+        gamepad->quadCount = gamepad->playerCount * PLAYER_QUADS + 1;
+        layout(gamepad);
+    }
+}
+
+bool gamepad_connected(const Gamepad* gamepad)
+{
+    return gamepad->devices.count > 0;
+}
+
+void gamepad_touch(Gamepad* gamepad, int x, int y)
+{
+    y = gamepad->height - y;
+
+    int i;
+    for (i = 0; i < gamepad->playerCount; ++i) {
+        GameController* controller = gamepad->players[i];
+        bool buttonTapped = false;
+
+        int j;
+        for (j = 0; j < MAX_BUTTONS; ++j) {
+            Button* button = &controller->virtualButtons[j];
+            Quad* quad = button->quad;
+
+            // Detect that a button was tapped.
+            if (x > quad->x && x < quad->x + quad->width &&
+                y > quad->y && y < quad->y + quad->height) {
+                controller->activeButton = button;
+                buttonTapped = true;
+                break;
+            }
+        }
+
+        if (controller->activeButton && !buttonTapped) {
+            // Cancel the button's active state.
+            controller->activeButton = NULL;
+        }
+    }
+
+    // The polling button is used to switch between handling all device events and polling devices.
+    Quad* quad = gamepad->pollingButton.quad;
+    if (x > quad->x && x < quad->x + quad->width &&
+        y > quad->y && y < quad->y + quad->height) {
+        gamepad->polling = !gamepad->polling;
+
+        // The polling button lights up when polling is enabled.
+        if (gamepad->polling) {
+            quad->uvs = _triggerDownUVs;
+        } else {
+            quad->uvs = _triggerUpUVs;
+        }
+        gamepad->quadsChanged = true;
+    }
+}
+
+// Writes value right-aligned in a field of at least width characters, like "%*d", and returns the end.
+static char* formatInt(char* out, int value, int width)
+{
+    char digits[12];
+    unsigned magnitude = value < 0 ? 0u - (unsigned)value : (unsigned)value;
+    int count = 0;
+
+    do {
+        digits[count++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude);
+
+    if (value < 0) {
+        digits[count++] = '-';
+    }
+
+    for (; width > count; --width) {
+        *out++ = ' ';
+    }
+
+    while (count) {
+        *out++ = digits[--count];
+    }
+
+    return out;
+}
+
+// Same as sprintf(out, "%s(%4d, %4d, %4d)", prefix, analog[0], analog[1], analog[2]).
+static void formatAnalog(char* out, const char* prefix, const int analog[3])
+{
+    size_t length = strlen(prefix);
+    memcpy(out, prefix, length);
+    out += length;
+
+    *out++ = '(';
+    out = formatInt(out, analog[0], 4);
+    *out++ = ',';
+    *out++ = ' ';
+    out = formatInt(out, analog[1], 4);
+    *out++ = ',';
+    *out++ = ' ';
+    out = formatInt(out, analog[2], 4);
+    *out++ = ')';
+    *out = '\0';
+}
+
+static void updateText(Gamepad* gamepad, GameController* controller, int buttons)
+{
+    // Formatting is only needed when what the text shows has changed, which for an idle controller is never.
+    bool changed = false;
+
+    if (!controller->textValid || memcmp(controller->shownAnalog0, controller->analog0, sizeof(controller->analog0))) {
+        if (controller->analogCount > 0) {
+            formatAnalog(controller->analog0String, "Analog 0: ", controller->analog0);
+        } else {
+            strcpy(controller->analog0String, "Analog 0: N/A");
+        }
+        memcpy(controller->shownAnalog0, controller->analog0, sizeof(controller->analog0));
+        changed = true;
+    }
+
+    if (!controller->textValid || memcmp(controller->shownAnalog1, controller->analog1, sizeof(controller->analog1))) {
+        if (controller->analogCount == 2) {
+            formatAnalog(controller->analog1String, "Analog 1: ", controller->analog1);
+        } else {
+            strcpy(controller->analog1String, "Analog 1: N/A");
+        }
+        memcpy(controller->shownAnalog1, controller->analog1, sizeof(controller->analog1));
+        changed = true;
+    }
+
+    if (!controller->textValid || controller->shownButtons != buttons) {
+        // List the indices of the buttons that are pressed, regardless of whether or not the buttons are mapped.
+        char* out = controller->buttonsString;
+        memcpy(out, "Buttons: ", 9);
+        out += 9;
+
+        int j;
+        for (j = 0; j < controller->buttonCount; ++j) {
+            if (gamepad->buttonMappings[j] & buttons) {
+                out = formatInt(out, j, 0);
+                *out++ = ' ';
+            }
+        }
+        *out = '\0';
+
+        controller->shownButtons = buttons;
+        changed = true;
+    }
+
+    if (changed) {
+        controller->textValid = true;
+        controller->textSerial = ++gamepad->textSerial;
+    }
+}
+
+static void drainRing(Gamepad* gamepad, GameController* controller, InputRing* ring, InputSource source)
+{
+    InputEvent event;
+
+    // Replay every queued change in order, remembering each press.  States are mapped here rather than
+    // where they are queued, so the poll thread never sees the tables change under it.
+    while (input_ring_pop(ring, &event)) {
+        controller->buttons = event.buttons;
+        controller->pressed |= event.pressed;
+        controller->mappedButtons = mapButtons(controller, event.buttons);
+        controller->mappedPressed |= mapButtons(controller, event.pressed);
+
+        int i;
+        for (i = 0; i < 3; ++i) {
+            controller->analog0[i] = mapAxis(controller->axisTables[i], event.analog0[i]);
+            controller->analog1[i] = mapAxis(controller->axisTables[i + 3], event.analog1[i]);
+        }
+
+        // This frame is the first to show the change, so its latency ends when the frame is swapped.
+        if ((event.pressed | event.released) && gamepad->edgeCount[source] < LATENCY_SAMPLES) {
+            gamepad->edgeTimes[source][gamepad->edgeCount[source]++] = event.time;
+        }
+    }
+}
+
+void gamepad_update(Gamepad* gamepad)
+{
+    gamepad->edgeCount[INPUT_EVENTS] = 0;
+    gamepad->edgeCount[INPUT_POLLING] = 0;
+
+    int i;
+    for (i = 0; i < gamepad->playerCount; ++i) {
+        GameController* controller = gamepad->players[i];
+
+        drainRing(gamepad, controller, &controller->eventRing, INPUT_EVENTS);
+        drainRing(gamepad, controller, &controller->pollRing, INPUT_POLLING);
+
+        // Buttons that are down now or were pressed at any point since the last frame.
+        const int buttons = controller->buttons | controller->pressed;
+        controller->pressed = 0;
+
+        // The same for the on-screen buttons, bit j standing for virtualButtons[j].
+        int mapped = controller->mappedButtons | controller->mappedPressed;
+        controller->mappedPressed = 0;
+
+        // If a button is active, map it to the first gamepad button pressed.
+        if (controller->activeButton) {
+            int j;
+            for (j = 0; j < controller->buttonCount; ++j) {
+                if (buttons & gamepad->buttonMappings[j]) {
+                    // Erase old button mapping if one exists.
+                    int k;
+                    for (k = 0; k < MAX_BUTTONS; ++k) {
+                        Button* button = &controller->virtualButtons[k];
+                        if (gamepad->buttonMappings[j] & button->mapping) {
+                            button->mapping = 0;
+                            break;
+                        }
+                    }
+
+                    // Set new button mapping and keep it for the next time this kind of device is attached.
+                    controller->activeButton->mapping = gamepad->buttonMappings[j];
+                    controller->activeButton = NULL;
+                    storeProfile(gamepad, controller);
+                    mapped = mapButtons(controller, buttons);
+                    break;
+                }
+            }
+        }
+
+        // An idle controller shows the same as in the last frame, so its quads and text are already right.
+        if (controller->textValid && buttons == controller->shownButtons && mapped == controller->shownMapped &&
+            controller->activeButton == controller->shownActive &&
+            !memcmp(controller->shownAnalog0, controller->analog0, sizeof(controller->analog0)) &&
+            !memcmp(controller->shownAnalog1, controller->analog1, sizeof(controller->analog1))) {
+            continue;
+        }
+
+        controller->shownMapped = mapped;
+        controller->shownActive = controller->activeButton;
+        gamepad->quadsChanged = true;
+
+        // Set the inner joystick positions.
+        if (controller->analogCount > 0) {
+            place(controller, controller->analog0Inner, ANALOG0_X + (controller->analog0[0] >> 2), ANALOG_Y - (controller->analog0[1] >> 2), ANALOG_SIZE, ANALOG_SIZE);
+        }
+
+        if (controller->analogCount == 2) {
+            place(controller, controller->analog1Inner, ANALOG1_X + (controller->analog1[0] >> 2), ANALOG_Y - (controller->analog1[1] >> 2), ANALOG_SIZE, ANALOG_SIZE);
+        }
+
+        updateText(gamepad, controller, buttons);
+
+        // Set the button UVs to correspond to their states.
+        int j;
+        for (j = 0; j < MAX_BUTTONS; ++j) {
+            Button* button = &controller->virtualButtons[j];
+
+            if ((mapped & (1 << j)) || button == controller->activeButton) {
+                switch (button->type) {
+                case DPAD_LEFT:
+                    button->quad->uvs = _leftDPadDownUVs;
+                    break;
+                case DPAD_RIGHT:
+                    button->quad->uvs = _rightDPadDownUVs;
+                    break;
+                case DPAD_UP:
+                    button->quad->uvs = _upDPadDownUVs;
+                    break;
+                case DPAD_DOWN:
+                    button->quad->uvs = _downDPadDownUVs;
+                    break;
+                case DIGITAL_TRIGGER:
+                case ANALOG_TRIGGER:
+                    button->quad->uvs = _triggerDownUVs;
+                    break;
+                case BUTTON:
+                    button->quad->uvs = _buttonDownUVs;
+                    break;
+                }
+            } else {
+                switch (button->type) {
+                case DPAD_LEFT:
+                    button->quad->uvs = _leftDPadUpUVs;
+                    break;
+                case DPAD_RIGHT:
+                    button->quad->uvs = _rightDPadUpUVs;
+                    break;
+                case DPAD_UP:
+                    button->quad->uvs = _upDPadUpUVs;
+                    break;
+                case DPAD_DOWN:
+                    button->quad->uvs = _downDPadUpUVs;
+                    break;
+                case DIGITAL_TRIGGER:
+                case ANALOG_TRIGGER:
+                    button->quad->uvs = _triggerUpUVs;
+                    break;
+                case BUTTON:
+                    button->quad->uvs = _buttonUpUVs;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void buildQuad(Gamepad* gamepad, int index, const Quad* quad)
+{
+    float vertices[QUAD_VERTEX_COORDS];
+    float textureCoords[QUAD_TEXCOORDS];
+
+    const float x = quad->x;
+    const float y = quad->y;
+    const float width = quad->width;
+    const float height = quad->height;
+    vertices[0] = x;
+    vertices[1] = y;
+    vertices[2] = x + width;
+    vertices[3] = y;
+    vertices[4] = x;
+    vertices[5] = y + height;
+    vertices[6] = x + width;
+    vertices[7] = y + height;
+
+    const float u1 = quad->uvs[0];
+    const float v1 = quad->uvs[1];
+    const float u2 = quad->uvs[2];
+    const float v2 = quad->uvs[3];
+    textureCoords[0] = u1;
+    textureCoords[1] = v2;
+    textureCoords[2] = u2;
+    textureCoords[3] = v2;
+    textureCoords[4] = u1;
+    textureCoords[5] = v1;
+    textureCoords[6] = u2;
+    textureCoords[7] = v1;
+
+    float* storedVertices = &gamepad->vertices[index * QUAD_VERTEX_COORDS];
+    float* storedTextureCoords = &gamepad->textureCoords[index * QUAD_TEXCOORDS];
+
+    // Most quads look the same as in the last frame.
+    if (!memcmp(vertices, storedVertices, sizeof(vertices)) &&
+        !memcmp(textureCoords, storedTextureCoords, sizeof(textureCoords))) {
+        return;
+    }
+
+    memcpy(storedVertices, vertices, sizeof(vertices));
+    memcpy(storedTextureCoords, textureCoords, sizeof(textureCoords));
+
+    // Extend the last run over a small gap, or start a new one.
+    int* runs = gamepad->dirtyRuns;
+    int last = gamepad->dirtyRunCount - 1;
+    if (last >= 0 && index - runs[last*2 + 1] <= DIRTY_MERGE_GAP) {
+        gamepad->dirtyQuads += index + 1 - runs[last*2 + 1];
+        runs[last*2 + 1] = index + 1;
+    } else {
+        runs[(last + 1)*2] = index;
+        runs[(last + 1)*2 + 1] = index + 1;
+        gamepad->dirtyRunCount++;
+        gamepad->dirtyQuads++;
+    }
+}
+
+void gamepad_build(Gamepad* gamepad)
+{
+    gamepad->dirtyRunCount = 0;
+    gamepad->dirtyQuads = 0;
+
+    // Every quad would compare equal to what it held before.
+    if (!gamepad->quadsChanged) {
+        return;
+    }
+    gamepad->quadsChanged = false;
+
+    // Populate vertex and texture coordinate arrays, player by player.
+    int i;
+    for (i = 0; i < gamepad->playerCount; ++i) {
+        const GameController* controller = gamepad->players[i];
+        int first = i * PLAYER_QUADS;
+
+        int j;
+        for (j = 0; j < PLAYER_QUADS; ++j) {
+            buildQuad(gamepad, first + j, &controller->quads[j]);
+        }
+    }
+
+    // The polling button follows the last player.
+    buildQuad(gamepad, gamepad->playerCount * PLAYER_QUADS, &gamepad->pollingQuad);
+}
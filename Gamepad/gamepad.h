@@ -0,0 +1,289 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GAMEPAD_H_
+#define GAMEPAD_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "devicemap.h"
+#include "inputring.h"
+#include "profile.h"
+
+// Controller information.
+#define MIN_PLAYERS 2                           // Players shown even when nothing is connected.
+#define MAX_BUTTONS PROFILE_BUTTONS
+
+// Constants used when allocating memory for our graphical data.
+#define PLAYER_QUADS 20                         // Quads drawn for each player.
+#define QUAD_VERTEX_COORDS 8                    // 4 vertices per image * 2 vertex coords per vertex.
+#define QUAD_INDICES 6                          // 6 indices per quad.
+#define QUAD_TEXCOORDS 8                        // 8 UVs per quad.
+
+// Vertices are indexed with unsigned shorts, which limits the number of players.
+#define MAX_PLAYERS ((65536 / 4 - 2) / PLAYER_QUADS)
+
+// Button changes per frame and input path whose arrival time is kept for latency measurement.
+#define LATENCY_SAMPLES 64
+
+// The path a controller state change came in on.
+typedef enum InputSource_t {
+    INPUT_EVENTS,       // Screen events, handled by the event loop.
+    INPUT_POLLING,      // Device polling, per frame or by the poll thread.
+    INPUT_SOURCE_COUNT
+} InputSource;
+
+// Each button type corresponds to a set of texture coordinates.
+typedef enum ButtonType_t {
+    DPAD_UP,
+    DPAD_DOWN,
+    DPAD_LEFT,
+    DPAD_RIGHT,
+    DIGITAL_TRIGGER,
+    ANALOG_TRIGGER,
+    BUTTON
+} ButtonType;
+
+// This structure defines a quad that can be drawn to the screen.
+typedef struct Quad_t {
+    float x;
+    float y;
+    float width;
+    float height;
+    const float* uvs;
+} Quad;
+
+// This structure contains everything needed to map a physical button on a device to a virtual button on the screen.
+typedef struct Button_t {
+    // A button's type determines which set of UVs it uses.
+    ButtonType type;
+    int mapping;
+    Quad* quad;
+    char* label;
+} Button;
+
+// Static information about a device, queried from libscreen when it is attached.
+typedef struct DeviceInfo_t {
+    bool gamepad;
+    int analogCount;
+    int buttonCount;
+    char id[64];
+} DeviceInfo;
+
+// Structure representing a game controller.
+typedef struct GameController_t {
+    // Static device info.  The handle is the screen_device_t of the device,
+    // or any unique non-NULL value when input is replayed.
+    void* handle;
+    bool gamepad;
+    int analogCount;
+    int buttonCount;
+    char id[64];
+
+    // Current state.  buttons holds the device's own button bits, while bit i of mappedButtons
+    // is set when on-screen button i is held.  Analog values are mapped by the profile.
+    int buttons;
+    int mappedButtons;
+    int analog0[3];
+    int analog1[3];
+
+    // Buttons pressed since the last frame, so that taps shorter than a frame are still shown.
+    int pressed;
+    int mappedPressed;
+
+    // The filtered x and y of both sticks last queued on each input path, see stick.h.
+    int16_t stickLast[INPUT_SOURCE_COUNT][4];
+
+    // Axis settings from this device's profile, and lookup tables built from them and from the
+    // button mappings, so that mapping a state change costs a few array lookups.
+    AxisSettings axes[PROFILE_AXES];
+    uint16_t buttonTable[4][256];
+    int16_t axisTables[PROFILE_AXES][PROFILE_AXIS_VALUES];
+
+    // State changes queued by the event handler and by polling, drained once per frame by gamepad_update().
+    InputRing eventRing;
+    InputRing pollRing;
+
+    // Text to display to the user about this controller.
+    char deviceString[256];
+    char buttonsString[128];
+    char analog0String[128];
+    char analog1String[128];
+
+    // The state the text was last formatted for.  Any change to this player's text or its
+    // position on screen gives textSerial a new value, so laid out text can be kept until then.
+    bool textValid;
+    int shownButtons;
+    int shownAnalog0[3];
+    int shownAnalog1[3];
+    unsigned textSerial;
+
+    // The on-screen buttons and active button the quads were last set for.  While these, the
+    // stick values and the text state are unchanged, gamepad_update() leaves this player alone.
+    int shownMapped;
+    Button* shownActive;
+
+    // Position on screen, from 0.  Stays the same for as long as the device is attached.
+    int player;
+
+    // The screen area of this player: bottom left corner, size, and the scale of the controls within it.
+    float left;
+    float bottom;
+    float cellWidth;
+    float cellHeight;
+    float scale;
+
+    // The quads drawn for this player, and pointers to the ones that move.
+    Quad quads[PLAYER_QUADS];
+    Quad* analog0Inner;
+    Quad* analog1Inner;
+    Button virtualButtons[MAX_BUTTONS];
+
+    // Tapping an on-screen button will make it 'active', and the next gamepad button-press will map that gamepad button to this on-screen button.
+    Button* activeButton;
+} GameController;
+
+/**
+ * Everything the sample shows: the controllers, the on-screen buttons that
+ * represent them and the geometry used to draw those.  Nothing in here
+ * depends on libscreen or OpenGL, so input can be replayed and measured on
+ * any system.
+ *
+ * There is one player per attached device, and never fewer than
+ * MIN_PLAYERS.  Each player is allocated on its own, so a GameController
+ * pointer stays valid while other devices come and go.  Players are laid
+ * out in a grid that grows with their number.
+ */
+typedef struct Gamepad_t {
+    float width;
+    float height;
+
+    // All players in screen order.  A player without a device has a NULL handle.
+    GameController** players;
+    int playerCount;
+    int playerCapacity;
+
+    // Device handle to controller, for constant time lookup of incoming events.
+    DeviceMap devices;
+
+    // Source of GameController.textSerial values, never handing out the same one twice.
+    unsigned textSerial;
+
+    // When the button presses and releases taken in by the last gamepad_update() arrived, per input
+    // path.  The frame built from that update is the first one to show them.  Only the first
+    // LATENCY_SAMPLES of a frame are kept.
+    uint64_t edgeTimes[INPUT_SOURCE_COUNT][LATENCY_SAMPLES];
+    int edgeCount[INPUT_SOURCE_COUNT];
+
+    // Button mappings and axis settings by device id, applied when a device is attached.  A remap
+    // updates the profile of the controller's device and sets profilesChanged, the caller saves them.
+    ProfileStore profiles;
+    bool profilesChanged;
+
+    // The possible values for Button.mapping.
+    int buttonMappings[32];
+
+    // Switches between handling all device events and polling devices.
+    Quad pollingQuad;
+    Button pollingButton;
+    volatile bool polling;
+
+    // Vertex and texture coordinates of all quads, filled in by gamepad_build(), and the indices to draw them.
+    // The quads of player i start at quad i * PLAYER_QUADS, the polling button comes last.
+    // The arrays hold quadCapacity quads plus one spare vertex, and only change size when players are added.
+    float* vertices;
+    float* textureCoords;
+    unsigned short* indices;
+    int quadCount;
+    int quadCapacity;
+
+    // Quads whose coordinates changed in the last gamepad_build(), as pairs of [first, end) quad
+    // indices.  Changes a few quads apart share a run.  dirtyQuads is the number of quads covered.
+    int* dirtyRuns;
+    int dirtyRunCount;
+    int dirtyQuads;
+
+    // Set when a quad may have moved or changed image since the last gamepad_build(), which has
+    // nothing to compare otherwise.
+    bool quadsChanged;
+} Gamepad;
+
+/**
+ * Lays out the on-screen controls for a surface of the given size and
+ * creates MIN_PLAYERS empty players.
+ *
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int gamepad_init(Gamepad* gamepad, float width, float height);
+
+/**
+ * Releases everything allocated for the players and their geometry.
+ */
+void gamepad_free(Gamepad* gamepad);
+
+/**
+ * Assigns a newly attached device to the first free player, adding a
+ * player if all are taken, and applies the profile stored for its id or
+ * the default mapping.  Other players keep their state and mappings, but
+ * move on screen if the grid has to grow.
+ *
+ * @return the controller now representing the device, or NULL if it could not be added
+ */
+GameController* gamepad_attach(Gamepad* gamepad, void* handle, const DeviceInfo* info);
+
+/**
+ * Frees the player the device was assigned to, if any.  Free players at
+ * the end of the list are removed, down to MIN_PLAYERS.
+ */
+void gamepad_detach(Gamepad* gamepad, void* handle);
+
+/**
+ * Returns the controller representing a device, or NULL.
+ */
+GameController* gamepad_find(Gamepad* gamepad, void* handle);
+
+/**
+ * Handles a tap on the screen: selects a button to remap or toggles polling.
+ *
+ * @param x, y position of the tap in screen coordinates, with y pointing down
+ */
+void gamepad_touch(Gamepad* gamepad, int x, int y);
+
+/**
+ * Drains the controllers' input rings, mapping each state through the
+ * controller's lookup tables, and updates button mappings, button images
+ * and stick positions.  A remap is stored in the device's profile.  Records when each button change that is
+ * taken in arrived, in edgeTimes.  Status text is only formatted again when
+ * the state it shows has changed, and a player whose state is the same as
+ * in the last frame is skipped after draining its rings.
+ */
+void gamepad_update(Gamepad* gamepad);
+
+/**
+ * Fills in the vertex and texture coordinates of every quad and records
+ * which of them changed since the previous call in dirtyRuns.  After the
+ * arrays were reallocated every quad counts as changed.  When no quad can
+ * have changed since the previous call it returns without comparing any.
+ */
+void gamepad_build(Gamepad* gamepad);
+
+/**
+ * Returns true if at least one controller is attached.
+ */
+bool gamepad_connected(const Gamepad* gamepad);
+
+#endif /* GAMEPAD_H_ */
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <time.h>
+
+#include "inputring.h"
+
+void input_ring_init(InputRing* ring)
+{
+    memset(ring, 0, sizeof(*ring));
+}
+
+uint64_t input_ring_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// The indices are read and advanced with full barrier atomics so that an
+// entry is written before its head is published and read before its slot is
+// handed back.  Each index only has one writer, so the increments never race.
+static unsigned loadIndex(volatile unsigned* index)
+{
+    return __sync_fetch_and_add(index, 0);
+}
+
+static bool enqueue(InputRing* ring, const InputEvent* event)
+{
+    unsigned head = loadIndex(&ring->head);
+
+    if (head - loadIndex(&ring->tail) == INPUT_RING_SIZE) {
+        return false;
+    }
+
+    ring->events[head & (INPUT_RING_SIZE - 1)] = *event;
+    __sync_fetch_and_add(&ring->head, 1);
+
+    return true;
+}
+
+void input_ring_flush(InputRing* ring)
+{
+    if (ring->hasPending && enqueue(ring, &ring->pending)) {
+        ring->hasPending = false;
+    }
+}
+
+void input_ring_push(InputRing* ring, uint64_t time, int buttons, const int* analog0, const int* analog1)
+{
+    InputEvent event;
+    unsigned changed = (unsigned)(buttons ^ ring->lastButtons);
+    unsigned bits;
+
+    event.time = time;
+    event.buttons = buttons;
+    event.pressed = buttons & ~ring->lastButtons;
+    event.released = ~buttons & ring->lastButtons;
+    ring->lastButtons = buttons;
+
+    memset(event.edges, 0, sizeof(event.edges));
+    for (bits = changed; bits; bits &= bits - 1) {
+        event.edges[__builtin_ctz(bits)] = 1;
+    }
+
+    if (analog0) {
+        memcpy(event.analog0, analog0, sizeof(event.analog0));
+    } else {
+        memset(event.analog0, 0, sizeof(event.analog0));
+    }
+
+    if (analog1) {
+        memcpy(event.analog1, analog1, sizeof(event.analog1));
+    } else {
+        memset(event.analog1, 0, sizeof(event.analog1));
+    }
+
+    // Older entries go first, so only queue this one if nothing is pending.
+    input_ring_flush(ring);
+    if (!ring->hasPending && enqueue(ring, &event)) {
+        return;
+    }
+
+    // The consumer is behind.  Keep the newest state, count every edge and
+    // keep the time of the first one, where the latency of the entry starts.
+    if (ring->hasPending) {
+        InputEvent* pending = &ring->pending;
+
+        for (bits = changed; bits; bits &= bits - 1) {
+            const int button = __builtin_ctz(bits);
+            if (pending->edges[button] < INPUT_RING_MAX_EDGES) {
+                pending->edges[button]++;
+            } else {
+                ring->folded++;
+            }
+        }
+
+        if (pending->pressed | pending->released) {
+            event.time = pending->time;
+        }
+        event.pressed |= pending->pressed;
+        event.released |= pending->released;
+        memcpy(event.edges, pending->edges, sizeof(event.edges));
+    }
+
+    ring->pending = event;
+    ring->hasPending = true;
+    ring->merged++;
+}
+
+bool input_ring_pop(InputRing* ring, InputEvent* event)
+{
+    unsigned tail = loadIndex(&ring->tail);
+
+    if (tail == loadIndex(&ring->head)) {
+        return false;
+    }
+
+    *event = ring->events[tail & (INPUT_RING_SIZE - 1)];
+    __sync_fetch_and_add(&ring->tail, 1);
+
+    return true;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INPUTRING_H_
+#define INPUTRING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Number of entries in a ring, must be a power of two.
+#define INPUT_RING_SIZE 256
+
+// Bits in a button mask.
+#define INPUT_RING_BUTTONS 32
+
+// Most edges of one button a merged entry can count.
+#define INPUT_RING_MAX_EDGES 255
+
+// One controller state change as seen by the producer.
+typedef struct InputEvent_t {
+    // When the change was received, in nanoseconds on CLOCK_MONOTONIC.  For
+    // a merged entry, when its first button edge was received.
+    uint64_t time;
+
+    // State after the change.
+    int buttons;
+    int analog0[3];
+    int analog1[3];
+
+    // Buttons that went down or up since the previous entry.  If entries had
+    // to be merged these hold every edge of the merged entries.
+    int pressed;
+    int released;
+
+    // Number of edges of each button since the previous entry.  Only more
+    // than one if entries had to be merged; presses and releases of a button
+    // alternate, so a double tap is four edges.
+    uint8_t edges[INPUT_RING_BUTTONS];
+} InputEvent;
+
+/**
+ * Single producer, single consumer queue of controller state changes.
+ *
+ * The producer (the event handler or the poll thread) pushes full state
+ * snapshots; the ring works out the button edges between them.  The
+ * consumer (update()) pops entries in order once per frame, so a button that
+ * is pressed and released between two frames is still seen.
+ *
+ * The ring never blocks and never drops an edge.  When it is full, further
+ * snapshots are merged into one pending entry on the producer side, keeping
+ * the latest state, the union of all edges with a count of the edges of each
+ * button and the time of the first edge, and the entry is queued as soon as
+ * there is room again.
+ */
+typedef struct InputRing_t {
+    InputEvent events[INPUT_RING_SIZE];
+
+    // Only written by the producer.
+    volatile unsigned head;
+    int lastButtons;
+    bool hasPending;
+    InputEvent pending;
+
+    // Snapshots that were merged because the ring was full, and edges that
+    // were lost because a button already had INPUT_RING_MAX_EDGES pending.
+    unsigned merged;
+    unsigned folded;
+
+    // Only written by the consumer, kept on its own cache line.
+    char padding[64];
+    volatile unsigned tail;
+} InputRing;
+
+/**
+ * Empties the ring.  Must not be called while the producer or the consumer
+ * is using it.
+ */
+void input_ring_init(InputRing* ring);
+
+/**
+ * Queues a controller state snapshot.  Producer side only.
+ *
+ * @param time when the state was received, see input_ring_now()
+ * @param buttons bitmask of buttons that are down
+ * @param analog0, analog1 stick positions, may be NULL if not present
+ */
+void input_ring_push(InputRing* ring, uint64_t time, int buttons, const int* analog0, const int* analog1);
+
+/**
+ * Queues the pending merged entry if there is room for it now.  The producer
+ * calls this after each batch of pushes so that the last state of a burst
+ * is not held back until the next push.
+ */
+void input_ring_flush(InputRing* ring);
+
+/**
+ * Takes the oldest entry off the ring.  Consumer side only.
+ *
+ * @return true if an entry was copied to event, false if the ring was empty
+ */
+bool input_ring_pop(InputRing* ring, InputEvent* event);
+
+/**
+ * Returns the current time in nanoseconds on CLOCK_MONOTONIC.
+ */
+uint64_t input_ring_now();
+
+#endif /* INPUTRING_H_ */
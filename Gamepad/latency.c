@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include "latency.h"
+
+// Width of the bars drawn for the fullest bucket.
+static const int BAR_WIDTH = 20;
+
+void latency_init(LatencyHistogram* histogram)
+{
+    memset(histogram, 0, sizeof(*histogram));
+}
+
+void latency_add(LatencyHistogram* histogram, uint64_t nanos)
+{
+    uint64_t bucket = nanos / LATENCY_BUCKET_NANOS;
+    if (bucket >= LATENCY_BUCKETS) {
+        bucket = LATENCY_BUCKETS - 1;
+    }
+
+    histogram->counts[bucket]++;
+    histogram->total++;
+    histogram->sum += nanos;
+    if (nanos > histogram->max) {
+        histogram->max = nanos;
+    }
+}
+
+uint64_t latency_percentile(const LatencyHistogram* histogram, int percent)
+{
+    uint64_t target = ((uint64_t)histogram->total * percent + 99) / 100;
+    uint64_t seen = 0;
+    int i;
+
+    if (!histogram->total) {
+        return 0;
+    }
+
+    for (i = 0; i < LATENCY_BUCKETS; ++i) {
+        seen += histogram->counts[i];
+        if (seen >= target) {
+            break;
+        }
+    }
+
+    return (i + 1) * LATENCY_BUCKET_NANOS;
+}
+
+void latency_report(FILE* out, const char* const* names, const LatencyHistogram* histograms, int count)
+{
+    unsigned fullest = 0;
+    int first = LATENCY_BUCKETS;
+    int last = -1;
+    int i, j;
+
+    for (j = 0; j < count; ++j) {
+        const LatencyHistogram* histogram = &histograms[j];
+
+        if (!histogram->total) {
+            fprintf(out, "%-8s no samples\n", names[j]);
+            continue;
+        }
+
+        fprintf(out, "%-8s %u samples, mean %.1f ms, p50 < %llu ms, p95 < %llu ms, p99 < %llu ms, max %.1f ms\n",
+                names[j], histogram->total,
+                (double)histogram->sum / histogram->total / 1000000.0,
+                (unsigned long long)(latency_percentile(histogram, 50) / 1000000ULL),
+                (unsigned long long)(latency_percentile(histogram, 95) / 1000000ULL),
+                (unsigned long long)(latency_percentile(histogram, 99) / 1000000ULL),
+                histogram->max / 1000000.0);
+
+        for (i = 0; i < LATENCY_BUCKETS; ++i) {
+            if (histogram->counts[i]) {
+                if (i < first) {
+                    first = i;
+                }
+                last = i;
+                if (histogram->counts[i] > fullest) {
+                    fullest = histogram->counts[i];
+                }
+            }
+        }
+    }
+
+    if (last < 0) {
+        return;
+    }
+
+    fprintf(out, "%10s", "");
+    for (j = 0; j < count; ++j) {
+        fprintf(out, " %7s %-*s", names[j], BAR_WIDTH, "");
+    }
+    fprintf(out, "\n");
+
+    // Every bucket between the fastest and the slowest sample, so gaps show.
+    for (i = first; i <= last; ++i) {
+        if (i == LATENCY_BUCKETS - 1) {
+            fprintf(out, "  >=%2d ms", i);
+        } else {
+            fprintf(out, "  %2d-%2d ms", i, i + 1);
+        }
+
+        for (j = 0; j < count; ++j) {
+            char bar[32];
+            int width = (int)(((uint64_t)histograms[j].counts[i] * BAR_WIDTH + fullest - 1) / fullest);
+
+            memset(bar, '#', width);
+            bar[width] = '\0';
+            fprintf(out, " %7u %-*s", histograms[j].counts[i], BAR_WIDTH, bar);
+        }
+        fprintf(out, "\n");
+    }
+}
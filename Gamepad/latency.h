@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Width of one histogram bucket.
+#define LATENCY_BUCKET_NANOS 1000000ULL
+
+// Number of buckets.  The last one also counts everything slower.
+#define LATENCY_BUCKETS 100
+
+/**
+ * Histogram of input latencies in 1 ms buckets, with the totals needed for
+ * the mean and maximum.
+ */
+typedef struct LatencyHistogram_t {
+    unsigned counts[LATENCY_BUCKETS];
+    unsigned total;
+    uint64_t sum;
+    uint64_t max;
+} LatencyHistogram;
+
+/**
+ * Empties a histogram.
+ */
+void latency_init(LatencyHistogram* histogram);
+
+/**
+ * Adds one measurement.
+ *
+ * @param nanos latency in nanoseconds
+ */
+void latency_add(LatencyHistogram* histogram, uint64_t nanos);
+
+/**
+ * Returns the upper edge of the bucket holding the given percentile, in
+ * nanoseconds, or 0 if the histogram is empty.
+ */
+uint64_t latency_percentile(const LatencyHistogram* histogram, int percent);
+
+/**
+ * Prints a summary line for each histogram followed by the non-empty
+ * buckets of all of them side by side, so that different input paths can be
+ * compared.
+ *
+ * @param out stream to write to
+ * @param names one column title per histogram
+ * @param histograms the histograms to compare
+ * @param count number of histograms
+ */
+void latency_report(FILE* out, const char* const* names, const LatencyHistogram* histograms, int count);
+
+#endif /* LATENCY_H_ */
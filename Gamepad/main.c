@@ -31,6 +31,7 @@
 #include <GLES/gl.h>
 
 #include <math.h>
+#include <pthread.h>
 #include <time.h>
 #include <ctype.h>
 #include <unistd.h>
@@ -39,176 +40,119 @@
 #include <string.h>
 
 #include "bbutil.h"
+#include "bench.h"
+#include "gamepad.h"
+#include "inputring.h"
+#include "latency.h"
+#include "profile.h"
+#include "stick.h"
+#include "record.h"
 
 // This macro provides error checking for all calls to libscreen APIs.
 static int rc;
 #define SCREEN_API(x, y) rc = x; \
     if (rc) fprintf(stderr, "\n%s in %s: %d", y, __FUNCTION__, errno)
 
-// Constants used when allocating memory for our graphical data.
-static const int QUAD_COUNT = 41;
-static const int VERTEX_COORD_COUNT = 328;    // QUAD_COUNT * 4 vertices per image * 2 vertex coords per vertex.
-static const int INDEX_COUNT = 246;           // QUAD_COUNT * 6 indices per quad.
-static const int TEXCOORD_COUNT = 328;        // QUAD_COUNT * 8 UVs per quad.
-
-// Size and positions of all the controls.
-static const float ANALOG0_X = 75.0f;
-static const float ANALOG1_X  = 460.0f;
-static const float ANALOG_Y = 75.0f;
-static const float ANALOG_SIZE = 100.0f;
-
-static const float DPAD_X = 25.0f;
-static const float DPAD_Y = 275.0f;
-static const float DPAD_LONG = 112.5f;
-static const float DPAD_SHORT = 75.0f;
-
-static const float BUTTONS_X = 400.0f;
-static const float BUTTONS_Y = 275.0f;
-static const float BUTTON_SIZE = 75.0f;
-
-static const float LEFT_TRIGGERS_X = 25.0f;
-static const float RIGHT_TRIGGERS_X = 450.0f;
-static const float TRIGGERS_Y = 525.0f;
-static const float TRIGGER_WIDTH = 175.0f;
-static const float TRIGGER_HEIGHT = 50.0f;
-
-static const float SELECT_X = 237.5f;
-static const float SELECT_Y = 475.0f;
-
 // Other constants.
 static const int FONT_SIZE = 4;
 
-// Texture coordinates for each image in our texture atlas.
-static GLfloat _outerUVs[4] = { 0.0f, 1.0f, 0.25f, 0.75f };
-static GLfloat _innerUVs[4] = { 0.25f, 1.0f, 0.5f, 0.75f };
-static GLfloat _buttonDownUVs[4] = { 0.0f, 0.7109375f, 0.166015625f, 0.544921875f };
-static GLfloat _buttonUpUVs[4] = { 0.166015625f, 0.7109375f, 0.33203125f, 0.544921875f };
-static GLfloat _triggerDownUVs[4] = { 0.0f, 0.51171875f, 0.1474609375f, 0.466796875f };
-static GLfloat _triggerUpUVs[4] = { 0.17578125f, 0.51171875f, 0.3232421875f, 0.466796875f };
-static GLfloat _upDPadDownUVs[4] = { 0.0f, 0.267578125f, 0.1005859375f, 0.1201171875f };
-static GLfloat _upDPadUpUVs[4] = { 0.390625f, 0.267578125f, 0.4912109375f, 0.1201171875f };
-static GLfloat _downDPadDownUVs[4] = { 0.17578125f, 0.267578125f, 0.2763671875f, 0.1201171875f };
-static GLfloat _downDPadUpUVs[4] = { 0.56640625f, 0.267578125f, 0.6669921875f, 0.1201171875f };
-static GLfloat _leftDPadDownUVs[4] = { 0.0f, 0.4140625f, 0.1474609375f, 0.3125f };
-static GLfloat _leftDPadUpUVs[4] = { 0.390625f, 0.4140625f, 0.5380859375f, 0.3125f };
-static GLfloat _rightDPadDownUVs[4] = { 0.17578125f, 0.4140625f, 0.3232421875f, 0.3125f };
-static GLfloat _rightDPadUpUVs[4] = { 0.56640625f, 0.4140625f, 0.7138671875f, 0.3125f } ;
-
-// Each button type corresponds to a set of texture coordinates from those defined above.
-typedef enum ButtonType_t {
-    DPAD_UP,
-    DPAD_DOWN,
-    DPAD_LEFT,
-    DPAD_RIGHT,
-    DIGITAL_TRIGGER,
-    ANALOG_TRIGGER,
-    BUTTON
-} ButtonType;
-
-// This structure defines a quad that can be drawn to the screen.
-typedef struct Quad_t {
-    GLfloat x;
-    GLfloat y;
-    GLfloat width;
-    GLfloat height;
-    GLfloat* uvs;
-} Quad;
-
-// This structure contains everything needed to map a physical button on a device to a virtual button on the screen.
-typedef struct Button_t {
-    // A button's type determines which set of UVs it uses.
-    ButtonType type;
-    int mapping;
-    Quad* quad;
-    char* label;
-} Button;
-
-// The possible values for Button.mapping.
-static int _buttonMappings[32];
-
 // Objects used by the application.
 static screen_context_t _screen_ctx;
 static font_t* _font;
 
 // Miscellaneous variables used by the application.
 static bool _shutdown;
-static bool _polling;
-static float _surfaceHeight;
-static float _surfaceWidth;
 
 // Storage for our graphical data.
 static unsigned int _gamepadTexture;
-static GLfloat* _vertices;
-static GLushort* _indices;
-static GLfloat* _textureCoords;
-static Quad _quads[41];
-
-// Pointers to the quads and buttons we'll need to modify during frame updates.
-static Quad* _analog0Inner[2];
-static Quad* _analog1Inner[2];
-static Button _buttons[2][16];
 
-// Tapping an on-screen button will make it 'active', and the next gamepad button-press will map that gamepad button to this on-screen button.
-static Button* _activeButton[2];
-
-static Button _pollingButton;
-
-// Structure representing a game controller.
-typedef struct GameController_t {
-    // Static device info.
-    screen_device_t handle;
-    int type;
-    int analogCount;
-    int buttonCount;
-    char id[64];
-
-    // Current state.
+// Buffer objects holding the geometry: vertex coordinates followed by texture coordinates, and the indices.
+// They are sized for _bufferQuads quads and recreated when the geometry arrays grow.
+static GLuint _vertexBuffer;
+static GLuint _indexBuffer;
+static int _bufferQuads;
+
+// GAMEPAD_LATENCY measures the time from receiving a button change to swapping the first frame that shows it,
+// separately for screen events and polling, and logs the histograms every LATENCY_REPORT_INTERVAL and at exit.
+static const uint64_t LATENCY_REPORT_INTERVAL = 30000000000ULL;
+static const char* const LATENCY_NAMES[INPUT_SOURCE_COUNT] = { "events", "polling" };
+static bool _measureLatency;
+static LatencyHistogram _latency[INPUT_SOURCE_COUNT];
+static uint64_t _latencyReported;
+
+// Text laid out for each player, kept until the player's textSerial changes, and for the polling button.
+typedef struct PlayerText_t {
+    text_batch_t* batch;
+    unsigned serial;
+} PlayerText;
+
+static PlayerText* _playerText;
+static int _playerTextCount;
+static text_batch_t* _pollingText;
+
+// With GAMEPAD_BENCH, the CPU time per frame, the bytes sent to the buffers and the number of
+// times text was laid out are logged every LOG_FRAMES frames.
+static const unsigned LOG_FRAMES = 600;
+static bool _logFrames;
+static unsigned _loggedFrames;
+static uint64_t _frameCpuTime;
+static uint64_t _uploadBytes;
+static unsigned _textLayouts;
+
+// The controllers and everything drawn to represent them.
+static Gamepad _gamepad;
+
+// When polling, a dedicated thread samples the controllers this many times per second.
+// With a rate of 0 the controllers are sampled once per frame instead.
+static int _pollRate;
+static pthread_t _pollThread;
+static bool _pollThreadRunning;
+static volatile bool _pollThreadStop;
+
+// Held by the poll thread while it samples and by the main thread while it attaches or removes devices.
+static pthread_mutex_t _controllerMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// GAMEPAD_STICK_DEAD_ZONE, GAMEPAD_STICK_CURVE and GAMEPAD_STICK_JITTER clean up stick positions before
+// they are queued.  Events and polling have a batch each, so the poll thread never shares one.
+static StickProcessor _sticks;
+static StickBatch _eventSticks;
+static StickBatch _pollSticks;
+
+// States sampled by pollDevices(), queued once the sticks of all of them were processed together.
+typedef struct PolledState_t {
+    GameController* controller;
+    uint64_t time;
     int buttons;
     int analog0[3];
     int analog1[3];
+} PolledState;
 
-    // Text to display to the user about this controller.
-    char deviceString[256];
-    char buttonsString[128];
-    char analog0String[128];
-    char analog1String[128];
-} GameController;
+static PolledState* _polled;
+static int _polledCapacity;
 
-// Controller information.
-static int MAX_CONTROLLERS = 2;
-static int MAX_BUTTONS = 16;
-static GameController _controllers[2];
+// Button mappings and axis settings per kind of device, saved whenever the user remaps a button.
+// GAMEPAD_PROFILES overrides where they are kept.
+static const char* const DEFAULT_PROFILE_PATH = "data/profiles.map";
+static const char* _profilePath;
 
-static void initController(GameController* controller, int player)
-{
-    // Initialize controller values.
-    controller->handle = 0;
-    controller->type = 0;
-    controller->analogCount = 0;
-    controller->buttonCount = 0;
-    controller->buttons = 0;
-    controller->analog0[0] = controller->analog0[1] = controller->analog0[2] = 0;
-    controller->analog1[0] = controller->analog1[1] = controller->analog1[2] = 0;
-    sprintf(controller->deviceString, "Player %d: No device detected.", player + 1);
-}
+// GAMEPAD_RECORD writes all input to a file, which GAMEPAD_REPLAY plays back instead of live input.
+static RecordFile _recording;
+static pthread_mutex_t _recordMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static RecordFile _replay;
+static bool _replaying;
+static bool _replayMaxSpeed;
+static uint64_t _replayStart;
+static Record _replayNext;
+static bool _replayHasNext;
+static unsigned _replayEvents;
+static unsigned _replayFrames;
 
 int init()
 {
-    // Initialize our static variables and controllers.
+    // Initialize our static variables.
     _font = NULL;
     _shutdown = false;
-    _polling = false;
-
-    int i;
-    for (i = 0; i < MAX_CONTROLLERS; ++i) {
-        initController(&_controllers[i], i);
-        _activeButton[i] = NULL;
-    }
-
-    // Populate an array of button mappings.
-    for (i = 0; i < 32; ++i) {
-        _buttonMappings[i] = 1 << i;
-    }
 
     EGLint surface_width, surface_height;
 
@@ -222,9 +166,6 @@ int init()
         return EXIT_FAILURE;
     }
 
-    _surfaceHeight = (float) surface_height;
-    _surfaceWidth = (float) surface_width;
-
     // Calculate our display's DPI and load our font using utility code.
     int dpi = bbutil_calculate_dpi(_screen_ctx);
     _font = bbutil_load_font("/usr/fonts/font_repository/monotype/cour.ttf", FONT_SIZE, dpi);
@@ -242,235 +183,32 @@ int init()
         return EXIT_FAILURE;
     }
 
-    // Set the initial positions of all joysticks and buttons.
-    for (i = 0; i < MAX_CONTROLLERS; ++i) {
-        /**
-         * Quads  | Buttons  | Description
-         * =======|==========|=============
-         * 0, 1   | 0, 1     | Analog triggers.
-         * 2-7    | 2, 3     | Analog sticks and their buttons.
-         * 6-9    | 4 - 7    | D-Pad.  Up, Down, Left, Right.
-         * 10-13  | 8 - 12   | A, B, X, Y Buttons.
-         * 14-17  | 13, 14   | Triggers: L1, R1
-         * 18, 19 | 15, 16   | Select, Start.
-         */
-        int controllerIndex = 20*i;
-        float xOffset = (_surfaceWidth * 0.5f)*i;
-
-        int j;
-        // Assign quads to all buttons other than L2, R2, L3 and R3.
-        for (j = 4; j < 16; ++j) {
-            _buttons[i][j].quad = &_quads[j+4 + controllerIndex];
-        }
-
-        // D-Pad.
-        for (j = 4; j < 8; ++j) {
-            _buttons[i][j].type = DPAD_UP + j-4;
-        }
-
-        // Buttons.
-        for (j = 8; j < 12; ++j) {
-            _buttons[i][j].type = BUTTON;
-            _buttons[i][j].quad->width = BUTTON_SIZE;
-            _buttons[i][j].quad->height = BUTTON_SIZE;
-            _buttons[i][j].quad->uvs = _buttonUpUVs;
-        }
+    // Initialize our controllers and set the initial positions of all joysticks and buttons.
+    if (EXIT_SUCCESS != gamepad_init(&_gamepad, (float) surface_width, (float) surface_height)) {
+        fprintf(stderr, "Unable to initialize controllers.\n");
+        return EXIT_FAILURE;
+    }
 
-        // Triggers.
-        for (j = 12; j < 16; ++j) {
-            _buttons[i][j].type = DIGITAL_TRIGGER;
-            _buttons[i][j].quad->width = TRIGGER_WIDTH;
-            _buttons[i][j].quad->height = TRIGGER_HEIGHT;
-            _buttons[i][j].quad->uvs = _triggerUpUVs;
-        }
+    // A damaged profile file is not fatal, devices without a profile use the default mapping.
+    _profilePath = getenv("GAMEPAD_PROFILES");
+    if (!_profilePath) {
+        _profilePath = DEFAULT_PROFILE_PATH;
+    }
+    profile_load(&_gamepad.profiles, _profilePath);
 
-        // Set quad positions and sizes.
-
-        // Analog triggers
-		_buttons[i][0].label = "L2";
-		_buttons[i][0].type = ANALOG_TRIGGER;
-		_buttons[i][0].quad = &_quads[0 + controllerIndex];
-		_buttons[i][0].quad->x = LEFT_TRIGGERS_X + xOffset;
-		_buttons[i][0].quad->y = TRIGGERS_Y + TRIGGER_HEIGHT + 25.0f;
-		_buttons[i][0].quad->width = TRIGGER_WIDTH;
-		_buttons[i][0].quad->height = TRIGGER_HEIGHT;
-		_buttons[i][0].quad->uvs = _triggerDownUVs;
-		_buttons[i][0].mapping = SCREEN_L2_GAME_BUTTON;
-
-		_buttons[i][1].label = "R2";
-		_buttons[i][1].type = ANALOG_TRIGGER;
-		_buttons[i][1].quad = &_quads[1 + controllerIndex];
-		_buttons[i][1].quad->x = RIGHT_TRIGGERS_X + xOffset;
-		_buttons[i][1].quad->y = TRIGGERS_Y + TRIGGER_HEIGHT + 25.0f;
-		_buttons[i][1].quad->width = TRIGGER_WIDTH;
-		_buttons[i][1].quad->height = TRIGGER_HEIGHT;
-		_buttons[i][1].quad->uvs = _triggerDownUVs;
-		_buttons[i][1].mapping = SCREEN_R2_GAME_BUTTON;
-
-        // Right stick
-		Quad* analog1Outer = &_quads[2 + controllerIndex];
-		analog1Outer->x = ANALOG1_X + xOffset;
-		analog1Outer->y = ANALOG_Y;
-		analog1Outer->width = analog1Outer->height = ANALOG_SIZE;
-		analog1Outer->uvs = _outerUVs;
-
-		_analog1Inner[i] = &_quads[3 + controllerIndex];
-		_analog1Inner[i]->x = ANALOG1_X + xOffset;
-		_analog1Inner[i]->y = ANALOG_Y;
-		_analog1Inner[i]->width = _analog1Inner[i]->height = ANALOG_SIZE;
-		_analog1Inner[i]->uvs = _innerUVs;
-
-		// R3
-		_buttons[i][2].label = "R3";
-		_buttons[i][2].type = BUTTON;
-		_buttons[i][2].quad = &_quads[4 + controllerIndex];
-		_buttons[i][2].quad->x = ANALOG1_X - BUTTON_SIZE*2.0f + xOffset;
-		_buttons[i][2].quad->y = ANALOG_Y + BUTTON_SIZE;
-		_buttons[i][2].quad->width = BUTTON_SIZE;
-		_buttons[i][2].quad->height = BUTTON_SIZE;
-		_buttons[i][2].quad->uvs = _buttonUpUVs;
-		_buttons[i][2].mapping = SCREEN_R3_GAME_BUTTON;
-
-		// Left stick
-		Quad* analog0Outer = &_quads[5 + controllerIndex];
-		analog0Outer->x = ANALOG0_X + xOffset;
-		analog0Outer->y = ANALOG_Y;
-		analog0Outer->width = analog0Outer->height = ANALOG_SIZE;
-		analog0Outer->uvs = _outerUVs;
-
-		_analog0Inner[i] = &_quads[6 + controllerIndex];
-		_analog0Inner[i]->x = ANALOG0_X + xOffset;
-		_analog0Inner[i]->y = ANALOG_Y;
-		_analog0Inner[i]->width = _analog0Inner[i]->height = ANALOG_SIZE;
-		_analog0Inner[i]->uvs = _innerUVs;
-
-		// L3
-		_buttons[i][3].quad = &_quads[7 + controllerIndex];
-		_buttons[i][3].type = BUTTON;
-		_buttons[i][3].label = "L3";
-		_buttons[i][3].quad->x = ANALOG0_X + BUTTON_SIZE*2.0f + xOffset;
-		_buttons[i][3].quad->y = ANALOG_Y + BUTTON_SIZE;
-		_buttons[i][3].quad->width = BUTTON_SIZE;
-		_buttons[i][3].quad->height = BUTTON_SIZE;
-		_buttons[i][3].quad->uvs = _buttonUpUVs;
-		_buttons[i][3].mapping = SCREEN_L3_GAME_BUTTON;
-
-		// Up
-		_buttons[i][4].label = "U";
-		_buttons[i][4].quad->x = DPAD_X + DPAD_SHORT + xOffset;
-		_buttons[i][4].quad->y = DPAD_Y + DPAD_LONG;
-		_buttons[i][4].quad->width = DPAD_SHORT;
-		_buttons[i][4].quad->height = DPAD_LONG;
-		_buttons[i][4].quad->uvs = _upDPadUpUVs;
-		_buttons[i][4].mapping = SCREEN_DPAD_UP_GAME_BUTTON;
-
-		// Down
-		_buttons[i][5].label = "D";
-		_buttons[i][5].quad->x = DPAD_X + DPAD_SHORT + xOffset;
-		_buttons[i][5].quad->y = DPAD_Y;
-		_buttons[i][5].quad->width = DPAD_SHORT;
-		_buttons[i][5].quad->height = DPAD_LONG;
-		_buttons[i][5].quad->uvs = _downDPadUpUVs;
-		_buttons[i][5].mapping = SCREEN_DPAD_DOWN_GAME_BUTTON;
-
-		// Left
-		_buttons[i][6].label = "L";
-		_buttons[i][6].quad->x = DPAD_X + xOffset;
-		_buttons[i][6].quad->y = DPAD_Y + DPAD_SHORT;
-		_buttons[i][6].quad->width = DPAD_LONG;
-		_buttons[i][6].quad->height = DPAD_SHORT;
-		_buttons[i][6].quad->uvs = _leftDPadUpUVs;
-		_buttons[i][6].mapping = SCREEN_DPAD_LEFT_GAME_BUTTON;
-
-		// Right
-		_buttons[i][7].label = "R";
-		_buttons[i][7].quad->x = DPAD_X + DPAD_LONG + xOffset;
-		_buttons[i][7].quad->y = DPAD_Y + DPAD_SHORT;
-		_buttons[i][7].quad->width = DPAD_LONG;
-		_buttons[i][7].quad->height = DPAD_SHORT;
-		_buttons[i][7].quad->uvs = _rightDPadUpUVs;
-		_buttons[i][7].mapping = SCREEN_DPAD_RIGHT_GAME_BUTTON;
-
-		// A, B, X, Y
-		_buttons[i][8].label = "A";
-		_buttons[i][8].quad->x = BUTTONS_X + BUTTON_SIZE + xOffset;
-		_buttons[i][8].quad->y = BUTTONS_Y;
-		_buttons[i][8].mapping = SCREEN_A_GAME_BUTTON;
-
-		_buttons[i][9].label = "B";
-		_buttons[i][9].quad->x = BUTTONS_X + 2*BUTTON_SIZE + xOffset;
-		_buttons[i][9].quad->y = BUTTONS_Y + BUTTON_SIZE;
-		_buttons[i][9].mapping = SCREEN_B_GAME_BUTTON;
-
-		_buttons[i][10].label = "X";
-		_buttons[i][10].quad->x = BUTTONS_X + xOffset;
-		_buttons[i][10].quad->y = BUTTONS_Y + BUTTON_SIZE;
-		_buttons[i][10].mapping = SCREEN_X_GAME_BUTTON;
-
-		_buttons[i][11].label = "Y";
-		_buttons[i][11].quad->x = BUTTONS_X + BUTTON_SIZE + xOffset;
-		_buttons[i][11].quad->y = BUTTONS_Y + 2*BUTTON_SIZE;
-		_buttons[i][11].mapping = SCREEN_Y_GAME_BUTTON;
-
-		// L1, R1
-		_buttons[i][12].label = "L1";
-		_buttons[i][12].quad->x = LEFT_TRIGGERS_X + xOffset;
-		_buttons[i][12].quad->y = TRIGGERS_Y;
-		_buttons[i][12].mapping = SCREEN_L1_GAME_BUTTON;
-
-		_buttons[i][13].label = "R1";
-		_buttons[i][13].quad->x = RIGHT_TRIGGERS_X + xOffset;
-		_buttons[i][13].quad->y = TRIGGERS_Y;
-		_buttons[i][13].mapping = SCREEN_R1_GAME_BUTTON;
-
-		// Select, Start
-		_buttons[i][14].label = "Select";
-		_buttons[i][14].quad->x = SELECT_X + xOffset;
-		_buttons[i][14].quad->y = SELECT_Y;
-		_buttons[i][14].mapping = SCREEN_MENU1_GAME_BUTTON;
-
-		_buttons[i][15].label = "Start";
-		_buttons[i][15].quad->x = SELECT_X + xOffset;
-		_buttons[i][15].quad->y = SELECT_Y + TRIGGER_HEIGHT + 25.0f;
-		_buttons[i][15].mapping = SCREEN_MENU2_GAME_BUTTON;
-    }
-
-    // Finally, one last quad is used for the "polling" button.
-    Quad* pollingQuad = &_quads[40];
-    pollingQuad->x = (surface_width * 0.5f) - TRIGGER_WIDTH * 0.5f;
-    pollingQuad->y = 5.0f;
-    pollingQuad->width = TRIGGER_WIDTH;
-    pollingQuad->height = TRIGGER_HEIGHT + 20;
-    pollingQuad->uvs = _triggerUpUVs;
-
-    _pollingButton.quad = pollingQuad;
-    _pollingButton.type = DIGITAL_TRIGGER;
-    _pollingButton.label = "Polling";
-
-    // Create our vertex and texture coordinate arrays.
-    _vertices = (GLfloat*) calloc(VERTEX_COORD_COUNT, sizeof(GLfloat));
-    _textureCoords = (GLfloat*) calloc(TEXCOORD_COUNT, sizeof(GLfloat));
-
-    // Create and initialize our index array.
-    _indices = (GLushort*) calloc(INDEX_COUNT, sizeof(GLushort));
-    _indices[0] = 0;
-    _indices[1] = 1;
-    _indices[2] = 2;
-    _indices[3] = 3;
-    _indices[4] = 3;
-    _indices[5] = 4;
-
-    int vertexCount = 4;
-    for (i = 1; i < QUAD_COUNT; ++i) {
-        _indices[i*6] = vertexCount;
-        _indices[i*6 + 1] = 1 + vertexCount;
-        _indices[i*6 + 2] = 2 + vertexCount;
-        _indices[i*6 + 3] = 3 + vertexCount;
-        _indices[i*6 + 4] = 3 + vertexCount;
-        vertexCount += 4;
-        _indices[i*6 + 5] = vertexCount;
+    // The polling button's label never changes or moves.
+    _pollingText = bbutil_create_text_batch();
+    if (!_pollingText || EXIT_SUCCESS != bbutil_add_text(_pollingText, _font, _gamepad.pollingButton.label,
+            _gamepad.pollingButton.quad->x + 20, _gamepad.pollingButton.quad->y + 20)) {
+        fprintf(stderr, "Unable to lay out text.\n");
+        return EXIT_FAILURE;
     }
 
+    // The geometry stays on the GPU and is updated where it changed.
+    glGenBuffers(1, &_vertexBuffer);
+    glGenBuffers(1, &_indexBuffer);
+    _bufferQuads = 0;
+
     // Initialize OpenGL for 2D rendering.
     glViewport(0, 0, surface_width, surface_height);
 
@@ -483,28 +221,41 @@ int init()
     glLoadIdentity();
 
     // Set world coordinates to coincide with screen pixels.
-    glScalef(1.0f / (float)surface_width, 1.0f / _surfaceHeight, 1.0f);
+    glScalef(1.0f / (float)surface_width, 1.0f / (float)surface_height, 1.0f);
 
     return EXIT_SUCCESS;
 }
 
 void finalize()
 {
-    // Free allocated resources.
-    if (_vertices) {
-        free(_vertices);
-        _vertices = NULL;
+    // Stop sampling controllers before anything they use goes away.
+    if (_pollThreadRunning) {
+        _pollThreadStop = true;
+        pthread_join(_pollThread, NULL);
+        _pollThreadRunning = false;
     }
 
-    if (_indices) {
-        free(_indices);
-        _indices = NULL;
+    record_close(&_recording);
+    record_close(&_replay);
+    gamepad_free(&_gamepad);
+    stick_batch_free(&_eventSticks);
+    stick_batch_free(&_pollSticks);
+    free(_polled);
+
+    if (_measureLatency) {
+        fprintf(stderr, "Input to swap latency:\n");
+        latency_report(stderr, LATENCY_NAMES, _latency, INPUT_SOURCE_COUNT);
     }
 
-    if (_textureCoords) {
-        free(_textureCoords);
-        _textureCoords = NULL;
+    glDeleteBuffers(1, &_vertexBuffer);
+    glDeleteBuffers(1, &_indexBuffer);
+
+    int i;
+    for (i = 0; i < _playerTextCount; ++i) {
+        bbutil_destroy_text_batch(_playerText[i].batch);
     }
+    free(_playerText);
+    bbutil_destroy_text_batch(_pollingText);
 
     // Destroy the font.
     bbutil_destroy_font(_font);
@@ -522,48 +273,249 @@ void finalize()
     SCREEN_API(screen_destroy_context(_screen_ctx), "destroy_context");
 }
 
-static void loadController(GameController* controller)
+static void recordEvent(void* handle, Record* event)
+{
+    if (!_recording.file) {
+        return;
+    }
+
+    // The poll thread records too.
+    pthread_mutex_lock(&_recordMutex);
+    event->device = handle ? record_device(&_recording, handle) : 0;
+    record_write(&_recording, event);
+    pthread_mutex_unlock(&_recordMutex);
+}
+
+static void queueState(GameController* controller, InputRing* ring, uint64_t time, int buttons, const int* analog0, const int* analog1)
+{
+    input_ring_push(ring, time, buttons, analog0, analog1);
+
+    if (_recording.file) {
+        Record event;
+        event.type = RECORD_STATE;
+        event.time = time;
+        event.buttons = buttons;
+        memcpy(event.analog0, analog0, sizeof(event.analog0));
+        memcpy(event.analog1, analog1, sizeof(event.analog1));
+        recordEvent(controller->handle, &event);
+    }
+}
+
+static int16_t clampStick(int value)
 {
+    return (int16_t)(value < -STICK_RANGE ? -STICK_RANGE : (value > STICK_RANGE - 1 ? STICK_RANGE - 1 : value));
+}
+
+// Lanes 2 * index and 2 * index + 1 of a batch hold the two sticks of a controller.
+static void loadSticks(StickBatch* batch, int index, const GameController* controller, InputSource source,
+        const int* analog0, const int* analog1)
+{
+    const int16_t* last = controller->stickLast[source];
+    const int lane = 2 * index;
+
+    batch->x[lane] = clampStick(analog0[0]);
+    batch->y[lane] = clampStick(analog0[1]);
+    batch->lastX[lane] = last[0];
+    batch->lastY[lane] = last[1];
+    batch->x[lane + 1] = clampStick(analog1[0]);
+    batch->y[lane + 1] = clampStick(analog1[1]);
+    batch->lastX[lane + 1] = last[2];
+    batch->lastY[lane + 1] = last[3];
+}
+
+static void storeSticks(const StickBatch* batch, int index, GameController* controller, InputSource source,
+        int* analog0, int* analog1)
+{
+    int16_t* last = controller->stickLast[source];
+    const int lane = 2 * index;
+
+    analog0[0] = batch->x[lane];
+    analog0[1] = batch->y[lane];
+    analog1[0] = batch->x[lane + 1];
+    analog1[1] = batch->y[lane + 1];
+    last[0] = batch->lastX[lane];
+    last[1] = batch->lastY[lane];
+    last[2] = batch->lastX[lane + 1];
+    last[3] = batch->lastY[lane + 1];
+}
+
+// Cleans up the stick positions of a single event.
+static void processEventSticks(GameController* controller, int* analog0, int* analog1)
+{
+    if (!_sticks.enabled) {
+        return;
+    }
+
+    loadSticks(&_eventSticks, 0, controller, INPUT_EVENTS, analog0, analog1);
+    _eventSticks.count = 2;
+    stick_process(&_sticks, &_eventSticks);
+    storeSticks(&_eventSticks, 0, controller, INPUT_EVENTS, analog0, analog1);
+}
+
+static bool attachDevice(screen_device_t device)
+{
+    DeviceInfo info;
+    int type;
+    int analog0[3] = { 0, 0, 0 };
+    int analog1[3] = { 0, 0, 0 };
+
     // Query libscreen for information about this device.
-    SCREEN_API(screen_get_device_property_iv(controller->handle, SCREEN_PROPERTY_TYPE, &controller->type), "SCREEN_PROPERTY_TYPE");
-    SCREEN_API(screen_get_device_property_cv(controller->handle, SCREEN_PROPERTY_ID_STRING, sizeof(controller->id), controller->id), "SCREEN_PROPERTY_ID_STRING");
-    SCREEN_API(screen_get_device_property_iv(controller->handle, SCREEN_PROPERTY_BUTTON_COUNT, &controller->buttonCount), "SCREEN_PROPERTY_BUTTON_COUNT");
+    memset(&info, 0, sizeof(info));
+    SCREEN_API(screen_get_device_property_iv(device, SCREEN_PROPERTY_TYPE, &type), "SCREEN_PROPERTY_TYPE");
+    SCREEN_API(screen_get_device_property_cv(device, SCREEN_PROPERTY_ID_STRING, sizeof(info.id), info.id), "SCREEN_PROPERTY_ID_STRING");
+    SCREEN_API(screen_get_device_property_iv(device, SCREEN_PROPERTY_BUTTON_COUNT, &info.buttonCount), "SCREEN_PROPERTY_BUTTON_COUNT");
+    info.gamepad = (type == SCREEN_EVENT_GAMEPAD);
 
     // Check for the existence of analog sticks.
-    if (!screen_get_device_property_iv(controller->handle, SCREEN_PROPERTY_ANALOG0, controller->analog0)) {
-    	++controller->analogCount;
+    if (!screen_get_device_property_iv(device, SCREEN_PROPERTY_ANALOG0, analog0)) {
+    	++info.analogCount;
     }
 
-    if (!screen_get_device_property_iv(controller->handle, SCREEN_PROPERTY_ANALOG1, controller->analog1)) {
-    	++controller->analogCount;
+    if (!screen_get_device_property_iv(device, SCREEN_PROPERTY_ANALOG1, analog1)) {
+    	++info.analogCount;
     }
 
-    if (controller->type == SCREEN_EVENT_GAMEPAD) {
-        sprintf(controller->deviceString, "Gamepad device ID: %s", controller->id);
-    } else {
-        sprintf(controller->deviceString, "Joystick device: %s", controller->id);
+    // Keep the poll thread away from the controllers while they change.
+    pthread_mutex_lock(&_controllerMutex);
+    GameController* controller = gamepad_attach(&_gamepad, device, &info);
+    pthread_mutex_unlock(&_controllerMutex);
+
+    if (!controller) {
+        return false;
+    }
+
+    if (_recording.file) {
+        Record event;
+        event.type = RECORD_ATTACH;
+        event.time = input_ring_now();
+        event.info = info;
+        recordEvent(device, &event);
+    }
+
+    // Start out with the stick positions we just read.
+    processEventSticks(controller, analog0, analog1);
+    queueState(controller, &controller->eventRing, input_ring_now(), 0, analog0, analog1);
+
+    return true;
+}
+
+static void detachDevice(screen_device_t device)
+{
+    GameController* controller = gamepad_find(&_gamepad, device);
+    if (!controller) {
+        return;
+    }
+
+    if (_recording.file) {
+        Record event;
+        event.type = RECORD_DETACH;
+        event.time = input_ring_now();
+        recordEvent(device, &event);
     }
+
+    pthread_mutex_lock(&_controllerMutex);
+    gamepad_detach(&_gamepad, device);
+    pthread_mutex_unlock(&_controllerMutex);
+}
+
+static bool reservePolled(int count)
+{
+    if (count <= _polledCapacity) {
+        return true;
+    }
+
+    PolledState* polled = (PolledState*)realloc(_polled, count * sizeof(PolledState));
+    if (!polled) {
+        return false;
+    }
+    _polled = polled;
+    _polledCapacity = count;
+
+    return !_sticks.enabled || EXIT_SUCCESS == stick_batch_reserve(&_pollSticks, 2 * count);
 }
 
 static void pollDevices()
 {
+    // Recorded input has no devices behind it.
+    if (_replaying) {
+        return;
+    }
+
+    if (!reservePolled(_gamepad.playerCount)) {
+        return;
+    }
+
+    int count = 0;
     int i;
-    for (i = 0; i < MAX_CONTROLLERS; i++) {
-        GameController* controller = &_controllers[i];
+    for (i = 0; i < _gamepad.playerCount; i++) {
+        GameController* controller = _gamepad.players[i];
 
         if (controller->handle) {
+            screen_device_t device = (screen_device_t)controller->handle;
+            PolledState* state = &_polled[count++];
+
+            memset(state, 0, sizeof(*state));
+            state->controller = controller;
+            state->time = input_ring_now();
+
             // Get the current state of a gamepad device.
-            SCREEN_API(screen_get_device_property_iv(controller->handle, SCREEN_PROPERTY_BUTTONS, &controller->buttons), "SCREEN_PROPERTY_BUTTONS");
+            SCREEN_API(screen_get_device_property_iv(device, SCREEN_PROPERTY_BUTTONS, &state->buttons), "SCREEN_PROPERTY_BUTTONS");
 
             if (controller->analogCount > 0) {
-            	SCREEN_API(screen_get_device_property_iv(controller->handle, SCREEN_PROPERTY_ANALOG0, controller->analog0), "SCREEN_PROPERTY_ANALOG0");
+            	SCREEN_API(screen_get_device_property_iv(device, SCREEN_PROPERTY_ANALOG0, state->analog0), "SCREEN_PROPERTY_ANALOG0");
             }
 
             if (controller->analogCount == 2) {
-            	SCREEN_API(screen_get_device_property_iv(controller->handle, SCREEN_PROPERTY_ANALOG1, controller->analog1), "SCREEN_PROPERTY_ANALOG1");
+            	SCREEN_API(screen_get_device_property_iv(device, SCREEN_PROPERTY_ANALOG1, state->analog1), "SCREEN_PROPERTY_ANALOG1");
             }
         }
     }
+
+    // The sticks of all controllers go through the vector kernels together.
+    if (_sticks.enabled) {
+        for (i = 0; i < count; i++) {
+            loadSticks(&_pollSticks, i, _polled[i].controller, INPUT_POLLING, _polled[i].analog0, _polled[i].analog1);
+        }
+        _pollSticks.count = 2 * count;
+        stick_process(&_sticks, &_pollSticks);
+        for (i = 0; i < count; i++) {
+            storeSticks(&_pollSticks, i, _polled[i].controller, INPUT_POLLING, _polled[i].analog0, _polled[i].analog1);
+        }
+    }
+
+    for (i = 0; i < count; i++) {
+        PolledState* state = &_polled[i];
+        queueState(state->controller, &state->controller->pollRing, state->time, state->buttons, state->analog0, state->analog1);
+        input_ring_flush(&state->controller->pollRing);
+    }
+}
+
+static void* pollThread(void* arg)
+{
+    const uint64_t period = 1000000000ULL / _pollRate;
+    uint64_t next = input_ring_now();
+
+    while (!_pollThreadStop) {
+        if (_gamepad.polling) {
+            pthread_mutex_lock(&_controllerMutex);
+            pollDevices();
+            pthread_mutex_unlock(&_controllerMutex);
+        }
+
+        // Sleep until the next sample is due.  If we fell behind, start counting from now.
+        uint64_t now = input_ring_now();
+        next += period;
+        if (next > now) {
+            struct timespec delay;
+            delay.tv_sec = (next - now) / 1000000000ULL;
+            delay.tv_nsec = (next - now) % 1000000000ULL;
+            nanosleep(&delay, NULL);
+        } else {
+            next = now;
+        }
+    }
+
+    return NULL;
 }
 
 static void handleScreenEvent(bps_event_t *event)
@@ -573,38 +525,43 @@ static void handleScreenEvent(bps_event_t *event)
     screen_event_t screen_event = screen_event_get_event(event);
     screen_get_event_property_iv(screen_event, SCREEN_PROPERTY_TYPE, &eventType);
 
+    // While a recording is replayed, live input would only get in the way.
+    if (_replaying) {
+        return;
+    }
+
     switch (eventType) {
         case SCREEN_EVENT_GAMEPAD:
         case SCREEN_EVENT_JOYSTICK:
         {
-            if (!_polling) {
+            if (!_gamepad.polling) {
                 // Determine which controller this is.
                 screen_device_t device;
                 SCREEN_API(screen_get_event_property_pv(screen_event, SCREEN_PROPERTY_DEVICE, (void**)&device), "SCREEN_PROPERTY_DEVICE");
 
-                GameController* controller = NULL;
-                int i;
-                for (i = 0; i < MAX_CONTROLLERS; ++i) {
-                    if (device == _controllers[i].handle) {
-                        controller = &_controllers[i];
-                        break;
-                    }
-                }
-
+                GameController* controller = gamepad_find(&_gamepad, device);
                 if (!controller) {
                     break;
                 }
 
-                // Store the controller's new state.
-                SCREEN_API(screen_get_event_property_iv(screen_event, SCREEN_PROPERTY_BUTTONS, &controller->buttons), "SCREEN_PROPERTY_BUTTONS");
+                // Queue the controller's new state for the next update().
+                int buttons = 0;
+                int analog0[3] = { 0, 0, 0 };
+                int analog1[3] = { 0, 0, 0 };
+                uint64_t time = input_ring_now();
+
+                SCREEN_API(screen_get_event_property_iv(screen_event, SCREEN_PROPERTY_BUTTONS, &buttons), "SCREEN_PROPERTY_BUTTONS");
 
                 if (controller->analogCount > 0) {
-                	SCREEN_API(screen_get_event_property_iv(screen_event, SCREEN_PROPERTY_ANALOG0, controller->analog0), "SCREEN_PROPERTY_ANALOG0");
+                	SCREEN_API(screen_get_event_property_iv(screen_event, SCREEN_PROPERTY_ANALOG0, analog0), "SCREEN_PROPERTY_ANALOG0");
                 }
 
                 if (controller->analogCount == 2) {
-                    SCREEN_API(screen_get_event_property_iv(screen_event, SCREEN_PROPERTY_ANALOG1, controller->analog1), "SCREEN_PROPERTY_ANALOG1");
+                    SCREEN_API(screen_get_event_property_iv(screen_event, SCREEN_PROPERTY_ANALOG1, analog1), "SCREEN_PROPERTY_ANALOG1");
                 }
+
+                processEventSticks(controller, analog0, analog1);
+                queueState(controller, &controller->eventRing, time, buttons, analog0, analog1);
             }
             break;
         }
@@ -622,22 +579,10 @@ static void handleScreenEvent(bps_event_t *event)
                 SCREEN_API(screen_get_device_property_iv(device, SCREEN_PROPERTY_TYPE, &type), "SCREEN_PROPERTY_TYPE");
             }
 
-            int i;
             if (attached && (type == SCREEN_EVENT_GAMEPAD || type == SCREEN_EVENT_JOYSTICK)) {
-                for (i = 0; i < MAX_CONTROLLERS; ++i) {
-                    if (!_controllers[i].handle) {
-                        _controllers[i].handle = device;
-                        loadController(&_controllers[i]);
-                        break;
-                    }
-                }
+                attachDevice(device);
             } else {
-                for (i = 0; i < MAX_CONTROLLERS; ++i) {
-                    if (device == _controllers[i].handle) {
-                        initController(&_controllers[i], i);
-                        break;
-                    }
-                }
+                detachDevice(device);
             }
 
             break;
@@ -647,47 +592,17 @@ static void handleScreenEvent(bps_event_t *event)
         {
             int pos[2];
             SCREEN_API(screen_get_event_property_iv(screen_event, SCREEN_PROPERTY_SOURCE_POSITION, pos), "SCREEN_PROPERTY_SOURCE_POSITION");
-            int x = pos[0];
-            int y = _surfaceHeight - pos[1];
-
-            int i;
-            for (i = 0; i < MAX_CONTROLLERS; ++i) {
-                bool buttonTapped = false;
-
-                int j;
-                for (j = 0; j < MAX_BUTTONS; ++j) {
-                    Button* button = &_buttons[i][j];
-                    Quad* quad = button->quad;
-
-                    // Detect that a button was tapped.
-                    if (x > quad->x && x < quad->x + quad->width &&
-                        y > quad->y && y < quad->y + quad->height) {
-                        _activeButton[i] = button;
-                        buttonTapped = true;
-                        break;
-                    }
-                }
 
-                if (_activeButton[i] && !buttonTapped) {
-                    // Cancel the button's active state.
-                    _activeButton[i] = NULL;
-                }
-            }
-
-            // The polling button is used to switch between handling all device events and polling devices once per frame.
-            Quad* quad = _pollingButton.quad;
-            if (x > quad->x && x < quad->x + quad->width &&
-                y > quad->y && y < quad->y + quad->height) {
-                _polling = !_polling;
-
-                // The polling button lights up when polling is enabled.
-                if (_polling) {
-                    quad->uvs = _triggerDownUVs;
-                } else {
-                    quad->uvs = _triggerUpUVs;
-                }
+            if (_recording.file) {
+                Record touch;
+                touch.type = RECORD_TOUCH;
+                touch.time = input_ring_now();
+                touch.x = pos[0];
+                touch.y = pos[1];
+                recordEvent(NULL, &touch);
             }
 
+            gamepad_touch(&_gamepad, pos[0], pos[1]);
             break;
         }
     }
@@ -731,9 +646,42 @@ static void handleEvents()
 
         if (BPS_SUCCESS != bps_get_event(&event, 0)) {
             fprintf(stderr, "bps_get_event() failed\n");
-            return;
+            break;
         }
     }
+
+    // Queue anything that had to be held back while the rings were full.
+    int i;
+    for (i = 0; i < _gamepad.playerCount; ++i) {
+        input_ring_flush(&_gamepad.players[i]->eventRing);
+    }
+}
+
+static void replayEvents()
+{
+    uint64_t elapsed = input_ring_now() - _replayStart;
+    int count = 0;
+
+    // At full speed every frame gets exactly one event, otherwise all events that are due.
+    while (_replayHasNext && (_replayMaxSpeed ? count == 0 : _replayNext.time <= elapsed)) {
+        record_apply(&_gamepad, &_replayNext);
+        _replayHasNext = record_read(&_replay, &_replayNext);
+        _replayEvents++;
+        count++;
+    }
+
+    _replayFrames++;
+
+    if (!_replayHasNext) {
+        double seconds = (input_ring_now() - _replayStart) / 1000000000.0;
+        fprintf(stderr, "Replayed %u events in %u frames over %.2f s, %.1f fps.\n",
+                _replayEvents, _replayFrames, seconds, _replayFrames / seconds);
+        record_close(&_replay);
+
+        // Leave the final state on screen, still ignoring live input.
+        _replayFrames = 0;
+        _replayStart = input_ring_now();
+    }
 }
 
 static void discoverControllers()
@@ -746,20 +694,14 @@ static void discoverControllers()
 
     // Scan the list for gamepad and joystick devices.
     int i;
-    int controllerIndex = 0;
     for (i = 0; i < deviceCount; i++) {
         int type;
         SCREEN_API(screen_get_device_property_iv(devices[i], SCREEN_PROPERTY_TYPE, &type), "SCREEN_PROPERTY_TYPE");
 
         if (!rc && (type == SCREEN_EVENT_GAMEPAD || type == SCREEN_EVENT_JOYSTICK)) {
-            // Assign this device to control Player 1 or Player 2.
-            GameController* controller = &_controllers[controllerIndex];
-            controller->handle = devices[i];
-            loadController(controller);
-
-            // We'll just use the first compatible devices we find.
-            controllerIndex++;
-            if (controllerIndex == MAX_CONTROLLERS) {
+            // Assign this device to the next player.
+            // Players are added as needed, so every compatible device gets one.
+            if (!attachDevice(devices[i])) {
                 break;
             }
         }
@@ -772,119 +714,159 @@ void update()
 {
     handleEvents();
 
-    if (_polling) {
+    if (_replaying) {
+        if (_replay.file) {
+            replayEvents();
+        }
+    } else if (_gamepad.polling && !_pollThreadRunning) {
         pollDevices();
     }
 
-    int i;
-    for (i = 0; i < MAX_CONTROLLERS; ++i) {
-        GameController* controller = &_controllers[i];
-
-        // If a button is active, map it to the first gamepad button pressed.
-        if (_activeButton[i]) {
-            int j;
-            for (j = 0; j < controller->buttonCount; ++j) {
-                if (controller->buttons & _buttonMappings[j]) {
-                    // Erase old button mapping if one exists.
-                    int k;
-                    for (k = 0; k < MAX_BUTTONS; ++k) {
-                        Button* button = &_buttons[i][k];
-                        if (_buttonMappings[j] & button->mapping) {
-                            button->mapping = 0;
-                            break;
-                        }
-                    }
-
-                    // Set new button mapping.
-                    _activeButton[i]->mapping = _buttonMappings[j];
-                    _activeButton[i] = NULL;
-                    break;
-                }
-            }
-        }
+    gamepad_update(&_gamepad);
 
-        float xOffset = (_surfaceWidth * 0.5f)*i;
+    // Remapping is rare and done by hand, so the profiles are written right away.
+    if (_gamepad.profilesChanged) {
+        profile_save(&_gamepad.profiles, _profilePath);
+        _gamepad.profilesChanged = false;
+    }
+}
 
-        // Set the inner joystick positions.
-        if (controller->analogCount > 0) {
-			_analog0Inner[i]->x = ANALOG0_X + xOffset + (controller->analog0[0] >> 2);
-			_analog0Inner[i]->y = ANALOG_Y - (controller->analog0[1] >> 2);
-			sprintf(controller->analog0String, "Analog 0: (%4d, %4d, %4d)", controller->analog0[0], controller->analog0[1], controller->analog0[2]);
-        } else {
-        	sprintf(controller->analog0String, "Analog 0: N/A");
+static void uploadGeometry()
+{
+    // Texture coordinates start right after the vertex coordinates, both arrays have the same size.
+    const GLsizeiptr arraySize = (_gamepad.quadCapacity * QUAD_VERTEX_COORDS + 2) * sizeof(float);
+    uint64_t bytes = 0;
+
+    glBindBuffer(GL_ARRAY_BUFFER, _vertexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer);
+
+    if (_bufferQuads != _gamepad.quadCapacity) {
+        // The arrays were reallocated: size the buffers to match and send everything once.
+        const GLsizeiptr indexSize = _gamepad.quadCapacity * QUAD_INDICES * sizeof(unsigned short);
+
+        glBufferData(GL_ARRAY_BUFFER, arraySize * 2, NULL, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, arraySize, _gamepad.vertices);
+        glBufferSubData(GL_ARRAY_BUFFER, arraySize, arraySize, _gamepad.textureCoords);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexSize, _gamepad.indices, GL_STATIC_DRAW);
+
+        _bufferQuads = _gamepad.quadCapacity;
+        bytes = arraySize * 2 + indexSize;
+    } else {
+        // Only the quads that changed since the last frame.
+        int i;
+        for (i = 0; i < _gamepad.dirtyRunCount; ++i) {
+            const int first = _gamepad.dirtyRuns[i*2];
+            const int end = _gamepad.dirtyRuns[i*2 + 1];
+            const GLintptr offset = first * QUAD_VERTEX_COORDS * sizeof(float);
+            const GLsizeiptr size = (end - first) * QUAD_VERTEX_COORDS * sizeof(float);
+
+            glBufferSubData(GL_ARRAY_BUFFER, offset, size, &_gamepad.vertices[first * QUAD_VERTEX_COORDS]);
+            glBufferSubData(GL_ARRAY_BUFFER, arraySize + offset, size, &_gamepad.textureCoords[first * QUAD_TEXCOORDS]);
+            bytes += size * 2;
         }
+    }
+
+    glVertexPointer(2, GL_FLOAT, 0, (const GLvoid*)0);
+    glTexCoordPointer(2, GL_FLOAT, 0, (const GLvoid*)arraySize);
+
+    _uploadBytes += bytes;
+}
+
+static void layoutPlayerText(text_batch_t* batch, const GameController* controller)
+{
+    const Button* buttons = controller->virtualButtons;
+    const float scale = controller->scale;
+    const float x = controller->left + 5;
+    const float top = controller->bottom + controller->cellHeight;
+
+    bbutil_clear_text_batch(batch);
+    bbutil_add_text(batch, _font, controller->deviceString, x, top - 20);
 
-        if (controller->analogCount == 2) {
-			_analog1Inner[i]->x = ANALOG1_X + xOffset + (controller->analog1[0] >> 2);
-			_analog1Inner[i]->y = ANALOG_Y - (controller->analog1[1] >> 2);
-			sprintf(controller->analog1String, "Analog 1: (%4d, %4d, %4d)", controller->analog1[0], controller->analog1[1], controller->analog1[2]);
+    if (!controller->handle) {
+        return;
+    }
+
+    // Controller is connected; display info about its current state.
+    bbutil_add_text(batch, _font, controller->buttonsString, x, top - 40);
+    bbutil_add_text(batch, _font, controller->analog0String, x, top - 60);
+    bbutil_add_text(batch, _font, controller->analog1String, x, top - 80);
+
+    // Label offsets follow the scale of the player's controls.
+    // Only draw L3 and R3 labels if they're present.
+    if (controller->analogCount == 2) {
+        bbutil_add_text(batch, _font, buttons[2].label, buttons[2].quad->x + 30*scale, buttons[2].quad->y + 30*scale);
+        bbutil_add_text(batch, _font, buttons[3].label, buttons[3].quad->x + 30*scale, buttons[3].quad->y + 30*scale);
+    } else if (controller->analogCount == 1) {
+        bbutil_add_text(batch, _font, buttons[3].label, buttons[3].quad->x + 30*scale, buttons[3].quad->y + 30*scale);
+    }
+
+    // L2, R2 labels.
+    bbutil_add_text(batch, _font, buttons[0].label, buttons[0].quad->x + 20*scale, buttons[0].quad->y + 20*scale);
+    bbutil_add_text(batch, _font, buttons[1].label, buttons[1].quad->x + 20*scale, buttons[1].quad->y + 20*scale);
+
+    // Button labels.
+    int j;
+    for (j = 4; j < MAX_BUTTONS; ++j) {
+        const Button* button = &buttons[j];
+        if (button->type == DIGITAL_TRIGGER) {
+            bbutil_add_text(batch, _font, button->label, button->quad->x + 20*scale, button->quad->y + 20*scale);
+        } else if (button->type == DPAD_UP) {
+            bbutil_add_text(batch, _font, button->label, button->quad->x + 30*scale, button->quad->y + 70*scale);
+        } else if (button->type == DPAD_RIGHT) {
+            bbutil_add_text(batch, _font, button->label, button->quad->x + 70*scale, button->quad->y + 30*scale);
         } else {
-        	sprintf(controller->analog1String, "Analog 1: N/A");
+            bbutil_add_text(batch, _font, button->label, button->quad->x + 30*scale, button->quad->y + 30*scale);
         }
+    }
+}
 
-        // Set the button UVs to correspond to their states, as well as the button text.
-        sprintf(controller->buttonsString, "Buttons: ");
-        int j;
-        for (j = 0; j < MAX_BUTTONS; ++j) {
-            Button* button = &_buttons[i][j];
+static bool reservePlayerText(int count)
+{
+    if (count <= _playerTextCount) {
+        return true;
+    }
 
-            if ((controller->buttons & button->mapping) || button == _activeButton[i]) {
-                switch (button->type) {
-                case DPAD_LEFT:
-                    button->quad->uvs = _leftDPadDownUVs;
-                    break;
-                case DPAD_RIGHT:
-                    button->quad->uvs = _rightDPadDownUVs;
-                    break;
-                case DPAD_UP:
-                    button->quad->uvs = _upDPadDownUVs;
-                    break;
-                case DPAD_DOWN:
-                    button->quad->uvs = _downDPadDownUVs;
-                    break;
-                case DIGITAL_TRIGGER:
-                case ANALOG_TRIGGER:
-                    button->quad->uvs = _triggerDownUVs;
-                    break;
-                case BUTTON:
-                    button->quad->uvs = _buttonDownUVs;
-                    break;
-                }
-            } else {
-                switch (button->type) {
-                case DPAD_LEFT:
-                    button->quad->uvs = _leftDPadUpUVs;
-                    break;
-                case DPAD_RIGHT:
-                    button->quad->uvs = _rightDPadUpUVs;
-                    break;
-                case DPAD_UP:
-                    button->quad->uvs = _upDPadUpUVs;
-                    break;
-                case DPAD_DOWN:
-                    button->quad->uvs = _downDPadUpUVs;
-                    break;
-                case DIGITAL_TRIGGER:
-                case ANALOG_TRIGGER:
-                    button->quad->uvs = _triggerUpUVs;
-                    break;
-                case BUTTON:
-                    button->quad->uvs = _buttonUpUVs;
-                    break;
-                }
-            }
+    PlayerText* playerText = (PlayerText*)realloc(_playerText, count * sizeof(PlayerText));
+    if (!playerText) {
+        return false;
+    }
+    _playerText = playerText;
+
+    for (; _playerTextCount < count; ++_playerTextCount) {
+        _playerText[_playerTextCount].batch = bbutil_create_text_batch();
+        _playerText[_playerTextCount].serial = 0;
+        if (!_playerText[_playerTextCount].batch) {
+            return false;
         }
+    }
 
-        // Append button indices to the string showing which buttons are pressed,
-        // regardless of whether or not the buttons are mapped.
-        char buttonString[4];
-        for (j = 0; j < controller->buttonCount; ++j) {
-            if (_buttonMappings[j] & controller->buttons) {
-                sprintf(buttonString, "%d ", j);
-                strcat(controller->buttonsString, buttonString);
-            }
+    return true;
+}
+
+static void measureLatency()
+{
+    // The frame that was just swapped is the first to show the changes taken in by the last update().
+    const uint64_t now = input_ring_now();
+
+    int source;
+    for (source = 0; source < INPUT_SOURCE_COUNT; ++source) {
+        int i;
+        for (i = 0; i < _gamepad.edgeCount[source]; ++i) {
+            latency_add(&_latency[source], now - _gamepad.edgeTimes[source][i]);
         }
     }
+
+    if (now - _latencyReported >= LATENCY_REPORT_INTERVAL) {
+        fprintf(stderr, "Input to swap latency:\n");
+        latency_report(stderr, LATENCY_NAMES, _latency, INPUT_SOURCE_COUNT);
+        _latencyReported = now;
+    }
+}
+
+// Byte offset of an index in the bound index buffer, as glDrawElements() expects it.
+static const GLvoid* indexOffset(int index)
+{
+    return (const GLvoid*)(index * sizeof(unsigned short));
 }
 
 void render()
@@ -892,34 +874,14 @@ void render()
     // Clear the screen.
     glClear(GL_COLOR_BUFFER_BIT);
 
-    // Populate vertex and texture coordinate arrays.
-    int i;
-    for (i = 0; i < QUAD_COUNT; ++i) {
-        const GLfloat x = _quads[i].x;
-        const GLfloat y = _quads[i].y;
-        const GLfloat width = _quads[i].width;
-        const GLfloat height = _quads[i].height;
-        _vertices[i*8 + 0] = x;
-        _vertices[i*8 + 1] = y;
-        _vertices[i*8 + 2] = x + width;
-        _vertices[i*8 + 3] = y;
-        _vertices[i*8 + 4] = x;
-        _vertices[i*8 + 5] = y + height;
-        _vertices[i*8 + 6] = x + width;
-        _vertices[i*8 + 7] = y + height;
-
-        const GLfloat u1 = _quads[i].uvs[0];
-        const GLfloat v1 = _quads[i].uvs[1];
-        const GLfloat u2 = _quads[i].uvs[2];
-        const GLfloat v2 = _quads[i].uvs[3];
-        _textureCoords[i*8 + 0] = u1;
-        _textureCoords[i*8 + 1] = v2;
-        _textureCoords[i*8 + 2] = u2;
-        _textureCoords[i*8 + 3] = v2;
-        _textureCoords[i*8 + 4] = u1;
-        _textureCoords[i*8 + 5] = v1;
-        _textureCoords[i*8 + 6] = u2;
-        _textureCoords[i*8 + 7] = v1;
+    // Update the vertex and texture coordinate arrays, then send the changes to the GPU.
+    gamepad_build(&_gamepad);
+
+    // One cached text layout per player.
+    if (!reservePlayerText(_gamepad.playerCount)) {
+        fprintf(stderr, "Unable to allocate player text.\n");
+        _shutdown = true;
+        return;
     }
 
     // Draw the virtual gamepad.
@@ -931,13 +893,12 @@ void render()
     glEnableClientState(GL_VERTEX_ARRAY);
     glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
-    glVertexPointer(2, GL_FLOAT, 0, _vertices);
-    glTexCoordPointer(2, GL_FLOAT, 0, _textureCoords);
+    uploadGeometry();
     glBindTexture(GL_TEXTURE_2D, _gamepadTexture);
 
-    if (_controllers[0].handle || _controllers[1].handle) {
-		// Draw the polling button.
-		glDrawElements(GL_TRIANGLE_STRIP, 6, GL_UNSIGNED_SHORT, _indices + 240);
+    if (gamepad_connected(&_gamepad)) {
+        // Draw the polling button, which follows the quads of the last player.
+        glDrawElements(GL_TRIANGLE_STRIP, 6, GL_UNSIGNED_SHORT, indexOffset(_gamepad.playerCount * PLAYER_QUADS * QUAD_INDICES));
     }
 
     // Draw only connected controllers.
@@ -948,93 +909,95 @@ void render()
     // Otherwise, we tint L2 and R2 using the analog values from the triggers.
 
     // Only draw the analog sticks and their buttons (L3, R3) if they're present.
-    for (i = 0; i < MAX_CONTROLLERS; ++i) {
-    	GameController* controller = &_controllers[i];
-    	if (controller->handle) {
-    		float tint = 1.0f;
-    		if (!(controller->buttons & _buttons[i][0].mapping) && &_buttons[i][0] != _activeButton[i]) {
-    			tint = 0.5f + 0.5f*(float)controller->analog0[2] / 255.0f;
-    		}
-    		glColor4f(tint, 0.0f, 0.0f, 1.0f);
-    		glDrawElements(GL_TRIANGLE_STRIP, 6, GL_UNSIGNED_SHORT, _indices + i*120);
-
-    		tint = 1.0f;
-    		if (!(controller->buttons & _buttons[i][1].mapping) && &_buttons[i][1] != _activeButton[i]) {
-				tint = 0.5f + 0.5f*(float)controller->analog1[2] / 255.0f;
-			}
-			glColor4f(tint, 0.0f, 0.0f, 1.0f);
-			glDrawElements(GL_TRIANGLE_STRIP, 6, GL_UNSIGNED_SHORT, _indices + 6 + i*120);
-
-			glColor4f(1.0f, 0.0f, 0.0f, 1.0f);
-    		if (controller->analogCount == 2) {
-    			glDrawElements(GL_TRIANGLE_STRIP, 108, GL_UNSIGNED_SHORT, _indices + 12 + i*120);
-    		} else if (controller->analogCount == 1) {
-    			glDrawElements(GL_TRIANGLE_STRIP, 90, GL_UNSIGNED_SHORT, _indices + 30 + i*120);
-    		} else {
-    			glDrawElements(GL_TRIANGLE_STRIP, 72, GL_UNSIGNED_SHORT, _indices + 48 + i*120);
-    		}
-    	}
+    int i;
+    for (i = 0; i < _gamepad.playerCount; ++i) {
+        GameController* controller = _gamepad.players[i];
+        const Button* buttons = controller->virtualButtons;
+        const int first = i * PLAYER_QUADS * QUAD_INDICES;
+
+        if (controller->handle) {
+            float tint = 1.0f;
+            if (!(controller->mappedButtons & (1 << 0)) && &buttons[0] != controller->activeButton) {
+                tint = 0.5f + 0.5f*(float)controller->analog0[2] / 255.0f;
+            }
+            glColor4f(tint, 0.0f, 0.0f, 1.0f);
+            glDrawElements(GL_TRIANGLE_STRIP, 6, GL_UNSIGNED_SHORT, indexOffset(first));
+
+            tint = 1.0f;
+            if (!(controller->mappedButtons & (1 << 1)) && &buttons[1] != controller->activeButton) {
+                tint = 0.5f + 0.5f*(float)controller->analog1[2] / 255.0f;
+            }
+            glColor4f(tint, 0.0f, 0.0f, 1.0f);
+            glDrawElements(GL_TRIANGLE_STRIP, 6, GL_UNSIGNED_SHORT, indexOffset(first + 6));
+
+            glColor4f(1.0f, 0.0f, 0.0f, 1.0f);
+            if (controller->analogCount == 2) {
+                glDrawElements(GL_TRIANGLE_STRIP, 108, GL_UNSIGNED_SHORT, indexOffset(first + 12));
+            } else if (controller->analogCount == 1) {
+                glDrawElements(GL_TRIANGLE_STRIP, 90, GL_UNSIGNED_SHORT, indexOffset(first + 30));
+            } else {
+                glDrawElements(GL_TRIANGLE_STRIP, 72, GL_UNSIGNED_SHORT, indexOffset(first + 48));
+            }
+        }
     }
 
+    // The text is drawn from client memory.
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
     glDisableClientState(GL_TEXTURE_COORD_ARRAY);
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisable(GL_TEXTURE_2D);
     glDisable(GL_BLEND);
 
-    // Use utility code to render text.
-    // Only draw L3 and R3 labels if they're present.
-    for (i = 0; i < MAX_CONTROLLERS; ++i) {
-		GameController* controller = &_controllers[i];
-		if (controller->handle) {
-			if (controller->analogCount == 2) {
-    			bbutil_render_text(_font, _buttons[i][2].label, _buttons[i][2].quad->x + 30, _buttons[i][2].quad->y + 30, 1.0f, 0.0f, 0.0f, 1.0f);
-    			bbutil_render_text(_font, _buttons[i][3].label, _buttons[i][3].quad->x + 30, _buttons[i][3].quad->y + 30, 1.0f, 0.0f, 0.0f, 1.0f);
-			} else if (controller->analogCount == 1) {
-    			bbutil_render_text(_font, _buttons[i][3].label, _buttons[i][3].quad->x + 30, _buttons[i][3].quad->y + 30, 1.0f, 0.0f, 0.0f, 1.0f);
-			}
-		}
-    }
-
-    // Now render the rest of the text.
-    for (i = 0; i < MAX_CONTROLLERS; ++i) {
-        GameController* controller = &_controllers[i];
-        float xOffset = (_surfaceWidth * 0.5f)*i;
-
-        bbutil_render_text(_font, controller->deviceString, 5 + xOffset, _surfaceHeight - 20, 1.0f, 0.0f, 0.0f, 1.0f);
+    // Use utility code to render text.  Each player's text is laid out once and kept until it changes.
+    for (i = 0; i < _gamepad.playerCount; ++i) {
+        GameController* controller = _gamepad.players[i];
 
-        if (controller->handle) {
-            // Controller is connected; display info about its current state.
-            bbutil_render_text(_font, controller->buttonsString, 5 + xOffset, _surfaceHeight - 40, 1.0f, 0.0f, 0.0f, 1.0f);
-            bbutil_render_text(_font, controller->analog0String, 5 + xOffset, _surfaceHeight - 60, 1.0f, 0.0f, 0.0f, 1.0f);
-            bbutil_render_text(_font, controller->analog1String, 5 + xOffset, _surfaceHeight - 80, 1.0f, 0.0f, 0.0f, 1.0f);
-
-            // L2, R2 labels.
-            bbutil_render_text(_font, _buttons[i][0].label, _buttons[i][0].quad->x + 20, _buttons[i][0].quad->y + 20, 1.0f, 0.0f, 0.0f, 1.0f);
-            bbutil_render_text(_font, _buttons[i][1].label, _buttons[i][1].quad->x + 20, _buttons[i][1].quad->y + 20, 1.0f, 0.0f, 0.0f, 1.0f);
-
-            // Button labels.
-            int j;
-            for (j = 4; j < MAX_BUTTONS; ++j) {
-                Button* button = &_buttons[i][j];
-                if (button->type == DIGITAL_TRIGGER) {
-                    bbutil_render_text(_font, button->label, button->quad->x + 20, button->quad->y + 20, 1.0f, 0.0f, 0.0f, 1.0f);
-                } else if (button->type == DPAD_UP) {
-                    bbutil_render_text(_font, button->label, button->quad->x + 30, button->quad->y + 70, 1.0f, 0.0f, 0.0f, 1.0f);
-                } else if (button->type == DPAD_RIGHT) {
-                    bbutil_render_text(_font, button->label, button->quad->x + 70, button->quad->y + 30, 1.0f, 0.0f, 0.0f, 1.0f);
-                } else {
-                    bbutil_render_text(_font, button->label, button->quad->x + 30, button->quad->y + 30, 1.0f, 0.0f, 0.0f, 1.0f);
-                }
-            }
+        if (_playerText[i].serial != controller->textSerial) {
+            layoutPlayerText(_playerText[i].batch, controller);
+            _playerText[i].serial = controller->textSerial;
+            _textLayouts++;
         }
+
+        bbutil_render_text_batch(_playerText[i].batch, _font, 1.0f, 0.0f, 0.0f, 1.0f);
     }
 
-    if (_controllers[0].handle || _controllers[1].handle) {
-        bbutil_render_text(_font, _pollingButton.label, _pollingButton.quad->x + 20, _pollingButton.quad->y + 20, 1.0f, 0.0f, 0.0f, 1.0f);
+    if (gamepad_connected(&_gamepad)) {
+        bbutil_render_text_batch(_pollingText, _font, 1.0f, 0.0f, 0.0f, 1.0f);
     }
 
     // Use utility code to update the screen.
     bbutil_swap();
+
+    if (_measureLatency) {
+        measureLatency();
+    }
+}
+
+// CPU time used by the calling thread, in nanoseconds.
+static uint64_t threadTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void logFrame(uint64_t cpuTime)
+{
+    _frameCpuTime += cpuTime;
+
+    if (++_loggedFrames == LOG_FRAMES) {
+        fprintf(stderr, "%.0f us CPU per frame, uploaded %.0f bytes per frame (%d bytes for all %d quads),"
+                " %u text layouts in %u frames.\n",
+                _frameCpuTime / 1000.0 / _loggedFrames, (double)_uploadBytes / _loggedFrames,
+                (int)(_gamepad.quadCount * QUAD_VERTEX_COORDS * sizeof(float) * 2), _gamepad.quadCount,
+                _textLayouts, _loggedFrames);
+        _frameCpuTime = 0;
+        _uploadBytes = 0;
+        _textLayouts = 0;
+        _loggedFrames = 0;
+    }
 }
 
 int main(int argc, char **argv)
@@ -1075,14 +1038,88 @@ int main(int argc, char **argv)
         return 0;
     }
 
+    // GAMEPAD_STICK_CURVE takes one exponent for both axes, or "x,y".
+    StickSettings stickSettings = { 0, { 100, 100 }, 0 };
+    const char* stickValue = getenv("GAMEPAD_STICK_DEAD_ZONE");
+    if (stickValue) {
+        stickSettings.deadZone = atoi(stickValue);
+    }
+    stickValue = getenv("GAMEPAD_STICK_CURVE");
+    if (stickValue) {
+        const char* comma = strchr(stickValue, ',');
+        stickSettings.curve[0] = stickSettings.curve[1] = atoi(stickValue);
+        if (comma) {
+            stickSettings.curve[1] = atoi(comma + 1);
+        }
+    }
+    stickValue = getenv("GAMEPAD_STICK_JITTER");
+    if (stickValue) {
+        stickSettings.jitter = atoi(stickValue);
+    }
+    stick_setup(&_sticks, &stickSettings);
+    if (_sticks.enabled && (EXIT_SUCCESS != stick_batch_init(&_eventSticks, 2)
+            || EXIT_SUCCESS != stick_batch_init(&_pollSticks, 2 * MIN_PLAYERS))) {
+        fprintf(stderr, "Unable to allocate stick batches, stick processing is off.\n");
+        _sticks.enabled = false;
+    }
+
+    // GAMEPAD_REPLAY plays back a recording made with GAMEPAD_RECORD instead of using live devices.
+    // GAMEPAD_REPLAY_SPEED=max feeds one event per frame regardless of the recorded timing.
+    const char* replay = getenv("GAMEPAD_REPLAY");
+    const char* record = getenv("GAMEPAD_RECORD");
+    if (replay && EXIT_SUCCESS == record_open(&_replay, replay)) {
+        const char* speed = getenv("GAMEPAD_REPLAY_SPEED");
+        _replaying = true;
+        _replayMaxSpeed = speed && !strcmp(speed, "max");
+        _replayHasNext = record_read(&_replay, &_replayNext);
+        _replayStart = input_ring_now();
+    } else if (record) {
+        record_create(&_recording, record);
+    }
+
     // Look for attached gamepad and joystick devices.
-    discoverControllers();
+    if (!_replaying) {
+        discoverControllers();
+    }
+
+    // GAMEPAD_POLL_RATE samples controllers from a separate thread while polling is enabled.
+    const char* pollRate = getenv("GAMEPAD_POLL_RATE");
+    _pollRate = pollRate ? atoi(pollRate) : 0;
+    if (_pollRate > 0) {
+        _pollThreadStop = false;
+        _pollThreadRunning = (pthread_create(&_pollThread, NULL, pollThread, NULL) == 0);
+        if (!_pollThreadRunning) {
+            fprintf(stderr, "Unable to start the poll thread, polling once per frame.\n");
+        }
+    }
+
+    // GAMEPAD_LATENCY reports how long button changes take to reach the screen.
+    _measureLatency = (getenv("GAMEPAD_LATENCY") != NULL);
+    if (_measureLatency) {
+        int source;
+        for (source = 0; source < INPUT_SOURCE_COUNT; ++source) {
+            latency_init(&_latency[source]);
+        }
+        _latencyReported = input_ring_now();
+    }
+
+    // GAMEPAD_BENCH logs the input ring stress test before starting, and the cost of frames while running.
+    _logFrames = (getenv("GAMEPAD_BENCH") != NULL);
+    if (_logFrames) {
+        bench_input_ring(stderr, BENCH_EVENT_RATE, BENCH_SECONDS);
+    }
 
     // Enter the event loop.
     while (!_shutdown) {
+        uint64_t start = threadTime();
+
         update();
 
         render();
+
+        if (_logFrames) {
+            logFrame(threadTime() - start);
+        }
     }
 
     // Clean up resources and shut everything down.
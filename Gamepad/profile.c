@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "profile.h"
+
+static const char MAGIC[4] = { 'G', 'P', 'M', 'P' };
+static const int VERSION = 1;
+
+// Largest profile: id length and id, buttons, and flags, scale and dead zone of each axis.
+#define MAX_PROFILE_SIZE (1 + 63 + PROFILE_BUTTONS + PROFILE_AXES * 4)
+
+// Full deflection of a stick in either direction, and of a trigger.
+static const int STICK_RANGE = 128;
+static const int TRIGGER_RANGE = 255;
+
+void profile_store_init(ProfileStore* store)
+{
+    store->profiles = NULL;
+    store->count = 0;
+    store->capacity = 0;
+}
+
+void profile_store_free(ProfileStore* store)
+{
+    free(store->profiles);
+    profile_store_init(store);
+}
+
+const Profile* profile_find(const ProfileStore* store, const char* id)
+{
+    // Only profiles of devices ever attached are kept, and this runs when a device is attached.
+    int i;
+    for (i = 0; i < store->count; ++i) {
+        if (!strcmp(store->profiles[i].id, id)) {
+            return &store->profiles[i];
+        }
+    }
+
+    return NULL;
+}
+
+int profile_put(ProfileStore* store, const Profile* profile)
+{
+    Profile* existing = (Profile*)profile_find(store, profile->id);
+    if (existing) {
+        *existing = *profile;
+        return EXIT_SUCCESS;
+    }
+
+    if (store->count == store->capacity) {
+        int capacity = store->capacity ? store->capacity * 2 : 4;
+        Profile* profiles = (Profile*)realloc(store->profiles, capacity * sizeof(Profile));
+        if (!profiles) {
+            return EXIT_FAILURE;
+        }
+        store->profiles = profiles;
+        store->capacity = capacity;
+    }
+
+    store->profiles[store->count++] = *profile;
+
+    return EXIT_SUCCESS;
+}
+
+static bool readProfile(FILE* file, Profile* profile)
+{
+    uint8_t buffer[MAX_PROFILE_SIZE];
+    size_t length;
+
+    if (fread(buffer, 1, 1, file) != 1) {
+        return false;
+    }
+
+    length = buffer[0];
+    if (length >= sizeof(profile->id)) {
+        return false;
+    }
+    if (length && fread(profile->id, length, 1, file) != 1) {
+        return false;
+    }
+    profile->id[length] = '\0';
+
+    if (fread(buffer, PROFILE_BUTTONS + PROFILE_AXES * 4, 1, file) != 1) {
+        return false;
+    }
+
+    const uint8_t* p = buffer;
+    int i;
+    for (i = 0; i < PROFILE_BUTTONS; ++i, ++p) {
+        profile->buttons[i] = (*p < 32) ? *p : -1;
+    }
+
+    for (i = 0; i < PROFILE_AXES; ++i, p += 4) {
+        profile->axes[i].invert = (p[0] & 1) != 0;
+        profile->axes[i].scale = p[1] | (p[2] << 8);
+        profile->axes[i].deadZone = p[3];
+    }
+
+    return true;
+}
+
+int profile_load(ProfileStore* store, const char* path)
+{
+    uint8_t header[8];
+    Profile profile;
+
+    store->count = 0;
+
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return EXIT_SUCCESS;
+    }
+
+    if (fread(header, sizeof(header), 1, file) != 1
+            || memcmp(header, MAGIC, sizeof(MAGIC)) || header[4] != VERSION) {
+        fprintf(stderr, "%s is not a Gamepad profile file\n", path);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    while (readProfile(file, &profile)) {
+        if (EXIT_SUCCESS != profile_put(store, &profile)) {
+            fclose(file);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Stopping anywhere but at the end means the file is damaged.  The profiles read so far are kept.
+    if (!feof(file)) {
+        fprintf(stderr, "Unable to read all profiles from %s\n", path);
+        fclose(file);
+        return EXIT_FAILURE;
+    }
+
+    fclose(file);
+
+    return EXIT_SUCCESS;
+}
+
+static void writeProfile(FILE* file, const Profile* profile)
+{
+    uint8_t buffer[MAX_PROFILE_SIZE];
+    uint8_t* p = buffer;
+    size_t length = strlen(profile->id);
+
+    *p++ = (uint8_t)length;
+    memcpy(p, profile->id, length);
+    p += length;
+
+    int i;
+    for (i = 0; i < PROFILE_BUTTONS; ++i) {
+        *p++ = (profile->buttons[i] >= 0 && profile->buttons[i] < 32) ? profile->buttons[i] : 255;
+    }
+
+    for (i = 0; i < PROFILE_AXES; ++i) {
+        const AxisSettings* axis = &profile->axes[i];
+        *p++ = axis->invert ? 1 : 0;
+        *p++ = axis->scale & 0xff;
+        *p++ = (axis->scale >> 8) & 0xff;
+        *p++ = (uint8_t)axis->deadZone;
+    }
+
+    fwrite(buffer, p - buffer, 1, file);
+}
+
+int profile_save(const ProfileStore* store, const char* path)
+{
+    uint8_t header[8] = { 0 };
+    size_t length = strlen(path);
+    char* temp = (char*)malloc(length + 5);
+
+    if (!temp) {
+        return EXIT_FAILURE;
+    }
+    memcpy(temp, path, length);
+    memcpy(temp + length, ".tmp", 5);
+
+    FILE* file = fopen(temp, "wb");
+    if (!file) {
+        fprintf(stderr, "Unable to create %s\n", temp);
+        free(temp);
+        return EXIT_FAILURE;
+    }
+
+    memcpy(header, MAGIC, sizeof(MAGIC));
+    header[4] = VERSION;
+    fwrite(header, sizeof(header), 1, file);
+
+    int i;
+    for (i = 0; i < store->count; ++i) {
+        writeProfile(file, &store->profiles[i]);
+    }
+
+    // Only replace the old file once the new one is complete.
+    bool written = !ferror(file);
+    if (fclose(file) != 0) {
+        written = false;
+    }
+
+    if (!written || rename(temp, path) != 0) {
+        fprintf(stderr, "Unable to save profiles to %s\n", path);
+        remove(temp);
+        free(temp);
+        return EXIT_FAILURE;
+    }
+
+    free(temp);
+
+    return EXIT_SUCCESS;
+}
+
+int profile_map_axis(const AxisSettings* settings, bool trigger, int raw)
+{
+    const int range = trigger ? TRIGGER_RANGE : STICK_RANGE;
+    const int low = trigger ? 0 : -STICK_RANGE;
+    const int high = trigger ? TRIGGER_RANGE : STICK_RANGE - 1;
+
+    if (raw < low) {
+        raw = low;
+    } else if (raw > high) {
+        raw = high;
+    }
+
+    int deadZone = settings->deadZone;
+    if (deadZone < 0) {
+        deadZone = 0;
+    } else if (deadZone >= range) {
+        deadZone = range - 1;
+    }
+
+    int magnitude = raw < 0 ? -raw : raw;
+    int value = 0;
+    if (magnitude > deadZone) {
+        value = (int)((int64_t)(magnitude - deadZone) * range * settings->scale / ((int64_t)(range - deadZone) * PROFILE_SCALE_ONE));
+    }
+
+    if (raw < 0) {
+        value = -value;
+    }
+
+    // A stick turns around its centre, a trigger reads as released when fully pressed.
+    if (settings->invert && !trigger) {
+        value = -value;
+    }
+
+    if (value < low) {
+        value = low;
+    } else if (value > high) {
+        value = high;
+    }
+
+    if (settings->invert && trigger) {
+        value = TRIGGER_RANGE - value;
+    }
+
+    return value;
+}
+
+void profile_build_axis_table(const AxisSettings* settings, bool trigger, int16_t table[PROFILE_AXIS_VALUES])
+{
+    int i;
+    for (i = 0; i < PROFILE_AXIS_VALUES; ++i) {
+        table[i] = (int16_t)profile_map_axis(settings, trigger, PROFILE_AXIS_MIN + i);
+    }
+}
+
+void profile_build_button_table(const int buttons[PROFILE_BUTTONS], uint16_t table[4][256])
+{
+    memset(table, 0, 4 * 256 * sizeof(uint16_t));
+
+    // Every byte value that has a mapped bit set lights that bit's on-screen buttons.
+    int i;
+    for (i = 0; i < PROFILE_BUTTONS; ++i) {
+        const int bit = buttons[i];
+        if (bit < 0 || bit >= 32) {
+            continue;
+        }
+
+        int value;
+        for (value = 0; value < 256; ++value) {
+            if (value & (1 << (bit & 7))) {
+                table[bit >> 3][value] |= 1 << i;
+            }
+        }
+    }
+}
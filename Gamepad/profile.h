@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// On-screen buttons a profile maps device buttons to.
+#define PROFILE_BUTTONS 16
+
+// analog0 x, y, z followed by analog1 x, y, z.  The z axes are the triggers.
+#define PROFILE_AXES 6
+
+// A scale of PROFILE_SCALE_ONE leaves an axis as it is.
+#define PROFILE_SCALE_ONE 256
+
+// Raw axis values covered by an axis table, from PROFILE_AXIS_MIN.  Values outside are clamped.
+#define PROFILE_AXIS_MIN (-256)
+#define PROFILE_AXIS_VALUES 512
+
+// How one analog axis is turned into the value shown.
+typedef struct AxisSettings_t {
+    bool invert;
+
+    // Multiplier in 1/PROFILE_SCALE_ONE units, applied after the dead zone.
+    int scale;
+
+    // Raw values this close to rest read as rest.  The remaining travel is
+    // stretched so that full deflection still reads as full deflection.
+    int deadZone;
+} AxisSettings;
+
+// Button mapping and axis settings for one kind of device.
+typedef struct Profile_t {
+    char id[64];
+
+    // The device button bit shown by each on-screen button, or -1 if none.
+    int buttons[PROFILE_BUTTONS];
+
+    AxisSettings axes[PROFILE_AXES];
+} Profile;
+
+/**
+ * The profiles of all devices seen so far, keyed by device id.
+ *
+ * The file starts with the magic "GPMP" and a version byte followed by three
+ * reserved bytes.  Each profile is then stored as the length of its id
+ * (8 bits) and the id, one byte per on-screen button holding the device
+ * button bit or 255 if unmapped, and for each axis a flags byte (bit 0:
+ * invert), the scale (16 bits) and the dead zone (8 bits).  All values are
+ * little endian, so a profile takes 41 bytes plus its id.
+ */
+typedef struct ProfileStore_t {
+    Profile* profiles;
+    int count;
+    int capacity;
+} ProfileStore;
+
+/**
+ * Creates an empty store.
+ */
+void profile_store_init(ProfileStore* store);
+
+/**
+ * Releases all profiles of a store.
+ */
+void profile_store_free(ProfileStore* store);
+
+/**
+ * Replaces the contents of a store with the profiles in a file.  A file
+ * that does not exist leaves the store empty and is not an error.
+ *
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int profile_load(ProfileStore* store, const char* path);
+
+/**
+ * Writes all profiles of a store to a file.  The file is written under a
+ * temporary name and renamed, so it is never left half written.
+ *
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int profile_save(const ProfileStore* store, const char* path);
+
+/**
+ * Returns the profile of a device id, or NULL.
+ */
+const Profile* profile_find(const ProfileStore* store, const char* id);
+
+/**
+ * Adds a profile, or replaces the one with the same id.
+ *
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int profile_put(ProfileStore* store, const Profile* profile);
+
+/**
+ * Maps a raw axis value through its settings.  Stick axes read from -128
+ * to 127 with rest at 0, triggers from 0 to 255 with rest at 0, and the
+ * result is clamped to the same range.
+ */
+int profile_map_axis(const AxisSettings* settings, bool trigger, int raw);
+
+/**
+ * Fills in the value of profile_map_axis() for every raw value from
+ * PROFILE_AXIS_MIN, so that an axis is mapped with one lookup.
+ */
+void profile_build_axis_table(const AxisSettings* settings, bool trigger, int16_t table[PROFILE_AXIS_VALUES]);
+
+/**
+ * Fills in the on-screen buttons lit by each value of each byte of the
+ * device button bits, so that a button state is mapped with four lookups:
+ *
+ *   table[0][b & 0xff] | table[1][b >> 8 & 0xff] | table[2][b >> 16 & 0xff] | table[3][b >> 24 & 0xff]
+ *
+ * Bit i of the result is on-screen button i.
+ */
+void profile_build_button_table(const int buttons[PROFILE_BUTTONS], uint16_t table[4][256]);
+
+#endif /* PROFILE_H_ */
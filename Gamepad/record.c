@@ -0,0 +1,263 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "record.h"
+
+static const char MAGIC[4] = { 'G', 'P', 'R', 'C' };
+static const int VERSION = 1;
+
+// Largest record: type, device, time and an attach payload with a full id.
+#define MAX_RECORD_SIZE (6 + 4 + 255)
+
+static uint8_t* put16(uint8_t* p, int value)
+{
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    return p + 2;
+}
+
+static uint8_t* put32(uint8_t* p, uint32_t value)
+{
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    p[2] = (value >> 16) & 0xff;
+    p[3] = (value >> 24) & 0xff;
+    return p + 4;
+}
+
+static int get16(const uint8_t* p)
+{
+    return (int16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+int record_create(RecordFile* record, const char* path)
+{
+    uint8_t header[8] = { 0 };
+
+    memset(record, 0, sizeof(*record));
+    record->file = fopen(path, "wb");
+    if (!record->file) {
+        fprintf(stderr, "Unable to create recording %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    memcpy(header, MAGIC, sizeof(MAGIC));
+    header[4] = VERSION;
+    if (fwrite(header, sizeof(header), 1, record->file) != 1) {
+        fclose(record->file);
+        record->file = NULL;
+        return EXIT_FAILURE;
+    }
+
+    record->start = record->last = input_ring_now();
+
+    return EXIT_SUCCESS;
+}
+
+int record_open(RecordFile* record, const char* path)
+{
+    uint8_t header[8];
+
+    memset(record, 0, sizeof(*record));
+    record->file = fopen(path, "rb");
+    if (!record->file) {
+        fprintf(stderr, "Unable to open recording %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    if (fread(header, sizeof(header), 1, record->file) != 1
+            || memcmp(header, MAGIC, sizeof(MAGIC)) || header[4] != VERSION) {
+        fprintf(stderr, "%s is not a Gamepad recording\n", path);
+        fclose(record->file);
+        record->file = NULL;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void record_close(RecordFile* record)
+{
+    if (record->file) {
+        fclose(record->file);
+        record->file = NULL;
+    }
+}
+
+int record_device(RecordFile* record, void* handle)
+{
+    int i;
+    for (i = 0; i < record->deviceCount; ++i) {
+        if (record->devices[i] == handle) {
+            return i;
+        }
+    }
+
+    if (record->deviceCount == RECORD_MAX_DEVICES) {
+        return -1;
+    }
+
+    record->devices[record->deviceCount] = handle;
+    return record->deviceCount++;
+}
+
+void record_write(RecordFile* record, const Record* event)
+{
+    uint8_t buffer[MAX_RECORD_SIZE];
+    uint8_t* p = buffer;
+    uint64_t time = event->time > record->last ? event->time : record->last;
+    uint64_t delta = (time - record->last) / 1000;
+
+    if (!record->file || event->device < 0) {
+        return;
+    }
+
+    // Keep the rounding error from adding up over a long session.
+    if (delta > 0xffffffffULL) {
+        delta = 0xffffffffULL;
+    }
+    record->last += delta * 1000;
+
+    *p++ = event->type;
+    *p++ = event->device;
+    p = put32(p, (uint32_t)delta);
+
+    switch (event->type) {
+    case RECORD_STATE:
+        p = put32(p, event->buttons);
+        p = put16(p, event->analog0[0]);
+        p = put16(p, event->analog0[1]);
+        p = put16(p, event->analog0[2]);
+        p = put16(p, event->analog1[0]);
+        p = put16(p, event->analog1[1]);
+        p = put16(p, event->analog1[2]);
+        break;
+    case RECORD_ATTACH:
+    {
+        size_t length = strlen(event->info.id);
+        *p++ = event->info.gamepad ? 1 : 0;
+        *p++ = event->info.analogCount;
+        *p++ = event->info.buttonCount;
+        *p++ = length;
+        memcpy(p, event->info.id, length);
+        p += length;
+        break;
+    }
+    case RECORD_DETACH:
+        break;
+    case RECORD_TOUCH:
+        p = put16(p, event->x);
+        p = put16(p, event->y);
+        break;
+    }
+
+    fwrite(buffer, p - buffer, 1, record->file);
+}
+
+bool record_read(RecordFile* record, Record* event)
+{
+    uint8_t buffer[MAX_RECORD_SIZE];
+
+    if (!record->file || fread(buffer, 6, 1, record->file) != 1) {
+        return false;
+    }
+
+    memset(event, 0, sizeof(*event));
+    event->type = (RecordType)buffer[0];
+    event->device = buffer[1];
+    record->last += (uint64_t)get32(buffer + 2) * 1000;
+    event->time = record->last;
+
+    switch (event->type) {
+    case RECORD_STATE:
+        if (fread(buffer, 16, 1, record->file) != 1) {
+            return false;
+        }
+        event->buttons = (int)get32(buffer);
+        event->analog0[0] = get16(buffer + 4);
+        event->analog0[1] = get16(buffer + 6);
+        event->analog0[2] = get16(buffer + 8);
+        event->analog1[0] = get16(buffer + 10);
+        event->analog1[1] = get16(buffer + 12);
+        event->analog1[2] = get16(buffer + 14);
+        return true;
+    case RECORD_ATTACH:
+    {
+        size_t length;
+        if (fread(buffer, 4, 1, record->file) != 1) {
+            return false;
+        }
+        event->info.gamepad = buffer[0] != 0;
+        event->info.analogCount = buffer[1];
+        event->info.buttonCount = buffer[2];
+        length = buffer[3];
+        if (length >= sizeof(event->info.id)) {
+            return false;
+        }
+        if (length && fread(event->info.id, length, 1, record->file) != 1) {
+            return false;
+        }
+        event->info.id[length] = '\0';
+        return true;
+    }
+    case RECORD_DETACH:
+        return true;
+    case RECORD_TOUCH:
+        if (fread(buffer, 4, 1, record->file) != 1) {
+            return false;
+        }
+        event->x = get16(buffer);
+        event->y = get16(buffer + 2);
+        return true;
+    }
+
+    fprintf(stderr, "Unknown record type %d\n", event->type);
+    return false;
+}
+
+void record_apply(Gamepad* gamepad, const Record* event)
+{
+    void* handle = (void*)(intptr_t)(event->device + 1);
+
+    switch (event->type) {
+    case RECORD_STATE:
+    {
+        GameController* controller = gamepad_find(gamepad, handle);
+        if (controller) {
+            input_ring_push(&controller->eventRing, input_ring_now(), event->buttons, event->analog0, event->analog1);
+            input_ring_flush(&controller->eventRing);
+        }
+        break;
+    }
+    case RECORD_ATTACH:
+        gamepad_attach(gamepad, handle, &event->info);
+        break;
+    case RECORD_DETACH:
+        gamepad_detach(gamepad, handle);
+        break;
+    case RECORD_TOUCH:
+        gamepad_touch(gamepad, event->x, event->y);
+        break;
+    }
+}
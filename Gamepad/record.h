@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef RECORD_H_
+#define RECORD_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "gamepad.h"
+
+// Devices that can appear in one recording.
+#define RECORD_MAX_DEVICES 256
+
+typedef enum RecordType_t {
+    RECORD_STATE = 1,
+    RECORD_ATTACH,
+    RECORD_DETACH,
+    RECORD_TOUCH
+} RecordType;
+
+// One recorded input event.  Only the fields of its type are used.
+typedef struct Record_t {
+    RecordType type;
+
+    // Writing: when the event was received, see input_ring_now().
+    // Reading: nanoseconds since the recording started, with microsecond resolution.
+    uint64_t time;
+
+    // Index of the device, see record_device().
+    int device;
+
+    // RECORD_STATE
+    int buttons;
+    int analog0[3];
+    int analog1[3];
+
+    // RECORD_ATTACH
+    DeviceInfo info;
+
+    // RECORD_TOUCH, in screen coordinates.
+    int x;
+    int y;
+} Record;
+
+/**
+ * A recording of a Gamepad session: controller states, devices being
+ * attached or removed, and taps on the screen.
+ *
+ * The file starts with the magic "GPRC" and a version byte followed by three
+ * reserved bytes.  Each event is then stored as its type and device index in
+ * one byte each, the time since the previous event in microseconds as a
+ * 32 bit value, and a payload that depends on the type:
+ *
+ *   RECORD_STATE   buttons (32 bits), analog0 and analog1 (3 x 16 bits each)
+ *   RECORD_ATTACH  gamepad flag, analog count, button count and id length
+ *                  (8 bits each), followed by the id
+ *   RECORD_DETACH  nothing
+ *   RECORD_TOUCH   x and y (16 bits each)
+ *
+ * All values are little endian, so a state change takes 22 bytes.
+ */
+typedef struct RecordFile_t {
+    FILE* file;
+    uint64_t start;
+    uint64_t last;
+
+    // Writing: the handle behind each device index.
+    void* devices[RECORD_MAX_DEVICES];
+    int deviceCount;
+} RecordFile;
+
+/**
+ * Creates a recording, overwriting any existing file.
+ *
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int record_create(RecordFile* record, const char* path);
+
+/**
+ * Opens a recording for reading.
+ *
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int record_open(RecordFile* record, const char* path);
+
+/**
+ * Closes a recording opened by record_create() or record_open().
+ */
+void record_close(RecordFile* record);
+
+/**
+ * Returns the index a device is stored under, assigning the next free one
+ * the first time the device is seen.
+ *
+ * @return the index, or -1 if the recording already holds RECORD_MAX_DEVICES devices
+ */
+int record_device(RecordFile* record, void* handle);
+
+/**
+ * Appends an event to a recording.
+ */
+void record_write(RecordFile* record, const Record* event);
+
+/**
+ * Reads the next event from a recording.
+ *
+ * @return true if an event was read, false at the end of the recording or on error
+ */
+bool record_read(RecordFile* record, Record* event);
+
+/**
+ * Feeds a recorded event to the gamepad through the same functions used
+ * for live input.  Devices are represented by the handle (index + 1) and
+ * controller states are queued as if they had just been received.
+ */
+void record_apply(Gamepad* gamepad, const Record* event);
+
+#endif /* RECORD_H_ */
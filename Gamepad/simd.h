@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMD_H_
+#define SIMD_H_
+
+#include <stdint.h>
+
+/**
+ * Minimal portable 8-wide 16 bit integer vector layer.
+ *
+ * Maps onto NEON on ARM and SSE2 on x86.  Everywhere else SIMD_SCALAR is
+ * defined and callers are expected to use their plain C loop instead.
+ *
+ * Every operation gives exactly the result of the matching C expression on
+ * each lane, so a kernel written against this header produces the same
+ * values as the equivalent scalar loop.  Loads and stores need 16 byte
+ * aligned addresses.
+ */
+
+#define SIMD_WIDTH 8
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+#include <arm_neon.h>
+
+#define SIMD_NAME "NEON"
+
+typedef int16x8_t simd8s;
+typedef uint16x8_t simd8m;
+
+static inline simd8s simd8s_load(const int16_t* p) { return vld1q_s16(p); }
+static inline void simd8s_store(int16_t* p, simd8s a) { vst1q_s16(p, a); }
+static inline simd8s simd8s_splat(int16_t v) { return vdupq_n_s16(v); }
+static inline simd8s simd8s_sub(simd8s a, simd8s b) { return vsubq_s16(a, b); }
+static inline simd8s simd8s_abs(simd8s a) { return vabsq_s16(a); }
+static inline simd8s simd8s_min(simd8s a, simd8s b) { return vminq_s16(a, b); }
+static inline simd8s simd8s_max(simd8s a, simd8s b) { return vmaxq_s16(a, b); }
+static inline simd8s simd8s_shl(simd8s a, int n) { return vshlq_s16(a, vdupq_n_s16(n)); }
+static inline simd8m simd8s_cmpgt(simd8s a, simd8s b) { return vcgtq_s16(a, b); }
+static inline simd8s simd8s_select(simd8m m, simd8s a, simd8s b) { return vbslq_s16(m, a, b); }
+
+// (a * b) >> 16.  vqdmulh gives (2 * a * b) >> 16 and only saturates for -32768 * -32768.
+static inline simd8s simd8s_mulhi(simd8s a, simd8s b) { return vshrq_n_s16(vqdmulhq_s16(a, b), 1); }
+
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+#define SIMD_NAME "SSE2"
+
+typedef __m128i simd8s;
+typedef __m128i simd8m;
+
+static inline simd8s simd8s_load(const int16_t* p) { return _mm_load_si128((const __m128i*)p); }
+static inline void simd8s_store(int16_t* p, simd8s a) { _mm_store_si128((__m128i*)p, a); }
+static inline simd8s simd8s_splat(int16_t v) { return _mm_set1_epi16(v); }
+static inline simd8s simd8s_sub(simd8s a, simd8s b) { return _mm_sub_epi16(a, b); }
+static inline simd8s simd8s_min(simd8s a, simd8s b) { return _mm_min_epi16(a, b); }
+static inline simd8s simd8s_max(simd8s a, simd8s b) { return _mm_max_epi16(a, b); }
+static inline simd8s simd8s_shl(simd8s a, int n) { return _mm_sll_epi16(a, _mm_cvtsi32_si128(n)); }
+static inline simd8m simd8s_cmpgt(simd8s a, simd8s b) { return _mm_cmpgt_epi16(a, b); }
+static inline simd8s simd8s_mulhi(simd8s a, simd8s b) { return _mm_mulhi_epi16(a, b); }
+static inline simd8s simd8s_select(simd8m m, simd8s a, simd8s b) {
+    return _mm_or_si128(_mm_and_si128(m, a), _mm_andnot_si128(m, b));
+}
+
+// SSE2 has no 16 bit absolute value, SSSE3 added it.
+static inline simd8s simd8s_abs(simd8s a) { return _mm_max_epi16(a, _mm_sub_epi16(_mm_setzero_si128(), a)); }
+
+#else
+
+// No vector unit, users fall back to their scalar loops.
+#define SIMD_NAME "C"
+#define SIMD_SCALAR
+
+#endif
+
+#endif /* SIMD_H_ */
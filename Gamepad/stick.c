@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simd.h"
+#include "stick.h"
+
+// The radial gain is a fixed point number with this many fraction bits.
+#define GAIN_BITS 12
+
+// Arrays of a batch, in the order of StickBatch.
+#define BATCH_ARRAYS 5
+
+// Response curve exponents are kept within this range, in percent.
+static const int MIN_CURVE = 10;
+static const int MAX_CURVE = 1000;
+
+static int clampInt(int value, int low, int high)
+{
+    return value < low ? low : (value > high ? high : value);
+}
+
+void stick_setup(StickProcessor* processor, const StickSettings* settings)
+{
+    StickSettings* s = &processor->settings;
+
+    s->deadZone = clampInt(settings->deadZone, 0, STICK_MAX_DEAD_ZONE);
+    s->curve[0] = clampInt(settings->curve[0], MIN_CURVE, MAX_CURVE);
+    s->curve[1] = clampInt(settings->curve[1], MIN_CURVE, MAX_CURVE);
+    s->jitter = clampInt(settings->jitter, 0, 2 * STICK_RANGE);
+
+    processor->enabled = s->deadZone > 0 || s->curve[0] != 100 || s->curve[1] != 100 || s->jitter > 0;
+
+    // Each entry holds the gain for the middle of its range of squared distances.  Without a dead
+    // zone the gain is exactly one, so positions pass through unchanged.
+    int i;
+    for (i = 0; i < STICK_RADIAL_ENTRIES; ++i) {
+        const double r = sqrt((double)((i << STICK_RADIAL_SHIFT) + (1 << STICK_RADIAL_SHIFT) / 2));
+        double gain = 1 << GAIN_BITS;
+
+        if (s->deadZone > 0) {
+            if (r <= s->deadZone) {
+                gain = 0.0;
+            } else {
+                gain *= (r - s->deadZone) / (STICK_RANGE - s->deadZone) * STICK_RANGE / r;
+            }
+        }
+
+        processor->radialGain[i] = (int16_t)clampInt((int)floor(gain + 0.5), 0, INT16_MAX);
+    }
+
+    int axis;
+    for (axis = 0; axis < 2; ++axis) {
+        const double exponent = s->curve[axis] / 100.0;
+
+        for (i = 0; i < 2 * STICK_RANGE; ++i) {
+            const int position = i - STICK_RANGE;
+            const double magnitude = abs(position) / (double)STICK_RANGE;
+            int value = (int)floor(STICK_RANGE * pow(magnitude, exponent) + 0.5);
+
+            processor->curves[axis][i] = (int16_t)clampInt(position < 0 ? -value : value, -STICK_RANGE, STICK_RANGE - 1);
+        }
+    }
+}
+
+int stick_batch_init(StickBatch* batch, int capacity)
+{
+    memset(batch, 0, sizeof(*batch));
+    return stick_batch_reserve(batch, capacity);
+}
+
+int stick_batch_reserve(StickBatch* batch, int capacity)
+{
+    void* mem;
+
+    capacity = (capacity + STICK_BATCH_ALIGN - 1) & ~(STICK_BATCH_ALIGN - 1);
+    if (capacity <= batch->capacity) {
+        return EXIT_SUCCESS;
+    }
+
+    // One block for all arrays, each one starting on a 16 byte boundary.
+    if (posix_memalign(&mem, 16, BATCH_ARRAYS * capacity * sizeof(int16_t)) != 0) {
+        return EXIT_FAILURE;
+    }
+    memset(mem, 0, BATCH_ARRAYS * capacity * sizeof(int16_t));
+    free(batch->x);
+
+    batch->x = (int16_t*)mem;
+    batch->y = batch->x + capacity;
+    batch->lastX = batch->y + capacity;
+    batch->lastY = batch->lastX + capacity;
+    batch->gain = batch->lastY + capacity;
+    batch->count = 0;
+    batch->capacity = capacity;
+
+    return EXIT_SUCCESS;
+}
+
+void stick_batch_free(StickBatch* batch)
+{
+    free(batch->x);
+    memset(batch, 0, sizeof(*batch));
+}
+
+// The radial gain of each stick.  There is no vector gather, so this and the curves are plain lookups.
+static void lookUpGain(const StickProcessor* processor, StickBatch* batch)
+{
+    const int16_t* x = batch->lastX;
+    const int16_t* y = batch->lastY;
+    int i;
+
+    for (i = 0; i < batch->count; ++i) {
+        batch->gain[i] = processor->radialGain[(unsigned)(x[i] * x[i] + y[i] * y[i]) >> STICK_RADIAL_SHIFT];
+    }
+}
+
+static void applyCurves(const StickProcessor* processor, StickBatch* batch)
+{
+    int i;
+    for (i = 0; i < batch->count; ++i) {
+        batch->x[i] = processor->curves[0][batch->x[i] + STICK_RANGE];
+        batch->y[i] = processor->curves[1][batch->y[i] + STICK_RANGE];
+    }
+}
+
+void stick_process_scalar(const StickProcessor* processor, StickBatch* batch)
+{
+    const int jitter = processor->settings.jitter;
+    int i;
+
+    for (i = 0; i < batch->count; ++i) {
+        int x = clampInt(batch->x[i], -STICK_RANGE, STICK_RANGE - 1);
+        int y = clampInt(batch->y[i], -STICK_RANGE, STICK_RANGE - 1);
+
+        if (abs(x - batch->lastX[i]) <= jitter) {
+            x = batch->lastX[i];
+        }
+        if (abs(y - batch->lastY[i]) <= jitter) {
+            y = batch->lastY[i];
+        }
+
+        batch->lastX[i] = (int16_t)x;
+        batch->lastY[i] = (int16_t)y;
+    }
+
+    lookUpGain(processor, batch);
+
+    for (i = 0; i < batch->count; ++i) {
+        const int gain = batch->gain[i];
+
+        batch->x[i] = (int16_t)clampInt((batch->lastX[i] * gain) >> GAIN_BITS, -STICK_RANGE, STICK_RANGE - 1);
+        batch->y[i] = (int16_t)clampInt((batch->lastY[i] * gain) >> GAIN_BITS, -STICK_RANGE, STICK_RANGE - 1);
+    }
+
+    applyCurves(processor, batch);
+}
+
+void stick_process(const StickProcessor* processor, StickBatch* batch)
+{
+#ifdef SIMD_SCALAR
+    stick_process_scalar(processor, batch);
+#else
+    const simd8s low = simd8s_splat(-STICK_RANGE);
+    const simd8s high = simd8s_splat(STICK_RANGE - 1);
+    const simd8s jitter = simd8s_splat((int16_t)processor->settings.jitter);
+    int i;
+
+    // Storage is padded to SIMD_WIDTH, the tail lanes are scratch.
+    for (i = 0; i < batch->count; i += SIMD_WIDTH) {
+        simd8s x = simd8s_max(simd8s_min(simd8s_load(batch->x + i), high), low);
+        simd8s y = simd8s_max(simd8s_min(simd8s_load(batch->y + i), high), low);
+        simd8s lastX = simd8s_load(batch->lastX + i);
+        simd8s lastY = simd8s_load(batch->lastY + i);
+
+        x = simd8s_select(simd8s_cmpgt(simd8s_abs(simd8s_sub(x, lastX)), jitter), x, lastX);
+        y = simd8s_select(simd8s_cmpgt(simd8s_abs(simd8s_sub(y, lastY)), jitter), y, lastY);
+
+        simd8s_store(batch->lastX + i, x);
+        simd8s_store(batch->lastY + i, y);
+    }
+
+    lookUpGain(processor, batch);
+
+    // (position * gain) >> GAIN_BITS as the high half of (position << (16 - GAIN_BITS)) * gain.
+    for (i = 0; i < batch->count; i += SIMD_WIDTH) {
+        const simd8s gain = simd8s_load(batch->gain + i);
+        simd8s x = simd8s_mulhi(simd8s_shl(simd8s_load(batch->lastX + i), 16 - GAIN_BITS), gain);
+        simd8s y = simd8s_mulhi(simd8s_shl(simd8s_load(batch->lastY + i), 16 - GAIN_BITS), gain);
+
+        simd8s_store(batch->x + i, simd8s_max(simd8s_min(x, high), low));
+        simd8s_store(batch->y + i, simd8s_max(simd8s_min(y, high), low));
+    }
+
+    applyCurves(processor, batch);
+#endif
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef STICK_H_
+#define STICK_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Sticks read from -STICK_RANGE to STICK_RANGE - 1 on each axis.
+#define STICK_RANGE 128
+
+// The radial gain is looked up by squared distance from the centre, in steps of 1 << STICK_RADIAL_SHIFT.
+#define STICK_RADIAL_SHIFT 5
+#define STICK_RADIAL_ENTRIES ((2 * STICK_RANGE * STICK_RANGE >> STICK_RADIAL_SHIFT) + 1)
+
+// Largest radial dead zone, which keeps the gain in 16 bits.
+#define STICK_MAX_DEAD_ZONE 100
+
+// Batches hold a multiple of this many sticks.
+#define STICK_BATCH_ALIGN 8
+
+// How stick positions are cleaned up before they are queued.
+typedef struct StickSettings_t {
+    // Positions at most this far from the centre read as centred.  The remaining travel is
+    // stretched so that the edge of the stick's circle still reads as full deflection.
+    int deadZone;
+
+    // Exponent of the response curve of the x and y axis, in percent.  100 is linear, higher
+    // values give finer control near the centre.
+    int curve[2];
+
+    // A change of at most this many units on an axis is taken as noise and ignored.
+    int jitter;
+} StickSettings;
+
+// Lookup tables built from StickSettings by stick_setup().
+typedef struct StickProcessor_t {
+    StickSettings settings;
+
+    // False if the settings leave every position as it is, so nothing needs to be done.
+    bool enabled;
+
+    // Gain applied to both axes in 1/4096 units, by squared distance from the centre.
+    int16_t radialGain[STICK_RADIAL_ENTRIES];
+
+    // Response of the x and y axis, indexed by position + STICK_RANGE.
+    int16_t curves[2][2 * STICK_RANGE];
+} StickProcessor;
+
+/**
+ * Positions of many sticks, one per lane, as a structure of arrays so that
+ * a vector load picks up the same axis of STICK_BATCH_ALIGN sticks.  Every
+ * array starts on a 16 byte boundary and holds capacity entries.
+ *
+ * The caller fills in x and y and the last filtered position of each stick,
+ * and stick_process() replaces them with the processed position and the new
+ * filtered position.  Lanes from count up to the next multiple of
+ * STICK_BATCH_ALIGN are scratch.
+ */
+typedef struct StickBatch_t {
+    int16_t* x;
+    int16_t* y;
+    int16_t* lastX;
+    int16_t* lastY;
+
+    // Scratch space for the radial gain of each stick.
+    int16_t* gain;
+
+    int count;
+    int capacity;
+} StickBatch;
+
+/**
+ * Builds the lookup tables for a set of settings.  Out of range settings
+ * are clamped.
+ */
+void stick_setup(StickProcessor* processor, const StickSettings* settings);
+
+/**
+ * Allocates an empty batch with room for at least capacity sticks.
+ *
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int stick_batch_init(StickBatch* batch, int capacity);
+
+/**
+ * Grows a batch so that at least capacity sticks fit.  The contents are not kept.
+ *
+ * @return EXIT_SUCCESS on success otherwise EXIT_FAILURE
+ */
+int stick_batch_reserve(StickBatch* batch, int capacity);
+
+/**
+ * Releases the storage of a batch.
+ */
+void stick_batch_free(StickBatch* batch);
+
+/**
+ * Processes every stick of a batch: positions are clamped to the stick
+ * range, changes of at most jitter units from the last filtered position
+ * are dropped, then the radial dead zone and the response curves are
+ * applied.  The filter and the gain are vector kernels, the dead zone and
+ * curves are table lookups.
+ */
+void stick_process(const StickProcessor* processor, StickBatch* batch);
+
+/**
+ * Scalar reference version of stick_process().  Performs the same integer
+ * operations, so both produce identical results.
+ */
+void stick_process_scalar(const StickProcessor* processor, StickBatch* batch);
+
+#endif /* STICK_H_ */
@@ -0,0 +1,130 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _ANIMATION_H_INCLUDED
+#define _ANIMATION_H_INCLUDED
+
+/**
+ * Time based animation of float values.
+ *
+ * Every animation computes its value from the time that has passed since it
+ * started, read from the monotonic clock, so motion runs at the same speed
+ * whatever the frame rate is and dropped frames simply skip ahead.
+ *
+ * An animator holds all running animations of an app in one array and
+ * animator_update() advances them together once per frame.
+ */
+
+#define ANIMATION_MAX 16
+
+/**
+ * Easing curve, maps progress from 0 to 1 onto the fraction of the distance covered.
+ */
+typedef float (*animation_ease_t)(float t);
+
+float animation_linear(float t);
+float animation_ease_in(float t);
+float animation_ease_out(float t);
+float animation_ease_in_out(float t);
+
+typedef struct {
+    float* value;
+    float from;
+    //End value of a tween, or degrees (or units) per second of a spin
+    float to;
+    double start;
+    //Length of a tween in seconds, or the period a spin wraps at
+    float duration;
+    //NULL for a spin
+    animation_ease_t ease;
+} animation_t;
+
+typedef struct {
+    animation_t animations[ANIMATION_MAX];
+    int count;
+    //Time of the last update, or of the pause while paused
+    double now;
+    int paused;
+} animator_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Returns the monotonic clock in seconds.
+ */
+double animation_time();
+
+/**
+ * Prepares an animator with no animations.
+ */
+void animator_init(animator_t* animator);
+
+/**
+ * Moves a value from where it is now to a new value. Any animation already
+ * running on the value is replaced, so a tween can be retargeted halfway.
+ *
+ * @param animator holding the animation
+ * @param value to animate, must stay valid while the animation runs
+ * @param to end value
+ * @param duration in seconds, the value jumps to the end on the next update if 0
+ * @param ease curve, e.g. animation_ease_out
+ * @return EXIT_SUCCESS if the animation was started otherwise EXIT_FAILURE
+ */
+int animator_tween(animator_t* animator, float* value, float to, float duration, animation_ease_t ease);
+
+/**
+ * Changes a value at a constant rate until it is stopped, starting from
+ * where it is now.
+ *
+ * @param animator holding the animation
+ * @param value to animate, must stay valid while the animation runs
+ * @param rate change per second
+ * @param period the value wraps around to stay within, e.g. 360 for degrees, or 0 for none
+ * @return EXIT_SUCCESS if the animation was started otherwise EXIT_FAILURE
+ */
+int animator_spin(animator_t* animator, float* value, float rate, float period);
+
+/**
+ * Stops any animation of a value, leaving it where it is.
+ */
+void animator_stop(animator_t* animator, const float* value);
+
+/**
+ * Returns true while a value is being animated. A tween stops running on
+ * the update that sets it to its end value.
+ */
+int animator_is_running(const animator_t* animator, const float* value);
+
+/**
+ * Sets every animated value for the current time and removes tweens that
+ * have reached their end.
+ */
+void animator_update(animator_t* animator);
+
+/**
+ * Freezes all animations, e.g. while the app is in the background.
+ * animator_resume() continues them where they were instead of jumping ahead.
+ */
+void animator_pause(animator_t* animator);
+void animator_resume(animator_t* animator);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ANIMATION_H_INCLUDED */
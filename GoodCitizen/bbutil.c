@@ -14,10 +14,14 @@
  * limitations under the License.
  */
 #include <ctype.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <sys/keycodes.h>
 #include <time.h>
 #include <stdbool.h>
@@ -751,9 +755,159 @@ void bbutil_measure_text(font_t* font, const char* msg, float* width, float* hei
     }
 }
 
+//Decoded textures are cached in the app's data directory, ready to be handed to GL
+#define TEXTURE_CACHE_DIR "data/"
+#define TEXTURE_CACHE_MAGIC ('T' | ('X' << 8) | ('C' << 16) | ('1' << 24))
+
+//Header of a texture cache file, followed by tex_width x tex_height pixels padded with zeros
+typedef struct {
+    uint32_t magic;
+    uint32_t format;
+    uint32_t image_width;
+    uint32_t image_height;
+    uint32_t tex_width;
+    uint32_t tex_height;
+    //Size and modification time of the png the pixels were decoded from
+    int64_t source_size;
+    int64_t source_mtime;
+} texture_cache_header_t;
+
+static int bytes_per_pixel(GLuint format) {
+    return format == GL_RGBA ? 4 : 3;
+}
+
+//Maps "app/native/image.png" to "data/app_native_image.png.tex"
+static char* texture_cache_path(const char* filename) {
+    size_t length = strlen(TEXTURE_CACHE_DIR) + strlen(filename) + 5;
+    char* path = (char*)malloc(length);
+    char* c;
+
+    if (!path) {
+        return NULL;
+    }
+
+    snprintf(path, length, "%s%s.tex", TEXTURE_CACHE_DIR, filename);
+    for (c = path + strlen(TEXTURE_CACHE_DIR); *c; c++) {
+        if (*c == '/') {
+            *c = '_';
+        }
+    }
+
+    return path;
+}
+
+//Creates the GL texture from padded pixels and returns the sizes and texture coordinates
+static int upload_texture(const texture_cache_header_t* info, const void* pixels,
+        int* width, int* height, float* tex_x, float* tex_y, unsigned int *tex) {
+    glGenTextures(1, tex);
+    glBindTexture(GL_TEXTURE_2D, (*tex));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    glTexImage2D(GL_TEXTURE_2D, 0, info->format, info->tex_width, info->tex_height, 0, info->format, GL_UNSIGNED_BYTE, pixels);
+
+    GLint err = glGetError();
+
+    if (err == 0) {
+        //Return physical with and height of texture if pointers are not null
+        if(width) {
+            *width = info->image_width;
+        }
+        if (height) {
+            *height = info->image_height;
+        }
+        //Return modified texture coordinates if pointers are not null
+        if(tex_x) {
+            *tex_x = ((float) info->image_width - 0.5f) / ((float)info->tex_width);
+        }
+        if(tex_y) {
+            *tex_y = ((float) info->image_height - 0.5f) / ((float)info->tex_height);
+        }
+        return EXIT_SUCCESS;
+    } else {
+        fprintf(stderr, "GL error %i \n", err);
+        return EXIT_FAILURE;
+    }
+}
+
+//Uploads a cached texture straight from the mapped file if it was made from the same png
+static int load_cached_texture(const char* cache_path, const struct stat* source,
+        int* width, int* height, float* tex_x, float* tex_y, unsigned int *tex) {
+    struct stat st;
+    const texture_cache_header_t* header;
+    int rc = EXIT_FAILURE;
+
+    int fd = open(cache_path, O_RDONLY);
+    if (fd < 0) {
+        return EXIT_FAILURE;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(texture_cache_header_t)) {
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return EXIT_FAILURE;
+    }
+
+    header = (const texture_cache_header_t*)map;
+
+    if (header->magic == TEXTURE_CACHE_MAGIC
+            && (header->format == GL_RGBA || header->format == GL_RGB)
+            && header->source_size == (int64_t)source->st_size
+            && header->source_mtime == (int64_t)source->st_mtime
+            && header->tex_width >= header->image_width
+            && header->tex_height >= header->image_height
+            && st.st_size == (off_t)(sizeof(texture_cache_header_t)
+                    + (size_t)header->tex_width * header->tex_height * bytes_per_pixel(header->format))) {
+        rc = upload_texture(header, header + 1, width, height, tex_x, tex_y, tex);
+    }
+
+    munmap(map, st.st_size);
+
+    return rc;
+}
+
+//Writes the padded pixels next to a temporary name first, so a partly written cache is never used
+static void save_cached_texture(const char* cache_path, const texture_cache_header_t* header, const void* pixels) {
+    size_t size = (size_t)header->tex_width * header->tex_height * bytes_per_pixel(header->format);
+    size_t length = strlen(cache_path) + 5;
+    char* temp_path = (char*)malloc(length);
+
+    if (!temp_path) {
+        return;
+    }
+    snprintf(temp_path, length, "%s.tmp", cache_path);
+
+    FILE *fp = fopen(temp_path, "wb");
+    if (!fp) {
+        free(temp_path);
+        return;
+    }
+
+    int written = fwrite(header, sizeof(texture_cache_header_t), 1, fp) == 1
+            && fwrite(pixels, 1, size, fp) == size;
+
+    if (fclose(fp) != 0 || !written || rename(temp_path, cache_path) != 0) {
+        fprintf(stderr, "Unable to write texture cache %s\n", cache_path);
+        unlink(temp_path);
+    }
+
+    free(temp_path);
+}
+
 int bbutil_load_texture(const char* filename, int* width, int* height, float* tex_x, float* tex_y, unsigned int *tex) {
     int i;
     GLuint format;
+    struct stat source;
+    texture_cache_header_t info;
     //header for testing if it is a png
     png_byte header[8];
 
@@ -761,9 +915,21 @@ int bbutil_load_texture(const char* filename, int* width, int* height, float* te
         return EXIT_FAILURE;
     }
 
+    if (stat(filename, &source) != 0) {
+        return EXIT_FAILURE;
+    }
+
+    //Skip decoding if the pixels are already in the cache
+    char* cache_path = texture_cache_path(filename);
+    if (cache_path && EXIT_SUCCESS == load_cached_texture(cache_path, &source, width, height, tex_x, tex_y, tex)) {
+        free(cache_path);
+        return EXIT_SUCCESS;
+    }
+
     //open file as binary
     FILE *fp = fopen(filename, "rb");
     if (!fp) {
+        free(cache_path);
         return EXIT_FAILURE;
     }
 
@@ -774,6 +940,7 @@ int bbutil_load_texture(const char* filename, int* width, int* height, float* te
     int is_png = !png_sig_cmp(header, 0, 8);
     if (!is_png) {
         fclose(fp);
+        free(cache_path);
         return EXIT_FAILURE;
     }
 
@@ -781,6 +948,7 @@ int bbutil_load_texture(const char* filename, int* width, int* height, float* te
     png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
     if (!png_ptr) {
         fclose(fp);
+        free(cache_path);
         return EXIT_FAILURE;
     }
 
@@ -789,6 +957,7 @@ int bbutil_load_texture(const char* filename, int* width, int* height, float* te
     if (!info_ptr) {
         png_destroy_read_struct(&png_ptr, (png_infopp) NULL, (png_infopp) NULL);
         fclose(fp);
+        free(cache_path);
         return EXIT_FAILURE;
     }
 
@@ -797,6 +966,7 @@ int bbutil_load_texture(const char* filename, int* width, int* height, float* te
     if (!end_info) {
         png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
         fclose(fp);
+        free(cache_path);
         return EXIT_FAILURE;
     }
 
@@ -804,6 +974,7 @@ int bbutil_load_texture(const char* filename, int* width, int* height, float* te
     if (setjmp(png_jmpbuf(png_ptr))) {
         png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
         fclose(fp);
+        free(cache_path);
         return EXIT_FAILURE;
     }
 
@@ -835,22 +1006,51 @@ int bbutil_load_texture(const char* filename, int* width, int* height, float* te
             fprintf(stderr,"Unsupported PNG color type (%d) for texture: %s", (int)color_type, filename);
             fclose(fp);
             png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
-            return NULL;
+            free(cache_path);
+            return EXIT_FAILURE;
+    }
+
+    //The texture holds 8 bits per channel, have libpng convert 16 bit channels
+    //and unpack bit depths below 8
+    if (bit_depth == 16) {
+        png_set_strip_16(png_ptr);
+    } else if (bit_depth < 8) {
+        png_set_packing(png_ptr);
     }
 
     // Update the png info struct.
     png_read_update_info(png_ptr, info_ptr);
 
-    // Row size in bytes.
-    int rowbytes = png_get_rowbytes(png_ptr, info_ptr);
+    info.magic = TEXTURE_CACHE_MAGIC;
+    info.format = format;
+    info.image_width = image_width;
+    info.image_height = image_height;
+    info.tex_width = nextp2(image_width);
+    info.tex_height = nextp2(image_height);
+    info.source_size = source.st_size;
+    info.source_mtime = source.st_mtime;
+
+    // Row size in bytes of the padded texture.
+    int rowbytes = info.tex_width * bytes_per_pixel(format);
+
+    //Every decoded row has to fit into a texture row
+    if (png_get_rowbytes(png_ptr, info_ptr) > (png_size_t) rowbytes) {
+        fprintf(stderr, "Unsupported PNG row size (%d bytes) for texture: %s\n",
+                (int) png_get_rowbytes(png_ptr, info_ptr), filename);
+        png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
+        fclose(fp);
+        free(cache_path);
+        return EXIT_FAILURE;
+    }
 
-    // Allocate the image_data as a big block, to be given to opengl
-    png_byte *image_data = (png_byte*) malloc(sizeof(png_byte) * rowbytes * image_height);
+    // Allocate the padded image_data as a big block, to be given to opengl
+    png_byte *image_data = (png_byte*) calloc(info.tex_height, rowbytes);
 
     if (!image_data) {
         //clean up memory and close stuff
         png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
         fclose(fp);
+        free(cache_path);
         return EXIT_FAILURE;
     }
 
@@ -861,6 +1061,7 @@ int bbutil_load_texture(const char* filename, int* width, int* height, float* te
         png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
         free(image_data);
         fclose(fp);
+        free(cache_path);
         return EXIT_FAILURE;
     }
 
@@ -872,55 +1073,21 @@ int bbutil_load_texture(const char* filename, int* width, int* height, float* te
     //read the png into image_data through row_pointers
     png_read_image(png_ptr, row_pointers);
 
-    int tex_width, tex_height;
-
-    tex_width = nextp2(image_width);
-    tex_height = nextp2(image_height);
+    int rc = upload_texture(&info, image_data, width, height, tex_x, tex_y, tex);
 
-    glGenTextures(1, tex);
-    glBindTexture(GL_TEXTURE_2D, (*tex));
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-    if ((tex_width != image_width) || (tex_height != image_height) ) {
-        glTexImage2D(GL_TEXTURE_2D, 0, format, tex_width, tex_height, 0, format, GL_UNSIGNED_BYTE, NULL);
-        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image_width, image_height, format, GL_UNSIGNED_BYTE, image_data);
-    } else {
-        glTexImage2D(GL_TEXTURE_2D, 0, format, tex_width, tex_height, 0, format, GL_UNSIGNED_BYTE, image_data);
+    //Keep the decoded pixels for the next launch
+    if (rc == EXIT_SUCCESS && cache_path) {
+        save_cached_texture(cache_path, &info, image_data);
     }
 
-    GLint err = glGetError();
-
     //clean up memory and close stuff
     png_destroy_read_struct(&png_ptr, &info_ptr, &end_info);
     free(image_data);
     free(row_pointers);
     fclose(fp);
+    free(cache_path);
 
-    if (err == 0) {
-        //Return physical with and height of texture if pointers are not null
-        if(width) {
-            *width = image_width;
-        }
-        if (height) {
-            *height = image_height;
-        }
-        //Return modified texture coordinates if pointers are not null
-        if(tex_x) {
-            *tex_x = ((float) image_width - 0.5f) / ((float)tex_width);
-        }
-        if(tex_y) {
-            *tex_y = ((float) image_height - 0.5f) / ((float)tex_height);
-        }
-        return EXIT_SUCCESS;
-    } else {
-        fprintf(stderr, "GL error %i \n", err);
-        return EXIT_FAILURE;
-    }
+    return rc;
 }
 
 int bbutil_calculate_dpi(screen_context_t ctx) {
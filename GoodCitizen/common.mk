@@ -17,13 +17,19 @@ EXTRA_LIBVPATH+=$(QNX_TARGET)/../target-override/$(CPUVARDIR)/lib \
 CCFLAGS+=-fstack-protector-strong -D_FORTIFY_SOURCE=2 \
 	$(if $(filter g so shared,$(VARIANTS)),,-fPIE) \
 	$(if $(filter g,$(VARIANTS)),,-frecord-gcc-switches) \
-	-DUSING_GL11
+	-DUSING_GL20
+
+# Vector units for the matrix code in vecmath.c. Contraction into fused
+# multiply-add is disabled so the vector and scalar versions round identically.
+CCFLAGS+=-ffp-contract=off \
+	$(if $(filter arm,$(CPU)),-mfpu=neon) \
+	$(if $(filter x86,$(CPU)),-msse2 -mfpmath=sse)
 
 # Linker options for enhanced security
 LDFLAGS+=-Wl,-z,relro -Wl,-z,now $(if $(filter g so shared,$(VARIANTS)),,-pie)
 
 # Add your required library names, here
-LIBS+=bps screen EGL GLESv1_CM m freetype png
+LIBS+=bps screen EGL GLESv2 m freetype png
 
 include $(MKFILES_ROOT)/qmacros.mk
 
@@ -14,7 +14,11 @@
  * limitations under the License.
  */
 
+#include "animation.h"
 #include "bbutil.h"
+#include "mesh.h"
+#include "persist.h"
+#include "vecmath.h"
 
 #include <bps/navigator.h>
 #include <bps/screen.h>
@@ -24,13 +28,14 @@
 #include <screen/screen.h>
 
 #include <EGL/egl.h>
-#include <GLES/gl.h>
+#include <GLES2/gl2.h>
 
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
 #include <math.h>
+#include <time.h>
 
 static GLfloat radio_btn_unselected_vertices[8], radio_btn_selected_vertices[8],
         background_portrait_vertices[8], background_landscape_vertices[8],
@@ -50,60 +55,94 @@ static float menu_animation, menu_height, button_size_x, button_size_y;
 static float pos_x, pos_y;
 static float cube_pos_x, cube_pos_y, cube_pos_z;
 
+//State kept across runs, written in the background by persist.c
+#define SAVE_FILE "data/save.dat"
+#define SAVE_TAG ('G' | ('C' << 8) | ('S' << 16) | ('T' << 24))
+#define SAVE_VERSION 1
+#define SAVE_DEBOUNCE_MS 500
+
+typedef struct {
+    int32_t selected;
+    int32_t menu_active;
+} save_state_t;
+
+static persist_t* persist;
+
+//All motion is driven by time, so it keeps its speed when frames are dropped
+#define CUBE_DEGREES_PER_SECOND 60.0f
+#define MENU_PIXELS_PER_SECOND 420.0f
+
+static animator_t animator;
+
 GLfloat light_ambient[] = { 0.5f, 0.5f, 0.5f, 1.0f };
 GLfloat light_diffuse[] = { 0.8f, 0.8f, 0.8f, 1.0f };
 GLfloat light_pos[] = { 0.0f, 25.0f, 0.0f, 1.0f };
-GLfloat light_direction[] = { 0.0f, 0.0f, -30.0f, 1.0f };
-
-static float cube_vertices[] = {
-        // FRONT
-        -2.0f, -2.0f, 2.0f, 2.0f, -2.0f, 2.0f, -2.0f,
-        2.0f,
-        2.0f,
-        2.0f,
-        2.0f,
-        2.0f,
-        // BACK
-        -2.0f, -2.0f, -2.0f, -2.0f, 2.0f, -2.0f, 2.0f, -2.0f,
-        -2.0f,
-        2.0f,
-        2.0f,
-        -2.0f,
-        // LEFT
-        -2.0f, -2.0f, 2.0f, -2.0f, 2.0f, 2.0f, -2.0f, -2.0f, -2.0f,
-        -2.0f,
-        2.0f,
-        -2.0f,
-        // RIGHT
-        2.0f, -2.0f, -2.0f, 2.0f, 2.0f, -2.0f, 2.0f, -2.0f, 2.0f, 2.0f,
-        2.0f,
-        2.0f,
-        // TOP
-        -2.0f, 2.0f, 2.0f, 2.0f, 2.0f, 2.0f, -2.0f, 2.0f, -2.0f, 2.0f, 2.0f,
-        -2.0f,
-        // BOTTOM
-        -2.0f, -2.0f, 2.0f, -2.0f, -2.0f, -2.0f, 2.0f, -2.0f, 2.0f, 2.0f, -2.0f,
-        -2.0f, };
-
-float cube_normals[] = {
-        // FRONT
-        0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-        0.0f,
-        1.0f,
-        // BACK
-        0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f,
-        0.0f,
-        -1.0f,
-        // LEFT
-        -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f,
-        0.0f,
-        // RIGHT
-        1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-        // TOP
-        0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-        // BOTTOM
-        0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f, 0.0f, 0.0f, -1.0f,
-        0.0f };
+
+//Scene ambient light added to that of the light, the OpenGL ES 1.1 default
+#define SCENE_AMBIENT 0.2f
+
+//Textured quads of the background and menu, in window coordinates
+static GLuint sprite_program;
+static GLint sprite_position_loc, sprite_texcoord_loc, sprite_mvp_loc, sprite_texture_loc;
+
+static const char* sprite_vertex_source =
+        "uniform mat4 u_mvp;"
+        "attribute vec2 a_position;"
+        "attribute vec2 a_texcoord;"
+        "varying mediump vec2 v_texcoord;"
+        "void main()"
+        "{"
+        "    gl_Position = u_mvp * vec4(a_position, 0.0, 1.0);"
+        "    v_texcoord = a_texcoord;"
+        "}";
+
+static const char* sprite_fragment_source =
+        "precision mediump float;"
+        "uniform sampler2D u_texture;"
+        "varying vec2 v_texcoord;"
+        "void main()"
+        "{"
+        "    gl_FragColor = texture2D(u_texture, v_texcoord);"
+        "}";
+
+//The cube, lit per vertex by a point light the same way as the fixed function pipeline did
+static GLuint cube_program;
+static GLint cube_position_loc, cube_normal_loc, cube_mvp_loc, cube_modelview_loc,
+        cube_normal_matrix_loc, cube_light_position_loc, cube_ambient_loc,
+        cube_diffuse_loc, cube_color_loc;
+
+static const char* cube_vertex_source =
+        "uniform mat4 u_mvp;"
+        "uniform mat4 u_modelview;"
+        "uniform mat3 u_normal_matrix;"
+        "uniform vec3 u_light_position;"
+        "uniform vec3 u_ambient;"
+        "uniform vec3 u_diffuse;"
+        "uniform vec4 u_color;"
+        "attribute vec4 a_position;"
+        "attribute vec3 a_normal;"
+        "varying lowp vec4 v_color;"
+        "void main()"
+        "{"
+        "    vec3 position = vec3(u_modelview * a_position);"
+        "    vec3 normal = normalize(u_normal_matrix * a_normal);"
+        "    vec3 light = normalize(u_light_position - position);"
+        "    vec3 intensity = u_ambient + u_diffuse * max(dot(normal, light), 0.0);"
+        "    v_color = vec4(clamp(u_color.rgb * intensity, 0.0, 1.0), u_color.a);"
+        "    gl_Position = u_mvp * a_position;"
+        "}";
+
+static const char* cube_fragment_source =
+        "varying lowp vec4 v_color;"
+        "void main()"
+        "{"
+        "    gl_FragColor = v_color;"
+        "}";
+
+static mat4_t projection_2d, projection_3d;
+
+//The cube is built once into static buffers and drawn with a single call
+static mesh_t cube_mesh;
 
 int resize();
 void update();
@@ -111,6 +150,18 @@ void render();
 int read_from_file();
 void save_to_file();
 
+//Slides the menu in or out, starting from wherever it is now
+static void animate_menu(int show) {
+    float to = show ? menu_height : 0.0f;
+
+    menu_show_animation = show;
+    menu_hide_animation = !show;
+
+    animator_tween(&animator, &menu_animation, to,
+            fabsf(to - menu_animation) / MENU_PIXELS_PER_SECOND,
+            show ? animation_ease_out : animation_ease_in);
+}
+
 void handleClick(int x, int y) {
     if (menu_active) {
         if ((y > menu_height - 4 * button_size_y)
@@ -145,12 +196,11 @@ void handleClick(int x, int y) {
             cube_color[2] = 0.0f;
             cube_color[3] = 1.0f;
         } else {
-            menu_hide_animation = true;
-            menu_show_animation = false;
+            animate_menu(false);
             menu_active = false;
         }
 
-        //Save current state to a file
+        //Queue current state to be saved to a file
         save_to_file();
     }
 }
@@ -204,13 +254,18 @@ static void handleNavigatorEvent(bps_event_t *event) {
         }
         break;
     case NAVIGATOR_SWIPE_DOWN:
-        menu_show_animation = true;
-        menu_hide_animation = false;
+        animate_menu(true);
         break;
     case NAVIGATOR_EXIT:
         shutdown = true;
         break;
     case NAVIGATOR_WINDOW_INACTIVE:
+        //Make sure the latest state is on disk, we may not get to run again
+        persist_flush(persist);
+
+        //Hold all animations until the window is back
+        animator_pause(&animator);
+
         //Wait for NAVIGATOR_WINDOW_ACTIVE event
         for (;;) {
             if (BPS_SUCCESS != bps_get_event(&event, -1)) {
@@ -228,6 +283,8 @@ static void handleNavigatorEvent(bps_event_t *event) {
                 }
             }
         }
+
+        animator_resume(&animator);
         break;
     }
 }
@@ -311,9 +368,112 @@ int resize(bps_event_t *event) {
     return EXIT_SUCCESS;
 }
 
+static GLuint compile_shader(GLenum type, const char* source) {
+    GLint status;
+    GLuint shader = glCreateShader(type);
+
+    if (!shader) {
+        fprintf(stderr, "Failed to create shader: %d\n", glGetError());
+        return 0;
+    }
+
+    glShaderSource(shader, 1, &source, 0);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (GL_FALSE == status) {
+        GLchar log[256];
+        glGetShaderInfoLog(shader, 256, NULL, log);
+
+        fprintf(stderr, "Failed to compile shader: %s\n", log);
+
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+//Returns the linked program, or 0 on failure
+static GLuint create_program(const char* v_source, const char* f_source) {
+    GLint status;
+    GLuint program = 0;
+    GLuint vs = compile_shader(GL_VERTEX_SHADER, v_source);
+    GLuint fs = compile_shader(GL_FRAGMENT_SHADER, f_source);
+
+    if (vs && fs) {
+        program = glCreateProgram();
+    }
+
+    if (program) {
+        glAttachShader(program, vs);
+        glAttachShader(program, fs);
+        glLinkProgram(program);
+
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (GL_FALSE == status) {
+            GLchar log[256];
+            glGetProgramInfoLog(program, 256, NULL, log);
+
+            fprintf(stderr, "Failed to link shader program: %s\n", log);
+
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    //We don't need the shaders anymore - the program is enough
+    if (vs) {
+        glDeleteShader(vs);
+    }
+    if (fs) {
+        glDeleteShader(fs);
+    }
+
+    return program;
+}
+
+static int create_programs() {
+    sprite_program = create_program(sprite_vertex_source, sprite_fragment_source);
+    cube_program = create_program(cube_vertex_source, cube_fragment_source);
+
+    if (!sprite_program || !cube_program) {
+        return EXIT_FAILURE;
+    }
+
+    //Store the locations of the shader variables we need later
+    sprite_position_loc = glGetAttribLocation(sprite_program, "a_position");
+    sprite_texcoord_loc = glGetAttribLocation(sprite_program, "a_texcoord");
+    sprite_mvp_loc = glGetUniformLocation(sprite_program, "u_mvp");
+    sprite_texture_loc = glGetUniformLocation(sprite_program, "u_texture");
+
+    cube_position_loc = glGetAttribLocation(cube_program, "a_position");
+    cube_normal_loc = glGetAttribLocation(cube_program, "a_normal");
+    cube_mvp_loc = glGetUniformLocation(cube_program, "u_mvp");
+    cube_modelview_loc = glGetUniformLocation(cube_program, "u_modelview");
+    cube_normal_matrix_loc = glGetUniformLocation(cube_program, "u_normal_matrix");
+    cube_light_position_loc = glGetUniformLocation(cube_program, "u_light_position");
+    cube_ambient_loc = glGetUniformLocation(cube_program, "u_ambient");
+    cube_diffuse_loc = glGetUniformLocation(cube_program, "u_diffuse");
+    cube_color_loc = glGetUniformLocation(cube_program, "u_color");
+
+    //The light never moves, it sits in eye space where glLightfv used to put it
+    glUseProgram(cube_program);
+    glUniform3f(cube_light_position_loc, light_pos[0], light_pos[1], light_pos[2]);
+    glUniform3f(cube_ambient_loc, SCENE_AMBIENT + light_ambient[0],
+            SCENE_AMBIENT + light_ambient[1], SCENE_AMBIENT + light_ambient[2]);
+    glUniform3f(cube_diffuse_loc, light_diffuse[0], light_diffuse[1], light_diffuse[2]);
+
+    glUseProgram(sprite_program);
+    glUniform1i(sprite_texture_loc, 0);
+
+    return EXIT_SUCCESS;
+}
+
 int initialize() {
     EGLint surface_width, surface_height;
 
+    animator_init(&animator);
+
     //Load background and button textures
     float tex_x = 1.0f, tex_y = 1.0f;
 
@@ -466,6 +626,13 @@ int initialize() {
     bbutil_measure_text(font, "Color Menu", &text_width, &text_height);
     menu_height = text_height + 10.0f + button_size_y * 4;
 
+    //Start the thread that writes the savefile
+    persist = persist_create(SAVE_FILE, SAVE_TAG, SAVE_VERSION, sizeof(save_state_t), SAVE_DEBOUNCE_MS);
+    if (!persist) {
+        fprintf(stderr, "Unable to start writing %s\n", SAVE_FILE);
+        return EXIT_FAILURE;
+    }
+
     //See if a savefile exists. If not, initialize to a hidden menu and a red cube.
     if (!read_from_file()) {
         selected = 3;
@@ -487,17 +654,30 @@ int initialize() {
     }
 
     //Common gl setup
-    glShadeModel(GL_SMOOTH);
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 
-    glLightfv(GL_LIGHT0, GL_AMBIENT, light_ambient);
-    glLightfv(GL_LIGHT0, GL_DIFFUSE, light_diffuse);
-    glLightfv(GL_LIGHT0, GL_POSITION, light_pos);
-    glLightfv(GL_LIGHT0, GL_SPOT_DIRECTION, light_direction);
-
     glEnable(GL_CULL_FACE);
 
-    menu_show_animation = true;
+    if (EXIT_SUCCESS != create_programs()) {
+        fprintf(stderr, "Unable to create shader programs\n");
+        return EXIT_FAILURE;
+    }
+
+    //Build the cube geometry, lit with normals and colored by a uniform
+    mesh_builder_t builder;
+    if (EXIT_SUCCESS != mesh_builder_init(&builder, 2.0f, MESH_NORMALS)
+            || EXIT_SUCCESS != mesh_builder_add_cube(&builder, NULL, 2.0f, NULL)
+            || EXIT_SUCCESS != mesh_create(&cube_mesh, &builder)) {
+        fprintf(stderr, "Unable to create cube mesh\n");
+        mesh_builder_free(&builder);
+        return EXIT_FAILURE;
+    }
+    mesh_builder_free(&builder);
+
+    //Spin the cube for as long as the app runs
+    animator_spin(&animator, &angle, CUBE_DEGREES_PER_SECOND, 360.0f);
+
+    animate_menu(true);
 
     return EXIT_SUCCESS;
 }
@@ -505,55 +685,30 @@ int initialize() {
 void enable_2d() {
     glViewport(0, 0, (int) width, (int) height);
 
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-
-    glOrthof(0.0f, width / height, 0.0f, 1.0f, -1.0f, 1.0f);
-
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
-    glScalef(1.0f / height, 1.0f / height, 1.0f);
+    //One unit per pixel with the origin at the bottom left
+    mat4_ortho(&projection_2d, 0.0f, width, 0.0f, height, -1.0f, 1.0f);
 }
 
 void enable_3d() {
     glViewport(0, 0, (int) width, (int) height);
 
-    GLfloat aspect_ratio = width / height;
-
-    GLfloat fovy = 45.0f;
-    GLfloat zNear = 1.0f;
-    GLfloat zFar = 1000.0f;
-
-    GLfloat top = tan(fovy * 0.0087266462599716478846184538424431f) * zNear;
-    GLfloat bottom = -top;
-
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-
-    glFrustumf(aspect_ratio * bottom, aspect_ratio * top, bottom, top, zNear,
-            zFar);
-
-    glMatrixMode(GL_MODELVIEW);
-    glLoadIdentity();
+    mat4_perspective(&projection_3d, 45.0f, width / height, 1.0f, 1000.0f);
 }
 
 void update() {
-    angle = fmod((angle + 1.0f), 360.0 );
+    //Move the cube and menu to where they should be at this time
+    animator_update(&animator);
 
     if (menu_show_animation) {
-        if (menu_animation < menu_height) {
-            menu_animation += 7.0f;
-        } else {
+        if (!animator_is_running(&animator, &menu_animation)) {
             menu_show_animation = false;
             menu_active = true;
 
-            //Save current state to a file
+            //Queue current state to be saved to a file
             save_to_file();
         }
     } else if (menu_hide_animation) {
-        if (menu_animation > 0.0f) {
-            menu_animation -= 7.0f;
-        } else {
+        if (!animator_is_running(&animator, &menu_animation)) {
             menu_hide_animation = false;
         }
     }
@@ -561,6 +716,16 @@ void update() {
     pos_y = height - menu_animation;
 }
 
+static void draw_sprite(const mat4_t* mvp, const GLfloat* vertices, const GLfloat* tex_coord, GLuint texture) {
+    glUniformMatrix4fv(sprite_mvp_loc, 1, GL_FALSE, mvp->m);
+
+    glVertexAttribPointer(sprite_position_loc, 2, GL_FLOAT, GL_FALSE, 0, vertices);
+    glVertexAttribPointer(sprite_texcoord_loc, 2, GL_FLOAT, GL_FALSE, 0, tex_coord);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
 void render() {
     int i;
 
@@ -570,86 +735,83 @@ void render() {
     //First render background and menu if it is enabled
     enable_2d();
 
-    glEnable(GL_TEXTURE_2D);
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glUseProgram(sprite_program);
+    glActiveTexture(GL_TEXTURE0);
+
+    glEnableVertexAttribArray(sprite_position_loc);
+    glEnableVertexAttribArray(sprite_texcoord_loc);
 
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-
-    glVertexPointer(2, GL_FLOAT, 0, background_vertices);
-    glTexCoordPointer(2, GL_FLOAT, 0, background_tex_coord);
-    glBindTexture(GL_TEXTURE_2D, background);
-
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    draw_sprite(&projection_2d, background_vertices, background_tex_coord, background);
 
     if (menu_active || menu_show_animation || menu_hide_animation) {
-        glTranslatef(pos_x, pos_y, 0.0f);
+        mat4_t mvp = projection_2d;
+        mat4_translate(&mvp, pos_x, pos_y, 0.0f);
 
         for (i = 0; i < 4; i++) {
             if (i == selected) {
-                glVertexPointer(2, GL_FLOAT, 0, radio_btn_selected_vertices);
-                glTexCoordPointer(2, GL_FLOAT, 0, radio_btn_selected_tex_coord);
-                glBindTexture(GL_TEXTURE_2D, radio_btn_selected);
+                draw_sprite(&mvp, radio_btn_selected_vertices,
+                        radio_btn_selected_tex_coord, radio_btn_selected);
             } else {
-                glVertexPointer(2, GL_FLOAT, 0, radio_btn_unselected_vertices);
-                glTexCoordPointer(2, GL_FLOAT, 0,
-                        radio_btn_unselected_tex_coord);
-                glBindTexture(GL_TEXTURE_2D, radio_btn_unselected);
+                draw_sprite(&mvp, radio_btn_unselected_vertices,
+                        radio_btn_unselected_tex_coord, radio_btn_unselected);
             }
 
-            glColor4f(1.0f, 1.0f, 1.0f, 1.0f);
-            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-            glTranslatef(0.0f, 60.0f, 0.0f);
+            mat4_translate(&mvp, 0.0f, 60.0f, 0.0f);
         }
 
-        bbutil_render_text(font, "Color Menu", 10.0f, 10.0f, 0.35f, 0.35f, 0.35f, 1.0f);
-        bbutil_render_text(font, "Red", 70.0f, -40.0f, 0.35f, 0.35f, 0.35f, 1.0f);
-        bbutil_render_text(font, "Green", 70.0f, -100.0f, 0.35f, 0.35f, 0.35f, 1.0f);
-        bbutil_render_text(font, "Blue", 70.0f, -160.0f, 0.35f, 0.35f, 0.35f, 1.0f);
-        bbutil_render_text(font, "Yellow", 70.0f, -220.0f, 0.35f, 0.35f, 0.35f, 1.0f);
+        glDisableVertexAttribArray(sprite_position_loc);
+        glDisableVertexAttribArray(sprite_texcoord_loc);
+
+        //Text is placed in window coordinates, relative to the top of the last button
+        float text_y = pos_y + 4 * 60.0f;
+
+        bbutil_render_text(font, "Color Menu", pos_x + 10.0f, text_y + 10.0f, 0.35f, 0.35f, 0.35f, 1.0f);
+        bbutil_render_text(font, "Red", pos_x + 70.0f, text_y - 40.0f, 0.35f, 0.35f, 0.35f, 1.0f);
+        bbutil_render_text(font, "Green", pos_x + 70.0f, text_y - 100.0f, 0.35f, 0.35f, 0.35f, 1.0f);
+        bbutil_render_text(font, "Blue", pos_x + 70.0f, text_y - 160.0f, 0.35f, 0.35f, 0.35f, 1.0f);
+        bbutil_render_text(font, "Yellow", pos_x + 70.0f, text_y - 220.0f, 0.35f, 0.35f, 0.35f, 1.0f);
+    } else {
+        glDisableVertexAttribArray(sprite_position_loc);
+        glDisableVertexAttribArray(sprite_texcoord_loc);
     }
 
-    glDisableClientState(GL_VERTEX_ARRAY);
-    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
-    glDisable(GL_TEXTURE_2D);
+    glDisable(GL_BLEND);
 
     //Then render the cube
     enable_3d();
-    glEnable(GL_LIGHTING);
-    glEnable(GL_LIGHT0);
-    glEnable(GL_COLOR_MATERIAL);
     glEnable(GL_DEPTH_TEST);
 
-    glTranslatef(cube_pos_x, cube_pos_y, cube_pos_z);
+    //The whole orientation is rebuilt from the angle each frame
+    quat_t rotation, spin;
+    quat_from_axis_angle(&rotation, 30.0f, 1.0f, 0.0f, 0.0f);
+    quat_from_axis_angle(&spin, 15.0f, 0.0f, 0.0f, 1.0f);
+    quat_multiply(&rotation, &rotation, &spin);
+    quat_from_axis_angle(&spin, angle, 0.0f, 1.0f, 0.0f);
+    quat_multiply(&rotation, &rotation, &spin);
 
-    glRotatef(30.0f, 1.0f, 0.0f, 0.0f);
-    glRotatef(15.0f, 0.0f, 0.0f, 1.0f);
-    glRotatef(angle, 0.0f, 1.0f, 0.0f);
+    mat4_t modelview, mvp;
+    float normal_matrix[9];
 
-    glColor4f(cube_color[0], cube_color[1], cube_color[2], cube_color[3]);
+    mat4_translation(&modelview, cube_pos_x, cube_pos_y, cube_pos_z);
+    mat4_rotate(&modelview, &rotation);
+    mat4_normal_matrix(normal_matrix, &modelview);
 
-    glEnableClientState(GL_VERTEX_ARRAY);
-    glEnableClientState(GL_NORMAL_ARRAY);
+    //Turn the shorts of the mesh back into the original coordinates
+    const float scale = 1.0f / cube_mesh.scale;
+    mat4_scale(&modelview, scale, scale, scale);
+    mat4_multiply(&mvp, &projection_3d, &modelview);
 
-    glVertexPointer(3, GL_FLOAT, 0, cube_vertices);
-    glNormalPointer(GL_FLOAT, 0, cube_normals);
+    glUseProgram(cube_program);
+    glUniformMatrix4fv(cube_mvp_loc, 1, GL_FALSE, mvp.m);
+    glUniformMatrix4fv(cube_modelview_loc, 1, GL_FALSE, modelview.m);
+    glUniformMatrix3fv(cube_normal_matrix_loc, 1, GL_FALSE, normal_matrix);
+    glUniform4fv(cube_color_loc, 1, cube_color);
+
+    mesh_draw(&cube_mesh, cube_position_loc, cube_normal_loc, -1);
 
-    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-    glDrawArrays(GL_TRIANGLE_STRIP, 4, 4);
-    glDrawArrays(GL_TRIANGLE_STRIP, 8, 4);
-    glDrawArrays(GL_TRIANGLE_STRIP, 12, 4);
-    glDrawArrays(GL_TRIANGLE_STRIP, 16, 4);
-    glDrawArrays(GL_TRIANGLE_STRIP, 20, 4);
-
-    glDisableClientState(GL_VERTEX_ARRAY);
-    glDisableClientState(GL_NORMAL_ARRAY);
-
-    glDisable(GL_LIGHTING);
-    glDisable(GL_LIGHT0);
-    glDisable(GL_COLOR_MATERIAL);
     glDisable(GL_DEPTH_TEST);
 
     //Use utility code to update the screen
@@ -657,72 +819,80 @@ void render() {
 }
 
 int read_from_file() {
-    //open file as binary
-    FILE *fp = fopen("data/save.dat", "rb");
+    save_state_t state;
 
-    if (!fp) {
+    //Map the savefile, anything damaged or from another version is ignored
+    if (EXIT_SUCCESS != persist_load(SAVE_FILE, SAVE_TAG, SAVE_VERSION, &state, sizeof(state))) {
         return false;
     }
 
-    int rc = fscanf(fp, "%i %i", &selected, &menu_active);
-
-    if (rc == -1) {
-        return false;
+    if (state.selected == 0) {
+        cube_color[0] = 1.0f;
+        cube_color[1] = 1.0f;
+        cube_color[2] = 0.0f;
+        cube_color[3] = 1.0f;
+    } else if (state.selected == 1) {
+        cube_color[0] = 0.0f;
+        cube_color[1] = 0.0f;
+        cube_color[2] = 1.0f;
+        cube_color[3] = 1.0f;
+    } else if (state.selected == 2) {
+        cube_color[0] = 0.0f;
+        cube_color[1] = 1.0f;
+        cube_color[2] = 0.0f;
+        cube_color[3] = 1.0f;
+    } else if (state.selected == 3) {
+        cube_color[0] = 1.0f;
+        cube_color[1] = 0.0f;
+        cube_color[2] = 0.0f;
+        cube_color[3] = 1.0f;
     } else {
-        if (selected == 0) {
-            cube_color[0] = 1.0f;
-            cube_color[1] = 1.0f;
-            cube_color[2] = 0.0f;
-            cube_color[3] = 1.0f;
-        } else if (selected == 1) {
-            cube_color[0] = 0.0f;
-            cube_color[1] = 0.0f;
-            cube_color[2] = 1.0f;
-            cube_color[3] = 1.0f;
-        } else if (selected == 2) {
-            cube_color[0] = 0.0f;
-            cube_color[1] = 1.0f;
-            cube_color[2] = 0.0f;
-            cube_color[3] = 1.0f;
-        } else if (selected == 3) {
-            cube_color[0] = 1.0f;
-            cube_color[1] = 0.0f;
-            cube_color[2] = 0.0f;
-            cube_color[3] = 1.0f;
-        } else {
-            return false;
-        }
+        return false;
     }
 
+    selected = state.selected;
+    menu_active = state.menu_active;
+
     if (menu_active) {
         menu_animation = menu_height;
     }
 
-    fclose(fp);
     return true;
 }
 
 void save_to_file() {
-    //open file as binary
-    FILE *fp = fopen("data/save.dat", "wb");
+    save_state_t state;
 
-    if (!fp) {
-        return;
-    }
+    state.selected = selected;
+    state.menu_active = menu_active;
 
-    fprintf(fp, "%i %i", selected, menu_active);
+    //Only copies the state, the file is written by the persist thread
+    persist_save(persist, &state);
+}
 
-    fclose(fp);
+//Prints the time from launch to the first frame on screen. The first launch decodes the
+//textures, later launches load them from the texture cache in the data directory.
+static void report_time_to_first_frame(const struct timespec* launch_time) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    fprintf(stderr, "Time to first frame: %.1f ms\n",
+            (now.tv_sec - launch_time->tv_sec) * 1000.0 + (now.tv_nsec - launch_time->tv_nsec) / 1000000.0);
 }
 
 int main(int argc, char *argv[]) {
+    struct timespec launch_time;
+    int first_frame = true;
+
+    clock_gettime(CLOCK_MONOTONIC, &launch_time);
+
     //Create a screen context that will be used to create an EGL surface to to receive libscreen events
     screen_create_context(&screen_cxt, SCREEN_APPLICATION_CONTEXT);
 
     //Initialize BPS library
     bps_initialize();
 
-    //Use utility code to initialize EGL for rendering with GL ES 1.1
+    //Use utility code to initialize EGL for rendering with GL ES 2.0
     if (EXIT_SUCCESS != bbutil_init_egl(screen_cxt)) {
         fprintf(stderr, "bbutil_init_egl failed\n");
         bbutil_terminate();
@@ -760,11 +930,23 @@ int main(int argc, char *argv[]) {
         update();
         // Draw Scene
         render();
+
+        if (first_frame) {
+            first_frame = false;
+            report_time_to_first_frame(&launch_time);
+        }
     }
 
+    //Write any state that is still waiting and stop the persist thread
+    persist_destroy(persist);
+
     //Stop requesting events from libscreen
     screen_stop_events(screen_cxt);
 
+    mesh_destroy(&cube_mesh);
+    glDeleteProgram(sprite_program);
+    glDeleteProgram(cube_program);
+
     //Use utility code to terminate EGL setup
     bbutil_terminate();
 
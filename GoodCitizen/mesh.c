@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "mesh.h"
+
+//Face normal, then the two axes along the face, crossing to the normal
+static const int cube_faces[6][3][3] = {
+    //front
+    { { 0, 0, 1 }, { 1, 0, 0 }, { 0, 1, 0 } },
+    //right
+    { { 1, 0, 0 }, { 0, 0, -1 }, { 0, 1, 0 } },
+    //back
+    { { 0, 0, -1 }, { -1, 0, 0 }, { 0, 1, 0 } },
+    //left
+    { { -1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },
+    //top
+    { { 0, 1, 0 }, { 1, 0, 0 }, { 0, 0, -1 } },
+    //bottom
+    { { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+};
+
+static GLshort quantize(float value, float scale) {
+    float v = floorf(value * scale + 0.5f);
+    return (GLshort)(v > 32767.0f ? 32767.0f : (v < -32767.0f ? -32767.0f : v));
+}
+
+static int grow(void** data, int* capacity, int needed, size_t size) {
+    int new_capacity = *capacity;
+    void* new_data;
+
+    if (needed <= *capacity) {
+        return EXIT_SUCCESS;
+    }
+
+    while (new_capacity < needed) {
+        new_capacity = new_capacity ? new_capacity * 2 : 256;
+    }
+
+    new_data = realloc(*data, new_capacity * size);
+    if (!new_data) {
+        return EXIT_FAILURE;
+    }
+
+    *data = new_data;
+    *capacity = new_capacity;
+    return EXIT_SUCCESS;
+}
+
+int mesh_builder_init(mesh_builder_t* builder, float extent, int attributes) {
+    memset(builder, 0, sizeof(mesh_builder_t));
+
+    if (extent <= 0.0f) {
+        return EXIT_FAILURE;
+    }
+
+    //Use the whole range of a short for the largest coordinate
+    builder->scale = 32767.0f / extent;
+    builder->attributes = attributes;
+
+    return EXIT_SUCCESS;
+}
+
+int mesh_builder_add_cube(mesh_builder_t* builder, const float* center, float half_size, const GLubyte face_colors[6][4]) {
+    static const float corners[4][2] = { { -1.0f, -1.0f }, { 1.0f, -1.0f }, { -1.0f, 1.0f }, { 1.0f, 1.0f } };
+    const float origin[3] = { 0.0f, 0.0f, 0.0f };
+    int face, corner, axis;
+
+    if (!center) {
+        center = origin;
+    }
+
+    if (builder->vertex_count + MESH_CUBE_VERTICES > MESH_MAX_VERTICES) {
+        return EXIT_FAILURE;
+    }
+
+    if (EXIT_SUCCESS != grow((void**)&builder->vertices, &builder->vertex_capacity,
+                    builder->vertex_count + MESH_CUBE_VERTICES, sizeof(mesh_vertex_t))
+            || EXIT_SUCCESS != grow((void**)&builder->indices, &builder->index_capacity,
+                    builder->index_count + MESH_CUBE_INDICES, sizeof(GLushort))) {
+        return EXIT_FAILURE;
+    }
+
+    for (face = 0; face < 6; face++) {
+        const int (*f)[3] = cube_faces[face];
+        GLushort base = (GLushort)builder->vertex_count;
+        GLushort* index = builder->indices + builder->index_count;
+
+        for (corner = 0; corner < 4; corner++) {
+            mesh_vertex_t* v = &builder->vertices[builder->vertex_count++];
+
+            for (axis = 0; axis < 3; axis++) {
+                float offset = f[0][axis] + corners[corner][0] * f[1][axis] + corners[corner][1] * f[2][axis];
+                v->position[axis] = quantize(center[axis] + offset * half_size, builder->scale);
+                v->normal[axis] = (GLbyte)(f[0][axis] * 127);
+            }
+            v->position[3] = 0;
+            v->normal[3] = 0;
+
+            if (face_colors) {
+                memcpy(v->color, face_colors[face], 4);
+            } else {
+                memset(v->color, 255, 4);
+            }
+        }
+
+        //The corners form a strip, split into two triangles with the same winding
+        index[0] = base;
+        index[1] = base + 1;
+        index[2] = base + 2;
+        index[3] = base + 2;
+        index[4] = base + 1;
+        index[5] = base + 3;
+        builder->index_count += 6;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void mesh_builder_free(mesh_builder_t* builder) {
+    free(builder->vertices);
+    free(builder->indices);
+    memset(builder, 0, sizeof(mesh_builder_t));
+}
+
+int mesh_create(mesh_t* mesh, const mesh_builder_t* builder) {
+    GLuint buffers[2];
+
+    memset(mesh, 0, sizeof(mesh_t));
+
+    if (!builder->index_count) {
+        return EXIT_FAILURE;
+    }
+
+    glGenBuffers(2, buffers);
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, builder->vertex_count * sizeof(mesh_vertex_t), builder->vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, builder->index_count * sizeof(GLushort), builder->indices, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    GLenum err = glGetError();
+    if (err != GL_NO_ERROR) {
+        fprintf(stderr, "Unable to create mesh buffers, GL error %i\n", err);
+        glDeleteBuffers(2, buffers);
+        return EXIT_FAILURE;
+    }
+
+    mesh->vertex_buffer = buffers[0];
+    mesh->index_buffer = buffers[1];
+    mesh->index_count = builder->index_count;
+    mesh->scale = builder->scale;
+    mesh->attributes = builder->attributes;
+
+    return EXIT_SUCCESS;
+}
+
+void mesh_draw(const mesh_t* mesh, GLint position, GLint normal, GLint color) {
+    const GLsizei stride = sizeof(mesh_vertex_t);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mesh->vertex_buffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->index_buffer);
+
+    //Positions stay in shorts, the model matrix turns them back into the original coordinates
+#ifdef USING_GL11
+    (void)position;
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_SHORT, stride, (const GLvoid*)offsetof(mesh_vertex_t, position));
+
+    if (normal >= 0 && (mesh->attributes & MESH_NORMALS)) {
+        glEnableClientState(GL_NORMAL_ARRAY);
+        glNormalPointer(GL_BYTE, stride, (const GLvoid*)offsetof(mesh_vertex_t, normal));
+    }
+
+    if (color >= 0 && (mesh->attributes & MESH_COLORS)) {
+        glEnableClientState(GL_COLOR_ARRAY);
+        glColorPointer(4, GL_UNSIGNED_BYTE, stride, (const GLvoid*)offsetof(mesh_vertex_t, color));
+    }
+
+    glDrawElements(GL_TRIANGLES, mesh->index_count, GL_UNSIGNED_SHORT, 0);
+
+    if (color >= 0 && (mesh->attributes & MESH_COLORS)) {
+        glDisableClientState(GL_COLOR_ARRAY);
+    }
+    if (normal >= 0 && (mesh->attributes & MESH_NORMALS)) {
+        glDisableClientState(GL_NORMAL_ARRAY);
+    }
+    glDisableClientState(GL_VERTEX_ARRAY);
+#else
+    glEnableVertexAttribArray(position);
+    glVertexAttribPointer(position, 3, GL_SHORT, GL_FALSE, stride, (const GLvoid*)offsetof(mesh_vertex_t, position));
+
+    if (normal >= 0 && (mesh->attributes & MESH_NORMALS)) {
+        glEnableVertexAttribArray(normal);
+        glVertexAttribPointer(normal, 3, GL_BYTE, GL_TRUE, stride, (const GLvoid*)offsetof(mesh_vertex_t, normal));
+    }
+
+    if (color >= 0 && (mesh->attributes & MESH_COLORS)) {
+        glEnableVertexAttribArray(color);
+        glVertexAttribPointer(color, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (const GLvoid*)offsetof(mesh_vertex_t, color));
+    }
+
+    glDrawElements(GL_TRIANGLES, mesh->index_count, GL_UNSIGNED_SHORT, 0);
+
+    if (color >= 0 && (mesh->attributes & MESH_COLORS)) {
+        glDisableVertexAttribArray(color);
+    }
+    if (normal >= 0 && (mesh->attributes & MESH_NORMALS)) {
+        glDisableVertexAttribArray(normal);
+    }
+    glDisableVertexAttribArray(position);
+#endif
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void mesh_destroy(mesh_t* mesh) {
+    if (mesh->vertex_buffer) {
+        glDeleteBuffers(1, &mesh->vertex_buffer);
+    }
+    if (mesh->index_buffer) {
+        glDeleteBuffers(1, &mesh->index_buffer);
+    }
+    memset(mesh, 0, sizeof(mesh_t));
+}
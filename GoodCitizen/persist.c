@@ -0,0 +1,377 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "persist.h"
+
+#define HEADER_SIZE 20
+
+//A burst of saves that never pauses is still written after this many debounce times
+#define MAX_DEBOUNCES 4
+
+static const char MAGIC[4] = { 'P', 'R', 'S', 'T' };
+
+struct persist_t {
+    char* path;
+    char* temp_path;
+    uint32_t tag;
+    int version;
+    size_t size;
+    uint64_t debounce;
+
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    //Signalled when new state comes in, a flush is requested or the writer should stop
+    pthread_cond_t wake;
+    //Signalled after every write
+    pthread_cond_t written;
+
+    //Newest state handed in, and the copy the writer thread is writing without the lock held
+    void* pending;
+    void* writing;
+    int has_pending;
+    uint64_t first_save;
+    uint64_t last_save;
+
+    //Every save gets the next generation, so a flush can wait for the one it saw
+    unsigned saved_generation;
+    unsigned written_generation;
+    int last_result;
+
+    int flush_requested;
+    int stop;
+};
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t crc32(const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*)data;
+    uint32_t crc = 0xffffffffu;
+    size_t i;
+    int k;
+
+    for (i = 0; i < size; i++) {
+        crc ^= p[i];
+        for (k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xedb88320u & (0u - (crc & 1)));
+        }
+    }
+
+    return ~crc;
+}
+
+static void put32(uint8_t* p, uint32_t value) {
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    p[2] = (value >> 16) & 0xff;
+    p[3] = (value >> 24) & 0xff;
+}
+
+static uint32_t get32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int write_all(int fd, const void* data, size_t size) {
+    const uint8_t* p = (const uint8_t*)data;
+
+    while (size > 0) {
+        ssize_t n = write(fd, p, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return EXIT_FAILURE;
+        }
+        p += n;
+        size -= n;
+    }
+
+    return EXIT_SUCCESS;
+}
+
+//Makes the rename itself survive a power loss by syncing the directory that holds the file
+static void sync_directory(const char* path) {
+    const char* slash = strrchr(path, '/');
+    char* dir;
+    int fd;
+
+    if (!slash) {
+        dir = strdup(".");
+    } else {
+        dir = strndup(path, slash == path ? 1 : slash - path);
+    }
+    if (!dir) {
+        return;
+    }
+
+    fd = open(dir, O_RDONLY);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    free(dir);
+}
+
+static int write_file(persist_t* persist, const void* data) {
+    uint8_t header[HEADER_SIZE] = { 0 };
+    int fd;
+
+    memcpy(header, MAGIC, sizeof(MAGIC));
+    put32(header + 4, persist->tag);
+    header[8] = persist->version & 0xff;
+    header[9] = (persist->version >> 8) & 0xff;
+    put32(header + 12, (uint32_t)persist->size);
+    put32(header + 16, crc32(data, persist->size));
+
+    fd = open(persist->temp_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0) {
+        fprintf(stderr, "Unable to create %s\n", persist->temp_path);
+        return EXIT_FAILURE;
+    }
+
+    //The new file has to be complete on disk before it replaces the old one
+    if (EXIT_SUCCESS != write_all(fd, header, sizeof(header))
+            || EXIT_SUCCESS != write_all(fd, data, persist->size)
+            || fsync(fd) != 0) {
+        fprintf(stderr, "Unable to write %s\n", persist->temp_path);
+        close(fd);
+        unlink(persist->temp_path);
+        return EXIT_FAILURE;
+    }
+
+    if (close(fd) != 0 || rename(persist->temp_path, persist->path) != 0) {
+        fprintf(stderr, "Unable to replace %s\n", persist->path);
+        unlink(persist->temp_path);
+        return EXIT_FAILURE;
+    }
+
+    sync_directory(persist->path);
+
+    return EXIT_SUCCESS;
+}
+
+static void* writer_thread(void* arg) {
+    persist_t* persist = (persist_t*)arg;
+
+    pthread_mutex_lock(&persist->mutex);
+
+    for (;;) {
+        while (!persist->has_pending && !persist->stop) {
+            pthread_cond_wait(&persist->wake, &persist->mutex);
+        }
+
+        if (!persist->has_pending) {
+            break;
+        }
+
+        //Wait for the saves to pause, but not forever
+        while (!persist->stop && !persist->flush_requested) {
+            uint64_t deadline = persist->last_save + persist->debounce;
+            uint64_t limit = persist->first_save + MAX_DEBOUNCES * persist->debounce;
+            uint64_t now = now_ns();
+            struct timespec ts;
+
+            if (deadline > limit) {
+                deadline = limit;
+            }
+            if (now >= deadline) {
+                break;
+            }
+
+            ts.tv_sec = deadline / 1000000000ULL;
+            ts.tv_nsec = deadline % 1000000000ULL;
+            pthread_cond_timedwait(&persist->wake, &persist->mutex, &ts);
+        }
+
+        //Take the newest state and write it without holding up further saves
+        unsigned generation = persist->saved_generation;
+        memcpy(persist->writing, persist->pending, persist->size);
+        persist->has_pending = 0;
+        persist->flush_requested = 0;
+        pthread_mutex_unlock(&persist->mutex);
+
+        int result = write_file(persist, persist->writing);
+
+        pthread_mutex_lock(&persist->mutex);
+        persist->written_generation = generation;
+        persist->last_result = result;
+        pthread_cond_broadcast(&persist->written);
+    }
+
+    pthread_mutex_unlock(&persist->mutex);
+
+    return NULL;
+}
+
+int persist_load(const char* path, uint32_t tag, int version, void* data, size_t size) {
+    struct stat st;
+    const uint8_t* map;
+    int fd;
+    int result = EXIT_FAILURE;
+
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return EXIT_FAILURE;
+    }
+
+    if (fstat(fd, &st) != 0 || st.st_size != (off_t)(HEADER_SIZE + size)) {
+        close(fd);
+        return EXIT_FAILURE;
+    }
+
+    map = (const uint8_t*)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return EXIT_FAILURE;
+    }
+
+    if (!memcmp(map, MAGIC, sizeof(MAGIC))
+            && get32(map + 4) == tag
+            && (map[8] | (map[9] << 8)) == version
+            && get32(map + 12) == size
+            && get32(map + 16) == crc32(map + HEADER_SIZE, size)) {
+        memcpy(data, map + HEADER_SIZE, size);
+        result = EXIT_SUCCESS;
+    }
+
+    munmap((void*)map, st.st_size);
+
+    return result;
+}
+
+persist_t* persist_create(const char* path, uint32_t tag, int version, size_t size, int debounce_ms) {
+    persist_t* persist = (persist_t*)calloc(1, sizeof(persist_t));
+    pthread_condattr_t attr;
+    size_t length = strlen(path);
+
+    if (!persist) {
+        return NULL;
+    }
+
+    persist->path = strdup(path);
+    persist->temp_path = (char*)malloc(length + 5);
+    persist->pending = malloc(size);
+    persist->writing = malloc(size);
+    if (!persist->path || !persist->temp_path || !persist->pending || !persist->writing) {
+        goto fail;
+    }
+    memcpy(persist->temp_path, path, length);
+    memcpy(persist->temp_path + length, ".tmp", 5);
+
+    persist->tag = tag;
+    persist->version = version;
+    persist->size = size;
+    persist->debounce = (uint64_t)debounce_ms * 1000000ULL;
+    persist->last_result = EXIT_SUCCESS;
+
+    //Deadlines are measured on the monotonic clock, so changing the time of day does not delay a write
+    pthread_mutex_init(&persist->mutex, NULL);
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&persist->wake, &attr);
+    pthread_cond_init(&persist->written, NULL);
+    pthread_condattr_destroy(&attr);
+
+    if (pthread_create(&persist->thread, NULL, writer_thread, persist) != 0) {
+        pthread_cond_destroy(&persist->written);
+        pthread_cond_destroy(&persist->wake);
+        pthread_mutex_destroy(&persist->mutex);
+        goto fail;
+    }
+
+    return persist;
+
+fail:
+    free(persist->writing);
+    free(persist->pending);
+    free(persist->temp_path);
+    free(persist->path);
+    free(persist);
+    return NULL;
+}
+
+void persist_save(persist_t* persist, const void* data) {
+    uint64_t now = now_ns();
+
+    pthread_mutex_lock(&persist->mutex);
+    memcpy(persist->pending, data, persist->size);
+    if (!persist->has_pending) {
+        persist->first_save = now;
+    }
+    persist->last_save = now;
+    persist->has_pending = 1;
+    persist->saved_generation++;
+    pthread_cond_signal(&persist->wake);
+    pthread_mutex_unlock(&persist->mutex);
+}
+
+int persist_flush(persist_t* persist) {
+    int result;
+
+    pthread_mutex_lock(&persist->mutex);
+    unsigned generation = persist->saved_generation;
+
+    if (persist->has_pending) {
+        persist->flush_requested = 1;
+        pthread_cond_signal(&persist->wake);
+    }
+
+    //Also waits for a write that is already under way
+    while ((int)(persist->written_generation - generation) < 0) {
+        pthread_cond_wait(&persist->written, &persist->mutex);
+    }
+    result = persist->last_result;
+    pthread_mutex_unlock(&persist->mutex);
+
+    return result;
+}
+
+void persist_destroy(persist_t* persist) {
+    if (!persist) {
+        return;
+    }
+
+    pthread_mutex_lock(&persist->mutex);
+    persist->stop = 1;
+    pthread_cond_signal(&persist->wake);
+    pthread_mutex_unlock(&persist->mutex);
+
+    //The writer thread writes whatever is still waiting before it returns
+    pthread_join(persist->thread, NULL);
+
+    pthread_cond_destroy(&persist->written);
+    pthread_cond_destroy(&persist->wake);
+    pthread_mutex_destroy(&persist->mutex);
+    free(persist->writing);
+    free(persist->pending);
+    free(persist->temp_path);
+    free(persist->path);
+    free(persist);
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _PERSIST_H_INCLUDED
+#define _PERSIST_H_INCLUDED
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Saves a fixed size block of app state to a file without blocking the
+ * caller and without ever leaving a damaged file behind.
+ *
+ * The file holds a 20 byte header followed by the state:
+ *
+ *   magic "PRST", the app's tag (4 bytes), the app's version of the state
+ *   (16 bits), 16 reserved bits, the size of the state (32 bits) and a
+ *   CRC-32 of the state (32 bits)
+ *
+ * followed by the state exactly as passed in, in the device's byte order.
+ * A file with another tag, version or size, or whose checksum does not
+ * match, is not loaded.
+ *
+ * Saving only copies the state.  A writer thread waits until no new state
+ * has come in for the debounce time, so a burst of saves costs one write,
+ * then writes the newest state to a temporary file, syncs it and renames
+ * it over the old file.  A crash at any point leaves either the old or the
+ * new state on disk.
+ *
+ * Nothing here depends on the rest of the app, so other samples can use it
+ * as it is.
+ */
+typedef struct persist_t persist_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Loads state saved by persist_save() by mapping the file into memory.
+ *
+ * @param path of the file
+ * @param tag four characters identifying the app's state, e.g. 'GCST'
+ * @param version of the app's state layout, bumped whenever it changes
+ * @param data receives the state
+ * @param size of the state in bytes
+ * @return EXIT_SUCCESS if valid state was loaded, otherwise EXIT_FAILURE and data is left untouched
+ */
+int persist_load(const char* path, uint32_t tag, int version, void* data, size_t size);
+
+/**
+ * Starts the writer thread for a file.
+ *
+ * @param path of the file, the temporary file is path with ".tmp" appended
+ * @param tag, version, size as for persist_load()
+ * @param debounce_ms time without new state before it is written
+ * @return the writer, or NULL if it could not be started
+ */
+persist_t* persist_create(const char* path, uint32_t tag, int version, size_t size, int debounce_ms);
+
+/**
+ * Hands a copy of the state to the writer and returns right away.  Only
+ * the newest state is written when several come in within the debounce
+ * time.
+ *
+ * @param persist writer returned by persist_create()
+ * @param data state of the size given to persist_create()
+ */
+void persist_save(persist_t* persist, const void* data);
+
+/**
+ * Writes any state that is still waiting without further delay and
+ * returns once it is on disk.
+ *
+ * @return EXIT_SUCCESS if nothing was waiting or it was written, otherwise EXIT_FAILURE
+ */
+int persist_flush(persist_t* persist);
+
+/**
+ * Writes any state that is still waiting, stops the writer thread and
+ * frees the writer.
+ */
+void persist_destroy(persist_t* persist);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PERSIST_H_INCLUDED */
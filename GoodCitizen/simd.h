@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SIMD_H_
+#define SIMD_H_
+
+/**
+ * Minimal portable 4-wide float vector layer.
+ *
+ * Maps onto NEON on ARM and SSE on x86. Everywhere else SIMD_SCALAR is
+ * defined and callers are expected to use their plain C loop instead.
+ *
+ * Only operations that are exact in IEEE single precision are exposed (no
+ * reciprocal estimates, no fused multiply-add), so a kernel written against
+ * this header produces the same bits as the equivalent scalar loop as long
+ * as no input or intermediate result is denormal. ARMv7 NEON flushes
+ * denormals to zero while VFP, which runs the scalar loop, does not.
+ */
+
+#define SIMD_WIDTH 4
+
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+
+#include <arm_neon.h>
+
+#define SIMD_NAME "NEON"
+
+typedef float32x4_t simd4f;
+typedef uint32x4_t simd4m;
+
+static inline simd4f simd4f_load(const float *p) { return vld1q_f32(p); }
+static inline void simd4f_store(float *p, simd4f a) { vst1q_f32(p, a); }
+static inline simd4f simd4f_splat(float f) { return vdupq_n_f32(f); }
+static inline simd4f simd4f_add(simd4f a, simd4f b) { return vaddq_f32(a, b); }
+static inline simd4f simd4f_sub(simd4f a, simd4f b) { return vsubq_f32(a, b); }
+static inline simd4f simd4f_mul(simd4f a, simd4f b) { return vmulq_f32(a, b); }
+static inline simd4f simd4f_min(simd4f a, simd4f b) { return vminq_f32(a, b); }
+static inline simd4f simd4f_max(simd4f a, simd4f b) { return vmaxq_f32(a, b); }
+static inline simd4m simd4f_cmpgt(simd4f a, simd4f b) { return vcgtq_f32(a, b); }
+static inline simd4m simd4m_or(simd4m a, simd4m b) { return vorrq_u32(a, b); }
+static inline simd4f simd4f_select(simd4m m, simd4f a, simd4f b) { return vbslq_f32(m, a, b); }
+
+#elif defined(__SSE__) || defined(_M_IX86_FP)
+
+#include <xmmintrin.h>
+
+#define SIMD_NAME "SSE"
+
+typedef __m128 simd4f;
+typedef __m128 simd4m;
+
+static inline simd4f simd4f_load(const float *p) { return _mm_load_ps(p); }
+static inline void simd4f_store(float *p, simd4f a) { _mm_store_ps(p, a); }
+static inline simd4f simd4f_splat(float f) { return _mm_set1_ps(f); }
+static inline simd4f simd4f_add(simd4f a, simd4f b) { return _mm_add_ps(a, b); }
+static inline simd4f simd4f_sub(simd4f a, simd4f b) { return _mm_sub_ps(a, b); }
+static inline simd4f simd4f_mul(simd4f a, simd4f b) { return _mm_mul_ps(a, b); }
+static inline simd4f simd4f_min(simd4f a, simd4f b) { return _mm_min_ps(a, b); }
+static inline simd4f simd4f_max(simd4f a, simd4f b) { return _mm_max_ps(a, b); }
+static inline simd4m simd4f_cmpgt(simd4f a, simd4f b) { return _mm_cmpgt_ps(a, b); }
+static inline simd4m simd4m_or(simd4m a, simd4m b) { return _mm_or_ps(a, b); }
+static inline simd4f simd4f_select(simd4m m, simd4f a, simd4f b) {
+    return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+}
+
+#else
+
+//No vector unit, users fall back to their scalar loops
+#define SIMD_NAME "C"
+#define SIMD_SCALAR
+
+#endif
+
+#endif /* SIMD_H_ */
@@ -0,0 +1,385 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <float.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "simd.h"
+#include "vecmath.h"
+
+void vec4_set(vec4_t* out, float x, float y, float z, float w) {
+    out->v[0] = x;
+    out->v[1] = y;
+    out->v[2] = z;
+    out->v[3] = w;
+}
+
+void mat4_identity(mat4_t* out) {
+    memset(out, 0, sizeof(mat4_t));
+    out->m[0] = 1.0f;
+    out->m[5] = 1.0f;
+    out->m[10] = 1.0f;
+    out->m[15] = 1.0f;
+}
+
+//Each column of the result is the columns of a weighted by one column of b
+void mat4_multiply_scalar(mat4_t* out, const mat4_t* a, const mat4_t* b) {
+    mat4_t result;
+    int i, j;
+
+    for (j = 0; j < 4; j++) {
+        for (i = 0; i < 4; i++) {
+            result.m[4 * j + i] = a->m[i] * b->m[4 * j]
+                    + a->m[4 + i] * b->m[4 * j + 1]
+                    + a->m[8 + i] * b->m[4 * j + 2]
+                    + a->m[12 + i] * b->m[4 * j + 3];
+        }
+    }
+
+    *out = result;
+}
+
+void mat4_multiply(mat4_t* out, const mat4_t* a, const mat4_t* b) {
+#ifdef SIMD_SCALAR
+    mat4_multiply_scalar(out, a, b);
+#else
+    const simd4f a0 = simd4f_load(a->m);
+    const simd4f a1 = simd4f_load(a->m + 4);
+    const simd4f a2 = simd4f_load(a->m + 8);
+    const simd4f a3 = simd4f_load(a->m + 12);
+    simd4f c[4];
+    int j;
+
+    for (j = 0; j < 4; j++) {
+        const float* column = b->m + 4 * j;
+        c[j] = simd4f_add(simd4f_add(simd4f_add(
+                simd4f_mul(a0, simd4f_splat(column[0])),
+                simd4f_mul(a1, simd4f_splat(column[1]))),
+                simd4f_mul(a2, simd4f_splat(column[2]))),
+                simd4f_mul(a3, simd4f_splat(column[3])));
+    }
+
+    //Only store once every column is done, out may be a or b
+    for (j = 0; j < 4; j++) {
+        simd4f_store(out->m + 4 * j, c[j]);
+    }
+#endif
+}
+
+void mat4_transform_scalar(vec4_t* out, const mat4_t* m, const vec4_t* v) {
+    vec4_t result;
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        result.v[i] = m->m[i] * v->v[0]
+                + m->m[4 + i] * v->v[1]
+                + m->m[8 + i] * v->v[2]
+                + m->m[12 + i] * v->v[3];
+    }
+
+    *out = result;
+}
+
+void mat4_transform(vec4_t* out, const mat4_t* m, const vec4_t* v) {
+#ifdef SIMD_SCALAR
+    mat4_transform_scalar(out, m, v);
+#else
+    simd4f result = simd4f_add(simd4f_add(simd4f_add(
+            simd4f_mul(simd4f_load(m->m), simd4f_splat(v->v[0])),
+            simd4f_mul(simd4f_load(m->m + 4), simd4f_splat(v->v[1]))),
+            simd4f_mul(simd4f_load(m->m + 8), simd4f_splat(v->v[2]))),
+            simd4f_mul(simd4f_load(m->m + 12), simd4f_splat(v->v[3])));
+
+    simd4f_store(out->v, result);
+#endif
+}
+
+//Elimination works on the columns of m as the rows of m transposed. The inverse of the transpose
+//is the transpose of the inverse, so its rows come out as the columns of the inverse of m.
+//Returns the row with the largest entry in column p from row p down, to pivot on.
+static int find_pivot(const mat4_t* a, int p) {
+    int pivot = p;
+    int r;
+
+    for (r = p + 1; r < 4; r++) {
+        if (fabsf(a->m[4 * r + p]) > fabsf(a->m[4 * pivot + p])) {
+            pivot = r;
+        }
+    }
+
+    return pivot;
+}
+
+//Pivots this small compared to the largest entry of the matrix mean it is singular
+static float singular_limit(const mat4_t* m) {
+    float largest = 0.0f;
+    int i;
+
+    for (i = 0; i < 16; i++) {
+        if (fabsf(m->m[i]) > largest) {
+            largest = fabsf(m->m[i]);
+        }
+    }
+
+    return largest * 4.0f * FLT_EPSILON;
+}
+
+static void swap_rows(mat4_t* a, int r0, int r1) {
+    float row[4];
+
+    memcpy(row, a->m + 4 * r0, sizeof(row));
+    memcpy(a->m + 4 * r0, a->m + 4 * r1, sizeof(row));
+    memcpy(a->m + 4 * r1, row, sizeof(row));
+}
+
+int mat4_inverse_scalar(mat4_t* out, const mat4_t* m) {
+    const float limit = singular_limit(m);
+    mat4_t a = *m;
+    mat4_t b;
+    int p, r, k;
+
+    mat4_identity(&b);
+
+    for (p = 0; p < 4; p++) {
+        int pivot = find_pivot(&a, p);
+        if (fabsf(a.m[4 * pivot + p]) <= limit) {
+            return EXIT_FAILURE;
+        }
+        if (pivot != p) {
+            swap_rows(&a, p, pivot);
+            swap_rows(&b, p, pivot);
+        }
+
+        const float scale = 1.0f / a.m[4 * p + p];
+        for (k = 0; k < 4; k++) {
+            a.m[4 * p + k] = a.m[4 * p + k] * scale;
+            b.m[4 * p + k] = b.m[4 * p + k] * scale;
+        }
+
+        for (r = 0; r < 4; r++) {
+            if (r != p) {
+                const float f = a.m[4 * r + p];
+                for (k = 0; k < 4; k++) {
+                    a.m[4 * r + k] = a.m[4 * r + k] - f * a.m[4 * p + k];
+                    b.m[4 * r + k] = b.m[4 * r + k] - f * b.m[4 * p + k];
+                }
+            }
+        }
+    }
+
+    *out = b;
+    return EXIT_SUCCESS;
+}
+
+int mat4_inverse(mat4_t* out, const mat4_t* m) {
+#ifdef SIMD_SCALAR
+    return mat4_inverse_scalar(out, m);
+#else
+    const float limit = singular_limit(m);
+    mat4_t a = *m;
+    mat4_t b;
+    int p, r;
+
+    mat4_identity(&b);
+
+    //Same steps as the scalar version with each row handled as one vector
+    for (p = 0; p < 4; p++) {
+        int pivot = find_pivot(&a, p);
+        if (fabsf(a.m[4 * pivot + p]) <= limit) {
+            return EXIT_FAILURE;
+        }
+        if (pivot != p) {
+            swap_rows(&a, p, pivot);
+            swap_rows(&b, p, pivot);
+        }
+
+        const simd4f scale = simd4f_splat(1.0f / a.m[4 * p + p]);
+        const simd4f ap = simd4f_mul(simd4f_load(a.m + 4 * p), scale);
+        const simd4f bp = simd4f_mul(simd4f_load(b.m + 4 * p), scale);
+        simd4f_store(a.m + 4 * p, ap);
+        simd4f_store(b.m + 4 * p, bp);
+
+        for (r = 0; r < 4; r++) {
+            if (r != p) {
+                const simd4f f = simd4f_splat(a.m[4 * r + p]);
+                simd4f_store(a.m + 4 * r, simd4f_sub(simd4f_load(a.m + 4 * r), simd4f_mul(f, ap)));
+                simd4f_store(b.m + 4 * r, simd4f_sub(simd4f_load(b.m + 4 * r), simd4f_mul(f, bp)));
+            }
+        }
+    }
+
+    *out = b;
+    return EXIT_SUCCESS;
+#endif
+}
+
+void mat4_transpose(mat4_t* out, const mat4_t* m) {
+    mat4_t result;
+    int i, j;
+
+    for (j = 0; j < 4; j++) {
+        for (i = 0; i < 4; i++) {
+            result.m[4 * i + j] = m->m[4 * j + i];
+        }
+    }
+
+    *out = result;
+}
+
+int mat4_normal_matrix(float out[9], const mat4_t* modelview) {
+    mat4_t inverse;
+    int r, c;
+
+    if (EXIT_SUCCESS != mat4_inverse(&inverse, modelview)) {
+        return EXIT_FAILURE;
+    }
+
+    for (c = 0; c < 3; c++) {
+        for (r = 0; r < 3; r++) {
+            out[3 * c + r] = inverse.m[4 * r + c];
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+void mat4_frustum(mat4_t* out, float left, float right, float bottom, float top, float near, float far) {
+    memset(out, 0, sizeof(mat4_t));
+    out->m[0] = 2.0f * near / (right - left);
+    out->m[5] = 2.0f * near / (top - bottom);
+    out->m[8] = (right + left) / (right - left);
+    out->m[9] = (top + bottom) / (top - bottom);
+    out->m[10] = -(far + near) / (far - near);
+    out->m[11] = -1.0f;
+    out->m[14] = -2.0f * far * near / (far - near);
+}
+
+void mat4_ortho(mat4_t* out, float left, float right, float bottom, float top, float near, float far) {
+    memset(out, 0, sizeof(mat4_t));
+    out->m[0] = 2.0f / (right - left);
+    out->m[5] = 2.0f / (top - bottom);
+    out->m[10] = -2.0f / (far - near);
+    out->m[12] = -(right + left) / (right - left);
+    out->m[13] = -(top + bottom) / (top - bottom);
+    out->m[14] = -(far + near) / (far - near);
+    out->m[15] = 1.0f;
+}
+
+void mat4_perspective(mat4_t* out, float fovy_degrees, float aspect, float near, float far) {
+    const float top = near * tanf(fovy_degrees * (float)M_PI / 360.0f);
+
+    mat4_frustum(out, -top * aspect, top * aspect, -top, top, near, far);
+}
+
+void mat4_translation(mat4_t* out, float x, float y, float z) {
+    mat4_identity(out);
+    out->m[12] = x;
+    out->m[13] = y;
+    out->m[14] = z;
+}
+
+void mat4_scaling(mat4_t* out, float x, float y, float z) {
+    mat4_identity(out);
+    out->m[0] = x;
+    out->m[5] = y;
+    out->m[10] = z;
+}
+
+void mat4_rotation(mat4_t* out, const quat_t* q) {
+    const float x = q->v[0], y = q->v[1], z = q->v[2], w = q->v[3];
+
+    out->m[0] = 1.0f - 2.0f * (y * y + z * z);
+    out->m[1] = 2.0f * (x * y + z * w);
+    out->m[2] = 2.0f * (x * z - y * w);
+    out->m[3] = 0.0f;
+
+    out->m[4] = 2.0f * (x * y - z * w);
+    out->m[5] = 1.0f - 2.0f * (x * x + z * z);
+    out->m[6] = 2.0f * (y * z + x * w);
+    out->m[7] = 0.0f;
+
+    out->m[8] = 2.0f * (x * z + y * w);
+    out->m[9] = 2.0f * (y * z - x * w);
+    out->m[10] = 1.0f - 2.0f * (x * x + y * y);
+    out->m[11] = 0.0f;
+
+    out->m[12] = 0.0f;
+    out->m[13] = 0.0f;
+    out->m[14] = 0.0f;
+    out->m[15] = 1.0f;
+}
+
+void mat4_translate(mat4_t* m, float x, float y, float z) {
+    mat4_t t;
+
+    mat4_translation(&t, x, y, z);
+    mat4_multiply(m, m, &t);
+}
+
+void mat4_scale(mat4_t* m, float x, float y, float z) {
+    mat4_t s;
+
+    mat4_scaling(&s, x, y, z);
+    mat4_multiply(m, m, &s);
+}
+
+void mat4_rotate(mat4_t* m, const quat_t* q) {
+    mat4_t r;
+
+    mat4_rotation(&r, q);
+    mat4_multiply(m, m, &r);
+}
+
+void quat_identity(quat_t* out) {
+    vec4_set(out, 0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+void quat_from_axis_angle(quat_t* out, float degrees, float x, float y, float z) {
+    const float length = sqrtf(x * x + y * y + z * z);
+    const float half = degrees * (float)M_PI / 360.0f;
+
+    if (length == 0.0f) {
+        quat_identity(out);
+        return;
+    }
+
+    const float s = sinf(half) / length;
+    vec4_set(out, x * s, y * s, z * s, cosf(half));
+}
+
+void quat_multiply(quat_t* out, const quat_t* a, const quat_t* b) {
+    const float ax = a->v[0], ay = a->v[1], az = a->v[2], aw = a->v[3];
+    const float bx = b->v[0], by = b->v[1], bz = b->v[2], bw = b->v[3];
+
+    vec4_set(out,
+            aw * bx + ax * bw + ay * bz - az * by,
+            aw * by - ax * bz + ay * bw + az * bx,
+            aw * bz + ax * by - ay * bx + az * bw,
+            aw * bw - ax * bx - ay * by - az * bz);
+}
+
+void quat_normalize(quat_t* q) {
+    const float length = sqrtf(q->v[0] * q->v[0] + q->v[1] * q->v[1] + q->v[2] * q->v[2] + q->v[3] * q->v[3]);
+
+    if (length == 0.0f) {
+        quat_identity(q);
+        return;
+    }
+
+    vec4_set(q, q->v[0] / length, q->v[1] / length, q->v[2] / length, q->v[3] / length);
+}
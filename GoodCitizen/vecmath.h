@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _VECMATH_H_INCLUDED
+#define _VECMATH_H_INCLUDED
+
+/**
+ * 4x4 matrix, vector and quaternion math for feeding shader uniforms, as a
+ * replacement for the OpenGL ES 1.1 matrix stacks.
+ *
+ * Matrices are column-major like OpenGL, so m[12], m[13], m[14] hold the
+ * translation and a matrix can be passed to glUniformMatrix4fv() as it is.
+ * Functions named like the OpenGL ES 1.1 calls (mat4_translate(),
+ * mat4_rotate(), mat4_scale()) multiply onto the right of a matrix the same
+ * way, so code ported from glTranslatef() and friends keeps its order.
+ *
+ * Multiplication, vector transforms and inversion run on NEON or SSE through
+ * simd.h. The scalar versions perform the same operations in the same order,
+ * so both give identical results as long as no input or intermediate result
+ * is denormal. ARMv7 NEON flushes denormals to zero while VFP, which runs the
+ * scalar versions, does not. Matrices for rendering are far from that range.
+ * CubeRotate/vecmath_test.c checks both versions against each other.
+ */
+
+#define VECMATH_ALIGN __attribute__((aligned(16)))
+
+typedef struct {
+    float v[4];
+} VECMATH_ALIGN vec4_t;
+
+typedef struct {
+    float m[16];
+} VECMATH_ALIGN mat4_t;
+
+//x, y, z, w with w the real part
+typedef vec4_t quat_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void vec4_set(vec4_t* out, float x, float y, float z, float w);
+
+void mat4_identity(mat4_t* out);
+
+/**
+ * out = a * b. out may be a or b.
+ */
+void mat4_multiply(mat4_t* out, const mat4_t* a, const mat4_t* b);
+void mat4_multiply_scalar(mat4_t* out, const mat4_t* a, const mat4_t* b);
+
+/**
+ * out = m * v. out may be v.
+ */
+void mat4_transform(vec4_t* out, const mat4_t* m, const vec4_t* v);
+void mat4_transform_scalar(vec4_t* out, const mat4_t* m, const vec4_t* v);
+
+/**
+ * Inverts a matrix by Gauss-Jordan elimination with partial pivoting. out may be m.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE and out untouched if m is singular
+ */
+int mat4_inverse(mat4_t* out, const mat4_t* m);
+int mat4_inverse_scalar(mat4_t* out, const mat4_t* m);
+
+void mat4_transpose(mat4_t* out, const mat4_t* m);
+
+/**
+ * Inverse transpose of the upper 3x3 part of a model view matrix, column-major
+ * for glUniformMatrix3fv(). Transforms normals into eye space.
+ *
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if the matrix is singular
+ */
+int mat4_normal_matrix(float out[9], const mat4_t* modelview);
+
+/**
+ * Projections, with the same parameters as glFrustumf(), glOrthof() and gluPerspective().
+ */
+void mat4_frustum(mat4_t* out, float left, float right, float bottom, float top, float near, float far);
+void mat4_ortho(mat4_t* out, float left, float right, float bottom, float top, float near, float far);
+void mat4_perspective(mat4_t* out, float fovy_degrees, float aspect, float near, float far);
+
+void mat4_translation(mat4_t* out, float x, float y, float z);
+void mat4_scaling(mat4_t* out, float x, float y, float z);
+void mat4_rotation(mat4_t* out, const quat_t* q);
+
+/**
+ * m = m * transform, like glTranslatef(), glScalef() and glRotatef()
+ */
+void mat4_translate(mat4_t* m, float x, float y, float z);
+void mat4_scale(mat4_t* m, float x, float y, float z);
+void mat4_rotate(mat4_t* m, const quat_t* q);
+
+void quat_identity(quat_t* out);
+
+/**
+ * Rotation by an angle in degrees around an axis, which need not be normalized, like glRotatef().
+ */
+void quat_from_axis_angle(quat_t* out, float degrees, float x, float y, float z);
+
+/**
+ * out = a * b, the rotation b followed by a. out may be a or b.
+ */
+void quat_multiply(quat_t* out, const quat_t* a, const quat_t* b);
+
+/**
+ * Scales a quaternion back to unit length, e.g. after many multiplications.
+ */
+void quat_normalize(quat_t* q);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _VECMATH_H_INCLUDED */
@@ -94,6 +94,10 @@ void bbutil_measure_text(font_t* font, const  char* msg, float* width, float* he
 /**
  * Creates and loads a texture from a png file
  * NOTE: must be called after a successful return from bbutil_init() or bbutil_init_egl() call
+ *
+ * The decoded pixels are cached in the app's data directory together with the size and
+ * modification time of the png. Later calls for an unchanged png map the cache file and
+ * upload it directly instead of decoding the png again.
 
  *
  * @param filename path to texture png
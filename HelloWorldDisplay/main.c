@@ -164,9 +164,23 @@ void render() {
     bbutil_swap();
 }
 
+//Prints the time from launch to the first frame on screen. The first launch decodes the
+//textures, later launches load them from the texture cache in the data directory.
+static void report_time_to_first_frame(const struct timespec* launch_time) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    fprintf(stderr, "Time to first frame: %.1f ms\n",
+            (now.tv_sec - launch_time->tv_sec) * 1000.0 + (now.tv_nsec - launch_time->tv_nsec) / 1000000.0);
+}
+
 int main(int argc, char **argv) {
 
     int rc = 0;
+    struct timespec launch_time;
+    int first_frame = 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &launch_time);
 
     //Create a screen context that will be used to create an EGL surface to to receive libscreen events
     rc = screen_create_context(&screen_ctx, SCREEN_APPLICATION_CONTEXT);
@@ -232,6 +246,11 @@ int main(int argc, char **argv) {
         }
 
         render();
+
+        if (first_frame) {
+            first_frame = 0;
+            report_time_to_first_frame(&launch_time);
+        }
     }
 
     //Stop requesting events from libscreen
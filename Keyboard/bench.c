@@ -0,0 +1,243 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+
+#include "animation.h"
+#include "bench.h"
+#include "input.h"
+
+//The spin constants of main.c
+#define SPIN_INCREMENT 180.0f
+#define SPIN_ACCELERATION 720.0f
+#define CIRCLE_DEGREES 360.0f
+
+//Key codes of letters are their lower case characters, KEYCODE_A is 'a'
+#define KEY_FASTER 'a'
+#define KEY_SLOWER 'z'
+
+#define FRAME_SECONDS (1.0 / 60.0)
+#define STREAM_SECONDS 60.0
+#define STREAM_RATE 1000.0
+#define PASSES 10
+
+//Hold A, type, hold Z, type, then start over
+#define CYCLE_SECONDS 4.0
+
+enum {
+    ACTION_SPIN_FASTER,
+    ACTION_SPIN_SLOWER,
+    ACTION_COUNT
+};
+
+static const input_binding_t bindings[] = {
+    { KEY_FASTER, ACTION_SPIN_FASTER },
+    { KEY_SLOWER, ACTION_SPIN_SLOWER }
+};
+
+//Unbound keys typed between the holds
+static const char typed[] = "bcdefgjklmnqrstuvwxy";
+
+typedef struct {
+    double time;
+    int key;
+    int down;
+} bench_event_t;
+
+typedef struct {
+    animator_t animator;
+    float angle;
+    float spin_rate;
+} bench_spin_t;
+
+//0 and 2 are the holds of A and Z, 1 and 3 typing
+static int bench_segment(double time) {
+    const double phase = fmod(time, CYCLE_SECONDS);
+
+    if (phase < 1.5) {
+        return 0;
+    } else if (phase < 2.5) {
+        return 1;
+    } else if (phase < 3.5) {
+        return 2;
+    }
+    return 3;
+}
+
+//One event every 1 / rate seconds, held keys auto repeat at that rate
+static bench_event_t* bench_stream(double rate, int* count) {
+    bench_event_t* events;
+    int i;
+
+    *count = (int)(STREAM_SECONDS * rate);
+    events = (bench_event_t*)malloc(*count * sizeof(bench_event_t));
+    if (!events) {
+        return NULL;
+    }
+
+    for (i = 0; i < *count; i++) {
+        const double time = i / rate;
+        const int segment = bench_segment(time);
+        bench_event_t* event = &events[i];
+
+        event->time = time;
+        if (segment == 1 || segment == 3) {
+            event->key = typed[(i / 2) % (sizeof(typed) - 1)];
+            event->down = i % 2 == 0;
+        } else {
+            //Down on entering the hold, up on the last event before it ends and repeats in between
+            event->key = segment == 0 ? KEY_FASTER : KEY_SLOWER;
+            event->down = bench_segment((i + 1) / rate) == segment;
+        }
+    }
+
+    return events;
+}
+
+static void bench_spin_init(bench_spin_t* spin) {
+    animator_init(&spin->animator);
+    spin->angle = 0.0f;
+    spin->spin_rate = 0.0f;
+}
+
+static void bench_change_spin(bench_spin_t* spin, float change) {
+    spin->spin_rate += change;
+    animator_spin(&spin->animator, &spin->angle, spin->spin_rate, CIRCLE_DEGREES);
+}
+
+//What main.c does every frame
+static void bench_frame(input_t* input, bench_spin_t* spin, double now) {
+    input_frame(input, now);
+
+    const float change = SPIN_INCREMENT * (input_presses(input, ACTION_SPIN_FASTER) - input_presses(input, ACTION_SPIN_SLOWER))
+            + SPIN_ACCELERATION * (float)(input_held_time(input, ACTION_SPIN_FASTER) - input_held_time(input, ACTION_SPIN_SLOWER));
+    if (change != 0.0f) {
+        bench_change_spin(spin, change);
+    }
+}
+
+//Returns seconds spent, the spin rate reached is left in spin
+static double bench_run_input(const bench_event_t* events, int count, bench_spin_t* spin) {
+    input_t input;
+    double frame = FRAME_SECONDS;
+    int i;
+
+    bench_spin_init(spin);
+    input_init(&input, bindings, sizeof(bindings) / sizeof(bindings[0]), ACTION_COUNT, 0.0);
+
+    const double start = animation_time();
+    for (i = 0; i < count; i++) {
+        while (events[i].time >= frame) {
+            bench_frame(&input, spin, frame);
+            frame += FRAME_SECONDS;
+        }
+        input_key(&input, events[i].key, events[i].down, events[i].time);
+    }
+    bench_frame(&input, spin, frame);
+
+    return animation_time() - start;
+}
+
+//The handler the sample had before the input layer: every key down event is logged and acted on
+static double bench_run_events(const bench_event_t* events, int count, bench_spin_t* spin, FILE* log) {
+    int i;
+
+    bench_spin_init(spin);
+
+    const double start = animation_time();
+    for (i = 0; i < count; i++) {
+        if (!events[i].down) {
+            continue;
+        }
+        fprintf(log, "The '%c' key was pressed\n", (char)events[i].key);
+
+        switch (events[i].key) {
+        case KEY_FASTER:
+            bench_change_spin(spin, SPIN_INCREMENT);
+            break;
+        case KEY_SLOWER:
+            bench_change_spin(spin, -SPIN_INCREMENT);
+            break;
+        default:
+            break;
+        }
+    }
+    fflush(log);
+
+    return animation_time() - start;
+}
+
+void bench_input(FILE* out) {
+    const double rates[2] = { 30.0, STREAM_RATE };
+    bench_event_t* events;
+    bench_spin_t spin;
+    int count;
+    int i;
+
+    //The old handler wrote to stderr, which goes to the log. /dev/null only counts formatting and the call
+    FILE* log = fopen("/dev/null", "w");
+    if (!log) {
+        fprintf(out, "Unable to open /dev/null\n");
+        return;
+    }
+
+    events = bench_stream(STREAM_RATE, &count);
+    if (!events) {
+        fclose(log);
+        return;
+    }
+
+    double input_seconds = 0.0;
+    double events_seconds = 0.0;
+    for (i = 0; i < PASSES; i++) {
+        input_seconds += bench_run_input(events, count, &spin);
+        events_seconds += bench_run_events(events, count, &spin, log);
+    }
+    free(events);
+
+    fprintf(out, "%.0f Hz key stream, %d events: input layer %.1f ns per event, "
+            "logging and acting on each event %.1f ns per event\n",
+            STREAM_RATE, count, input_seconds * 1e9 / (PASSES * count), events_seconds * 1e9 / (PASSES * count));
+
+    for (i = 0; i < 2; i++) {
+        events = bench_stream(rates[i], &count);
+        if (!events) {
+            break;
+        }
+
+        bench_run_input(events, count, &spin);
+        const float input_rate = spin.spin_rate;
+        bench_run_events(events, count, &spin, log);
+        const float events_rate = spin.spin_rate;
+        free(events);
+
+        fprintf(out, "spin after %.0f s with %.0f Hz auto repeat: input layer %.0f degrees per second, "
+                "acting on each event %.0f degrees per second\n",
+                STREAM_SECONDS, rates[i], input_rate, events_rate);
+    }
+
+    fclose(log);
+}
+
+#ifdef KEYBOARD_BENCH_MAIN
+
+int main(void) {
+    bench_input(stdout);
+    return EXIT_SUCCESS;
+}
+
+#endif
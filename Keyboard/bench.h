@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _BENCH_H_INCLUDED
+#define _BENCH_H_INCLUDED
+
+#include <stdio.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Feeds a scripted key stream, A held, typing, Z held, typing, through the
+ * input layer as a 60 fps app would and through a handler that acts on and
+ * logs every key down event the way the sample used to. Prints the time per
+ * event for a 1 kHz stream, and the spin rate each reaches at 30 Hz and at
+ * 1 kHz auto repeat, which only stays the same for the input layer.
+ *
+ * @param out stream the results are written to
+ */
+void bench_input(FILE* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _BENCH_H_INCLUDED */
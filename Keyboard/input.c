@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "input.h"
+
+int input_init(input_t* input, const input_binding_t* bindings, int binding_count, int action_count, double now) {
+    int i;
+
+    if (action_count < 0 || action_count > INPUT_ACTION_MAX) {
+        return EXIT_FAILURE;
+    }
+
+    memset(input, 0, sizeof(*input));
+    input->action_count = action_count;
+    input->frame = now;
+
+    for (i = 0; i < binding_count; i++) {
+        if (bindings[i].key < 0 || bindings[i].key >= INPUT_KEY_MAX
+                || bindings[i].action < 0 || bindings[i].action >= action_count) {
+            return EXIT_FAILURE;
+        }
+        input->map[bindings[i].key] = (unsigned char)(bindings[i].action + 1);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+//Time an action was held between the last frame and now, up to its current press
+static double input_since_frame(const input_t* input, const input_action_t* action, double now) {
+    const double start = action->since > input->frame ? action->since : input->frame;
+    return now > start ? now - start : 0.0;
+}
+
+void input_key(input_t* input, int key, int down, double now) {
+    input->events++;
+
+    if (key < 0 || key >= INPUT_KEY_MAX || !input->map[key]) {
+        return;
+    }
+
+    input_action_t* action = &input->actions[input->map[key] - 1];
+
+    if (down) {
+        if (input->down[key]) {
+            //Auto repeat, the action is already held
+            input->repeats++;
+            return;
+        }
+        input->down[key] = 1;
+        if (action->keys++ == 0) {
+            action->since = now;
+            action->pending_presses++;
+        }
+    } else if (input->down[key]) {
+        input->down[key] = 0;
+        if (--action->keys == 0) {
+            action->pending_time += input_since_frame(input, action, now);
+        }
+    }
+}
+
+void input_reset(input_t* input, double now) {
+    int i;
+
+    for (i = 0; i < input->action_count; i++) {
+        input_action_t* action = &input->actions[i];
+        if (action->keys) {
+            action->pending_time += input_since_frame(input, action, now);
+            action->keys = 0;
+        }
+    }
+    memset(input->down, 0, sizeof(input->down));
+}
+
+void input_frame(input_t* input, double now) {
+    int i;
+
+    for (i = 0; i < input->action_count; i++) {
+        input_action_t* action = &input->actions[i];
+
+        action->presses = action->pending_presses;
+        action->held_time = action->pending_time;
+        if (action->keys) {
+            action->held_time += input_since_frame(input, action, now);
+        }
+        action->pending_presses = 0;
+        action->pending_time = 0.0;
+    }
+    input->frame = now;
+}
+
+int input_presses(const input_t* input, int action) {
+    return input->actions[action].presses;
+}
+
+double input_held_time(const input_t* input, int action) {
+    return input->actions[action].held_time;
+}
@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef _INPUT_H_INCLUDED
+#define _INPUT_H_INCLUDED
+
+/**
+ * Maps keys to app defined actions and folds key events into per frame state.
+ *
+ * A binding table maps key codes to actions, which are numbered from 0. The
+ * event callback hands every key event to input_key(), which only updates a
+ * few counters, so its cost stays the same however fast events arrive. Auto
+ * repeats of a key that is already down change nothing but the repeat count.
+ *
+ * Once per frame input_frame() closes the events received since the previous
+ * frame. The app then reads how often each action was pressed and for how
+ * many seconds it was held during that time, so anything driven by holding a
+ * key depends on how long it is held rather than on the repeat rate.
+ */
+
+//Key codes from 0 up to this can be bound, others are ignored
+#define INPUT_KEY_MAX 256
+#define INPUT_ACTION_MAX 16
+
+typedef struct {
+    int key;
+    int action;
+} input_binding_t;
+
+typedef struct {
+    //Number of bound keys down and the time the first went down
+    int keys;
+    double since;
+    //Collected since the last frame
+    int pending_presses;
+    double pending_time;
+    //Results of the last frame
+    int presses;
+    double held_time;
+} input_action_t;
+
+typedef struct {
+    //Action plus one for every key, 0 when unbound
+    unsigned char map[INPUT_KEY_MAX];
+    unsigned char down[INPUT_KEY_MAX];
+    input_action_t actions[INPUT_ACTION_MAX];
+    int action_count;
+    //Time of the last frame
+    double frame;
+    //Totals since input_init(), for reporting
+    unsigned long events;
+    unsigned long repeats;
+} input_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Sets up the key map from a binding table with no keys down. Several keys
+ * may be bound to the same action.
+ *
+ * @param now the current time in seconds, as returned by animation_time()
+ * @return EXIT_SUCCESS, or EXIT_FAILURE if a key or action is out of range
+ */
+int input_init(input_t* input, const input_binding_t* bindings, int binding_count, int action_count, double now);
+
+/**
+ * Records a key going down, repeating or going up at the given time.
+ */
+void input_key(input_t* input, int key, int down, double now);
+
+/**
+ * Releases every key at the given time, for when key up events may be lost,
+ * e.g. when the keyboard is hidden while a key is down.
+ */
+void input_reset(input_t* input, double now);
+
+/**
+ * Closes the frame ending at now: works out the presses and held time of
+ * every action since the previous frame.
+ */
+void input_frame(input_t* input, double now);
+
+/**
+ * Number of times an action went from released to pressed in the last frame.
+ */
+int input_presses(const input_t* input, int action);
+
+/**
+ * Seconds an action was held during the last frame.
+ */
+double input_held_time(const input_t* input, int action);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _INPUT_H_INCLUDED */
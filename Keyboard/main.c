@@ -14,6 +14,11 @@
 * limitations under the License.
 */
 
+#include "animation.h"
+#include "bench.h"
+#include "input.h"
+#include "vecmath.h"
+
 #include <bps/virtualkeyboard.h>
 #include <bps/navigator.h>
 #include <bps/screen.h>
@@ -22,18 +27,49 @@
 
 
 #include <glview/glview.h>
+#ifdef USING_GL11
 #include <GLES/gl.h>
+#elif defined(USING_GL20)
+#include <GLES2/gl2.h>
+#else
+#error Keyboard must be compiled with either USING_GL11 or USING_GL20 flags
+#endif
 
 #include <screen/screen.h>
 #include <sys/keycodes.h>
 #include <math.h>
+#include <stdbool.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <unistd.h>
 
-#define ANGLE_INCREMENT 3.0f
+// Each key press changes the spin by 3 degrees per frame at 60 frames per second,
+// holding the key keeps changing it by SPIN_ACCELERATION every second
+#define SPIN_INCREMENT 180.0f
+#define SPIN_ACCELERATION 720.0f
 #define CIRCLE_DEGREES 360.0f
 
+enum {
+    ACTION_LAYOUT_EMAIL,
+    ACTION_LAYOUT_PHONE,
+    ACTION_LAYOUT_DEFAULT,
+    ACTION_HIDE_KEYBOARD,
+    ACTION_SPIN_FASTER,
+    ACTION_SPIN_SLOWER,
+    ACTION_COUNT
+};
+
+static const input_binding_t bindings[] = {
+    { KEYCODE_I, ACTION_LAYOUT_EMAIL },
+    { KEYCODE_O, ACTION_LAYOUT_PHONE },
+    { KEYCODE_P, ACTION_LAYOUT_DEFAULT },
+    { KEYCODE_H, ACTION_HIDE_KEYBOARD },
+    { KEYCODE_A, ACTION_SPIN_FASTER },
+    { KEYCODE_Z, ACTION_SPIN_SLOWER }
+};
+
+static input_t input;
+
 static const GLfloat vertices[] = {
     -0.25f, -0.25f,
      0.25f, -0.25f,
@@ -48,9 +84,135 @@ static const GLfloat colors[] = {
     0.0f, 1.0f, 1.0f, 1.0f
 };
 
-static float angle = 0.0;
+// Spin speed in degrees per second and the current angle, which the animator advances
+static float spin_rate = 0.0f;
+static float angle = 0.0f;
+static animator_t animator;
 static bool keyboard_visible = false;
 
+// Built with make GLES=1 the square is drawn with the OpenGL ES 1.1 fixed function pipeline instead of shaders
+#ifdef USING_GL11
+#define GLES_VERSION "1.1"
+#else
+#define GLES_VERSION "2.0"
+
+// OpenGL ES 2.0 path: the square sits in a static buffer and the transform is a uniform
+static GLuint program = 0;
+static GLuint vertex_buffer = 0;
+static GLint position_loc;
+static GLint color_loc;
+static GLint mvp_loc;
+static mat4_t view;
+
+static const char *vertex_source =
+        "uniform mat4 u_mvp;"
+        "attribute vec2 a_position;"
+        "attribute vec4 a_color;"
+        "varying lowp vec4 v_color;"
+        "void main()"
+        "{"
+        "    gl_Position = u_mvp * vec4(a_position, 0.0, 1.0);"
+        "    v_color = a_color;"
+        "}";
+
+static const char *fragment_source =
+        "varying lowp vec4 v_color;"
+        "void main()"
+        "{"
+        "    gl_FragColor = v_color;"
+        "}";
+#endif
+
+// Set KEYBOARD_REPORT to log the CPU time spent submitting each frame
+#define REPORT_SECONDS 5.0
+
+static bool reporting = false;
+static double report_time = 0.0;
+static double submit_time = 0.0;
+static int report_frames = 0;
+static double event_time = 0.0;
+static unsigned long report_events = 0;
+static unsigned long report_repeats = 0;
+
+#ifdef USING_GL20
+static GLuint
+compile_shader(GLenum type, const char *source)
+{
+    GLint status;
+    GLuint shader = glCreateShader(type);
+
+    if (!shader) {
+        fprintf(stderr, "Failed to create shader: %d\n", glGetError());
+        return 0;
+    }
+
+    glShaderSource(shader, 1, &source, 0);
+    glCompileShader(shader);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (GL_FALSE == status) {
+        GLchar log[256];
+        glGetShaderInfoLog(shader, 256, NULL, log);
+        fprintf(stderr, "Failed to compile shader: %s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+static int
+create_program(void)
+{
+    GLint status;
+    GLuint vs = compile_shader(GL_VERTEX_SHADER, vertex_source);
+    GLuint fs = compile_shader(GL_FRAGMENT_SHADER, fragment_source);
+
+    if (vs && fs) {
+        program = glCreateProgram();
+    }
+    if (program) {
+        glAttachShader(program, vs);
+        glAttachShader(program, fs);
+        glLinkProgram(program);
+
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if (GL_FALSE == status) {
+            GLchar log[256];
+            glGetProgramInfoLog(program, 256, NULL, log);
+            fprintf(stderr, "Failed to link shader program: %s\n", log);
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+
+    // The program keeps what it needs of the shaders
+    if (vs) {
+        glDeleteShader(vs);
+    }
+    if (fs) {
+        glDeleteShader(fs);
+    }
+
+    if (!program) {
+        return EXIT_FAILURE;
+    }
+
+    position_loc = glGetAttribLocation(program, "a_position");
+    color_loc = glGetAttribLocation(program, "a_color");
+    mvp_loc = glGetUniformLocation(program, "u_mvp");
+
+    // Positions followed by colors, uploaded once
+    glGenBuffers(1, &vertex_buffer);
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices) + sizeof(colors), NULL, GL_STATIC_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices);
+    glBufferSubData(GL_ARRAY_BUFFER, sizeof(vertices), sizeof(colors), colors);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    return EXIT_SUCCESS;
+}
+#endif
+
 static void
 initialize(void *p)
 {
@@ -60,11 +222,13 @@ initialize(void *p)
     unsigned int surface_width, surface_height;
     glview_get_size(&surface_width, &surface_height);
 
-    glShadeModel(GL_SMOOTH);
-
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
 
     glViewport(0, 0, surface_width, surface_height);
+
+#ifdef USING_GL11
+    glShadeModel(GL_SMOOTH);
+
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
 
@@ -76,26 +240,209 @@ initialize(void *p)
 
     glTranslatef((float) (surface_width) / (float) (surface_height) / 2, 0.5f,
             0.0f);
+#else
+    if (EXIT_SUCCESS != create_program()) {
+        exit(EXIT_FAILURE);
+    }
+
+    // The same projection and translation as the fixed function path
+    mat4_ortho(&view, 0.0f, (float) (surface_width) / (float) (surface_height), 0.0f,
+            1.0f, -1.0f, 1.0f);
+    mat4_translate(&view, (float) (surface_width) / (float) (surface_height) / 2, 0.5f,
+            0.0f);
+#endif
+
+    animator_init(&animator);
+
+    if (EXIT_SUCCESS != input_init(&input, bindings, sizeof(bindings) / sizeof(bindings[0]), ACTION_COUNT, animator.now)) {
+        fprintf(stderr, "Invalid key bindings\n");
+        exit(EXIT_FAILURE);
+    }
+
+    if (getenv("KEYBOARD_BENCH")) {
+        bench_input(stderr);
+    }
+
+    reporting = getenv("KEYBOARD_REPORT") != NULL;
+    report_time = animation_time();
 }
 
 static void
-render(void *p)
+finalize(void *p)
 {
-    glClear(GL_COLOR_BUFFER_BIT);
+#ifdef USING_GL20
+    if (vertex_buffer) {
+        glDeleteBuffers(1, &vertex_buffer);
+        vertex_buffer = 0;
+    }
+    if (program) {
+        glDeleteProgram(program);
+        program = 0;
+    }
+#endif
+}
+
+static void
+report(void)
+{
+    const double now = animation_time();
+
+    report_frames++;
+    if (now - report_time < REPORT_SECONDS) {
+        return;
+    }
+
+    const unsigned long events = input.events - report_events;
+    fprintf(stderr, "%.3f ms to submit a frame with OpenGL ES %s, %lu key events (%lu repeats coalesced), "
+            "%.2f us to handle each\n",
+            submit_time * 1000.0 / report_frames, GLES_VERSION,
+            events, input.repeats - report_repeats, events ? event_time * 1e6 / events : 0.0);
+
+    report_time = now;
+    report_frames = 0;
+    submit_time = 0.0;
+    event_time = 0.0;
+    report_events = input.events;
+    report_repeats = input.repeats;
+}
+
+static void
+change_spin(float change)
+{
+    spin_rate += change;
+
+    // The new speed takes over from the current angle, so the square does not jump
+    animator_spin(&animator, &angle, spin_rate, CIRCLE_DEGREES);
+}
+
+static void
+layout_email(void)
+{
+    // Display the email layout with "Send" enter key
+    virtualkeyboard_change_options(VIRTUALKEYBOARD_LAYOUT_EMAIL, VIRTUALKEYBOARD_ENTER_SEND);
+}
+
+static void
+layout_phone(void)
+{
+    // Display the phone layout with "Connect" enter key
+    virtualkeyboard_change_options(VIRTUALKEYBOARD_LAYOUT_PHONE, VIRTUALKEYBOARD_ENTER_CONNECT);
+}
+
+static void
+layout_default(void)
+{
+    // Display the default layout with default enter key
+    virtualkeyboard_change_options(VIRTUALKEYBOARD_LAYOUT_DEFAULT, VIRTUALKEYBOARD_ENTER_DEFAULT);
+}
+
+static void
+hide_keyboard(void)
+{
+    virtualkeyboard_hide();
+}
+
+// What a press of each action does, the spin actions act on how long they are held instead
+static void (* const press_handlers[ACTION_COUNT])(void) = {
+    layout_email,
+    layout_phone,
+    layout_default,
+    hide_keyboard,
+    NULL,
+    NULL
+};
 
+static void
+apply_input(double now)
+{
+    int i;
+
+    input_frame(&input, now);
+
+    for (i = 0; i < ACTION_COUNT; i++) {
+        if (press_handlers[i] && input_presses(&input, i)) {
+            press_handlers[i]();
+        }
+    }
+
+    // A press gives a step, holding accelerates by the time held, whatever the repeat rate
+    const float change = SPIN_INCREMENT * (input_presses(&input, ACTION_SPIN_FASTER) - input_presses(&input, ACTION_SPIN_SLOWER))
+            + SPIN_ACCELERATION * (float)(input_held_time(&input, ACTION_SPIN_FASTER) - input_held_time(&input, ACTION_SPIN_SLOWER));
+    if (change != 0.0f) {
+        change_spin(change);
+    }
+}
+
+#ifdef USING_GL11
+static void
+render_fixed(void)
+{
     glEnableClientState(GL_VERTEX_ARRAY);
     glVertexPointer(2, GL_FLOAT, 0, vertices);
 
     glEnableClientState(GL_COLOR_ARRAY);
     glColorPointer(4, GL_FLOAT, 0, colors);
 
+    glPushMatrix();
     glRotatef(angle, 0.0f, 1.0f, 0.0f);
 
     glDrawArrays(GL_TRIANGLE_STRIP, 0 , 4);
+    glPopMatrix();
 
     glDisableClientState(GL_VERTEX_ARRAY);
     glDisableClientState(GL_COLOR_ARRAY);
 }
+#else
+static void
+render_shader(void)
+{
+    quat_t rotation;
+    mat4_t mvp = view;
+
+    quat_from_axis_angle(&rotation, angle, 0.0f, 1.0f, 0.0f);
+    mat4_rotate(&mvp, &rotation);
+
+    glUseProgram(program);
+    glUniformMatrix4fv(mvp_loc, 1, GL_FALSE, mvp.m);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+    glEnableVertexAttribArray(position_loc);
+    glVertexAttribPointer(position_loc, 2, GL_FLOAT, GL_FALSE, 0, 0);
+    glEnableVertexAttribArray(color_loc);
+    glVertexAttribPointer(color_loc, 4, GL_FLOAT, GL_FALSE, 0, (const GLvoid *) sizeof(vertices));
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0 , 4);
+
+    glDisableVertexAttribArray(position_loc);
+    glDisableVertexAttribArray(color_loc);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+#endif
+
+static void
+render(void *p)
+{
+    const double start = animation_time();
+
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    // Rotate by the angle reached at this time, however long the last frame took
+    animator_update(&animator);
+
+    // Act on the keys pressed and held since the last frame
+    apply_input(animator.now);
+
+#ifdef USING_GL11
+    render_fixed();
+#else
+    render_shader();
+#endif
+
+    if (reporting) {
+        submit_time += animation_time() - start;
+        report();
+    }
+}
 
 static void
 event(bps_event_t *event, int domain, int code, void *p)
@@ -107,6 +454,8 @@ event(bps_event_t *event, int domain, int code, void *p)
             break;
         case VIRTUALKEYBOARD_EVENT_HIDDEN:
             keyboard_visible = false;
+            // Key releases may not arrive any more
+            input_reset(&input, animation_time());
             break;
         }
     } else if (screen_get_domain() == domain) {
@@ -122,53 +471,44 @@ event(bps_event_t *event, int domain, int code, void *p)
                 virtualkeyboard_show();
             }
             break;
-        case SCREEN_EVENT_KEYBOARD:
-            screen_get_event_property_iv(screen_event, SCREEN_PROPERTY_KEY_FLAGS, &screen_val);
-
-            if (screen_val & KEY_DOWN) {
-                screen_get_event_property_iv(screen_event, SCREEN_PROPERTY_KEY_SYM,&screen_val);
-
-                fprintf(stderr, "The '%c' key was pressed\n", (char)screen_val);
-
-                switch (screen_val) {
-                case KEYCODE_I:
-                    // Display the email layout with "Send" enter key
-                    virtualkeyboard_change_options(VIRTUALKEYBOARD_LAYOUT_EMAIL, VIRTUALKEYBOARD_ENTER_SEND);
-                    break;
-                case KEYCODE_O:
-                    // Display the phone layout with "Connect" enter key
-                    virtualkeyboard_change_options(VIRTUALKEYBOARD_LAYOUT_PHONE, VIRTUALKEYBOARD_ENTER_CONNECT);
-                    break;
-                case KEYCODE_P:
-                    // Display the default layout with default enter key
-                    virtualkeyboard_change_options(VIRTUALKEYBOARD_LAYOUT_DEFAULT, VIRTUALKEYBOARD_ENTER_DEFAULT);
-                    break;
-                case KEYCODE_H:
-                    // Hide the keyboard
-                    virtualkeyboard_hide();
-                    break;
-                case KEYCODE_A:
-                    // Increment rotation angle
-                    angle = fmod(angle + ANGLE_INCREMENT, CIRCLE_DEGREES );
-                    break;
-                case KEYCODE_Z:
-                    // Decrement rotation angle
-                    angle = fmod(angle - ANGLE_INCREMENT, CIRCLE_DEGREES );
-                    break;
-                default:
-                    break;
-                }
+        case SCREEN_EVENT_KEYBOARD: {
+            // Key events only update the input state, the actions run once per frame
+            const double start = animation_time();
+            int flags;
+            int key;
+
+            screen_get_event_property_iv(screen_event, SCREEN_PROPERTY_KEY_FLAGS, &flags);
+
+            // The cap names the physical key, the same on release and whatever the modifiers
+            if (flags & KEY_CAP_VALID) {
+                screen_get_event_property_iv(screen_event, SCREEN_PROPERTY_KEY_CAP, &key);
+            } else if (flags & KEY_SYM_VALID) {
+                screen_get_event_property_iv(screen_event, SCREEN_PROPERTY_KEY_SYM, &key);
+            } else {
+                break;
+            }
+
+            input_key(&input, key, flags & KEY_DOWN, start);
+
+            if (reporting) {
+                event_time += animation_time() - start;
             }
             break;
         }
+        }
     }
 }
 
 int
 main(int argc, char *argv[])
 {
+#ifdef USING_GL11
     glview_initialize(GLVIEW_API_OPENGLES_11, &render);
+#else
+    glview_initialize(GLVIEW_API_OPENGLES_20, &render);
+#endif
     glview_register_initialize_callback(&initialize);
+    glview_register_finalize_callback(&finalize);
     glview_register_event_callback(&event);
     return glview_loop();
 }
@@ -21,6 +21,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/select.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -38,6 +40,7 @@
 #include <bps/navigator.h>
 
 #include "dialogutil.h"
+#include "prefetch.h"
 /*
  * buffer to store messages that we will display in the dialog
  */
@@ -95,6 +98,31 @@ int sample_rate;
 int sample_channels;
 int sample_bits;
 
+/*
+ * Set PLAYWAV_MMAP to 1 to play straight from a memory mapping of the data
+ * chunk rather than reading each fragment into a buffer first.
+ * Set PLAYWAV_PCM_MMAP to 1 to leave the plugin's mmap transfer enabled, so
+ * each fragment is copied into the buffer shared with the driver rather than
+ * written to it.
+ */
+int map_file = 0;
+int pcm_mmap = 0;
+
+/*
+ * Milliseconds of audio the reader thread keeps ahead of playback, set by
+ * PLAYWAV_PREFETCH_MS. 0 reads in the playback loop instead.
+ */
+#define PREFETCH_MS 500
+int prefetch_ms = PREFETCH_MS;
+
+/*
+ * What playback cost, reported when the file has been played.
+ */
+long file_reads = 0;
+long pcm_writes = 0;
+long selects = 0;
+long underruns = 0;
+
 int
 err(char *message)
 {
@@ -175,7 +203,7 @@ setup_snd(const char * name)
     /* disabling mmap is not actually required in this example but it is included to
      * demonstrate how it is used when it is required.
      */
-    if ((rtn = snd_pcm_plugin_set_disable(pcm_handle, PLUGIN_DISABLE_MMAP)) < 0) {
+    if (!pcm_mmap && (rtn = snd_pcm_plugin_set_disable(pcm_handle, PLUGIN_DISABLE_MMAP)) < 0) {
         snprintf(msg, MSG_SIZE, "snd_pcm_plugin_set_disable failed: %s\n", snd_strerror(rtn));
         goto setup_failure;
     }
@@ -260,6 +288,9 @@ setup_snd(const char * name)
     strlcat(msg, tmp, MSG_SIZE);
     snprintf(tmp, MSG_SIZE, "Mixer Pcm Group [%s]\n", group.gid.name);
     strlcat(msg, tmp, MSG_SIZE);
+    snprintf(tmp, MSG_SIZE, "Playing from %s, %s PCM transfer\n", map_file ? "mapped file" : "fread buffer",
+        pcm_mmap ? "mmap" : "write");
+    strlcat(msg, tmp, MSG_SIZE);
     show_dialog_message(msg);
 
     return SUCCESS;
@@ -270,12 +301,96 @@ setup_failure:
     return FAILURE;
 }
 
+/*
+ * Maps the data chunk, which starts at the current position of the file,
+ * into memory. The mapping has to start on a page boundary, so it may begin
+ * a little before the chunk. The file is read ahead as playback moves through
+ * it, so pages are normally in memory before they are written.
+ */
+char *
+map_data(FILE * fp, int *size, void **map_base, size_t *map_size)
+{
+    struct stat st;
+    long page = sysconf(_SC_PAGESIZE);
+    off_t data_offset = ftell(fp);
+    off_t map_offset = data_offset & ~((off_t)page - 1);
+
+    if (data_offset < 0 || fstat(fileno(fp), &st) == -1) {
+        return NULL;
+    }
+
+    /* Do not map past the end of a truncated file */
+    if (st.st_size - data_offset < *size) {
+        *size = st.st_size - data_offset;
+    }
+    if (*size <= 0) {
+        return NULL;
+    }
+
+    *map_size = *size + (data_offset - map_offset);
+    *map_base = mmap(NULL, *map_size, PROT_READ, MAP_SHARED, fileno(fp), map_offset);
+    if (*map_base == MAP_FAILED) {
+        *map_base = NULL;
+        return NULL;
+    }
+
+    posix_madvise(*map_base, *map_size, POSIX_MADV_SEQUENTIAL);
+
+    return (char *) *map_base + (data_offset - map_offset);
+}
+
+/*
+ * Shows the CPU time and the calls into the file system and the audio driver
+ * per second of audio played.
+ */
+void
+show_cost(const struct rusage *start, int bytes)
+{
+    struct rusage end;
+    double seconds = (double) bytes / ENDIAN_LE32(wav_header.avg_bytes_per_sec);
+    double cpu;
+
+    if (seconds <= 0.0 || getrusage(RUSAGE_SELF, &end) == -1) {
+        return;
+    }
+
+    cpu = (end.ru_utime.tv_sec - start->ru_utime.tv_sec) + (end.ru_utime.tv_usec - start->ru_utime.tv_usec) / 1e6
+        + (end.ru_stime.tv_sec - start->ru_stime.tv_sec) + (end.ru_stime.tv_usec - start->ru_stime.tv_usec) / 1e6;
+
+    snprintf(msg, MSG_SIZE, "Played %.1f s: %.2f ms CPU, %.1f file reads, %.1f PCM writes, %.1f selects "
+        "per second of audio, %ld underruns\n", seconds, cpu * 1000.0 / seconds, file_reads / seconds,
+        pcm_writes / seconds, selects / seconds, underruns);
+    show_dialog_message(msg);
+}
+
+/*
+ * Shows how full the ring was kept and how long the reader thread took to
+ * read a block.
+ */
+void
+show_prefetch(const prefetch_t *prefetch)
+{
+    snprintf(msg, MSG_SIZE, "Ring of %u blocks (%.0f ms): high water %u, low water %u, empty %d times, "
+        "read latency %.2f ms average, %.2f ms max\n", prefetch->count, prefetch->ring_seconds * 1000.0,
+        prefetch->high_water, prefetch->low_water, prefetch->empty,
+        prefetch->reads ? prefetch->read_total * 1000.0 / prefetch->reads : 0.0, prefetch->read_max * 1000.0);
+    show_dialog_message(msg);
+}
+
 int
 main(int argc, char **argv)
 {
     FILE *file;
     int  samples;
-    char *sample_buffer;
+    char *sample_buffer = NULL;
+    char *mapped_data = NULL;
+    char *buffer;
+    void *map_base = NULL;
+    size_t map_size = 0;
+    struct rusage start_usage;
+    const char *env;
+    prefetch_t prefetch;
+    int prefetching = 0;
 
     int rtn, final_return_code = -1, exit_application = 0;
 
@@ -332,6 +447,17 @@ main(int argc, char **argv)
      */
     create_dialog();
 
+    memset(&prefetch, 0, sizeof(prefetch));
+
+    env = getenv("PLAYWAV_MMAP");
+    map_file = env && atoi(env) == 1;
+    env = getenv("PLAYWAV_PCM_MMAP");
+    pcm_mmap = env && atoi(env) == 1;
+    env = getenv("PLAYWAV_PREFETCH_MS");
+    if (env) {
+        prefetch_ms = atoi(env);
+    }
+
     /*
      * Open and check the input file.
      */
@@ -374,11 +500,34 @@ main(int argc, char **argv)
 
     bsize = setup.buf.block.frag_size;
     samples = find_tag(file, "data");
-    sample_buffer = malloc(bsize);
-    if (!sample_buffer) {
-        goto fail3;
+    if (map_file) {
+        mapped_data = map_data(file, &samples, &map_base, &map_size);
+        if (!mapped_data) {
+            err("mmap failed");
+            goto fail5;
+        }
+    } else if (prefetch_ms <= 0) {
+        sample_buffer = malloc(bsize);
+        if (!sample_buffer) {
+            goto fail5;
+        }
     }
 
+    /*
+     * The reader thread takes over the file, the playback loop only takes
+     * blocks off the ring.
+     */
+    if (prefetch_ms > 0) {
+        if (prefetch_start(&prefetch, file, mapped_data, samples, bsize, ENDIAN_LE32(wav_header.avg_bytes_per_sec),
+                prefetch_ms) != EXIT_SUCCESS) {
+            err("prefetch_start failed");
+            goto fail5;
+        }
+        prefetching = 1;
+    }
+
+    getrusage(RUSAGE_SELF, &start_usage);
+
     FD_ZERO(&rfds);
     FD_ZERO(&wfds);
     bytes_read = 1;
@@ -444,6 +593,7 @@ main(int argc, char **argv)
         rtn = max(snd_mixer_file_descriptor(mixer_handle),
                    snd_pcm_file_descriptor(pcm_handle, SND_PCM_CHANNEL_PLAYBACK));
 
+        selects++;
         if (select(rtn + 1, &rfds, &wfds, NULL, NULL) == -1) {
             err("select");
             goto fail5;
@@ -453,9 +603,32 @@ main(int argc, char **argv)
             snd_pcm_channel_status_t status;
             int written = 0;
 
-            if ((bytes_read = fread(sample_buffer, 1, min(samples - total_written, bsize), file)) <= 0)
-                continue;
-            written = snd_pcm_plugin_write(pcm_handle, sample_buffer, bytes_read);
+            if (prefetching) {
+                const prefetch_block_t *block = prefetch_peek(&prefetch);
+
+                if (!block) {
+                    if (prefetch_finished(&prefetch)) {
+                        bytes_read = 0;
+                    } else {
+                        /* The reader thread fell behind, give it a quarter of a fragment */
+                        usleep(250000LL * bsize / ENDIAN_LE32(wav_header.avg_bytes_per_sec));
+                    }
+                    continue;
+                }
+                buffer = (char *) block->data;
+                bytes_read = block->size;
+            } else if (mapped_data) {
+                /* The fragment is written from where it is in the file, no copy is made first */
+                buffer = mapped_data + total_written;
+                bytes_read = min(samples - total_written, bsize);
+            } else {
+                buffer = sample_buffer;
+                file_reads++;
+                if ((bytes_read = fread(sample_buffer, 1, min(samples - total_written, bsize), file)) <= 0)
+                    continue;
+            }
+            pcm_writes++;
+            written = snd_pcm_plugin_write(pcm_handle, buffer, bytes_read);
             if (written < bytes_read) {
                 memset(&status, 0, sizeof(status));
                 status.channel = SND_PCM_CHANNEL_PLAYBACK;
@@ -464,6 +637,9 @@ main(int argc, char **argv)
                     goto fail5;
                 }
 
+                if (status.status == SND_PCM_STATUS_UNDERRUN) {
+                    underruns++;
+                }
                 if (status.status == SND_PCM_STATUS_READY ||
                     status.status == SND_PCM_STATUS_UNDERRUN) {
                     if (snd_pcm_plugin_prepare(pcm_handle, SND_PCM_CHANNEL_PLAYBACK) < 0) {
@@ -473,7 +649,11 @@ main(int argc, char **argv)
                 }
                 if (written < 0)
                     written = 0;
-                written += snd_pcm_plugin_write(pcm_handle, sample_buffer + written, bytes_read - written);
+                pcm_writes++;
+                written += snd_pcm_plugin_write(pcm_handle, buffer + written, bytes_read - written);
+            }
+            if (prefetching) {
+                prefetch_release(&prefetch);
             }
             total_written += written;
         }
@@ -481,6 +661,11 @@ main(int argc, char **argv)
 
 success:
     bytes_read = snd_pcm_plugin_flush(pcm_handle, SND_PCM_CHANNEL_PLAYBACK);
+    show_cost(&start_usage, total_written);
+    if (prefetching) {
+        prefetch_stop(&prefetch);
+        show_prefetch(&prefetch);
+    }
     final_return_code = 0;
     /*
      * there are return codes to these close calls, but we would do the same
@@ -491,8 +676,14 @@ fail5:
 fail4:
     snd_pcm_close(pcm_handle);
 fail3:
+    /* The reader thread must be gone before the file and the mapping are */
+    prefetch_stop(&prefetch);
     free(sample_buffer);
     sample_buffer = NULL;
+    if (map_base) {
+        munmap(map_base, map_size);
+        map_base = NULL;
+    }
 fail2:
     fclose(file);
 fail1:
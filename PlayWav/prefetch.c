@@ -0,0 +1,224 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "prefetch.h"
+
+/*
+ * The indices and flags are read and written with full barrier atomics, so a
+ * block is filled before the head publishes it and written before the tail
+ * hands it back. Each is only written by one thread.
+ */
+static unsigned
+load(volatile unsigned *index)
+{
+    return __sync_fetch_and_add(index, 0);
+}
+
+static int
+load_flag(volatile int *flag)
+{
+    return __sync_fetch_and_add(flag, 0);
+}
+
+static double
+now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static void
+sleep_for(double seconds)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t) seconds;
+    ts.tv_nsec = (long) ((seconds - ts.tv_sec) * 1000000000.0);
+    nanosleep(&ts, NULL);
+}
+
+/*
+ * Brings every page of a mapped block into memory.
+ */
+static void
+touch(const char *data, int size)
+{
+    const volatile char *p = (const volatile char *) data;
+    long page = sysconf(_SC_PAGESIZE);
+    int i;
+
+    for (i = 0; i < size; i += page) {
+        (void) p[i];
+    }
+    (void) p[size - 1];
+}
+
+static void *
+reader(void *arg)
+{
+    prefetch_t *prefetch = (prefetch_t *) arg;
+    int offset = 0;
+
+    while (offset < prefetch->size && !load_flag(&prefetch->stop)) {
+        unsigned head = load(&prefetch->head);
+        unsigned fill = head - load(&prefetch->tail);
+        prefetch_block_t *block = &prefetch->blocks[head & (prefetch->count - 1)];
+        int size = prefetch->size - offset;
+        double start, latency;
+
+        if (fill == prefetch->count) {
+            /* Full, let a quarter of the ring play before looking again */
+            sleep_for(prefetch->ring_seconds / 4);
+            continue;
+        }
+
+        if (size > prefetch->block_size) {
+            size = prefetch->block_size;
+        }
+
+        start = now();
+        if (prefetch->mapped) {
+            block->data = prefetch->mapped + offset;
+            touch(block->data, size);
+        } else {
+            char *storage = prefetch->storage + (head & (prefetch->count - 1)) * prefetch->block_size;
+            size = fread(storage, 1, size, prefetch->file);
+            if (size <= 0) {
+                break;
+            }
+            block->data = storage;
+        }
+        latency = now() - start;
+
+        if (latency > prefetch->read_max) {
+            prefetch->read_max = latency;
+        }
+        prefetch->read_total += latency;
+        prefetch->reads++;
+
+        block->size = size;
+        offset += size;
+        __sync_fetch_and_add(&prefetch->head, 1);
+
+        if (fill + 1 > prefetch->high_water) {
+            prefetch->high_water = fill + 1;
+        }
+    }
+
+    __sync_lock_test_and_set(&prefetch->done, 1);
+    return NULL;
+}
+
+int
+prefetch_start(prefetch_t *prefetch, FILE *file, const char *mapped, int size, int block_size,
+    int bytes_per_sec, int buffer_ms)
+{
+    unsigned blocks = (unsigned) (((double) buffer_ms * bytes_per_sec / 1000 + block_size - 1) / block_size);
+
+    memset(prefetch, 0, sizeof(*prefetch));
+
+    /* A power of two, so the free running indices wrap cleanly */
+    prefetch->count = 2;
+    while (prefetch->count < blocks) {
+        prefetch->count *= 2;
+    }
+    prefetch->block_size = block_size;
+    prefetch->ring_seconds = (double) prefetch->count * block_size / bytes_per_sec;
+    prefetch->file = file;
+    prefetch->mapped = mapped;
+    prefetch->size = size;
+    prefetch->low_water = prefetch->count;
+
+    prefetch->blocks = (prefetch_block_t *) calloc(prefetch->count, sizeof(prefetch_block_t));
+    if (!prefetch->blocks) {
+        return EXIT_FAILURE;
+    }
+
+    if (!mapped) {
+        prefetch->storage = (char *) malloc(prefetch->count * block_size);
+        if (!prefetch->storage) {
+            prefetch_stop(prefetch);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (pthread_create(&prefetch->thread, NULL, reader, prefetch) != 0) {
+        prefetch_stop(prefetch);
+        return EXIT_FAILURE;
+    }
+    prefetch->started = 1;
+
+    /* Fill the ring before playback starts */
+    while (load(&prefetch->head) < prefetch->count && !load_flag(&prefetch->done)) {
+        sleep_for(0.001);
+    }
+
+    return EXIT_SUCCESS;
+}
+
+const prefetch_block_t *
+prefetch_peek(prefetch_t *prefetch)
+{
+    unsigned tail = load(&prefetch->tail);
+    unsigned fill = load(&prefetch->head) - tail;
+
+    if (fill == 0) {
+        if (!load_flag(&prefetch->done)) {
+            prefetch->empty++;
+        }
+        return NULL;
+    }
+
+    /* The ring drains at the end of the data, that does not count */
+    if (fill < prefetch->low_water && !load_flag(&prefetch->done)) {
+        prefetch->low_water = fill;
+    }
+
+    return &prefetch->blocks[tail & (prefetch->count - 1)];
+}
+
+void
+prefetch_release(prefetch_t *prefetch)
+{
+    __sync_fetch_and_add(&prefetch->tail, 1);
+}
+
+int
+prefetch_finished(prefetch_t *prefetch)
+{
+    /* Check done first, the last block is queued before it is set */
+    return load_flag(&prefetch->done) && load(&prefetch->tail) == load(&prefetch->head);
+}
+
+void
+prefetch_stop(prefetch_t *prefetch)
+{
+    if (prefetch->started) {
+        __sync_lock_test_and_set(&prefetch->stop, 1);
+        pthread_join(prefetch->thread, NULL);
+        prefetch->started = 0;
+    }
+
+    free(prefetch->storage);
+    prefetch->storage = NULL;
+    free(prefetch->blocks);
+    prefetch->blocks = NULL;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2011-2012 Research In Motion Limited.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PREFETCH_H_
+#define PREFETCH_H_
+
+#include <pthread.h>
+#include <stdio.h>
+
+/**
+ * One fragment sized block of sample data, ready to be written.
+ */
+typedef struct {
+    const char *data;
+    int size;
+} prefetch_block_t;
+
+/**
+ * Reads the sample data ahead of playback on a thread of its own.
+ *
+ * The reader thread fills a single producer, single consumer ring of
+ * fragment sized blocks, so a slow read only empties the ring instead of
+ * stalling the loop that feeds the PCM device. The loop takes blocks off the
+ * ring without locks or system calls.
+ *
+ * When reading from a file each block has its own storage that the data is
+ * read into. When the data is memory mapped the blocks point into the
+ * mapping, and the reader thread touches each page of a block before queuing
+ * it, so any page fault happens on the reader thread.
+ */
+typedef struct {
+    prefetch_block_t *blocks;
+    char *storage;
+    unsigned count;
+    int block_size;
+    double ring_seconds;
+
+    FILE *file;
+    const char *mapped;
+    int size;
+
+    pthread_t thread;
+    int started;
+
+    /* Only written by the reader thread. */
+    volatile unsigned head;
+    volatile int done;
+    /* Most blocks queued, and the longest and total time taken to read a block */
+    unsigned high_water;
+    double read_max;
+    double read_total;
+    int reads;
+
+    /* Only written by the playback loop, kept on its own cache line. */
+    char padding[64];
+    volatile unsigned tail;
+    volatile int stop;
+    /* Fewest blocks queued when one was taken before the end, and times the ring was found empty */
+    unsigned low_water;
+    int empty;
+} prefetch_t;
+
+/**
+ * Allocates a ring holding at least the given duration of audio, rounded up
+ * to a power of two number of blocks, starts the reader thread and waits for
+ * it to fill the ring.
+ *
+ * @param file the file to read from, positioned at the start of the data
+ * @param mapped the data when it is memory mapped, otherwise NULL
+ * @param size the number of bytes to read
+ * @param block_size the fragment size
+ * @param bytes_per_sec the data rate of the audio
+ * @param buffer_ms the duration of audio the ring must hold
+ * @return @c EXIT_SUCCESS or @c EXIT_FAILURE
+ */
+int prefetch_start(prefetch_t *prefetch, FILE *file, const char *mapped, int size, int block_size,
+    int bytes_per_sec, int buffer_ms);
+
+/**
+ * Returns the oldest block without taking it off the ring, so that it can be
+ * written in place.
+ *
+ * @return the block, or NULL if the ring is empty
+ */
+const prefetch_block_t *prefetch_peek(prefetch_t *prefetch);
+
+/**
+ * Hands the block returned by prefetch_peek() back to the reader thread.
+ */
+void prefetch_release(prefetch_t *prefetch);
+
+/**
+ * Returns whether all of the data has been read and taken off the ring.
+ */
+int prefetch_finished(prefetch_t *prefetch);
+
+/**
+ * Stops the reader thread, waits for it and frees the ring.
+ */
+void prefetch_stop(prefetch_t *prefetch);
+
+#endif /* PREFETCH_H_ */